@@ -0,0 +1,88 @@
+#ifndef ANTI_ALIASING_HPP
+#define ANTI_ALIASING_HPP
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <string_view>
+
+enum class AntiAliasingMode { Off, Msaa2, Msaa4, Msaa8, Fxaa, Taa };
+
+constexpr AntiAliasingMode antiAliasingModes[]{
+    AntiAliasingMode::Off,   AntiAliasingMode::Msaa2, AntiAliasingMode::Msaa4,
+    AntiAliasingMode::Msaa8, AntiAliasingMode::Fxaa,  AntiAliasingMode::Taa};
+
+const char *antiAliasingModeName(AntiAliasingMode mode);
+// Takes the names antiAliasingModeName() gives; throws on anything else.
+AntiAliasingMode parseAntiAliasingMode(std::string_view name);
+
+// Anti-aliasing picked at runtime, around the drawing of a scene:
+//   Off    draws straight into the current framebuffer
+//   MSAA   draws into a 2, 4 or 8 sample target and resolves it
+//   FXAA   draws into a plain target and smooths edges found from luma
+//   TAA    jitters the projection by a sub-pixel Halton offset every frame
+//          and blends with the previous result, reprojected with motion
+//          vectors and clamped to the current 3x3 neighborhood in YCoCg so
+//          that stale colors do not ghost
+// For TAA, fragment shaders write their motion to location 1, as a vec2
+// (ndc - previousNdc) * 0.5 from unjittered positions; without it, moving
+// things smear until the clamp catches them. Other modes ignore it.
+//
+// The scene is drawn at the size of the viewport that was current at
+// beginFrame(), so this composes with DynamicResolution; TAA starts its
+// history over whenever that size changes.
+class AntiAliasing {
+public:
+  AntiAliasing(size_t width, size_t height,
+               AntiAliasingMode mode = AntiAliasingMode::Off);
+  ~AntiAliasing();
+  AntiAliasing(const AntiAliasing &) = delete;
+  AntiAliasing &operator=(const AntiAliasing &) = delete;
+
+  // Both reallocate the targets only when something changed.
+  void setMode(AntiAliasingMode mode);
+  void resize(size_t width, size_t height);
+  AntiAliasingMode mode() const { return _mode; }
+
+  // Clears the scene's target to clearColor, depth 1 and no motion, and
+  // makes it the draw target; draw the scene next, without clearing again.
+  void beginFrame(glm::vec4 clearColor);
+  // The projection, shifted by this frame's jitter under TAA; call between
+  // beginFrame() and endFrame().
+  glm::mat4 jitter(const glm::mat4 &projection) const;
+  // Resolves the scene into the framebuffer and viewport that were current
+  // at beginFrame(), and restores them. Depth testing is off while it draws
+  // and restored afterwards; the program and vertex array are not.
+  void endFrame();
+
+  // Memory held by the targets of the current mode.
+  size_t targetBytes() const;
+
+private:
+  void createTargets();
+  void deleteTargets();
+
+  size_t _width, _height, _renderWidth{}, _renderHeight{};
+  AntiAliasingMode _mode;
+
+  GLuint _textures[3]{}; // color, depth, motion
+  GLuint _framebuffer{};
+  GLuint _historyTextures[2]{}, _historyFramebuffers[2]{};
+  bool _historyValid{};
+  size_t _historyWidth{}, _historyHeight{};
+  GLuint _fxaaProgram{}, _taaProgram{}, _emptyVertexArray{};
+  GLint _fxaaTexelSizeLoc{}, _fxaaUvMaxLoc{}, _fxaaOriginLoc{};
+  GLint _taaTexelSizeLoc{}, _taaUvScaleLoc{}, _taaRenderSizeLoc{},
+      _taaHistoryWeightLoc{};
+  GLint _previousFramebuffer{}, _previousViewport[4]{};
+  uint64_t _frame{};
+};
+
+// Draws a wheel of thin spinning spokes offscreen at 1920x1080 in every
+// mode, and prints the GPU time of each, scene included, and the memory its
+// targets take.
+void benchmarkAntiAliasing();
+
+#endif // ANTI_ALIASING_HPP
@@ -0,0 +1,61 @@
+#ifndef ASSET_CACHE_HPP
+#define ASSET_CACHE_HPP
+
+#include "job_system.hpp"
+#include "mesh.hpp"
+#include "texture_compression.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// xxHash64. Cheap enough to rehash every source on each import, which is what
+// lets the cache ignore timestamps.
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+uint64_t hashFile(const std::filesystem::path &path, uint64_t seed = 0);
+
+struct AssetCacheStats {
+  size_t hits, misses;
+  double secondsBuilding; // spent on misses
+  double secondsSaved;    // what the hits took to build originally
+};
+
+// Derived artifacts stored under the hash of everything they were built from,
+// so a changed source or setting simply misses instead of invalidating
+// anything. Safe to use from several threads.
+class AssetCache {
+public:
+  using Builder = std::function<void(const std::filesystem::path &)>;
+
+  explicit AssetCache(const std::filesystem::path &directory);
+
+  // Path of the artifact for key, running build on a temporary path and
+  // moving the result into place first if it isn't cached yet.
+  std::filesystem::path fetch(uint64_t key, std::string_view extension,
+                              const Builder &build);
+  AssetCacheStats stats() const;
+
+private:
+  std::filesystem::path _directory;
+  mutable std::mutex _mutex;
+  AssetCacheStats _stats{};
+};
+
+// Meshes after loadObj and optimizeMesh, materials included.
+void saveMeshArtifact(const Mesh &mesh, const std::filesystem::path &path);
+Mesh loadMeshArtifact(const std::filesystem::path &path);
+
+struct ImportedAsset {
+  std::filesystem::path source, artifact;
+};
+
+// Brings the artifacts of every OBJ and PPM under root up to date, building
+// the changed ones as jobs, and prints how much the cache saved.
+std::vector<ImportedAsset>
+importAssetTree(const std::filesystem::path &root, AssetCache &cache,
+                const BcEncodeSettings &textureSettings, JobSystem &jobs);
+
+#endif // ASSET_CACHE_HPP
@@ -0,0 +1,121 @@
+#ifndef ASSET_PACK_HPP
+#define ASSET_PACK_HPP
+
+#include "lod.hpp"
+#include "mesh.hpp"
+#include "meshlet.hpp"
+#include "quantization.hpp"
+#include "texture_compression.hpp"
+
+#include "glad/glad.h"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+// Pack layout: a PackHeader, the PackEntry table, then every blob aligned to
+// packAlignment. Blobs are stored exactly as the GPU consumes them, so the
+// runtime never parses anything.
+
+constexpr size_t packAlignment{16};
+
+enum class PackEntryType : uint32_t { Mesh, Texture };
+
+enum class PackBlob : size_t {
+  Vertices,
+  Indices,
+  Submeshes,
+  Materials,
+  Lods,
+  Meshlets,
+  MeshletBounds,
+  QuantizedVertices,
+  TextureLevels = 0
+};
+
+struct PackHeader {
+  uint32_t magic, version, entryCount, padding;
+  uint64_t entriesOffset, fileSize;
+};
+
+// Materials as stored in the pack, laid out for a std430 buffer.
+struct PackedMaterial {
+  glm::vec3 kd;
+  float d;
+  glm::vec3 ks;
+  float ns;
+  glm::vec3 ke;
+  float ni;
+  int32_t illum;
+  int32_t diffuseTexture; // entry index, or -1
+  // Ka as half floats, packHalf2x16(r, g) then packHalf2x16(b, 0), in the
+  // two words std430 would otherwise leave as padding before uvTransform.
+  uint32_t ka[2];
+  // Diffuse UVs are sampled at uv * zw + xy; folds the MTL -o/-s options,
+  // the flip from OBJ's bottom-up v to the texture's top-down rows, and the
+  // texture's place in its atlas page.
+  glm::vec4 uvTransform;
+};
+static_assert(sizeof(PackedMaterial) == 80);
+
+// A level of detail as stored in the pack: a range of the Submeshes blob,
+// which holds every level's submeshes back to back, finest first.
+struct PackedLod {
+  uint32_t firstSubmesh, submeshCount;
+  float error;
+  uint32_t padding;
+};
+
+struct PackEntry {
+  char name[64];
+  PackEntryType type;
+  uint32_t format; // textures: BcFormat
+  uint32_t width, height, levelCount;
+  uint32_t vertexCount, indexCount, submeshCount, materialCount, lodCount;
+  uint32_t meshletCount;
+  float boundsMin[3], boundsExtent[3]; // QuantizedMesh::dequantization()
+  uint32_t padding;
+  uint64_t blobOffsets[8], blobSizes[8];
+};
+static_assert(sizeof(PackEntry) == 264);
+
+// Read-only memory mapping of a baked pack. Opening it checks the entry
+// table against the file, so that every blob, count and cross reference in
+// it can be trusted afterwards; a truncated or corrupt pack throws instead.
+class AssetPack {
+public:
+  explicit AssetPack(const std::filesystem::path &packPath);
+
+  ~AssetPack();
+
+  AssetPack(const AssetPack &) = delete;
+  AssetPack &operator=(const AssetPack &) = delete;
+
+  size_t entryCount() const;
+  const PackEntry &entry(size_t index) const;
+  const PackEntry *find(std::string_view name) const;
+  const void *blob(const PackEntry &entry, PackBlob blob) const;
+
+  GLuint createBuffer(const PackEntry &entry, PackBlob blob) const;
+  GLuint createTexture(const PackEntry &entry) const;
+
+private:
+  bool isValid() const;
+  void unmap();
+
+  const uint8_t *_data{};
+  size_t _size{};
+  void *_file{}, *_mapping{};
+};
+
+// Bakes OBJ meshes (optimized, split into meshlets and with their LOD chains),
+// the PPM textures their materials reference and any loose PPMs among sources
+// into a single pack.
+void bakeAssetPack(const std::vector<std::filesystem::path> &sources,
+                   const std::filesystem::path &packPath,
+                   const BcEncodeSettings &textureSettings);
+
+#endif // ASSET_PACK_HPP
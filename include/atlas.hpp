@@ -0,0 +1,41 @@
+#ifndef ATLAS_HPP
+#define ATLAS_HPP
+
+#include "image.hpp"
+
+#include "glm/vec2.hpp"
+
+#include <vector>
+
+struct AtlasSettings {
+  size_t pageSize{256};
+  // Images larger than this on either side are left out of the atlas.
+  size_t maxImageSize{64};
+  // Edge pixels replicated around each image; a padding of 2^k keeps mip
+  // levels 0 to k free of bleeding from the neighbours.
+  size_t padding{4};
+};
+
+// Where an image ended up: its UVs map into the page as
+// uv * uvScale + uvOffset.
+struct AtlasRegion {
+  size_t page;
+  glm::vec2 uvOffset, uvScale;
+};
+
+struct TextureAtlas {
+  std::vector<Image> pages;
+  std::vector<AtlasRegion> regions; // parallel to the packed images
+  size_t mipSafeLevels;             // levels to keep when mipmapping pages
+
+  static constexpr size_t notPacked{~size_t{}}; // AtlasRegion::page value
+};
+
+// Packs images into as few pages as possible with stb_rect_pack. Images the
+// settings exclude get a region whose page is TextureAtlas::notPacked. Only
+// clamp-addressed textures can be atlased: repeating UVs would wrap into the
+// neighbours.
+TextureAtlas packAtlas(const std::vector<Image> &images,
+                       const AtlasSettings &settings = {});
+
+#endif // ATLAS_HPP
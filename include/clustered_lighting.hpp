@@ -0,0 +1,111 @@
+#ifndef CLUSTERED_LIGHTING_HPP
+#define CLUSTERED_LIGHTING_HPP
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// A point or spot light as shaders read it (std430). Spot lights fade from
+// cosInner to cosOuter around direction, and cosInner must stay above
+// cosOuter; point lights have cosOuter = -2.
+struct Light {
+  glm::vec3 position;
+  float range;
+  glm::vec3 color;
+  float intensity;
+  glm::vec3 direction;
+  float cosOuter;
+  float cosInner;
+  float padding[3];
+};
+
+Light pointLight(glm::vec3 position, float range, glm::vec3 color,
+                 float intensity = 1);
+Light spotLight(glm::vec3 position, glm::vec3 direction, float range,
+                float innerAngle, float outerAngle, glm::vec3 color,
+                float intensity = 1);
+
+// Clustered forward shading. The view frustum is split into a grid of
+// clusters, gridX x gridY tiles on screen by gridZ slices growing
+// exponentially with depth; every frame a compute pass finds the lights
+// touching each cluster, and fragments then only loop over the lights of
+// their own cluster, so their cost follows the lights nearby rather than the
+// lights in the scene. Clusters keep up to maxLightsPerCluster lights; the
+// rest are ignored.
+//
+// Fragment shaders get the lists, and MTL Blinn-Phong shading over them,
+// from clusteredShadingSource.
+class ClusteredLighting {
+public:
+  static constexpr uint32_t gridX{16}, gridY{9}, gridZ{24};
+  static constexpr uint32_t clusterCount{gridX * gridY * gridZ};
+  static constexpr uint32_t maxLightsPerCluster{256};
+  // Fixed, since clusteredShadingSource names them.
+  static constexpr GLuint paramsBinding{2}; // uniform block
+  static constexpr GLuint lightsBinding{4}, countsBinding{5},
+      indicesBinding{6}, boundsBinding{7}; // shader storage
+
+  explicit ClusteredLighting(size_t maxLights);
+  ~ClusteredLighting();
+  ClusteredLighting(const ClusteredLighting &) = delete;
+  ClusteredLighting &operator=(const ClusteredLighting &) = delete;
+
+  // Replaces the lights; throws beyond maxLights.
+  void setLights(const Light *lights, size_t count);
+  size_t lightCount() const { return _lightCount; }
+  void setAmbient(glm::vec3 ambient) { _ambient = ambient; }
+
+  // Assigns the lights to the clusters of this camera, rebuilding the
+  // cluster bounds first if the projection or the viewport changed. Call
+  // once per frame before drawing; projection must be a perspective one with
+  // the given near and far planes.
+  void update(const glm::mat4 &view, const glm::mat4 &projection, float near,
+              float far, size_t width, size_t height);
+
+  // Binds what clusteredShadingSource reads.
+  void bind() const;
+
+  // Reads back how many lights each cluster got (slow; for statistics).
+  std::vector<uint32_t> clusterLightCounts() const;
+
+private:
+  struct Params {
+    glm::mat4 view;
+    uint32_t grid[4]; // gridX, gridY, gridZ, maxLightsPerCluster
+    glm::vec4 slicing; // tile width and height in pixels, slice scale, bias
+    glm::vec4 ambient;
+  };
+
+  void buildBounds(const glm::mat4 &projection, float near, float far);
+
+  size_t _maxLights, _lightCount{};
+  glm::vec3 _ambient{0.05f};
+  glm::mat4 _boundsProjection{0};
+  // Kept so that rebuilding them, whenever the viewport changes size, does
+  // not allocate.
+  std::vector<glm::vec4> _bounds;
+  size_t _boundsWidth{}, _boundsHeight{};
+  GLuint _program{}, _paramsBuffer{}, _lightsBuffer{}, _countsBuffer{},
+      _indicesBuffer{}, _boundsBuffer{};
+  GLint _lightCountLoc{};
+};
+
+// GLSL to insert right after a fragment shader's #version line. Declares
+//   vec3 shadeBlinnPhong(vec3 position, vec3 normal, vec3 eye, vec3 ka,
+//                        vec3 kd, vec3 ks, float ns, vec3 ke)
+// which sums MTL's terms over the lights of the fragment's cluster, with
+// world-space position, normal and eye; pass ks = 0 for illum 1.
+extern const char *const clusteredShadingSource;
+
+// Lights a field of boxes, then the same field behind rows of walls drawn
+// back to front, with 10 to 10000 lights of a fixed range, so that they
+// crowd together as they multiply, offscreen at 1280x720. Prints the GPU
+// time of the light assignment and of forward and deferred shading for each
+// count, along with the lights per cluster.
+void benchmarkClusteredLighting();
+
+#endif // CLUSTERED_LIGHTING_HPP
@@ -0,0 +1,46 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include "job_system.hpp"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// World-space bounds of every object, one array per component so that eight
+// objects load into one AVX2 register.
+struct CullingBounds {
+  std::vector<float> centerX, centerY, centerZ, radius;
+  std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+  size_t size() const { return radius.size(); }
+  void resize(size_t count);
+  // Sets the box and the sphere around it.
+  void set(size_t index, glm::vec3 boundsMin, glm::vec3 boundsMax);
+};
+
+// Spheres are cheaper to test, boxes are tighter.
+enum class CullShape { Sphere, Box };
+
+// Writes the indices, in increasing order, of the objects not entirely
+// outside one of the frustum planes to the front of visible and returns how
+// many there are. visible is only ever grown, to a little more than the
+// object count, so reusing it across frames costs no allocations. Large
+// inputs are split into jobs when given a job system.
+size_t frustumCull(const CullingBounds &bounds,
+                   const glm::mat4 &viewProjection, CullShape shape,
+                   std::vector<uint32_t> &visible, JobSystem *jobs = nullptr);
+
+// The same into caller-owned memory, such as a frame arena's, with room for
+// bounds.size() + 8 indices.
+size_t frustumCull(const CullingBounds &bounds,
+                   const glm::mat4 &viewProjection, CullShape shape,
+                   uint32_t *visible, JobSystem *jobs = nullptr);
+
+// Culls count random objects against a fixed camera and prints the time per
+// call for both shapes.
+void benchmarkFrustumCulling(size_t count, JobSystem *jobs = nullptr);
+
+#endif // CULLING_HPP
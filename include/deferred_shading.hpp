@@ -0,0 +1,67 @@
+#ifndef DEFERRED_SHADING_HPP
+#define DEFERRED_SHADING_HPP
+
+#include "clustered_lighting.hpp"
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+// Which way opaque geometry gets lit; both read the same ClusteredLighting,
+// so either can be picked per frame.
+enum class ShadingPath { Forward, Deferred };
+
+const char *shadingPathName(ShadingPath path);
+
+// Deferred shading over a compact G-buffer, 12 bytes per pixel:
+//   RGBA8     Kd, and the roughness sqrt(2 / (Ns + 2))
+//   RGB10_A2  octahedral world-space normal, and the luminance of Ks
+//   D32F      depth, from which view-space positions are reconstructed
+// Lighting is a compute pass over 16x16 tiles: every tile finds its depth
+// bounds, culls the lights against its own frustum into shared memory, and
+// shades its pixels with the lights that survived, using the same
+// Blinn-Phong as clusteredShadingSource. Ka is taken to be Kd.
+class DeferredShading {
+public:
+  static constexpr GLuint tileSize{16}, maxLightsPerTile{256};
+
+  DeferredShading(size_t width, size_t height);
+  ~DeferredShading();
+  DeferredShading(const DeferredShading &) = delete;
+  DeferredShading &operator=(const DeferredShading &) = delete;
+
+  void resize(size_t width, size_t height);
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+
+  // Clears the G-buffer and makes it the draw target, with depth testing on;
+  // draw opaque geometry next, with fragment shaders built on
+  // gBufferSource.
+  void beginGeometry();
+  // Lights the G-buffer with the lights lighting was last updated with, then
+  // draws the result into the framebuffer that was bound before
+  // beginGeometry(), where background pixels get clearColor.
+  void light(const ClusteredLighting &lighting, const glm::mat4 &projection,
+             glm::vec3 clearColor = glm::vec3{0});
+
+  GLuint depthTexture() const { return _textures[0]; }
+
+private:
+  void createTargets();
+  void deleteTargets();
+
+  size_t _width, _height;
+  GLuint _textures[4]{}; // depth, albedo and roughness, normal, lit color
+  GLuint _framebuffer{};
+  GLuint _lightingProgram{}, _presentProgram{}, _emptyVertexArray{};
+  GLint _inverseProjectionLoc{}, _lightCountLoc{}, _clearColorLoc{};
+  GLint _previousFramebuffer{}, _previousViewport[4]{};
+};
+
+// GLSL to insert right after a geometry pass fragment shader's #version
+// line. Declares
+//   void writeGBuffer(vec3 normal, vec3 kd, vec3 ks, float ns)
+// taking a world-space normal and MTL's terms.
+extern const char *const gBufferSource;
+
+#endif // DEFERRED_SHADING_HPP
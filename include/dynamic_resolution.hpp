@@ -0,0 +1,81 @@
+#ifndef DYNAMIC_RESOLUTION_HPP
+#define DYNAMIC_RESOLUTION_HPP
+
+#include "glad/glad.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Renders the scene offscreen at a fraction of the window's resolution and
+// stretches it over the window, picking the fraction every frame from the
+// GPU time the scene took against a frame-time budget. Cost is taken to go
+// with the pixel count, so the scale moves towards
+// sqrt(budget / time) times the current one: quickly when over budget,
+// slowly when well under it, and not at all in between, so that timing
+// noise does not make the image pulse.
+//
+// The target is allocated at full window size and the scene drawn into a
+// corner of it, so changing the scale never reallocates. Timings are read
+// back a couple of frames late, once the GPU has them, and never waited on.
+class DynamicResolution {
+public:
+  // The scene's share of the budget; the rest is left for upscaling and
+  // whatever is drawn at native resolution after endFrame().
+  static constexpr double sceneShare{0.9};
+
+  DynamicResolution(size_t width, size_t height,
+                    double budgetMs = 1000.0 / 60, float minScale = 0.5f,
+                    float maxScale = 1);
+  ~DynamicResolution();
+  DynamicResolution(const DynamicResolution &) = delete;
+  DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+  // Follows the window's size; reallocates only when it changed.
+  void resize(size_t width, size_t height);
+  void setBudget(double budgetMs) { _budgetMs = budgetMs; }
+  // Turns the controller off and keeps this scale, for comparisons.
+  void setFixedScale(float scale);
+  void setDynamic() { _fixed = false; }
+
+  // Adjusts the scale and makes the offscreen target, with its scaled
+  // viewport, the draw target; draw the scene next.
+  void beginFrame();
+  // Stretches the scene over the framebuffer that was bound before
+  // beginFrame(), restoring it and its viewport. Depth testing is off while
+  // it draws and restored afterwards; the program and vertex array are not.
+  void endFrame();
+
+  float scale() const { return _scale; }
+  size_t renderWidth() const { return _renderWidth; }
+  size_t renderHeight() const { return _renderHeight; }
+  // GPU time of the latest scene whose timing came back, 0 before any has.
+  double gpuMs() const { return _gpuMs; }
+
+private:
+  void createTarget();
+  void deleteTarget();
+  void adjust(double gpuMs);
+  void readTimings(size_t slot);
+
+  size_t _width, _height, _renderWidth, _renderHeight;
+  double _budgetMs, _gpuMs{};
+  float _minScale, _maxScale, _scale;
+  bool _fixed{};
+
+  GLuint _textures[2]{}; // color, depth
+  GLuint _framebuffer{};
+  GLuint _program{}, _emptyVertexArray{};
+  GLint _uvScaleLoc{}, _uvMaxLoc{};
+  GLint _previousFramebuffer{}, _previousViewport[4]{};
+  GLuint _queries[3][2]{}; // timestamps before and after the scene
+  bool _queryIssued[3]{};
+  bool _timed{}; // whether this frame's scene got a slot to time it in
+  uint64_t _frame{};
+};
+
+// Draws a scene whose shading cost swings between 1 and 4 times its
+// lightest, offscreen at 1280x720, at full resolution and then with dynamic
+// resolution, and prints how the frame times held against the budget.
+void benchmarkDynamicResolution();
+
+#endif // DYNAMIC_RESOLUTION_HPP
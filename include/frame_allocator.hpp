@@ -0,0 +1,150 @@
+#ifndef FRAME_ALLOCATOR_HPP
+#define FRAME_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Bump allocator over one fixed block. Allocating is a pointer increment and
+// everything is freed at once by reset(); destructors are never run, so only
+// trivially destructible data belongs here.
+class LinearArena {
+public:
+  explicit LinearArena(size_t capacity);
+
+  // Throws once the block is exhausted; the arena never grows, so size it
+  // after peak().
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  template <typename T> T *allocateArray(size_t count) {
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+  void reset() { _used = 0; }
+
+  size_t used() const { return _used; }
+  size_t peak() const { return _peak; }
+  size_t capacity() const { return _capacity; }
+
+private:
+  std::unique_ptr<std::byte[]> _memory;
+  size_t _capacity, _used{}, _peak{};
+};
+
+// Lets standard containers live in an arena; deallocation is a no-op.
+template <typename T> class ArenaAllocator {
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(LinearArena &arena) : _arena{&arena} {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : _arena{other._arena} {}
+
+  T *allocate(size_t count) { return _arena->allocateArray<T>(count); }
+  void deallocate(T *, size_t) {}
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &other) const {
+    return _arena == other._arena;
+  }
+
+private:
+  template <typename U> friend class ArenaAllocator;
+  LinearArena *_arena;
+};
+
+// Heap activity between two nextFrame() calls, across all threads.
+struct FrameMemoryStats {
+  size_t heapAllocations{}, heapBytes{};
+  size_t arenaBytes{};
+};
+
+// Two arenas that trade places every frame: whatever was allocated during
+// frame n stays valid through frame n + 1, long enough for data handed from
+// one frame to the next (or to the GPU upload of the next one).
+class FrameArena {
+public:
+  explicit FrameArena(size_t capacityPerFrame);
+
+  LinearArena &current() { return _arenas[_frame & 1]; }
+  LinearArena &previous() { return _arenas[~_frame & 1]; }
+
+  // Call once at the start of every frame, before allocating from it;
+  // recycles the arena of two frames ago and records the stats of the frame
+  // that just ended.
+  void nextFrame();
+
+  uint64_t frame() const { return _frame; }
+  const FrameMemoryStats &lastFrameStats() const { return _lastFrame; }
+
+private:
+  LinearArena _arenas[2];
+  uint64_t _frame{};
+  size_t _heapAllocationsAtStart{}, _heapBytesAtStart{};
+  FrameMemoryStats _lastFrame;
+};
+
+// Fixed number of slots threaded on a free list; create() returns nullptr
+// when they are all taken. Objects still alive when the pool dies are not
+// destroyed. Not thread-safe.
+template <typename T> class Pool {
+public:
+  explicit Pool(size_t capacity)
+      : _slots{std::make_unique<Slot[]>(capacity)}, _capacity{capacity} {
+    for (size_t i{}; i < capacity; ++i)
+      _slots[i].next = i + 1 < capacity ? &_slots[i + 1] : nullptr;
+    _free = capacity ? &_slots[0] : nullptr;
+  }
+  Pool(const Pool &) = delete;
+  Pool &operator=(const Pool &) = delete;
+
+  template <typename... Args> T *create(Args &&...args) {
+    if (!_free)
+      return nullptr;
+    auto slot{_free};
+    _free = slot->next;
+    ++_size;
+    return new (slot->object) T{std::forward<Args>(args)...};
+  }
+
+  void destroy(T *object) {
+    object->~T();
+    auto slot{reinterpret_cast<Slot *>(object)};
+    slot->next = _free;
+    _free = slot;
+    --_size;
+  }
+
+  size_t size() const { return _size; }
+  size_t capacity() const { return _capacity; }
+
+private:
+  union Slot {
+    Slot *next;
+    alignas(T) std::byte object[sizeof(T)];
+  };
+
+  std::unique_ptr<Slot[]> _slots;
+  Slot *_free;
+  size_t _capacity, _size{};
+};
+
+// Global operator new is replaced to count every heap allocation the program
+// makes, from any thread.
+size_t heapAllocationCount();
+size_t heapAllocatedBytes();
+
+// While one of these is alive, any heap allocation through operator new, on
+// any thread, fails an assert. Wrap the steady-state part of the frame in one
+// to prove it allocation-free. Does nothing when NDEBUG is defined.
+class HeapAllocationGuard {
+public:
+  explicit HeapAllocationGuard(bool active = true);
+  ~HeapAllocationGuard();
+  HeapAllocationGuard(const HeapAllocationGuard &) = delete;
+  HeapAllocationGuard &operator=(const HeapAllocationGuard &) = delete;
+
+private:
+  bool _active;
+};
+
+#endif // FRAME_ALLOCATOR_HPP
@@ -0,0 +1,106 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include "glad/glad.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FrameCaptureStats {
+  size_t captured{}, written{};
+  size_t dropped{}; // frames skipped because every buffer was still busy
+};
+
+// Screenshots and video capture without stalling the GPU. Every captured
+// frame is read into one of a ring of persistently mapped pixel-pack
+// buffers, guarded by a fence that is only polled, never waited on, by
+// later frames; once it has signaled, usually two or three frames later,
+// the buffer goes to a writer thread that encodes it to a PPM or appends it
+// to a Y4M stream (4:2:0, BT.601). Neither thread uses operator new per
+// frame, so capturing is allowed within a HeapAllocationGuard.
+class FrameCapture {
+public:
+  static constexpr size_t ringSize{3};
+
+  // Frames are the width x height pixels at the lower left corner of the
+  // read framebuffer; screenshots are saved as <prefix><frame>.ppm.
+  FrameCapture(size_t width, size_t height,
+               std::string screenshotPrefix = "screenshot-");
+  // Waits for the frames in flight and writes them.
+  ~FrameCapture();
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+
+  // Saves the next frame to end.
+  void takeScreenshot() { _screenshotRequested = true; }
+  // Appends every frame to end from now on to the file, overwriting it.
+  void startRecording(const std::filesystem::path &y4mPath,
+                      unsigned fps = 60);
+  // Waits for the recorded frames in flight and closes the file.
+  void stopRecording();
+  bool isRecording() const { return _recording; }
+
+  // Call every frame once it is drawn, before swapping buffers.
+  void endFrame();
+  // Writes the frames in flight, then captures width x height pixels from
+  // the next frame on; call it when the framebuffer is resized. A Y4M stream
+  // cannot change size, so a recording in progress ends here.
+  void resize(size_t width, size_t height);
+
+  FrameCaptureStats stats() const;
+
+private:
+  enum class SlotState { Free, Pending, Writing };
+
+  struct Slot {
+    GLuint buffer{};
+    const uint8_t *pixels{}; // RGBA, bottom row first
+    GLsync fence{};
+    SlotState state{SlotState::Free};
+    uint64_t frame{};
+    bool screenshot{}, video{};
+  };
+
+  static constexpr int closeVideo{-1};
+
+  void createBuffers();
+  void deleteBuffers();
+  // Hands the pending slots whose fence has signaled to the writer, oldest
+  // first; with wait, all of them.
+  void poll(bool wait);
+  // poll(true), then waits until the writer is idle.
+  void flush();
+  void enqueue(int task);
+  void writerLoop();
+  void writeScreenshot(const Slot &slot);
+  void writeVideoFrame(const Slot &slot);
+
+  size_t _width, _height;
+  std::string _screenshotPrefix, _videoPath;
+  unsigned _videoFps{};
+  bool _screenshotRequested{}, _recording{};
+  uint64_t _frame{};
+
+  Slot _slots[ringSize];
+  size_t _firstPending{}, _pendingCount{};
+
+  // Owned by the writer thread.
+  std::FILE *_video{};
+  std::vector<uint8_t> _rgb, _yuv;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _wake, _idle;
+  int _queue[ringSize + 1]; // slot indices or closeVideo
+  size_t _queueFirst{}, _queueSize{};
+  bool _quit{};
+  FrameCaptureStats _stats;
+  std::thread _writer;
+};
+
+#endif // FRAME_CAPTURE_HPP
@@ -0,0 +1,41 @@
+#ifndef GOLDEN_HPP
+#define GOLDEN_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Regression harness: every named scene is rendered frameCount times into an
+// offscreen framebuffer, its last frame is read back and compared with
+// <referenceDirectory>/<scene>.ppm, and its median frame time with the one
+// in <scene>.time. Scenes draw main.cpp's triangle without anti-aliasing
+// and under MSAA 4x, FXAA and TAA, and the Cornell box with cascaded shadows
+// and with clustered forward and deferred lighting, through the same modules
+// and shaders as the demo. The harness asks for a GL 4.5 core context and
+// all of these only use GLSL 4.50, so it runs on Mesa's llvmpipe, through
+// xvfb-run when there is no display. The images in assets/golden were
+// rendered by llvmpipe; frame times only mean something on the machine that
+// took them, so no .time goes with them, and the timing check is skipped
+// until a local --golden-update writes one.
+struct GoldenTestOptions {
+  std::filesystem::path referenceDirectory;
+  std::filesystem::path reportPath{"golden.json"};
+  // All of them when empty; names goldenSceneNames() lacks throw.
+  std::vector<std::string> scenes;
+  size_t frameCount{60};
+  // Overwrites the references with this run instead of comparing.
+  bool updateReferences{};
+  double minPsnr{40}, minSsim{0.98};
+  double maxSlowdown{1.25}; // median frame time over the reference one
+};
+
+// Names of the scenes the harness knows, in the order they run.
+std::vector<std::string> goldenSceneNames();
+
+// Prints a verdict per scene and writes every frame's CPU and GPU times,
+// along with the comparisons, to the JSON report. Returns whether all scenes
+// passed; the last frame of those that did not is saved beside the report as
+// <scene>.actual.ppm.
+bool runGoldenTests(const GoldenTestOptions &options);
+
+#endif // GOLDEN_HPP
@@ -0,0 +1,74 @@
+#ifndef GPU_SCENE_HPP
+#define GPU_SCENE_HPP
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// One object as shaders read it from the scene buffer (std430).
+struct GpuObject {
+  glm::mat4 model;
+  uint32_t material;
+  uint32_t padding[3];
+};
+
+struct GpuSceneUploadStats {
+  size_t dirtyObjects{}, uploadBytes{};
+  bool scattered{}; // through the compute pass rather than a plain copy
+};
+
+// Persistent GPU copy of every object's transform and material. Changes are
+// kept on a dirty list and sent once per frame by upload(), which costs in
+// proportion to what changed rather than to the size of the scene: either
+// the records plus their indices go into a small staging buffer and a
+// compute pass scatters them, or, when the dirty objects are packed closely
+// enough that it is cheaper, the range spanning them is copied as is.
+class GpuScene {
+public:
+  explicit GpuScene(size_t capacity);
+  ~GpuScene();
+  GpuScene(const GpuScene &) = delete;
+  GpuScene &operator=(const GpuScene &) = delete;
+
+  size_t capacity() const { return _objects.size(); }
+
+  void setTransform(uint32_t object, const glm::mat4 &model);
+  void setMaterial(uint32_t object, uint32_t material);
+  const GpuObject &object(uint32_t object) const { return _objects[object]; }
+
+  // Sends the pending changes; call once per frame before drawing. Shaders
+  // and buffer reads issued afterwards see them. The scatter pass leaves the
+  // current program as it found it, but not shader storage bindings 0 to 2.
+  void upload();
+
+  // Binds the scene buffer as an array of GpuObject.
+  void bind(GLuint binding) const;
+  GLuint buffer() const { return _buffer; }
+
+  const GpuSceneUploadStats &lastUploadStats() const { return _lastUpload; }
+  size_t totalUploadBytes() const { return _totalUploadBytes; }
+
+private:
+  void markDirty(uint32_t object);
+
+  std::vector<GpuObject> _objects; // CPU mirror, the source of every upload
+  std::vector<uint32_t> _dirty;
+  std::vector<uint8_t> _isDirty;
+  std::vector<GpuObject> _stagingRecords;
+
+  GLuint _program{}, _buffer{}, _stagingBuffers[2]{};
+  GLint _countLoc{};
+  size_t _stagingCapacity{}; // in records
+  GpuSceneUploadStats _lastUpload;
+  size_t _totalUploadBytes{};
+};
+
+// Keeps 100000 objects and changes some of them every frame, scattered over
+// the scene, in one run and then all of them, reading the buffer back after
+// each upload to check it against the CPU copy. Prints what each upload
+// sent, which way and how long it took.
+void benchmarkGpuScene();
+
+#endif // GPU_SCENE_HPP
@@ -0,0 +1,39 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// 8-bit RGB image, matching the binary PPMs (P6) under assets/textures.
+class Image {
+public:
+  Image() = default;
+  Image(size_t width, size_t height);
+  explicit Image(const std::filesystem::path &ppmPath);
+
+  size_t width() const;
+  size_t height() const;
+  size_t sizeInBytes() const;
+
+  uint8_t *data();
+  const uint8_t *data() const;
+  uint8_t *pixel(size_t x, size_t y);
+  const uint8_t *pixel(size_t x, size_t y) const;
+
+  void savePpm(const std::filesystem::path &ppmPath) const;
+
+private:
+  size_t _width{}, _height{};
+  std::vector<uint8_t> _pixels;
+};
+
+// Peak signal-to-noise ratio over all channels, in dB. Identical images
+// report infinity.
+double psnr(const Image &a, const Image &b);
+
+// Mean structural similarity of the luma, over 8x8 windows 4 pixels apart.
+// Identical images report 1.
+double ssim(const Image &a, const Image &b);
+
+#endif // IMAGE_HPP
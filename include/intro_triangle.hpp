@@ -0,0 +1,16 @@
+#ifndef INTRO_TRIANGLE_HPP
+#define INTRO_TRIANGLE_HPP
+
+// The shaders of main.cpp's spinning triangle, shared with the golden image
+// harness so that it checks what the demo actually draws. The vertex shader
+// takes positions at attribute 0 and colors at attribute 1, and the uniforms
+//   float t, previousT  the angle of this frame and of the previous one
+//   mat4 jitter         AntiAliasing::jitter(), the identity outside TAA
+// The fragment shader outlines the triangle and its center from the
+// barycentrics, read from gl_BaryCoordNV where the driver has it and
+// otherwise derived from gl_VertexID, and writes motion vectors to location
+// 1 for TAA.
+extern const char *const introTriangleVertexShaderSource;
+extern const char *const introTriangleFragmentShaderSource;
+
+#endif // INTRO_TRIANGLE_HPP
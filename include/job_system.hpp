@@ -0,0 +1,133 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include "frame_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs started with it; wait on it to join them.
+class JobCounter {
+public:
+  bool done() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+  std::atomic<size_t> _pending{};
+};
+
+// Fixed-size work-stealing pool. Every worker owns a Chase-Lev deque: it
+// pushes and pops jobs at the bottom, LIFO for locality, while idle workers
+// steal from the top. The thread that creates the JobSystem takes part as
+// worker 0 whenever it waits, so waiting never wastes a core; other threads
+// may submit jobs too, through a shared queue that is served in order.
+//
+// There are no fibers, so a job that depends on others simply waits on their
+// counter, running other jobs in the meantime.
+//
+// Jobs come from a fixed pool and parallelFor() doesn't go through
+// std::function, so it never touches the heap; run() only does when the
+// function's captures don't fit std::function's small buffer.
+class JobSystem {
+public:
+  // 0 threads means one per core, the creating thread included.
+  explicit JobSystem(size_t threadCount = 0);
+  ~JobSystem();
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  size_t threadCount() const { return _deques.size(); }
+
+  void run(std::function<void()> job, JobCounter *counter = nullptr);
+  void wait(JobCounter &counter);
+
+  // Calls fn(first, last) over [begin, end) in chunks of about grain items
+  // and returns once all of them are done.
+  template <typename Fn>
+  void parallelFor(size_t begin, size_t end, size_t grain, Fn fn) {
+    if (begin >= end)
+      return;
+    grain = std::max(grain, size_t{1});
+    JobCounter counter;
+    for (auto first{begin}; first < end; first += grain) {
+      auto last{std::min(first + grain, end)};
+      if (last == end) // the last chunk runs right here
+        fn(first, last);
+      else
+        runRange(&callRange<Fn>, &fn, first, last, &counter);
+    }
+    wait(counter);
+  }
+
+private:
+  // Either a function, or a range of a parallelFor() called through a plain
+  // function pointer.
+  struct Job {
+    std::function<void()> function;
+    void (*range)(void *context, size_t first, size_t last);
+    void *context;
+    size_t first, last;
+    JobCounter *counter;
+  };
+
+  template <typename Fn>
+  static void callRange(void *fn, size_t first, size_t last) {
+    (*static_cast<Fn *>(fn))(first, last);
+  }
+
+  void runRange(void (*range)(void *, size_t, size_t), void *context,
+                size_t first, size_t last, JobCounter *counter);
+  void submit(Job &&job);
+
+  // Chase-Lev deque with the memory orderings of Le et al. 2013. Fixed
+  // capacity; run() executes a job inline when its deque is full.
+  class Deque {
+  public:
+    bool push(Job *job);
+    Job *pop();
+    Job *steal();
+
+  private:
+    static constexpr int64_t capacity{4096};
+    alignas(64) std::atomic<int64_t> _top{};
+    alignas(64) std::atomic<int64_t> _bottom{};
+    std::atomic<Job *> _jobs[capacity];
+  };
+
+  void workerLoop(size_t index);
+  Job *findJob(size_t index);
+  static void invoke(Job &job);
+  void execute(Job *job); // and returns it to the pool
+
+  std::vector<std::unique_ptr<Deque>> _deques;
+  std::vector<std::thread> _threads;
+
+  std::mutex _jobPoolMutex;
+  Pool<Job> _jobPool;
+
+  // Jobs submitted from outside the pool, oldest first from _sharedFirst,
+  // in a ring as large as the job pool, which it therefore never overflows.
+  std::mutex _sharedMutex;
+  std::vector<Job *> _shared;
+  size_t _sharedFirst{};
+  std::atomic<size_t> _sharedCount{};
+
+  std::mutex _sleepMutex;
+  std::condition_variable _wake;
+  std::atomic<size_t> _queued{}, _sleepers{};
+  std::atomic<bool> _stopping{};
+};
+
+// Runs a fixed amount of work on 1, 2, 4... threads, up to maxThreads (0
+// means the number of cores), and prints the throughput of each. Counts past
+// the number of cores are marked as oversubscribed.
+void benchmarkJobSystem(size_t maxThreads = 0);
+
+#endif // JOB_SYSTEM_HPP
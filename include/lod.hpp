@@ -0,0 +1,54 @@
+#ifndef LOD_HPP
+#define LOD_HPP
+
+#include "mesh.hpp"
+
+#include <vector>
+
+// One level of detail: its own submesh ranges into the mesh's index buffer,
+// all levels sharing the same vertices.
+struct MeshLod {
+  float error; // object-space deviation from the full-detail mesh
+  std::vector<Submesh> submeshes;
+};
+
+struct LodSettings {
+  size_t levelCount{5}; // including the full-detail level
+  float reduction{0.5f}; // triangle ratio between consecutive levels
+};
+
+// Builds a chain of progressively coarser levels by quadric error metric
+// edge collapse (Garland and Heckbert 1997) and appends their indices to
+// mesh.indices. Level 0 is the mesh as given. Vertices on open borders never
+// move; those on attribute seams only collapse along the seam, together with
+// their copies on the other side, so UV and normal discontinuities survive
+// without cracking open.
+// Generation stops early when a level cannot be reduced any further.
+std::vector<MeshLod> generateLods(Mesh &mesh, const LodSettings &settings = {});
+
+struct LodSelectionSettings {
+  float fovY;           // radians
+  float viewportHeight; // pixels
+  float pixelThreshold{1};
+  float hysteresis{0.25f}; // fraction of the threshold
+};
+
+// Screen-space size, in pixels, of an object-space error seen at distance.
+float projectedLodError(float error, float distance,
+                        const LodSelectionSettings &settings);
+
+// Picks the coarsest level whose projected error stays under the threshold.
+// Moving away from currentLevel needs the error to clear the threshold by the
+// hysteresis margin, so instances near a boundary don't flicker between
+// levels. scale is the instance's uniform world scale.
+size_t selectLod(const std::vector<MeshLod> &lods, float distance, float scale,
+                 const LodSelectionSettings &settings, size_t currentLevel);
+
+// Builds the levels of an OBJ mesh and moves an instance of it away from a
+// 1080p camera until the coarsest level is picked, then back. Prints the
+// levels, the distances at which selectLod() switched, and whether every
+// pick kept within the pixel threshold (plus the hysteresis margin) without
+// a coarser level that would also have.
+void benchmarkLodSelection(const std::filesystem::path &objPath);
+
+#endif // LOD_HPP
@@ -0,0 +1,47 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct Vertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 uv;
+};
+
+// The subset of MTL that Blender writes for our assets.
+struct Material {
+  std::string name;
+  glm::vec3 ka{1}, kd{0.8f}, ks{0.5f}, ke{0};
+  float ns{250}, ni{1.45f}, d{1};
+  int illum{2};
+  std::string mapKd;
+  glm::vec2 mapKdOffset{0}, mapKdScale{1}; // map_Kd -o and -s options
+  bool mapKdClamp{};                       // map_Kd -clamp on
+};
+
+// A run of triangles drawn with a single material.
+struct Submesh {
+  uint32_t firstIndex, indexCount, material;
+};
+
+struct Mesh {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<Submesh> submeshes;
+  std::vector<Material> materials;
+};
+
+// Loads an OBJ file and the MTL libraries it references. Polygons are fanned
+// into triangles and every face corner gets its own vertex, in face order.
+Mesh loadObj(const std::filesystem::path &objPath);
+
+std::vector<Material> loadMtl(const std::filesystem::path &mtlPath);
+
+#endif // MESH_HPP
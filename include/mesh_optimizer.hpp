@@ -0,0 +1,44 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include "mesh.hpp"
+
+#include <vector>
+
+constexpr size_t defaultVertexCacheSize{16};
+
+struct VertexCacheStats {
+  float acmr; // vertex shader invocations per triangle, 0.5 at best
+  float atvr; // vertex shader invocations per vertex, 1 at best
+};
+
+// Simulates a FIFO post-transform cache over the mesh's index buffer.
+VertexCacheStats analyzeVertexCache(const Mesh &mesh,
+                                    size_t cacheSize = defaultVertexCacheSize);
+
+// Merges bitwise-identical vertices and rewrites the index buffer to match.
+void weldVertices(Mesh &mesh);
+
+// Reorders the triangles of each submesh with Tipsify (Sander, Nehab and
+// Barczak 2007) for a post-transform cache of the given size.
+void optimizeVertexCache(Mesh &mesh,
+                         size_t cacheSize = defaultVertexCacheSize);
+
+// Splits each submesh's (already cache-optimized) triangle order into
+// clusters at cache restarts and sorts them so that clusters facing away from
+// the mesh centre come first, which lets them occlude the rest.
+void optimizeOverdraw(Mesh &mesh, size_t cacheSize = defaultVertexCacheSize);
+
+// Renumbers vertices in order of first use and drops unreferenced ones.
+void optimizeVertexFetch(Mesh &mesh);
+
+struct MeshOptimizationStep {
+  const char *name;
+  VertexCacheStats stats;
+};
+
+// Runs every stage above in order and returns the cache statistics measured
+// before the first stage and after each one.
+std::vector<MeshOptimizationStep> optimizeMesh(Mesh &mesh);
+
+#endif // MESH_OPTIMIZER_HPP
@@ -0,0 +1,97 @@
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+
+#include "mesh.hpp"
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+constexpr size_t maxMeshletVertices{64}, maxMeshletTriangles{124};
+
+// A cluster of triangles drawn from a contiguous range of the index buffer.
+struct Meshlet {
+  uint32_t firstIndex, triangleCount, vertexCount, material;
+};
+
+// Bounding sphere and normal cone, laid out for a std430 buffer. A cutoff of
+// 1 marks a cone too wide to ever be backface culled.
+struct MeshletBounds {
+  glm::vec3 center;
+  float radius;
+  glm::vec3 coneAxis;
+  float coneCutoff;
+};
+
+struct MeshletSet {
+  std::vector<Meshlet> meshlets;
+  std::vector<MeshletBounds> bounds;
+};
+
+// Cuts each submesh's triangles, in index buffer order, into runs of up to
+// maxMeshletVertices vertices and maxMeshletTriangles triangles. The order is
+// left alone, so run optimizeMesh first: its cache-optimized order already
+// keeps neighbouring triangles together, and meshlets drawn in sequence then
+// keep both its cache and its overdraw ordering.
+MeshletSet buildMeshlets(const Mesh &mesh);
+
+struct MeshletCullStats {
+  uint32_t visibleMeshlets, visibleTriangles;
+};
+
+// GPU cluster culling: a compute pass tests every meshlet against the view
+// frustum and its normal cone, and appends one indirect draw per survivor.
+// Each command's baseInstance is the meshlet index, so vertex shaders can
+// fetch per-meshlet data such as the material through gl_BaseInstance.
+class MeshletCuller {
+public:
+  explicit MeshletCuller(const MeshletSet &set);
+
+  ~MeshletCuller();
+
+  MeshletCuller(const MeshletCuller &) = delete;
+  MeshletCuller &operator=(const MeshletCuller &) = delete;
+
+  // Dispatches the culling pass for one instance of the mesh.
+  void cull(const glm::mat4 &model, const glm::mat4 &viewProjection,
+            glm::vec3 cameraPosition) const;
+
+  // Draws the surviving meshlets with the caller's program, vertex array and
+  // index buffer bound.
+  void draw() const;
+
+  // Reads the counters of the last pass back; this waits for the GPU and is
+  // meant for profiling only.
+  MeshletCullStats stats() const;
+
+  GLuint meshletBuffer() const;
+
+  // The surviving meshlets' DrawElementsIndirectCommands, stats()
+  // .visibleMeshlets of them.
+  GLuint commandBuffer() const;
+
+private:
+  GLuint _program{}, _meshlets{}, _bounds{}, _commands{}, _counters{};
+  GLint _modelLoc{}, _planesLoc{}, _objectCameraLoc{}, _scaleLoc{},
+      _countLoc{};
+  size_t _meshletCount{};
+};
+
+// Loads, welds and optimizes an OBJ, cuts it into meshlets and views it from
+// a few cameras, one of them through a non-uniform scale. For each, prints
+// how many meshlets and triangles survive culling, the time of a culled
+// frame against drawing the whole mesh, and how many meshlets were dropped
+// although a triangle of theirs faces the camera inside the frustum.
+void benchmarkMeshletCulling(const std::filesystem::path &objPath);
+
+// The six planes of a view-projection matrix, normals pointing inwards
+// (Gribb and Hartmann).
+void extractFrustumPlanes(const glm::mat4 &viewProjection,
+                          glm::vec4 planes[6]);
+
+#endif // MESHLET_HPP
@@ -0,0 +1,88 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+#include "culling.hpp"
+#include "job_system.hpp"
+#include "mesh.hpp"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Software occlusion culling: a few big, simple occluders (walls, floors,
+// their simplified stand-ins) are rasterized into a small CPU depth buffer,
+// and object bounding boxes are tested against it before any draw is
+// recorded, all within the same frame. Occluders only need to be drawn
+// depth-wise, so the buffer is tiny, filled eight pixels at a time, and
+// split into tiles that are rasterized in parallel.
+//
+// Pixels are sampled at their centers, so an object seen only through a gap
+// narrower than a buffer pixel may be culled.
+class OcclusionBuffer {
+public:
+  static constexpr size_t tileSize{32};
+
+  // width must be a multiple of 8; a quarter of the screen or less in each
+  // direction is typical.
+  OcclusionBuffer(size_t width, size_t height);
+
+  // Starts a frame: forgets the occluders and sets the camera.
+  void begin(const glm::mat4 &viewProjection);
+  // Queues the mesh's triangles, clipped against the near plane.
+  void addOccluder(const Mesh &mesh, const glm::mat4 &model);
+  // Rasterizes the queued occluders; call before testing.
+  void rasterize(JobSystem *jobs = nullptr);
+
+  // Whether any part of the box could be in front of the occluders. Boxes
+  // crossing the near plane are always visible.
+  bool isVisible(glm::vec3 boundsMin, glm::vec3 boundsMax) const;
+
+  // Tests the boxes of the given objects, typically frustumCull()'s output,
+  // and writes the visible ones to visible, in order, returning how many
+  // there are. visible may be candidates itself.
+  size_t cull(const CullingBounds &bounds, const uint32_t *candidates,
+              size_t count, uint32_t *visible, JobSystem *jobs = nullptr) const;
+
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+  size_t triangleCount() const { return _triangles.size(); }
+  // Normalized device depth, from -1 at the near plane to 1 (cleared) at the
+  // far one.
+  const float *depth() const { return _depth.data(); }
+
+private:
+  // Edge functions scaled into barycentrics, and the depth plane, both in
+  // pixel coordinates.
+  struct Triangle {
+    float a[3], b[3], c[3];
+    float depthA, depthB, depthC;
+    int minX, minY, maxX, maxY; // inclusive pixel bounds
+  };
+
+  void addTriangle(const glm::vec4 clip[3]);
+  void rasterizeTile(size_t tile);
+  void rasterizeScalar(const Triangle &triangle, int minX, int minY, int maxX,
+                       int maxY);
+  void rasterizeAvx2(const Triangle &triangle, int minX, int minY, int maxX,
+                     int maxY);
+  // Whether a depth in the inclusive rectangle is behind minDepth.
+  bool anyBehind(int minX, int minY, int maxX, int maxY,
+                 float minDepth) const;
+
+  size_t _width, _height, _tilesX, _tilesY;
+  glm::mat4 _viewProjection{1};
+  std::vector<float> _depth;
+  std::vector<float> _tileMaxDepth; // the farthest depth in each tile
+  std::vector<Triangle> _triangles;
+  std::vector<std::vector<uint32_t>> _bins; // triangles overlapping each tile
+};
+
+// Builds a grid of walled rooms with furniture-sized objects, looks down it
+// from a corner, and prints how many objects survive frustum culling alone
+// and then occlusion culling, along with the time each step takes.
+void benchmarkOcclusionCulling(JobSystem *jobs = nullptr);
+
+#endif // OCCLUSION_HPP
@@ -0,0 +1,104 @@
+#ifndef PACK_RENDERER_HPP
+#define PACK_RENDERER_HPP
+
+#include "asset_pack.hpp"
+#include "bvh.hpp"
+#include "clustered_lighting.hpp"
+#include "culling.hpp"
+#include "deferred_shading.hpp"
+#include "frame_allocator.hpp"
+#include "gpu_scene.hpp"
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Draws every mesh of an asset pack, one instance of each side by side
+// along x, lit by a ring of point lights through clustered forward shading
+// or deferred shading.
+// Buffers are created straight from the pack's blobs and textures from its
+// BC blocks, so nothing is parsed or decoded; the pack is only read while
+// constructing, which also builds the BVHs that picking traces. Instance
+// transforms live in a GpuScene that the vertex shader indexes.
+class PackRenderer {
+public:
+  explicit PackRenderer(const AssetPack &pack);
+  ~PackRenderer();
+  PackRenderer(const PackRenderer &) = delete;
+  PackRenderer &operator=(const PackRenderer &) = delete;
+
+  // Submeshes drawn per frame when everything is in view, how many times a
+  // texture gets bound for them, and how many the last frame drew.
+  size_t drawCount() const { return _draws.size(); }
+  size_t textureBinds() const { return _textureBinds; }
+  size_t lastDrawCount() const { return _lastDrawCount; }
+
+  // The closest instance and triangle along a world-space ray, such as
+  // pickingRay() gives for the cursor.
+  RayHit pick(const Ray &ray) const;
+  const std::string &instanceName(uint32_t instance) const;
+
+  // Forward by default. Deferred writes no motion vectors, lights with what
+  // fits in DeferredShading's G-buffer and fills the pixels no geometry
+  // covers with background, which should match what the target was cleared
+  // to.
+  ShadingPath shadingPath() const { return _shadingPath; }
+  void setShadingPath(ShadingPath path) { _shadingPath = path; }
+  void setBackground(glm::vec3 background) { _background = background; }
+
+  // World-space bounds of every instance, to frame a camera with.
+  glm::vec3 boundsMin() const { return _boundsMin; }
+  glm::vec3 boundsMax() const { return _boundsMax; }
+
+  // Draws into the bound framebuffer, whose viewport is width x height, with
+  // depth testing on while it draws. projection must be a perspective one
+  // with the given near and far planes; jitter is applied on top of it, and
+  // motion vectors, computed without it, go to location 1 for TAA. The
+  // instances outside the frustum are culled; the frame's visible list and
+  // draw list are allocated from arena. The program and vertex array are not
+  // restored.
+  void draw(const glm::mat4 &view, const glm::mat4 &projection, float near,
+            float far, size_t width, size_t height, const glm::mat4 &jitter,
+            LinearArena &arena);
+
+private:
+  struct Instance {
+    GLuint vertexArray{}, buffers[3]{}; // vertices, indices, materials
+    glm::mat4 model{1}; // also in _gpuScene
+    glm::vec3 boundsMin, boundsExtent; // QuantizedMesh::dequantization()
+    std::string name;
+    std::unique_ptr<MeshBvh> bvh;
+  };
+  struct Draw {
+    uint32_t instance;
+    GLuint texture; // diffuse, 0 for none
+    Submesh submesh;
+  };
+
+  std::vector<GLuint> _textures; // by pack entry, 0 for meshes
+  std::vector<Instance> _instances;
+  std::vector<Draw> _draws;
+  size_t _lastDrawCount{};
+  CullingBounds _instanceBounds;
+  SceneBvh _scene;
+  size_t _textureBinds{};
+  glm::vec3 _boundsMin{0}, _boundsMax{0};
+  ClusteredLighting _lighting;
+  GpuScene _gpuScene; // instance transforms
+  ShadingPath _shadingPath{ShadingPath::Forward};
+  DeferredShading _deferred{1, 1}; // sized on the first deferred frame
+  glm::vec3 _background{0};
+  struct Program {
+    GLuint id{};
+    GLint objectLoc{}, boundsMinLoc{}, boundsExtentLoc{}, viewProjectionLoc{},
+        previousViewProjectionLoc{}, jitterLoc{}, eyeLoc{}, materialLoc{};
+  } _programs[2]; // by ShadingPath
+  glm::mat4 _previousViewProjection{0};
+};
+
+#endif // PACK_RENDERER_HPP
@@ -0,0 +1,90 @@
+#ifndef PATH_TRACER_HPP
+#define PATH_TRACER_HPP
+
+#include "bvh.hpp"
+#include "image.hpp"
+#include "job_system.hpp"
+#include "mesh.hpp"
+
+#include "glm/mat3x3.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// Reference renderer: a unidirectional path tracer over the same meshes and
+// MTL materials the rasterizer draws, for ground-truth images on machines
+// without a GPU. Materials map to a BSDF as follows:
+//   Ke           emission
+//   Kd           Lambertian reflectance
+//   Ks, Ns       GGX reflection with Schlick's Fresnel starting at Ks and a
+//                roughness of sqrt(2 / (Ns + 2)), for illum 2 and up
+//   d            opacity; the rest of the light is transmitted
+//   Ni           index of refraction of that transmission for illum 6 and 7,
+//                which refract; other illum values let it straight through
+//   illum 0      Kd as is, unlit; illum 1 is diffuse only
+// Textures are not sampled.
+class PathTracer {
+public:
+  static constexpr size_t tileSize{16}, maxBounces{16};
+
+  PathTracer(size_t width, size_t height);
+
+  // The mesh must outlive the tracer; the index is for addInstance().
+  uint32_t addMesh(const Mesh &mesh);
+  void addInstance(uint32_t mesh, const glm::mat4 &transform);
+
+  // Both start the accumulation over.
+  void setCamera(const glm::mat4 &view, const glm::mat4 &projection);
+  void setSkyColor(glm::vec3 color);
+
+  // Traces samplesPerPixel more paths through every pixel, tile by tile in
+  // parallel, and adds them to the running average.
+  void render(size_t samplesPerPixel = 1, JobSystem *jobs = nullptr);
+  size_t samplesPerPixel() const { return _sampleCount; }
+
+  // The average so far, clamped and encoded as sRGB.
+  Image image() const;
+
+private:
+  struct MeshData {
+    const Mesh *mesh;
+    std::unique_ptr<MeshBvh> bvh;
+    std::vector<uint32_t> triangleMaterials;
+  };
+
+  struct Instance {
+    uint32_t mesh;
+    glm::mat4 objectToWorld;
+    glm::mat3 normalToWorld;
+  };
+
+  glm::vec3 radiance(Ray ray, uint32_t &random) const;
+  void renderTile(size_t tile, size_t samples);
+
+  size_t _width, _height, _tilesX, _tilesY;
+  std::vector<MeshData> _meshes;
+  std::vector<Instance> _instances;
+  SceneBvh _bvh;
+  bool _bvhBuilt{};
+  glm::mat4 _inverseViewProjection{1};
+  glm::vec3 _skyColor{0};
+  std::vector<glm::vec3> _accumulated;
+  size_t _sampleCount{};
+};
+
+// A Cornell box: colored walls, an area light, a glossy block and a glass
+// one, with unit half-size around the origin.
+Mesh cornellBox();
+
+// Renders the mesh, or the Cornell box if there is none, from the front,
+// doubling the samples per pixel each pass up to samplesPerPixel and
+// printing the samples per second of every pass, then saves the result.
+void renderReferenceImage(const Mesh *mesh,
+                          const std::filesystem::path &ppmPath,
+                          size_t samplesPerPixel, JobSystem *jobs = nullptr);
+
+#endif // PATH_TRACER_HPP
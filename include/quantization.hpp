@@ -0,0 +1,55 @@
+#ifndef QUANTIZATION_HPP
+#define QUANTIZATION_HPP
+
+#include "mesh.hpp"
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// 12 bytes per vertex instead of the 32 of Vertex: positions as unorm16
+// within the mesh bounds, normals octahedral-encoded as snorm8x2 and UVs as
+// half floats.
+struct QuantizedVertex {
+  uint16_t position[3];
+  int8_t normal[2];
+  uint16_t uv[2];
+};
+static_assert(sizeof(QuantizedVertex) == 12);
+
+struct QuantizationError {
+  float maxPosition;      // object-space units
+  float maxNormalDegrees;
+  float maxUv;
+};
+
+struct QuantizedMesh {
+  std::vector<QuantizedVertex> vertices;
+  glm::vec3 boundsMin, boundsExtent;
+
+  // Maps decoded [0, 1] positions back into object space. Fold it into the
+  // object transform on the CPU, but keep using the unquantized transform's
+  // normal matrix: the scale here is not uniform.
+  glm::mat4 dequantization() const;
+};
+
+QuantizedMesh quantizeMesh(const Mesh &mesh, QuantizationError *error = nullptr);
+
+glm::vec2 encodeOctahedral(glm::vec3 n);
+glm::vec3 decodeOctahedral(glm::vec2 e);
+
+// Points attributes 0 (position), 1 (normal) and 2 (UV) of vao at a buffer of
+// QuantizedVertex.
+void setupQuantizedVertexArray(GLuint vao, GLuint vertexBuffer);
+
+// GLSL vertex inputs for QuantizedVertex, without a #version line, to prepend
+// to a vertex shader: position (unorm16, [0, 1] within the bounds, so the
+// shader's transform must include QuantizedMesh::dequantization()), normal
+// (octahedral, to pass through decodeOctahedral) and uv.
+extern const char *const quantizedVertexInputSource;
+
+#endif // QUANTIZATION_HPP
@@ -0,0 +1,16 @@
+#ifndef SHADER_HPP
+#define SHADER_HPP
+
+#include "glad/glad.h"
+
+GLuint compileShader(GLenum type, const char *source);
+
+// Links a program from a vertex and a fragment shader source.
+GLuint createProgram(const char *vsSrc, const char *fsSrc);
+
+// Same, with a geometry shader in between.
+GLuint createProgram(const char *vsSrc, const char *gsSrc, const char *fsSrc);
+
+GLuint createComputeProgram(const char *csSrc);
+
+#endif // SHADER_HPP
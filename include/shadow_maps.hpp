@@ -0,0 +1,125 @@
+#ifndef SHADOW_MAPS_HPP
+#define SHADOW_MAPS_HPP
+
+#include "glad/glad.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Something drawn into the shadow maps: indexed triangles (32-bit indices)
+// with their positions at attribute 0 of the vertex array.
+struct ShadowCaster {
+  GLuint vertexArray;
+  GLuint firstIndex;
+  GLsizei indexCount;
+  glm::mat4 model;
+  glm::vec3 boundsMin, boundsMax; // world space
+};
+
+struct ShadowCascadeStats {
+  float splitDepth{}; // far end of the cascade, in view-space depth
+  bool rendered{};    // false when the cached map was kept
+  size_t casters{}, triangles{};
+};
+
+struct ShadowStats {
+  ShadowCascadeStats cascades[4];
+  // GPU time of the whole layered pass, from a few frames ago since it is
+  // never waited on, or 0 when that pass's time has not come back yet; every
+  // cascade is drawn in the same pass.
+  double gpuMs{};
+};
+
+// Cascaded shadow maps for a directional light. The cascades split the
+// depth range the casters actually cover in view, between logarithmic and
+// uniform spacing, and each is a light-space square around the bounding
+// sphere of its slice, snapped to whole texels so that it does not shimmer
+// as the camera moves. All cascades that need it are drawn in a single
+// layered pass, a geometry shader instance per cascade, with depth clamping
+// so that casters between the light and the cascade are never clipped.
+//
+// Cascades from firstCachedCascade on are fitted with some margin and then
+// kept, map included, while they still cover their slice of the view and no
+// caster inside them has moved; in a mostly static scene they are rarely
+// drawn at all.
+class CascadedShadowMaps {
+public:
+  static constexpr size_t cascadeCount{4}, firstCachedCascade{2};
+  // Fixed, since shadowSource names them.
+  static constexpr GLuint paramsBinding{3}; // uniform block
+  static constexpr GLuint textureUnit{8};
+
+  explicit CascadedShadowMaps(size_t resolution = 2048);
+  ~CascadedShadowMaps();
+  CascadedShadowMaps(const CascadedShadowMaps &) = delete;
+  CascadedShadowMaps &operator=(const CascadedShadowMaps &) = delete;
+
+  // Without caching, every cascade is fitted tightly and drawn every frame.
+  void setCaching(bool enabled) { _caching = enabled; }
+
+  // Fits the cascades to this camera and draws the ones that changed.
+  // lightDirection is the way the light travels. Casters are matched with
+  // the previous frame's by index, to tell which of them moved. The
+  // framebuffer, viewport and depth state are restored afterwards.
+  void render(const glm::mat4 &view, const glm::mat4 &projection, float near,
+              float far, glm::vec3 lightDirection,
+              const ShadowCaster *casters, size_t count);
+
+  // Binds what shadowSource reads.
+  void bind() const;
+
+  const ShadowStats &stats() const { return _stats; }
+  GLuint texture() const { return _texture; }
+  size_t resolution() const { return _resolution; }
+
+private:
+  // A light-space square, center +- radius on every axis.
+  struct Cascade {
+    glm::vec3 center{0};
+    float radius{-1}; // invalid until first fitted
+    glm::mat4 viewProjection{1};
+  };
+
+  struct Params {
+    glm::mat4 viewProjection[cascadeCount];
+    glm::vec4 splits;      // far depth of each cascade
+    glm::vec4 texelSizes;  // world size of a texel in each cascade
+    glm::vec4 toLight;
+  };
+
+  // Cascades whose box the world-space box reaches.
+  uint32_t cascadeMask(const glm::mat4 &lightView, glm::vec3 boundsMin,
+                       glm::vec3 boundsMax) const;
+
+  size_t _resolution;
+  bool _caching{true};
+  Cascade _cascades[cascadeCount];
+  glm::vec3 _lightDirection{0};
+  std::vector<glm::mat4> _previousModels;
+  std::vector<glm::vec3> _previousBounds; // min and max of each caster
+
+  GLuint _program{}, _texture{}, _framebuffer{}, _paramsBuffer{};
+  GLint _modelLoc{}, _maskLoc{};
+  GLuint _queries[3]{};
+  bool _queryIssued[3]{};
+  uint64_t _frame{};
+  ShadowStats _stats;
+};
+
+// GLSL to insert right after a fragment shader's #version line. Declares
+//   float directionalShadow(vec3 position, vec3 normal, float viewDepth)
+// which is 1 where the world-space position is lit by the directional light
+// and 0 where it is in shadow, filtered over 3x3 texels; viewDepth is the
+// fragment's positive view-space depth.
+extern const char *const shadowSource;
+
+// Renders the shadows of a field of boxes under four scenarios (still,
+// camera moving, a caster moving near the camera, one moving far from it),
+// with and without caching, and prints the pass time and how often each
+// cascade was drawn, with how many casters.
+void benchmarkShadowMaps();
+
+#endif // SHADOW_MAPS_HPP
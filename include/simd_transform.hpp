@@ -0,0 +1,81 @@
+#ifndef SIMD_TRANSFORM_HPP
+#define SIMD_TRANSFORM_HPP
+
+#include "glm/mat4x4.hpp"
+
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||           \
+    defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// MSVC lets any function use any intrinsic; GCC and Clang want to be told
+// which functions may use which instructions, so that the rest of the program
+// still runs on CPUs without them. Only call such functions once simdLevel()
+// says the CPU has the instructions.
+#if defined(SIMD_X86) && !defined(_MSC_VER)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// Batched transform kernels over AoSoA blocks: each block holds simdLanes
+// objects with every scalar field stored as its own array of lanes, so one
+// AVX2 register (or two SSE ones) covers the same field of a whole block.
+// Partially filled blocks are fine; the unused lanes are transformed along
+// with the rest and can be ignored.
+constexpr size_t simdLanes{8};
+
+struct alignas(32) MatrixBlock {
+  float m[16][simdLanes]; // column-major like glm: element column * 4 + row
+};
+
+struct alignas(32) PointBlock {
+  float x[simdLanes], y[simdLanes], z[simdLanes];
+};
+
+struct alignas(32) AabbBlock {
+  float minX[simdLanes], minY[simdLanes], minZ[simdLanes];
+  float maxX[simdLanes], maxY[simdLanes], maxZ[simdLanes];
+};
+
+struct alignas(32) SphereBlock {
+  float x[simdLanes], y[simdLanes], z[simdLanes], radius[simdLanes];
+};
+
+void setLane(MatrixBlock &block, size_t lane, const glm::mat4 &matrix);
+glm::mat4 getLane(const MatrixBlock &block, size_t lane);
+
+enum class SimdLevel { Scalar, Sse41, Avx2 };
+
+// The best level the CPU supports is picked at startup; setSimdLevel() can
+// lower it (levels the CPU lacks are clamped), which is what the benchmark
+// uses to compare them.
+SimdLevel simdLevel();
+SimdLevel supportedSimdLevel();
+void setSimdLevel(SimdLevel level);
+const char *simdLevelName(SimdLevel level);
+
+// result = a * b, lane by lane.
+void multiplyMatrices(const MatrixBlock *a, const MatrixBlock *b,
+                      MatrixBlock *result, size_t blockCount);
+
+// The matrices here are expected to be affine; w is taken as 1 and the
+// bottom row ignored.
+void transformPoints(const glm::mat4 &matrix, const PointBlock *points,
+                     PointBlock *result, size_t blockCount);
+// Tightest axis-aligned boxes around the transformed boxes (Arvo 1990).
+void transformAabbs(const MatrixBlock *matrices, const AabbBlock *boxes,
+                    AabbBlock *result, size_t blockCount);
+// Radii are scaled by the largest axis scale, so non-uniform scales give
+// conservative spheres.
+void transformSpheres(const MatrixBlock *matrices, const SphereBlock *spheres,
+                      SphereBlock *result, size_t blockCount);
+
+// Times every supported level against plain glm on count objects and prints
+// the results, with each kernel's largest error against a glm computation.
+void benchmarkSimdTransforms(size_t count);
+
+#endif // SIMD_TRANSFORM_HPP
@@ -0,0 +1,71 @@
+#ifndef SOFTWARE_RASTERIZER_HPP
+#define SOFTWARE_RASTERIZER_HPP
+
+#include "image.hpp"
+#include "job_system.hpp"
+
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// CPU stand-in for main.cpp's pipeline, for machines without a GPU (or
+// without GL_NV_fragment_shader_barycentric). Triangles are binned into
+// tiles, and every tile is then rasterized on its own, in parallel, with
+// edge functions evaluated eight pixels at a time. The fragment stage is
+// main.cpp's: the perspective-correct vertex color, brightened near the
+// edges and at the center of the triangle.
+class SoftwareRasterizer {
+public:
+  static constexpr size_t tileSize{64};
+
+  SoftwareRasterizer(size_t width, size_t height);
+
+  // Clears the target and draws the triangles, given in clip space with one
+  // color per vertex, in order. Like GL with its default state: no depth
+  // test, no face culling. Triangles crossing w = 0 are dropped rather than
+  // clipped.
+  void render(glm::vec3 clearColor, const glm::vec4 *positions,
+              const glm::vec3 *colors, size_t vertexCount,
+              JobSystem *jobs = nullptr);
+
+  const Image &image() const { return _image; }
+
+private:
+  // Edge functions e = a * x + b * y + c in pixel coordinates, one per
+  // vertex, scaled so that they are the screen-space barycentrics.
+  struct Triangle {
+    float a[3], b[3], c[3];
+    bool topLeft[3]; // owns the pixels exactly on the edge
+    float inverseW[3];
+    glm::vec3 colors[3];
+    int minX, minY, maxX, maxY; // inclusive pixel bounds
+  };
+
+  void setup(const glm::vec4 *positions, const glm::vec3 *colors,
+             size_t vertexCount);
+  void renderTile(size_t tile, glm::vec3 clearColor);
+  // Over an inclusive pixel rectangle within the triangle's bounds.
+  void rasterizeScalar(const Triangle &triangle, int minX, int minY, int maxX,
+                       int maxY);
+  void rasterizeAvx2(const Triangle &triangle, int minX, int minY, int maxX,
+                     int maxY);
+
+  Image _image;
+  size_t _tilesX, _tilesY;
+  std::vector<Triangle> _triangles;
+  std::vector<std::vector<uint32_t>> _bins; // triangles overlapping each tile
+};
+
+// Renders main.cpp's spinning triangle at angle t, the way its vertex
+// shader places it.
+void renderIntroTriangle(SoftwareRasterizer &rasterizer, float t,
+                         JobSystem *jobs = nullptr);
+
+// Prints the frames per second of the spinning triangle at 900x900 and at
+// 3840x2160, then how many pixels of 100 frames the scalar fallback draws
+// differently from the vector path (none, as both do the same arithmetic).
+void benchmarkSoftwareRasterizer(JobSystem *jobs = nullptr);
+
+#endif // SOFTWARE_RASTERIZER_HPP
@@ -0,0 +1,71 @@
+#ifndef TEXTURE_COMPRESSION_HPP
+#define TEXTURE_COMPRESSION_HPP
+
+#include "image.hpp"
+
+#include "glad/glad.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+enum class BcFormat : uint32_t { Bc1, Bc3, Bc7 };
+
+struct BcEncodeSettings {
+  BcFormat format{BcFormat::Bc7};
+  // 0 picks endpoints from the block's bounding box; 1 uses the principal
+  // axis; every level above that adds a least-squares refinement pass (and
+  // for BC7, an exhaustive p-bit search).
+  int quality{2};
+  bool generateMips{true};
+  size_t maxLevelCount{}; // 0 keeps the whole chain down to 1x1
+  size_t threadCount{}; // 0 uses every hardware thread
+};
+
+struct BcEncodeReport {
+  double psnr{}; // level 0 only, against the source image
+  double seconds{};
+  size_t sourceBytes{}, compressedBytes{};
+};
+
+// A block-compressed texture with its full mip chain, as uploaded to the GPU.
+class CompressedTexture {
+public:
+  CompressedTexture() = default;
+  CompressedTexture(const Image &image, const BcEncodeSettings &settings,
+                    BcEncodeReport *report = nullptr);
+  explicit CompressedTexture(const std::filesystem::path &cachePath);
+
+  BcFormat format() const;
+  int quality() const;
+  size_t width() const;
+  size_t height() const;
+  size_t levelCount() const;
+  size_t levelWidth(size_t level) const;
+  size_t levelHeight(size_t level) const;
+  size_t levelSizeInBytes(size_t level) const;
+  const uint8_t *levelData(size_t level) const;
+  size_t sizeInBytes() const;
+
+  Image decode(size_t level = 0) const;
+  void save(const std::filesystem::path &cachePath) const;
+  GLuint upload() const;
+
+private:
+  BcFormat _format{};
+  int _quality{};
+  size_t _width{}, _height{};
+  std::vector<size_t> _levelOffsets;
+  std::vector<uint8_t> _blocks;
+};
+
+size_t bcBlockSizeInBytes(BcFormat format);
+size_t bcLevelSizeInBytes(BcFormat format, size_t width, size_t height);
+GLenum bcGlInternalFormat(BcFormat format);
+// Creates an immutable texture from a whole mip chain of blocks, stored one
+// level after the other from the largest, with trilinear filtering when
+// there is more than one level.
+GLuint uploadBcTexture(BcFormat format, size_t width, size_t height,
+                       size_t levelCount, const uint8_t *levels);
+
+#endif // TEXTURE_COMPRESSION_HPP
@@ -11,9 +11,17 @@
 #include <stdexcept>
 #include <thread>
 
+// Version of the core profile context to ask for.
+struct GlVersion {
+  int major, minor;
+};
+
 class Window {
 public:
-  Window(size_t width, size_t height, const char *title);
+  // samples > 0 asks for a multisampled default framebuffer; AntiAliasing
+  // needs a single sampled one.
+  Window(size_t width, size_t height, const char *title, int samples = 0,
+         GlVersion version = {4, 6});
 
   ~Window();
 
@@ -24,12 +32,19 @@ public:
   void swapBuffers() const;
   void pollEvents() const;
   bool keyIsPressed(int key) const;
+  bool mouseButtonIsPressed(int button) const;
   std::tuple<float, float> getCursorPos() const;
   void show() const;
 
+  // Called from pollEvents() with the new size whenever the framebuffer is
+  // resized, after the viewport was set to cover it.
+  void setFramebufferSizeCallback(
+      std::function<void(size_t width, size_t height)> callback);
+
 private:
   GLFWwindow *_window{};
   size_t _width, _height;
+  std::function<void(size_t, size_t)> _framebufferSizeCallback;
 };
 
 #endif // GL_BOILERPLATE_HPP
\ No newline at end of file
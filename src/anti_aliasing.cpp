@@ -0,0 +1,530 @@
+#include "anti_aliasing.hpp"
+#include "gl_util.hpp"
+#include "image.hpp"
+#include "shader.hpp"
+#include "window.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+GLsizei sampleCount(AntiAliasingMode mode) {
+  switch (mode) {
+  case AntiAliasingMode::Msaa2:
+    return 2;
+  case AntiAliasingMode::Msaa4:
+    return 4;
+  case AntiAliasingMode::Msaa8:
+    return 8;
+  default:
+    return 1;
+  }
+}
+
+// The radical inverse of index in base.
+float halton(uint64_t index, uint64_t base) {
+  float fraction{1}, result{};
+  for (; index; index /= base) {
+    fraction /= float(base);
+    result += fraction * float(index % base);
+  }
+  return result;
+}
+
+// A triangle covering the screen.
+constexpr auto vsSrc{R"(
+  #version 450
+
+  void main(void) {
+    vec2 p = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;
+    gl_Position = vec4(p, 0, 1);
+  }
+)"};
+
+// FXAA in the manner of Lottes' console version: blurs along the edge the
+// luma gradient finds, unless that overshoots the local luma range.
+constexpr auto fxaaFsSrc{R"(
+  #version 450
+
+  layout (binding = 0) uniform sampler2D colorTexture;
+
+  uniform vec2 texelSize;
+  uniform vec2 uvMax;
+  uniform vec2 origin;
+
+  out vec4 fragmentColor;
+
+  const float reduceMul = 1.0 / 8.0, reduceMin = 1.0 / 128.0, spanMax = 8.0;
+
+  vec3 fetch(vec2 uv) {
+    return texture(colorTexture, clamp(uv, 0.5 * texelSize, uvMax)).rgb;
+  }
+
+  float luma(vec3 color) { return dot(color, vec3(0.299, 0.587, 0.114)); }
+
+  void main(void) {
+    vec2 uv = (gl_FragCoord.xy - origin) * texelSize;
+    float lumaNW = luma(fetch(uv + vec2(-1, -1) * texelSize));
+    float lumaNE = luma(fetch(uv + vec2(1, -1) * texelSize));
+    float lumaSW = luma(fetch(uv + vec2(-1, 1) * texelSize));
+    float lumaSE = luma(fetch(uv + vec2(1, 1) * texelSize));
+    vec3 center = fetch(uv);
+    float lumaM = luma(center);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 direction = vec2(lumaSW + lumaSE - lumaNW - lumaNE,
+                          lumaNW + lumaSW - lumaNE - lumaSE);
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * reduceMul,
+                       reduceMin);
+    direction = clamp(direction / (min(abs(direction.x), abs(direction.y))
+                                   + reduce),
+                      -spanMax, spanMax) * texelSize;
+
+    vec3 inner = 0.5 * (fetch(uv - direction / 6.0)
+                        + fetch(uv + direction / 6.0));
+    vec3 outer = 0.5 * inner + 0.25 * (fetch(uv - direction * 0.5)
+                                       + fetch(uv + direction * 0.5));
+    float lumaOuter = luma(outer);
+    fragmentColor = vec4(lumaOuter < lumaMin || lumaOuter > lumaMax ? inner
+                                                                    : outer,
+                         1);
+  }
+)"};
+
+constexpr auto taaFsSrc{R"(
+  #version 450
+
+  layout (binding = 0) uniform sampler2D colorTexture;
+  layout (binding = 1) uniform sampler2D motionTexture;
+  layout (binding = 2) uniform sampler2D historyTexture;
+
+  uniform vec2 texelSize;
+  uniform vec2 uvScale; // of the scene's corner of the targets
+  uniform ivec2 renderSize;
+  uniform float historyWeight;
+
+  out vec4 resolved;
+
+  vec3 toYCoCg(vec3 c) {
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b,
+                -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+  }
+
+  vec3 toRgb(vec3 c) {
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+  }
+
+  void main(void) {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 current = toYCoCg(texelFetch(colorTexture, pixel, 0).rgb);
+    vec3 lo = current, hi = current;
+    for (int y = -1; y <= 1; ++y)
+      for (int x = -1; x <= 1; ++x) {
+        ivec2 neighbor = clamp(pixel + ivec2(x, y), ivec2(0), renderSize - 1);
+        vec3 c = toYCoCg(texelFetch(colorTexture, neighbor, 0).rgb);
+        lo = min(lo, c);
+        hi = max(hi, c);
+      }
+
+    vec2 uv = (vec2(pixel) + 0.5) * texelSize;
+    vec2 previousUv = uv - texelFetch(motionTexture, pixel, 0).xy * uvScale;
+    bool onScreen = all(greaterThanEqual(previousUv, vec2(0)))
+                    && all(lessThanEqual(previousUv, uvScale));
+    vec3 history = toYCoCg(texture(historyTexture,
+                                   clamp(previousUv, 0.5 * texelSize,
+                                         uvScale - 0.5 * texelSize)).rgb);
+    history = clamp(history, lo, hi);
+    float weight = onScreen ? historyWeight : 0.0;
+    resolved = vec4(toRgb(mix(current, history, weight)), 1);
+  }
+)"};
+} // namespace
+
+const char *antiAliasingModeName(AntiAliasingMode mode) {
+  switch (mode) {
+  case AntiAliasingMode::Off:
+    return "off";
+  case AntiAliasingMode::Msaa2:
+    return "msaa2";
+  case AntiAliasingMode::Msaa4:
+    return "msaa4";
+  case AntiAliasingMode::Msaa8:
+    return "msaa8";
+  case AntiAliasingMode::Fxaa:
+    return "fxaa";
+  case AntiAliasingMode::Taa:
+    return "taa";
+  }
+  return "?";
+}
+
+AntiAliasingMode parseAntiAliasingMode(std::string_view name) {
+  for (auto mode : antiAliasingModes)
+    if (name == antiAliasingModeName(mode))
+      return mode;
+  throw std::runtime_error{"unknown anti-aliasing mode " + std::string{name}};
+}
+
+AntiAliasing::AntiAliasing(size_t width, size_t height, AntiAliasingMode mode)
+    : _width{width}, _height{height}, _mode{mode} {
+  _fxaaProgram = createProgram(vsSrc, fxaaFsSrc);
+  _fxaaTexelSizeLoc = glGetUniformLocation(_fxaaProgram, "texelSize");
+  _fxaaUvMaxLoc = glGetUniformLocation(_fxaaProgram, "uvMax");
+  _fxaaOriginLoc = glGetUniformLocation(_fxaaProgram, "origin");
+  _taaProgram = createProgram(vsSrc, taaFsSrc);
+  _taaTexelSizeLoc = glGetUniformLocation(_taaProgram, "texelSize");
+  _taaUvScaleLoc = glGetUniformLocation(_taaProgram, "uvScale");
+  _taaRenderSizeLoc = glGetUniformLocation(_taaProgram, "renderSize");
+  _taaHistoryWeightLoc = glGetUniformLocation(_taaProgram, "historyWeight");
+  glCheck(glCreateVertexArrays(1, &_emptyVertexArray));
+  createTargets();
+}
+
+AntiAliasing::~AntiAliasing() {
+  deleteTargets();
+  glDeleteVertexArrays(1, &_emptyVertexArray);
+  glDeleteProgram(_taaProgram);
+  glDeleteProgram(_fxaaProgram);
+}
+
+void AntiAliasing::createTargets() {
+  _historyValid = false;
+  if (_mode == AntiAliasingMode::Off)
+    return;
+  auto samples{sampleCount(_mode)};
+  auto taa{_mode == AntiAliasingMode::Taa};
+  GLsizei count{taa ? 3 : 2};
+  constexpr GLenum formats[]{GL_RGBA8, GL_DEPTH_COMPONENT24, GL_RG16F};
+  glCheck(glCreateTextures(samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE
+                                       : GL_TEXTURE_2D,
+                           count, _textures));
+  for (GLsizei i{}; i < count; ++i) {
+    if (samples > 1) {
+      glCheck(glTextureStorage2DMultisample(_textures[i], samples, formats[i],
+                                            GLsizei(_width), GLsizei(_height),
+                                            GL_TRUE));
+    } else {
+      glCheck(glTextureStorage2D(_textures[i], 1, formats[i], GLsizei(_width),
+                                 GLsizei(_height)));
+    }
+  }
+  if (samples == 1) {
+    glCheck(glTextureParameteri(_textures[0], GL_TEXTURE_MIN_FILTER,
+                                GL_LINEAR));
+    glCheck(glTextureParameteri(_textures[0], GL_TEXTURE_MAG_FILTER,
+                                GL_LINEAR));
+  }
+  glCheck(glCreateFramebuffers(1, &_framebuffer));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_COLOR_ATTACHMENT0,
+                                    _textures[0], 0));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_DEPTH_ATTACHMENT,
+                                    _textures[1], 0));
+  if (taa)
+    glCheck(glNamedFramebufferTexture(_framebuffer, GL_COLOR_ATTACHMENT1,
+                                      _textures[2], 0));
+  GLenum drawBuffers[]{GL_COLOR_ATTACHMENT0,
+                       GLenum(taa ? GL_COLOR_ATTACHMENT1 : GL_NONE)};
+  glCheck(glNamedFramebufferDrawBuffers(_framebuffer, 2, drawBuffers));
+  if (glCheckNamedFramebufferStatus(_framebuffer, GL_FRAMEBUFFER) !=
+      GL_FRAMEBUFFER_COMPLETE)
+    throw std::runtime_error{"anti-aliasing framebuffer is incomplete"};
+
+  if (!taa)
+    return;
+  glCheck(glCreateTextures(GL_TEXTURE_2D, 2, _historyTextures));
+  glCheck(glCreateFramebuffers(2, _historyFramebuffers));
+  for (int i{}; i < 2; ++i) {
+    glCheck(glTextureStorage2D(_historyTextures[i], 1, GL_RGBA8,
+                               GLsizei(_width), GLsizei(_height)));
+    glCheck(glTextureParameteri(_historyTextures[i], GL_TEXTURE_MIN_FILTER,
+                                GL_LINEAR));
+    glCheck(glTextureParameteri(_historyTextures[i], GL_TEXTURE_MAG_FILTER,
+                                GL_LINEAR));
+    glCheck(glNamedFramebufferTexture(_historyFramebuffers[i],
+                                      GL_COLOR_ATTACHMENT0,
+                                      _historyTextures[i], 0));
+  }
+}
+
+void AntiAliasing::deleteTargets() {
+  glDeleteFramebuffers(2, _historyFramebuffers);
+  glDeleteTextures(2, _historyTextures);
+  glDeleteFramebuffers(1, &_framebuffer);
+  glDeleteTextures(3, _textures);
+  std::fill(std::begin(_historyFramebuffers), std::end(_historyFramebuffers),
+            0);
+  std::fill(std::begin(_historyTextures), std::end(_historyTextures), 0);
+  std::fill(std::begin(_textures), std::end(_textures), 0);
+  _framebuffer = 0;
+}
+
+void AntiAliasing::setMode(AntiAliasingMode mode) {
+  if (mode == _mode)
+    return;
+  deleteTargets();
+  _mode = mode;
+  createTargets();
+}
+
+void AntiAliasing::resize(size_t width, size_t height) {
+  if ((width == _width && height == _height) || !width || !height)
+    return;
+  deleteTargets();
+  _width = width, _height = height;
+  createTargets();
+}
+
+size_t AntiAliasing::targetBytes() const {
+  // Color and depth, 4 bytes each per sample, then what each mode adds.
+  size_t perPixel{};
+  switch (_mode) {
+  case AntiAliasingMode::Off:
+    break;
+  case AntiAliasingMode::Taa:
+    perPixel = 8 + 4 + 2 * 4; // motion, two histories
+    break;
+  default:
+    perPixel = 8 * size_t(sampleCount(_mode));
+  }
+  return perPixel * _width * _height;
+}
+
+void AntiAliasing::beginFrame(glm::vec4 clearColor) {
+  glCheck(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &_previousFramebuffer));
+  glCheck(glGetIntegerv(GL_VIEWPORT, _previousViewport));
+  _renderWidth = std::min(size_t(_previousViewport[2]), _width);
+  _renderHeight = std::min(size_t(_previousViewport[3]), _height);
+
+  constexpr float farthest{1}, noMotion[4]{};
+  auto framebuffer{_mode == AntiAliasingMode::Off ? GLuint(_previousFramebuffer)
+                                                  : _framebuffer};
+  glCheck(glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0,
+                                    glm::value_ptr(clearColor)));
+  glCheck(glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &farthest));
+  if (_mode == AntiAliasingMode::Taa)
+    glCheck(glClearNamedFramebufferfv(framebuffer, GL_COLOR, 1, noMotion));
+  if (_mode == AntiAliasingMode::Off)
+    return;
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+  glCheck(glViewport(0, 0, GLsizei(_renderWidth), GLsizei(_renderHeight)));
+}
+
+glm::mat4 AntiAliasing::jitter(const glm::mat4 &projection) const {
+  if (_mode != AntiAliasingMode::Taa || !_renderWidth || !_renderHeight)
+    return projection;
+  // Eight points of the (2, 3) Halton sequence, within a pixel.
+  auto index{_frame % 8 + 1};
+  glm::vec3 offset{(halton(index, 2) - 0.5f) * 2 / float(_renderWidth),
+                   (halton(index, 3) - 0.5f) * 2 / float(_renderHeight), 0};
+  return glm::translate(glm::mat4{1}, offset) * projection;
+}
+
+void AntiAliasing::endFrame() {
+  ++_frame;
+  if (_mode == AntiAliasingMode::Off)
+    return;
+  auto previous{GLuint(_previousFramebuffer)};
+  auto *viewport{_previousViewport};
+  auto blit{[&](GLuint source) {
+    glCheck(glBlitNamedFramebuffer(
+        source, previous, 0, 0, GLint(_renderWidth), GLint(_renderHeight),
+        viewport[0], viewport[1], viewport[0] + GLint(_renderWidth),
+        viewport[1] + GLint(_renderHeight), GL_COLOR_BUFFER_BIT, GL_NEAREST));
+  }};
+  auto depthTest{glIsEnabled(GL_DEPTH_TEST)};
+  glCheck(glDisable(GL_DEPTH_TEST));
+  glm::vec2 texelSize{1 / float(_width), 1 / float(_height)};
+  glm::vec2 uvScale{float(_renderWidth) / float(_width),
+                    float(_renderHeight) / float(_height)};
+
+  if (_mode == AntiAliasingMode::Fxaa) {
+    glCheck(glBindFramebuffer(GL_FRAMEBUFFER, previous));
+    glCheck(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+    glCheck(glUseProgram(_fxaaProgram));
+    glCheck(glUniform2fv(_fxaaTexelSizeLoc, 1, glm::value_ptr(texelSize)));
+    glCheck(glUniform2fv(_fxaaUvMaxLoc, 1,
+                         glm::value_ptr(uvScale - 0.5f * texelSize)));
+    glCheck(glUniform2f(_fxaaOriginLoc, float(viewport[0]),
+                        float(viewport[1])));
+    glCheck(glBindTextureUnit(0, _textures[0]));
+    glCheck(glBindVertexArray(_emptyVertexArray));
+    glCheck(glDrawArrays(GL_TRIANGLES, 0, 3));
+  } else if (_mode == AntiAliasingMode::Taa) {
+    if (_renderWidth != _historyWidth || _renderHeight != _historyHeight)
+      _historyValid = false;
+    auto write{_frame % 2}, read{1 - write};
+    glCheck(glBindFramebuffer(GL_FRAMEBUFFER, _historyFramebuffers[write]));
+    glCheck(glViewport(0, 0, GLsizei(_renderWidth), GLsizei(_renderHeight)));
+    glCheck(glUseProgram(_taaProgram));
+    glCheck(glUniform2fv(_taaTexelSizeLoc, 1, glm::value_ptr(texelSize)));
+    glCheck(glUniform2fv(_taaUvScaleLoc, 1, glm::value_ptr(uvScale)));
+    glCheck(glUniform2i(_taaRenderSizeLoc, GLint(_renderWidth),
+                        GLint(_renderHeight)));
+    glCheck(glUniform1f(_taaHistoryWeightLoc, _historyValid ? 0.9f : 0));
+    glCheck(glBindTextureUnit(0, _textures[0]));
+    glCheck(glBindTextureUnit(1, _textures[2]));
+    glCheck(glBindTextureUnit(2, _historyTextures[read]));
+    glCheck(glBindVertexArray(_emptyVertexArray));
+    glCheck(glDrawArrays(GL_TRIANGLES, 0, 3));
+    blit(_historyFramebuffers[write]);
+    _historyValid = true;
+    _historyWidth = _renderWidth, _historyHeight = _renderHeight;
+  } else {
+    // MSAA resolves in the blit; the framebuffer it goes to must be single
+    // sampled.
+    blit(_framebuffer);
+  }
+
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, previous));
+  glCheck(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+  if (depthTest)
+    glCheck(glEnable(GL_DEPTH_TEST));
+}
+
+void benchmarkAntiAliasing() {
+  constexpr size_t width{1920}, height{1080}, warmupFrames{10}, frames{60};
+  constexpr GLsizei spokes{360};
+  constexpr float step{0.002f};
+  Window window{width, height, "Anti-aliasing benchmark"};
+
+  // Stands in for the window's framebuffer.
+  GLuint framebuffer, renderbuffers[2];
+  glCheck(glCreateRenderbuffers(2, renderbuffers));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width,
+                                     height));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24,
+                                     width, height));
+  glCheck(glCreateFramebuffers(1, &framebuffer));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0,
+                                         GL_RENDERBUFFER, renderbuffers[0]));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT,
+                                         GL_RENDERBUFFER, renderbuffers[1]));
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+  glCheck(glViewport(0, 0, width, height));
+
+  // Thin wedges around the center, turning by step radians a frame.
+  auto program{createProgram(R"(
+    #version 450
+
+    uniform float t;
+    uniform float previousT;
+    uniform mat4 jitter;
+    uniform float aspect;
+
+    out vec4 clipPosition;
+    out vec4 previousClipPosition;
+
+    vec4 corner(float angle) {
+      int spoke = gl_VertexID / 3, k = gl_VertexID % 3;
+      float a = angle + float(spoke) * 6.2831853 / 360.0
+                + (k == 1 ? 0.004 : k == 2 ? -0.004 : 0.0);
+      float r = k == 0 ? 0.05 : 0.95;
+      return vec4(r * cos(a) / aspect, r * sin(a), 0, 1);
+    }
+
+    void main(void) {
+      clipPosition = corner(t);
+      previousClipPosition = corner(previousT);
+      gl_Position = jitter * clipPosition;
+    }
+  )",
+                             R"(
+    #version 450
+
+    in vec4 clipPosition;
+    in vec4 previousClipPosition;
+
+    layout (location = 0) out vec4 fragmentColor;
+    layout (location = 1) out vec2 motionVector;
+
+    void main(void) {
+      fragmentColor = vec4(0.1, 0.1, 0.1, 1);
+      motionVector = (clipPosition.xy / clipPosition.w
+                      - previousClipPosition.xy / previousClipPosition.w)
+                     * 0.5;
+    }
+  )")};
+  auto tLoc{glGetUniformLocation(program, "t")};
+  auto previousTLoc{glGetUniformLocation(program, "previousT")};
+  auto jitterLoc{glGetUniformLocation(program, "jitter")};
+  glCheck(glProgramUniform1f(program, glGetUniformLocation(program, "aspect"),
+                             float(width) / height));
+  GLuint vao;
+  glCheck(glCreateVertexArrays(1, &vao));
+  auto drawSpokes{[&](float t, const glm::mat4 &jitter) {
+    glCheck(glUseProgram(program));
+    glCheck(glUniform1f(tLoc, t));
+    glCheck(glUniform1f(previousTLoc, t - step));
+    glCheck(glUniformMatrix4fv(jitterLoc, 1, GL_FALSE,
+                               glm::value_ptr(jitter)));
+    glCheck(glBindVertexArray(vao));
+    glCheck(glDrawArrays(GL_TRIANGLES, 0, 3 * spokes));
+  }};
+  auto readColor{[] {
+    Image image{width, height};
+    glCheck(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    glCheck(glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+                         image.data()));
+    return image;
+  }};
+  constexpr glm::vec4 white{1, 1, 1, 1};
+  constexpr auto lastT{step * float(warmupFrames + frames - 1)};
+
+  // The last frame's spokes, 8x8 supersampled, to judge the edges by.
+  Image reference{width, height};
+  {
+    std::vector<uint32_t> sums(reference.sizeInBytes());
+    for (int y{}; y < 8; ++y)
+      for (int x{}; x < 8; ++x) {
+        glm::vec3 offset{(float(x) + 0.5f) / 4 - 1, (float(y) + 0.5f) / 4 - 1,
+                         0};
+        offset /= glm::vec3{float(width), float(height), 1};
+        glCheck(glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0,
+                                          glm::value_ptr(white)));
+        drawSpokes(lastT, glm::translate(glm::mat4{1}, offset));
+        auto sample{readColor()};
+        for (size_t i{}; i < sums.size(); ++i)
+          sums[i] += sample.data()[i];
+      }
+    for (size_t i{}; i < sums.size(); ++i)
+      reference.data()[i] = uint8_t((sums[i] + 32) / 64);
+  }
+
+  GLuint queries[2];
+  glCheck(glCreateQueries(GL_TIMESTAMP, 2, queries));
+  for (auto mode : antiAliasingModes) {
+    AntiAliasing antiAliasing{width, height, mode};
+    double ms{};
+    for (size_t frame{}; frame < warmupFrames + frames; ++frame) {
+      glCheck(glQueryCounter(queries[0], GL_TIMESTAMP));
+      antiAliasing.beginFrame(white);
+      drawSpokes(step * float(frame), antiAliasing.jitter(glm::mat4{1}));
+      antiAliasing.endFrame();
+      glCheck(glQueryCounter(queries[1], GL_TIMESTAMP));
+      GLuint64 ns[2];
+      for (int i{}; i < 2; ++i)
+        glCheck(glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns[i]));
+      if (frame >= warmupFrames)
+        ms += double(ns[1] - ns[0]) * 1e-6;
+    }
+    std::printf("%-5s %7.3f ms/frame, %6.1f MiB of targets, SSIM %.4f "
+                "against 64 samples per pixel\n",
+                antiAliasingModeName(mode), ms / frames,
+                double(antiAliasing.targetBytes()) / (1 << 20),
+                ssim(readColor(), reference));
+  }
+
+  glDeleteQueries(2, queries);
+  glDeleteVertexArrays(1, &vao);
+  glDeleteProgram(program);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(2, renderbuffers);
+}
@@ -0,0 +1,326 @@
+#include "asset_cache.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+constexpr uint64_t prime1{11400714785074694791ull};
+constexpr uint64_t prime2{14029467366897019727ull};
+constexpr uint64_t prime3{1609587929392839161ull};
+constexpr uint64_t prime4{9650029242287828579ull};
+constexpr uint64_t prime5{2870177450012600261ull};
+
+constexpr uint32_t meshMagic{0x3148534D}; // "MSH1"
+
+// Bumped whenever the mesh import steps change what they produce, so stale
+// artifacts miss instead of being reused.
+constexpr uint64_t meshImporterVersion{2};
+
+struct MeshHeader {
+  uint32_t magic, vertexCount, indexCount, submeshCount, materialCount;
+};
+
+uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t read64(const uint8_t *p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof value);
+  return value;
+}
+
+uint32_t read32(const uint8_t *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof value);
+  return value;
+}
+
+uint64_t xxRound(uint64_t acc, uint64_t input) {
+  return rotl(acc + input * prime2, 31) * prime1;
+}
+
+uint64_t xxMerge(uint64_t acc, uint64_t value) {
+  return (acc ^ xxRound(0, value)) * prime1 + prime4;
+}
+
+std::string readFile(const std::filesystem::path &path) {
+  std::ifstream in{path, std::ios::binary};
+  if (!in)
+    throw std::runtime_error{"could not open " + path.string()};
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+std::string hex(uint64_t value) {
+  char text[17];
+  std::snprintf(text, sizeof text, "%016llx", (unsigned long long)value);
+  return text;
+}
+
+// Only the settings that change the encoded blocks; threadCount doesn't.
+uint64_t textureSettingsHash(const BcEncodeSettings &settings) {
+  uint64_t fields[]{uint64_t(settings.format), uint64_t(settings.quality),
+                    uint64_t(settings.generateMips), settings.maxLevelCount};
+  return hashBytes(fields, sizeof fields);
+}
+
+// An OBJ's artifact also depends on the MTL libraries it pulls in.
+uint64_t meshKey(const std::filesystem::path &objPath) {
+  auto text{readFile(objPath)};
+  auto key{hashBytes(text.data(), text.size(), meshImporterVersion)};
+  std::istringstream lines{text};
+  for (std::string line; std::getline(lines, line);) {
+    if (line.rfind("mtllib ", 0) != 0)
+      continue;
+    auto library{line.substr(7)};
+    while (!library.empty() && std::isspace((unsigned char)library.back()))
+      library.pop_back();
+    key = hashFile(objPath.parent_path() / library, key);
+  }
+  return key;
+}
+
+template <typename T> void write(std::ofstream &out, const T &value) {
+  out.write(reinterpret_cast<const char *>(&value), sizeof value);
+}
+
+template <typename T>
+void writeArray(std::ofstream &out, const std::vector<T> &values) {
+  out.write(reinterpret_cast<const char *>(values.data()),
+            std::streamsize(values.size() * sizeof(T)));
+}
+
+void writeString(std::ofstream &out, const std::string &text) {
+  write(out, uint32_t(text.size()));
+  out.write(text.data(), std::streamsize(text.size()));
+}
+
+template <typename T> void read(std::ifstream &in, T &value) {
+  in.read(reinterpret_cast<char *>(&value), sizeof value);
+}
+
+template <typename T>
+void readArray(std::ifstream &in, std::vector<T> &values, size_t count) {
+  values.resize(count);
+  in.read(reinterpret_cast<char *>(values.data()),
+          std::streamsize(count * sizeof(T)));
+}
+
+void readString(std::ifstream &in, std::string &text) {
+  uint32_t size{};
+  read(in, size);
+  text.resize(size);
+  in.read(text.data(), std::streamsize(size));
+}
+} // namespace
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+  auto p{static_cast<const uint8_t *>(data)};
+  auto end{p + size};
+  uint64_t h;
+  if (size >= 32) {
+    uint64_t v1{seed + prime1 + prime2}, v2{seed + prime2}, v3{seed},
+        v4{seed - prime1};
+    for (; p + 32 <= end; p += 32) {
+      v1 = xxRound(v1, read64(p));
+      v2 = xxRound(v2, read64(p + 8));
+      v3 = xxRound(v3, read64(p + 16));
+      v4 = xxRound(v4, read64(p + 24));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = xxMerge(xxMerge(xxMerge(xxMerge(h, v1), v2), v3), v4);
+  } else {
+    h = seed + prime5;
+  }
+  h += size;
+  for (; p + 8 <= end; p += 8)
+    h = rotl(h ^ xxRound(0, read64(p)), 27) * prime1 + prime4;
+  if (p + 4 <= end) {
+    h = rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+    p += 4;
+  }
+  for (; p < end; ++p)
+    h = rotl(h ^ (*p * prime5), 11) * prime1;
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t hashFile(const std::filesystem::path &path, uint64_t seed) {
+  auto contents{readFile(path)};
+  return hashBytes(contents.data(), contents.size(), seed);
+}
+
+AssetCache::AssetCache(const std::filesystem::path &directory)
+    : _directory{directory} {
+  std::filesystem::create_directories(_directory);
+}
+
+std::filesystem::path AssetCache::fetch(uint64_t key,
+                                        std::string_view extension,
+                                        const Builder &build) {
+  namespace fs = std::filesystem;
+  auto name{hex(key)};
+  auto artifact{_directory / (name + std::string{extension})};
+  // Next to each artifact: how long it took to build, in seconds.
+  auto timing{_directory / (name + ".time")};
+  if (fs::exists(artifact)) {
+    double seconds{};
+    if (std::ifstream in{timing, std::ios::binary}; in)
+      read(in, seconds);
+    std::lock_guard lock{_mutex};
+    ++_stats.hits;
+    _stats.secondsSaved += seconds;
+    return artifact;
+  }
+
+  // Build under a name of our own and rename, so that a crash or a worker
+  // racing on an identical source never leaves a half-written artifact.
+  auto temporary{artifact};
+  temporary += ".tmp" + std::to_string(std::hash<std::thread::id>{}(
+                            std::this_thread::get_id()));
+  auto start{std::chrono::steady_clock::now()};
+  build(temporary);
+  std::chrono::duration<double> seconds{std::chrono::steady_clock::now() -
+                                        start};
+  if (std::ofstream out{timing, std::ios::binary}; out)
+    write(out, seconds.count());
+  fs::rename(temporary, artifact);
+
+  std::lock_guard lock{_mutex};
+  ++_stats.misses;
+  _stats.secondsBuilding += seconds.count();
+  return artifact;
+}
+
+AssetCacheStats AssetCache::stats() const {
+  std::lock_guard lock{_mutex};
+  return _stats;
+}
+
+void saveMeshArtifact(const Mesh &mesh, const std::filesystem::path &path) {
+  std::ofstream out{path, std::ios::binary};
+  if (!out)
+    throw std::runtime_error{"could not create " + path.string()};
+  write(out, MeshHeader{meshMagic, uint32_t(mesh.vertices.size()),
+                        uint32_t(mesh.indices.size()),
+                        uint32_t(mesh.submeshes.size()),
+                        uint32_t(mesh.materials.size())});
+  writeArray(out, mesh.vertices);
+  writeArray(out, mesh.indices);
+  writeArray(out, mesh.submeshes);
+  for (auto &material : mesh.materials) {
+    writeString(out, material.name);
+    write(out, material.ka), write(out, material.kd);
+    write(out, material.ks), write(out, material.ke);
+    write(out, material.ns), write(out, material.ni), write(out, material.d);
+    write(out, material.illum);
+    writeString(out, material.mapKd);
+    write(out, material.mapKdOffset), write(out, material.mapKdScale);
+    write(out, material.mapKdClamp);
+  }
+  if (!out)
+    throw std::runtime_error{"could not write " + path.string()};
+}
+
+Mesh loadMeshArtifact(const std::filesystem::path &path) {
+  std::ifstream in{path, std::ios::binary};
+  MeshHeader header{};
+  read(in, header);
+  if (!in || header.magic != meshMagic)
+    throw std::runtime_error{path.string() + " is not a mesh artifact"};
+  Mesh mesh;
+  readArray(in, mesh.vertices, header.vertexCount);
+  readArray(in, mesh.indices, header.indexCount);
+  readArray(in, mesh.submeshes, header.submeshCount);
+  mesh.materials.resize(header.materialCount);
+  for (auto &material : mesh.materials) {
+    readString(in, material.name);
+    read(in, material.ka), read(in, material.kd);
+    read(in, material.ks), read(in, material.ke);
+    read(in, material.ns), read(in, material.ni), read(in, material.d);
+    read(in, material.illum);
+    readString(in, material.mapKd);
+    read(in, material.mapKdOffset), read(in, material.mapKdScale);
+    read(in, material.mapKdClamp);
+  }
+  if (!in)
+    throw std::runtime_error{path.string() + " is truncated"};
+  return mesh;
+}
+
+std::vector<ImportedAsset>
+importAssetTree(const std::filesystem::path &root, AssetCache &cache,
+                const BcEncodeSettings &textureSettings, JobSystem &jobs) {
+  std::vector<ImportedAsset> assets;
+  for (auto &file : std::filesystem::recursive_directory_iterator{root}) {
+    auto extension{file.path().extension()};
+    if (file.is_regular_file() && (extension == ".obj" || extension == ".ppm"))
+      assets.push_back({file.path(), {}});
+  }
+  std::sort(assets.begin(), assets.end(),
+            [](const ImportedAsset &a, const ImportedAsset &b) {
+              return a.source < b.source;
+            });
+
+  // Parallelism comes from the jobs; encoding each texture on all cores too
+  // would only oversubscribe them.
+  auto perTexture{textureSettings};
+  if (jobs.threadCount() > 1)
+    perTexture.threadCount = 1;
+  auto textureSeed{textureSettingsHash(textureSettings)};
+
+  auto before{cache.stats()};
+  std::exception_ptr failure;
+  std::mutex failureMutex;
+  jobs.parallelFor(0, assets.size(), 1, [&](size_t first, size_t last) {
+    for (auto i{first}; i < last; ++i) {
+      auto &asset{assets[i]};
+      try {
+        if (asset.source.extension() == ".obj")
+          asset.artifact = cache.fetch(
+              meshKey(asset.source), ".mesh",
+              [&](const std::filesystem::path &path) {
+                auto mesh{loadObj(asset.source)};
+                optimizeMesh(mesh);
+                saveMeshArtifact(mesh, path);
+              });
+        else
+          asset.artifact = cache.fetch(
+              hashFile(asset.source, textureSeed), ".bct",
+              [&](const std::filesystem::path &path) {
+                CompressedTexture{Image{asset.source}, perTexture}.save(path);
+              });
+      } catch (...) {
+        std::lock_guard lock{failureMutex};
+        if (!failure)
+          failure = std::current_exception();
+      }
+    }
+  });
+  if (failure)
+    std::rethrow_exception(failure);
+
+  auto after{cache.stats()};
+  auto hits{after.hits - before.hits}, misses{after.misses - before.misses};
+  std::printf("%zu assets: %zu cached (%.0f%% hit rate), %zu rebuilt in "
+              "%.2f s, %.2f s saved\n",
+              assets.size(), hits,
+              assets.empty() ? 0.0 : 100.0 * double(hits) / double(assets.size()),
+              misses, after.secondsBuilding - before.secondsBuilding,
+              after.secondsSaved - before.secondsSaved);
+  return assets;
+}
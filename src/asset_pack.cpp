@@ -0,0 +1,472 @@
+#include "asset_pack.hpp"
+#include "atlas.hpp"
+#include "gl_util.hpp"
+#include "mesh_optimizer.hpp"
+
+#include "glm/common.hpp"
+#include "glm/packing.hpp"
+#include "glm/vector_relational.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr uint32_t packMagic{0x314B4150}; // "PAK1"
+constexpr uint32_t packVersion{8};
+
+size_t alignUp(size_t value) {
+  return (value + packAlignment - 1) & ~(packAlignment - 1);
+}
+
+void setName(PackEntry &entry, const std::filesystem::path &path) {
+  auto name{path.stem().string()};
+  name.resize(std::min(name.size(), sizeof entry.name - 1));
+  std::memcpy(entry.name, name.c_str(), name.size() + 1);
+}
+
+std::filesystem::path resolveTexture(const std::filesystem::path &objPath,
+                                     const std::string &map) {
+  for (auto candidate : {std::filesystem::path{map},
+                         objPath.parent_path() / map})
+    if (candidate.extension() == ".ppm" && std::filesystem::exists(candidate))
+      return std::filesystem::canonical(candidate);
+  return {};
+}
+} // namespace
+
+AssetPack::AssetPack(const std::filesystem::path &packPath) {
+#ifdef _WIN32
+  _file = CreateFileW(packPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (_file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error{"could not open " + packPath.string()};
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(_file, &size)) {
+    unmap();
+    throw std::runtime_error{"could not read the size of " +
+                             packPath.string()};
+  }
+  _size = size_t(size.QuadPart);
+  _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (_mapping)
+    _data = static_cast<const uint8_t *>(
+        MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+  auto fd{open(packPath.c_str(), O_RDONLY)};
+  if (fd < 0)
+    throw std::runtime_error{"could not open " + packPath.string()};
+  struct stat status{};
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error{"could not read the size of " +
+                             packPath.string()};
+  }
+  _size = size_t(status.st_size);
+  auto data{mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0)};
+  close(fd);
+  if (data != MAP_FAILED)
+    _data = static_cast<const uint8_t *>(data);
+#endif
+  if (!_data) {
+    unmap();
+    throw std::runtime_error{"could not map " + packPath.string()};
+  }
+
+  if (!isValid()) {
+    unmap();
+    throw std::runtime_error{packPath.string() + " is not a valid asset pack"};
+  }
+}
+
+bool AssetPack::isValid() const {
+  auto header{reinterpret_cast<const PackHeader *>(_data)};
+  if (_size < sizeof(PackHeader) || header->magic != packMagic ||
+      header->version != packVersion || header->fileSize != _size ||
+      header->entriesOffset > _size ||
+      header->entryCount >
+          (_size - header->entriesOffset) / sizeof(PackEntry))
+    return false;
+  auto tableEnd{header->entriesOffset + header->entryCount * sizeof(PackEntry)};
+  for (size_t i{}; i < entryCount(); ++i) {
+    auto &entry{this->entry(i)};
+    if (!std::memchr(entry.name, 0, sizeof entry.name))
+      return false;
+    for (size_t b{}; b < std::size(entry.blobOffsets); ++b)
+      if (entry.blobSizes[b] > 0 &&
+          (entry.blobOffsets[b] < tableEnd || entry.blobOffsets[b] > _size ||
+           entry.blobSizes[b] > _size - entry.blobOffsets[b]))
+        return false;
+    // The counts are what the runtime sizes its reads by, so they must
+    // agree with the blobs they describe.
+    auto holds{[&](PackBlob blob, size_t count, size_t size) {
+      return entry.blobSizes[size_t(blob)] == count * size;
+    }};
+    if (entry.type == PackEntryType::Texture) {
+      size_t size{};
+      for (uint32_t level{}; level < entry.levelCount; ++level)
+        size += bcLevelSizeInBytes(BcFormat(entry.format),
+                                   std::max(1u, entry.width >> level),
+                                   std::max(1u, entry.height >> level));
+      if (entry.format > uint32_t(BcFormat::Bc7) || entry.levelCount == 0 ||
+          entry.levelCount > 32 ||
+          !holds(PackBlob::TextureLevels, 1, size))
+        return false;
+      continue;
+    }
+    if (entry.type != PackEntryType::Mesh ||
+        !holds(PackBlob::Vertices, entry.vertexCount, sizeof(Vertex)) ||
+        !holds(PackBlob::Indices, entry.indexCount, sizeof(uint32_t)) ||
+        !holds(PackBlob::Submeshes, entry.submeshCount, sizeof(Submesh)) ||
+        !holds(PackBlob::Materials, entry.materialCount,
+               sizeof(PackedMaterial)) ||
+        !holds(PackBlob::Lods, entry.lodCount, sizeof(PackedLod)) ||
+        !holds(PackBlob::Meshlets, entry.meshletCount, sizeof(Meshlet)) ||
+        !holds(PackBlob::MeshletBounds, entry.meshletCount,
+               sizeof(MeshletBounds)) ||
+        !holds(PackBlob::QuantizedVertices, entry.vertexCount,
+               sizeof(QuantizedVertex)))
+      return false;
+    // Ranges between blobs; the index values themselves are left to the
+    // GPU, since checking them would mean reading the whole buffer.
+    auto submeshes{
+        static_cast<const Submesh *>(blob(entry, PackBlob::Submeshes))};
+    for (uint32_t s{}; s < entry.submeshCount; ++s)
+      if (submeshes[s].firstIndex > entry.indexCount ||
+          submeshes[s].indexCount >
+              entry.indexCount - submeshes[s].firstIndex ||
+          submeshes[s].material >= entry.materialCount)
+        return false;
+    auto lods{static_cast<const PackedLod *>(blob(entry, PackBlob::Lods))};
+    for (uint32_t l{}; l < entry.lodCount; ++l)
+      if (lods[l].firstSubmesh > entry.submeshCount ||
+          lods[l].submeshCount > entry.submeshCount - lods[l].firstSubmesh)
+        return false;
+    auto materials{
+        static_cast<const PackedMaterial *>(blob(entry, PackBlob::Materials))};
+    for (uint32_t m{}; m < entry.materialCount; ++m)
+      if (auto t{materials[m].diffuseTexture};
+          t != -1 && (t < 0 || uint32_t(t) >= entryCount() ||
+                      this->entry(size_t(t)).type != PackEntryType::Texture))
+        return false;
+    auto meshlets{
+        static_cast<const Meshlet *>(blob(entry, PackBlob::Meshlets))};
+    for (uint32_t m{}; m < entry.meshletCount; ++m)
+      if (meshlets[m].firstIndex > entry.indexCount ||
+          meshlets[m].triangleCount >
+              (entry.indexCount - meshlets[m].firstIndex) / 3 ||
+          meshlets[m].material >= entry.materialCount)
+        return false;
+  }
+  return true;
+}
+
+AssetPack::~AssetPack() { unmap(); }
+
+void AssetPack::unmap() {
+#ifdef _WIN32
+  if (_data)
+    UnmapViewOfFile(_data);
+  if (_mapping)
+    CloseHandle(_mapping);
+  if (_file && _file != INVALID_HANDLE_VALUE)
+    CloseHandle(_file);
+#else
+  if (_data)
+    munmap(const_cast<uint8_t *>(_data), _size);
+#endif
+  _data = nullptr;
+  _mapping = _file = nullptr;
+}
+
+size_t AssetPack::entryCount() const {
+  return reinterpret_cast<const PackHeader *>(_data)->entryCount;
+}
+
+const PackEntry &AssetPack::entry(size_t index) const {
+  auto header{reinterpret_cast<const PackHeader *>(_data)};
+  return reinterpret_cast<const PackEntry *>(_data +
+                                             header->entriesOffset)[index];
+}
+
+const PackEntry *AssetPack::find(std::string_view name) const {
+  for (size_t i{}; i < entryCount(); ++i)
+    if (name == entry(i).name)
+      return &entry(i);
+  return nullptr;
+}
+
+const void *AssetPack::blob(const PackEntry &entry, PackBlob blob) const {
+  return _data + entry.blobOffsets[size_t(blob)];
+}
+
+GLuint AssetPack::createBuffer(const PackEntry &entry, PackBlob blob) const {
+  GLuint buffer;
+  glCheck(glCreateBuffers(1, &buffer));
+  glCheck(glNamedBufferStorage(buffer,
+                               GLsizeiptr(entry.blobSizes[size_t(blob)]),
+                               this->blob(entry, blob), 0));
+  return buffer;
+}
+
+GLuint AssetPack::createTexture(const PackEntry &entry) const {
+  return uploadBcTexture(
+      BcFormat(entry.format), entry.width, entry.height, entry.levelCount,
+      static_cast<const uint8_t *>(blob(entry, PackBlob::TextureLevels)));
+}
+
+void bakeAssetPack(const std::vector<std::filesystem::path> &sources,
+                   const std::filesystem::path &packPath,
+                   const BcEncodeSettings &textureSettings) {
+  std::vector<std::filesystem::path> meshPaths, texturePaths;
+  std::vector<Mesh> meshes;
+  auto addTexture{[&](const std::filesystem::path &path) {
+    auto found{std::find(texturePaths.begin(), texturePaths.end(), path)};
+    if (found == texturePaths.end())
+      found = texturePaths.insert(found, path);
+    return size_t(found - texturePaths.begin());
+  }};
+
+  for (auto &source : sources) {
+    if (source.extension() == ".obj") {
+      meshPaths.push_back(source);
+      meshes.push_back(loadObj(source));
+      std::printf("%s\n", source.string().c_str());
+      for (auto &step : optimizeMesh(meshes.back()))
+        std::printf("  %-14s ACMR %.3f  ATVR %.3f\n", step.name,
+                    step.stats.acmr, step.stats.atvr);
+    } else if (source.extension() == ".ppm") {
+      addTexture(std::filesystem::canonical(source));
+    } else {
+      throw std::runtime_error{"don't know how to bake " + source.string()};
+    }
+  }
+
+  std::vector<MeshletSet> meshlets;
+  for (auto &mesh : meshes)
+    meshlets.push_back(buildMeshlets(mesh));
+
+  std::vector<std::vector<Submesh>> submeshes(meshes.size());
+  std::vector<std::vector<PackedLod>> lods(meshes.size());
+  for (size_t m{}; m < meshes.size(); ++m)
+    for (auto &lod : generateLods(meshes[m])) {
+      lods[m].push_back({uint32_t(submeshes[m].size()),
+                         uint32_t(lod.submeshes.size()), lod.error, 0});
+      submeshes[m].insert(submeshes[m].end(), lod.submeshes.begin(),
+                          lod.submeshes.end());
+    }
+
+  std::vector<QuantizedMesh> quantized;
+  for (size_t m{}; m < meshes.size(); ++m) {
+    QuantizationError error;
+    quantized.push_back(quantizeMesh(meshes[m], &error));
+    std::printf("%s quantized: position %g, normal %.3f deg, UV %g\n",
+                meshPaths[m].string().c_str(), error.maxPosition,
+                error.maxNormalDegrees, error.maxUv);
+  }
+
+  // Resolve every material's diffuse map first so that the small ones can
+  // be packed together.
+  std::vector<std::vector<size_t>> materialTextures(meshes.size());
+  for (size_t m{}; m < meshes.size(); ++m)
+    for (auto &material : meshes[m].materials) {
+      auto path{resolveTexture(meshPaths[m], material.mapKd)};
+      materialTextures[m].push_back(path.empty() ? TextureAtlas::notPacked
+                                                 : addTexture(path));
+    }
+
+  // Only textures referenced through materials go into the atlas; loose ones
+  // are looked up by name and keep an entry of their own.
+  std::vector<Image> images;
+  for (auto &path : texturePaths)
+    images.emplace_back(path);
+  std::vector<bool> referenced(texturePaths.size()),
+      atlasable(texturePaths.size(), true);
+  for (auto &indices : materialTextures)
+    for (auto t : indices)
+      if (t != TextureAtlas::notPacked)
+        referenced[t] = true;
+  // An atlas region cannot repeat, so a texture stays out of it if any
+  // submesh samples it past [0, 1] after the -o/-s options. Under -clamp on
+  // the replicated padding is its clamped edge, so it may go that far out.
+  AtlasSettings atlasSettings;
+  for (size_t m{}; m < meshes.size(); ++m)
+    for (auto &submesh : meshes[m].submeshes) {
+      auto t{materialTextures[m][submesh.material]};
+      if (t == TextureAtlas::notPacked || !atlasable[t])
+        continue;
+      auto &material{meshes[m].materials[submesh.material]};
+      glm::vec2 uvMin{std::numeric_limits<float>::max()}, uvMax{-uvMin};
+      for (auto i{submesh.firstIndex};
+           i < submesh.firstIndex + submesh.indexCount; ++i) {
+        auto uv{meshes[m].vertices[meshes[m].indices[i]].uv *
+                    material.mapKdScale +
+                material.mapKdOffset};
+        uvMin = glm::min(uvMin, uv);
+        uvMax = glm::max(uvMax, uv);
+      }
+      glm::vec2 slack{1e-4f};
+      if (material.mapKdClamp)
+        slack += float(atlasSettings.padding) /
+                 glm::vec2{images[t].width(), images[t].height()};
+      atlasable[t] = glm::all(glm::greaterThanEqual(uvMin, -slack)) &&
+                     glm::all(glm::lessThanEqual(uvMax, 1.0f + slack));
+    }
+  std::vector<Image> candidates;
+  std::vector<size_t> candidateTextures;
+  for (size_t t{}; t < texturePaths.size(); ++t)
+    if (referenced[t] && atlasable[t]) {
+      candidates.push_back(images[t]);
+      candidateTextures.push_back(t);
+    }
+  auto atlas{packAtlas(candidates, atlasSettings)};
+  std::vector<AtlasRegion> regions(texturePaths.size(),
+                                   {TextureAtlas::notPacked, {0, 0}, {1, 1}});
+  for (size_t c{}; c < candidates.size(); ++c)
+    regions[candidateTextures[c]] = atlas.regions[c];
+
+  std::vector<CompressedTexture> textures;
+  std::vector<std::filesystem::path> textureNames;
+  std::vector<size_t> textureEntries(texturePaths.size());
+  for (size_t t{}; t < texturePaths.size(); ++t)
+    if (regions[t].page == TextureAtlas::notPacked) {
+      textureEntries[t] = meshes.size() + textures.size();
+      textures.emplace_back(images[t], textureSettings);
+      textureNames.push_back(texturePaths[t]);
+    }
+  auto pageSettings{textureSettings};
+  pageSettings.maxLevelCount = atlas.mipSafeLevels;
+  auto firstPage{meshes.size() + textures.size()};
+  for (size_t p{}; p < atlas.pages.size(); ++p) {
+    textures.emplace_back(atlas.pages[p], pageSettings);
+    textureNames.push_back("atlas" + std::to_string(p));
+  }
+  for (size_t t{}; t < texturePaths.size(); ++t)
+    if (regions[t].page != TextureAtlas::notPacked)
+      textureEntries[t] = firstPage + regions[t].page;
+  if (!atlas.pages.empty())
+    std::printf("%zu textures packed into %zu atlas pages\n",
+                candidateTextures.size() -
+                    size_t(std::count_if(
+                        atlas.regions.begin(), atlas.regions.end(),
+                        [](const AtlasRegion &region) {
+                          return region.page == TextureAtlas::notPacked;
+                        })),
+                atlas.pages.size());
+
+  std::vector<std::vector<PackedMaterial>> materials(meshes.size());
+  for (size_t m{}; m < meshes.size(); ++m)
+    for (size_t i{}; i < meshes[m].materials.size(); ++i) {
+      auto &material{meshes[m].materials[i]};
+      auto t{materialTextures[m][i]};
+      int32_t diffuseTexture{-1};
+      auto offset{material.mapKdOffset}, scale{material.mapKdScale};
+      if (t != TextureAtlas::notPacked) {
+        diffuseTexture = int32_t(textureEntries[t]);
+        // OBJ's v goes up from the bottom of the image, while textures and
+        // atlas regions start at its top row.
+        offset.y = 1 - offset.y, scale.y = -scale.y;
+        offset = offset * regions[t].uvScale + regions[t].uvOffset;
+        scale *= regions[t].uvScale;
+      }
+      uint32_t ka[2]{glm::packHalf2x16({material.ka.r, material.ka.g}),
+                     glm::packHalf2x16({material.ka.b, 0})};
+      materials[m].push_back({material.kd, material.d, material.ks,
+                              material.ns, material.ke, material.ni,
+                              material.illum, diffuseTexture, {ka[0], ka[1]},
+                              {offset, scale}});
+    }
+
+  // Lay the blobs out after the entry table.
+  std::vector<PackEntry> entries(meshes.size() + textures.size());
+  std::vector<std::pair<const void *, size_t>> blobs;
+  size_t offset{alignUp(sizeof(PackHeader) + entries.size() * sizeof(PackEntry))};
+  auto place{[&](PackEntry &entry, PackBlob blob, const void *data,
+                 size_t size) {
+    entry.blobOffsets[size_t(blob)] = offset;
+    entry.blobSizes[size_t(blob)] = size;
+    blobs.emplace_back(data, size);
+    offset = alignUp(offset + size);
+  }};
+
+  for (size_t m{}; m < meshes.size(); ++m) {
+    auto &entry{entries[m]};
+    auto &mesh{meshes[m]};
+    setName(entry, meshPaths[m]);
+    entry.type = PackEntryType::Mesh;
+    entry.vertexCount = uint32_t(mesh.vertices.size());
+    entry.indexCount = uint32_t(mesh.indices.size());
+    entry.submeshCount = uint32_t(submeshes[m].size());
+    entry.materialCount = uint32_t(materials[m].size());
+    entry.lodCount = uint32_t(lods[m].size());
+    entry.meshletCount = uint32_t(meshlets[m].meshlets.size());
+    for (size_t axis{}; axis < 3; ++axis) {
+      entry.boundsMin[axis] = quantized[m].boundsMin[axis];
+      entry.boundsExtent[axis] = quantized[m].boundsExtent[axis];
+    }
+    place(entry, PackBlob::Vertices, mesh.vertices.data(),
+          mesh.vertices.size() * sizeof(Vertex));
+    place(entry, PackBlob::Indices, mesh.indices.data(),
+          mesh.indices.size() * sizeof(uint32_t));
+    place(entry, PackBlob::Submeshes, submeshes[m].data(),
+          submeshes[m].size() * sizeof(Submesh));
+    place(entry, PackBlob::Materials, materials[m].data(),
+          materials[m].size() * sizeof(PackedMaterial));
+    place(entry, PackBlob::Lods, lods[m].data(),
+          lods[m].size() * sizeof(PackedLod));
+    place(entry, PackBlob::Meshlets, meshlets[m].meshlets.data(),
+          meshlets[m].meshlets.size() * sizeof(Meshlet));
+    place(entry, PackBlob::MeshletBounds, meshlets[m].bounds.data(),
+          meshlets[m].bounds.size() * sizeof(MeshletBounds));
+    place(entry, PackBlob::QuantizedVertices, quantized[m].vertices.data(),
+          quantized[m].vertices.size() * sizeof(QuantizedVertex));
+  }
+  for (size_t t{}; t < textures.size(); ++t) {
+    auto &entry{entries[meshes.size() + t]};
+    auto &texture{textures[t]};
+    setName(entry, textureNames[t]);
+    entry.type = PackEntryType::Texture;
+    entry.format = uint32_t(texture.format());
+    entry.width = uint32_t(texture.width());
+    entry.height = uint32_t(texture.height());
+    entry.levelCount = uint32_t(texture.levelCount());
+    place(entry, PackBlob::TextureLevels, texture.levelData(0),
+          texture.sizeInBytes());
+  }
+
+  std::ofstream out{packPath, std::ios::binary};
+  if (!out)
+    throw std::runtime_error{"could not create " + packPath.string()};
+  PackHeader header{packMagic,           packVersion, uint32_t(entries.size()),
+                    0,                   sizeof(PackHeader), offset};
+  out.write(reinterpret_cast<const char *>(&header), sizeof header);
+  out.write(reinterpret_cast<const char *>(entries.data()),
+            std::streamsize(entries.size() * sizeof(PackEntry)));
+  size_t written{sizeof(PackHeader) + entries.size() * sizeof(PackEntry)};
+  constexpr char zeros[packAlignment]{};
+  for (auto [data, size] : blobs) {
+    out.write(zeros, std::streamsize(alignUp(written) - written));
+    out.write(static_cast<const char *>(data), std::streamsize(size));
+    written = alignUp(written) + size;
+  }
+  out.write(zeros, std::streamsize(alignUp(written) - written));
+  if (!out)
+    throw std::runtime_error{"could not write " + packPath.string()};
+}
@@ -0,0 +1,93 @@
+#include "atlas.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// imgui_draw.cpp compiles its own copy of stb_rect_pack with internal
+// linkage, so this translation unit needs one as well; it comes with a
+// heuristic setter that goes unused here.
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#include "imgui/imstb_rectpack.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+// Page offsets and sizes are kept to multiples of a BC block.
+constexpr size_t atlasAlignment{4};
+
+size_t alignUp(size_t value) {
+  return (value + atlasAlignment - 1) / atlasAlignment * atlasAlignment;
+}
+
+// Copies image into page at (x, y), past the padding, and replicates its
+// edges into the padding and alignment slack around it.
+void blit(Image &page, const Image &image, size_t x, size_t y, size_t w,
+          size_t h, size_t padding) {
+  for (size_t row{}; row < h; ++row)
+    for (size_t column{}; column < w; ++column) {
+      auto sx{std::clamp<ptrdiff_t>(ptrdiff_t(column) - ptrdiff_t(padding), 0,
+                                    ptrdiff_t(image.width()) - 1)};
+      auto sy{std::clamp<ptrdiff_t>(ptrdiff_t(row) - ptrdiff_t(padding), 0,
+                                    ptrdiff_t(image.height()) - 1)};
+      std::copy_n(image.pixel(size_t(sx), size_t(sy)), 3,
+                  page.pixel(x + column, y + row));
+    }
+}
+} // namespace
+
+TextureAtlas packAtlas(const std::vector<Image> &images,
+                       const AtlasSettings &settings) {
+  TextureAtlas atlas;
+  atlas.regions.assign(images.size(), {TextureAtlas::notPacked, {0, 0}, {1, 1}});
+  atlas.mipSafeLevels = 1;
+  while ((size_t{1} << atlas.mipSafeLevels) <= settings.padding)
+    ++atlas.mipSafeLevels;
+
+  std::vector<stbrp_rect> pending;
+  for (size_t i{}; i < images.size(); ++i) {
+    auto &image{images[i]};
+    if (image.width() > settings.maxImageSize ||
+        image.height() > settings.maxImageSize)
+      continue;
+    auto w{alignUp(image.width() + 2 * settings.padding)};
+    auto h{alignUp(image.height() + 2 * settings.padding)};
+    if (w > settings.pageSize || h > settings.pageSize)
+      throw std::runtime_error{"atlas pages are too small for the padding"};
+    pending.push_back({int(i), int(w), int(h), 0, 0, 0});
+  }
+
+  std::vector<stbrp_node> nodes(settings.pageSize);
+  auto pageSize{float(settings.pageSize)};
+  while (!pending.empty()) {
+    stbrp_context context;
+    stbrp_init_target(&context, int(settings.pageSize), int(settings.pageSize),
+                      nodes.data(), int(nodes.size()));
+    stbrp_pack_rects(&context, pending.data(), int(pending.size()));
+
+    auto &page{atlas.pages.emplace_back(settings.pageSize, settings.pageSize)};
+    std::vector<stbrp_rect> leftover;
+    for (auto &rect : pending) {
+      if (!rect.was_packed) {
+        leftover.push_back(rect);
+        continue;
+      }
+      auto &image{images[size_t(rect.id)]};
+      blit(page, image, size_t(rect.x), size_t(rect.y), size_t(rect.w),
+           size_t(rect.h), settings.padding);
+      atlas.regions[size_t(rect.id)] = {
+          atlas.pages.size() - 1,
+          glm::vec2(float(size_t(rect.x) + settings.padding),
+                    float(size_t(rect.y) + settings.padding)) /
+              pageSize,
+          glm::vec2(float(image.width()), float(image.height())) / pageSize};
+    }
+    pending = std::move(leftover);
+  }
+  return atlas;
+}
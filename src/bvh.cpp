@@ -0,0 +1,604 @@
+#include "bvh.hpp"
+#include "simd_transform.hpp"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/matrix.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace {
+constexpr size_t binCount{16};
+constexpr size_t maxLeafSize{8};
+// Deepest a tree gets: past sahDepth nodes are split in half, which adds at
+// most 32 levels for 32-bit primitive counts. Traversal keeps at most one
+// pending node per level, so its stack is this deep.
+constexpr size_t maxDepth{96}, sahDepth{maxDepth - 32};
+// Cost of visiting a node relative to intersecting one primitive.
+constexpr float traversalCost{1};
+constexpr float infinity{std::numeric_limits<float>::infinity()};
+
+struct Bin {
+  glm::vec3 boundsMin{infinity}, boundsMax{-infinity};
+  uint32_t count{};
+};
+
+float surfaceArea(glm::vec3 boundsMin, glm::vec3 boundsMax) {
+  auto e{glm::max(boundsMax - boundsMin, glm::vec3{0})};
+  return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+size_t binIndex(float centroid, float centroidMin, float scale) {
+  return std::min(binCount - 1, size_t((centroid - centroidMin) * scale));
+}
+
+// Binned SAH build (Wald 2007) over primitives given by their boxes. Writes
+// the nodes, root first and children always after their parent, and the
+// primitives in the order the leaves refer to them.
+void buildBvh(const std::vector<glm::vec3> &mins,
+              const std::vector<glm::vec3> &maxs, std::vector<BvhNode> &nodes,
+              std::vector<uint32_t> &order) {
+  auto count{uint32_t(mins.size())};
+  order.resize(count);
+  for (uint32_t i{}; i < count; ++i)
+    order[i] = i;
+  nodes.clear();
+  if (!count)
+    return;
+  nodes.reserve(2 * size_t(count));
+  nodes.push_back({glm::vec3{0}, 0, glm::vec3{0}, count});
+
+  struct Pending {
+    uint32_t node;
+    size_t depth;
+  };
+  std::vector<Pending> stack{{0, 0}};
+  while (!stack.empty()) {
+    auto [index, depth]{stack.back()};
+    stack.pop_back();
+    auto first{nodes[index].leftOrFirst}, nodeCount{nodes[index].count};
+
+    glm::vec3 lo{infinity}, hi{-infinity}, centroidMin{infinity},
+        centroidMax{-infinity};
+    for (auto i{first}; i < first + nodeCount; ++i) {
+      auto primitive{order[i]};
+      lo = glm::min(lo, mins[primitive]);
+      hi = glm::max(hi, maxs[primitive]);
+      auto centroid{(mins[primitive] + maxs[primitive]) * 0.5f};
+      centroidMin = glm::min(centroidMin, centroid);
+      centroidMax = glm::max(centroidMax, centroid);
+    }
+    nodes[index].boundsMin = lo;
+    nodes[index].boundsMax = hi;
+    if (nodeCount <= 1 || (depth >= sahDepth && nodeCount <= maxLeafSize))
+      continue;
+
+    auto bestCost{infinity};
+    int bestAxis{-1};
+    size_t bestSplit{};
+    for (int axis{}; axis < 3 && depth < sahDepth; ++axis) {
+      auto extent{centroidMax[axis] - centroidMin[axis]};
+      if (extent <= 0)
+        continue;
+      auto scale{float(binCount) / extent};
+      Bin bins[binCount];
+      for (auto i{first}; i < first + nodeCount; ++i) {
+        auto primitive{order[i]};
+        auto centroid{(mins[primitive][axis] + maxs[primitive][axis]) * 0.5f};
+        auto &bin{bins[binIndex(centroid, centroidMin[axis], scale)]};
+        bin.boundsMin = glm::min(bin.boundsMin, mins[primitive]);
+        bin.boundsMax = glm::max(bin.boundsMax, maxs[primitive]);
+        ++bin.count;
+      }
+      // Sweep from both ends: cost of splitting after bin i.
+      float leftCost[binCount - 1];
+      Bin left, right;
+      for (size_t i{}; i < binCount - 1; ++i) {
+        left.boundsMin = glm::min(left.boundsMin, bins[i].boundsMin);
+        left.boundsMax = glm::max(left.boundsMax, bins[i].boundsMax);
+        left.count += bins[i].count;
+        leftCost[i] =
+            float(left.count) * surfaceArea(left.boundsMin, left.boundsMax);
+      }
+      for (auto i{binCount - 1}; i > 0; --i) {
+        right.boundsMin = glm::min(right.boundsMin, bins[i].boundsMin);
+        right.boundsMax = glm::max(right.boundsMax, bins[i].boundsMax);
+        right.count += bins[i].count;
+        auto cost{leftCost[i - 1] + float(right.count) * surfaceArea(
+                                                             right.boundsMin,
+                                                             right.boundsMax)};
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = i;
+        }
+      }
+    }
+
+    auto area{surfaceArea(lo, hi)};
+    auto leafCost{float(nodeCount)};
+    auto splitCost{traversalCost + (area > 0 ? bestCost / area : infinity)};
+    if (depth < sahDepth && nodeCount <= maxLeafSize && leafCost <= splitCost)
+      continue;
+
+    uint32_t leftCount;
+    if (bestAxis < 0) {
+      // Every centroid in the same spot, or the tree is already sahDepth
+      // deep: split the list in half to keep leaves small and the tree
+      // shallow.
+      leftCount = nodeCount / 2;
+    } else {
+      auto scale{float(binCount) /
+                 (centroidMax[bestAxis] - centroidMin[bestAxis])};
+      auto middle{std::partition(
+          order.begin() + first, order.begin() + first + nodeCount,
+          [&](uint32_t primitive) {
+            auto centroid{
+                (mins[primitive][bestAxis] + maxs[primitive][bestAxis]) *
+                0.5f};
+            return binIndex(centroid, centroidMin[bestAxis], scale) <
+                   bestSplit;
+          })};
+      leftCount = uint32_t(middle - (order.begin() + first));
+      if (leftCount == 0 || leftCount == nodeCount)
+        leftCount = nodeCount / 2;
+    }
+
+    auto leftIndex{uint32_t(nodes.size())};
+    nodes.push_back({glm::vec3{0}, first, glm::vec3{0}, leftCount});
+    nodes.push_back(
+        {glm::vec3{0}, first + leftCount, glm::vec3{0}, nodeCount - leftCount});
+    nodes[index].leftOrFirst = leftIndex;
+    nodes[index].count = 0;
+    stack.push_back({leftIndex + 1, depth + 1});
+    stack.push_back({leftIndex, depth + 1});
+  }
+}
+
+// Entry distance of the ray into the node's box, or infinity if it misses
+// it or only enters beyond tMax.
+float intersectBox(const BvhNode &node, glm::vec3 origin,
+                   glm::vec3 inverseDirection, float tMax) {
+  auto t1{(node.boundsMin - origin) * inverseDirection};
+  auto t2{(node.boundsMax - origin) * inverseDirection};
+  auto near{glm::min(t1, t2)}, far{glm::max(t1, t2)};
+  auto tNear{std::max({near.x, near.y, near.z, 0.0f})};
+  auto tFar{std::min({far.x, far.y, far.z, tMax})};
+  return tNear <= tFar ? tNear : infinity;
+}
+
+struct LeafHit {
+  float t{infinity}, u{}, v{};
+  uint32_t index{};
+};
+
+// Moller-Trumbore, both faces, over triangles first to first + count of
+// MeshBvh's arrays; returns the closest hit nearer than tMax.
+LeafHit intersectLeafScalar(const float *data, size_t stride, uint32_t first,
+                            uint32_t count, const Ray &ray, float tMax) {
+  LeafHit closest;
+  for (auto i{first}; i < first + count; ++i) {
+    glm::vec3 vertex{data[i], data[stride + i], data[2 * stride + i]};
+    glm::vec3 edge1{data[3 * stride + i], data[4 * stride + i],
+                    data[5 * stride + i]};
+    glm::vec3 edge2{data[6 * stride + i], data[7 * stride + i],
+                    data[8 * stride + i]};
+    auto p{glm::cross(ray.direction, edge2)};
+    auto determinant{glm::dot(edge1, p)};
+    if (std::abs(determinant) < 1e-12f)
+      continue;
+    auto inverseDeterminant{1 / determinant};
+    auto s{ray.origin - vertex};
+    auto u{glm::dot(s, p) * inverseDeterminant};
+    if (u < 0 || u > 1)
+      continue;
+    auto q{glm::cross(s, edge1)};
+    auto v{glm::dot(ray.direction, q) * inverseDeterminant};
+    if (v < 0 || u + v > 1)
+      continue;
+    auto t{glm::dot(edge2, q) * inverseDeterminant};
+    if (t <= 0 || t >= std::min(closest.t, tMax))
+      continue;
+    closest = {t, u, v, i};
+  }
+  return closest;
+}
+
+#ifdef SIMD_X86
+// Helpers of intersectLeafAvx2(), as functions rather than lambdas since
+// lambdas do not inherit the target attribute. load() reads components
+// component to component + 2 of the eight triangles from first on.
+SIMD_TARGET("avx2,fma")
+inline void load(const float *data, size_t stride, uint32_t first,
+                 size_t component, __m256 result[3]) {
+  for (size_t i{}; i < 3; ++i)
+    result[i] = _mm256_loadu_ps(data + (component + i) * stride + first);
+}
+
+SIMD_TARGET("avx2,fma")
+inline void cross(const __m256 a[3], const __m256 b[3], __m256 result[3]) {
+  result[0] = _mm256_fmsub_ps(a[1], b[2], _mm256_mul_ps(a[2], b[1]));
+  result[1] = _mm256_fmsub_ps(a[2], b[0], _mm256_mul_ps(a[0], b[2]));
+  result[2] = _mm256_fmsub_ps(a[0], b[1], _mm256_mul_ps(a[1], b[0]));
+}
+
+SIMD_TARGET("avx2,fma")
+inline __m256 dot(const __m256 a[3], const __m256 b[3]) {
+  return _mm256_fmadd_ps(
+      a[0], b[0], _mm256_fmadd_ps(a[1], b[1], _mm256_mul_ps(a[2], b[2])));
+}
+
+// The same test on a whole leaf at once, one triangle per lane.
+SIMD_TARGET("avx2,fma")
+LeafHit intersectLeafAvx2(const float *data, size_t stride, uint32_t first,
+                          uint32_t count, const Ray &ray, float tMax) {
+  __m256 direction[]{_mm256_set1_ps(ray.direction.x),
+                     _mm256_set1_ps(ray.direction.y),
+                     _mm256_set1_ps(ray.direction.z)};
+  __m256 vertex[3], edge1[3], edge2[3];
+  load(data, stride, first, 0, vertex);
+  load(data, stride, first, 3, edge1);
+  load(data, stride, first, 6, edge2);
+  __m256 s[]{_mm256_sub_ps(_mm256_set1_ps(ray.origin.x), vertex[0]),
+             _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), vertex[1]),
+             _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), vertex[2])};
+  __m256 p[3], q[3];
+  cross(direction, edge2, p);
+  cross(s, edge1, q);
+  auto determinant{dot(edge1, p)};
+  auto inverseDeterminant{_mm256_div_ps(_mm256_set1_ps(1), determinant)};
+  auto u{_mm256_mul_ps(dot(s, p), inverseDeterminant)};
+  auto v{_mm256_mul_ps(dot(direction, q), inverseDeterminant)};
+  auto t{_mm256_mul_ps(dot(edge2, q), inverseDeterminant)};
+
+  auto zero{_mm256_setzero_ps()}, one{_mm256_set1_ps(1)};
+  auto absMask{_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))};
+  auto valid{_mm256_cmp_ps(_mm256_and_ps(determinant, absMask),
+                           _mm256_set1_ps(1e-12f), _CMP_GE_OQ)};
+  valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+  valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, one, _CMP_LE_OQ));
+  valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+  valid = _mm256_and_ps(
+      valid, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+  valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+  valid = _mm256_and_ps(
+      valid, _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+  auto mask{unsigned(_mm256_movemask_ps(valid)) & ((1u << count) - 1)};
+  if (!mask)
+    return {};
+
+  alignas(32) float ts[8], us[8], vs[8];
+  _mm256_store_ps(ts, t);
+  _mm256_store_ps(us, u);
+  _mm256_store_ps(vs, v);
+  LeafHit closest;
+  for (; mask; mask &= mask - 1) {
+    auto lane{std::countr_zero(mask)};
+    if (ts[lane] < closest.t)
+      closest = {ts[lane], us[lane], vs[lane], first + uint32_t(lane)};
+  }
+  return closest;
+}
+#endif
+
+// Walks the tree front to back, calling hitLeaf(first, count) for every leaf
+// whose box the ray enters before the closest hit so far.
+template <typename Fn>
+void traverse(const std::vector<BvhNode> &nodes, const Ray &ray,
+              const RayHit &hit, Fn hitLeaf) {
+  if (nodes.empty())
+    return;
+  auto inverseDirection{1.0f / ray.direction};
+  auto tMax{[&] { return std::min(ray.tMax, hit.t); }};
+  if (intersectBox(nodes[0], ray.origin, inverseDirection, tMax()) ==
+      infinity)
+    return;
+
+  // Far children wait here with their entry distance, so that they can be
+  // skipped once a closer hit turns up.
+  struct Pending {
+    uint32_t node;
+    float t;
+  } stack[maxDepth];
+  size_t stackSize{};
+  uint32_t index{};
+  while (true) {
+    auto &node{nodes[index]};
+    if (node.count) {
+      hitLeaf(node.leftOrFirst, node.count);
+    } else {
+      auto near{node.leftOrFirst}, far{near + 1};
+      auto tNear{intersectBox(nodes[near], ray.origin, inverseDirection,
+                              tMax())};
+      auto tFar{
+          intersectBox(nodes[far], ray.origin, inverseDirection, tMax())};
+      if (tFar < tNear) {
+        std::swap(near, far);
+        std::swap(tNear, tFar);
+      }
+      if (tNear != infinity) {
+        if (tFar != infinity)
+          stack[stackSize++] = {far, tFar};
+        index = near;
+        continue;
+      }
+    }
+    do {
+      if (!stackSize)
+        return;
+      --stackSize;
+    } while (stack[stackSize].t > tMax());
+    index = stack[stackSize].node;
+  }
+}
+} // namespace
+
+MeshBvh::MeshBvh(const Mesh &mesh) {
+  std::vector<uint32_t> meshTriangles;
+  for (auto &submesh : mesh.submeshes)
+    for (uint32_t i{}; i + 2 < submesh.indexCount; i += 3)
+      meshTriangles.push_back((submesh.firstIndex + i) / 3);
+
+  std::vector<glm::vec3> mins, maxs;
+  mins.reserve(meshTriangles.size());
+  maxs.reserve(meshTriangles.size());
+  for (auto triangle : meshTriangles) {
+    auto &a{mesh.vertices[mesh.indices[3 * triangle]].position};
+    auto &b{mesh.vertices[mesh.indices[3 * triangle + 1]].position};
+    auto &c{mesh.vertices[mesh.indices[3 * triangle + 2]].position};
+    mins.push_back(glm::min(a, glm::min(b, c)));
+    maxs.push_back(glm::max(a, glm::max(b, c)));
+  }
+
+  std::vector<uint32_t> order;
+  buildBvh(mins, maxs, _nodes, order);
+  _triangles.reserve(order.size());
+  _stride = order.size() + maxLeafSize;
+  _triangleData.resize(9 * _stride);
+  for (size_t i{}; i < order.size(); ++i) {
+    auto triangle{meshTriangles[order[i]]};
+    auto &a{mesh.vertices[mesh.indices[3 * triangle]].position};
+    auto &b{mesh.vertices[mesh.indices[3 * triangle + 1]].position};
+    auto &c{mesh.vertices[mesh.indices[3 * triangle + 2]].position};
+    _triangles.push_back(triangle);
+    glm::vec3 columns[]{a, b - a, c - a};
+    for (size_t component{}; component < 9; ++component)
+      _triangleData[component * _stride + i] =
+          columns[component / 3][int(component % 3)];
+  }
+}
+
+glm::vec3 MeshBvh::boundsMin() const {
+  return _nodes.empty() ? glm::vec3{0} : _nodes[0].boundsMin;
+}
+
+glm::vec3 MeshBvh::boundsMax() const {
+  return _nodes.empty() ? glm::vec3{0} : _nodes[0].boundsMax;
+}
+
+bool MeshBvh::intersect(const Ray &ray, RayHit &hit) const {
+  bool found{};
+  traverse(_nodes, ray, hit, [&](uint32_t first, uint32_t count) {
+    LeafHit leafHit;
+#ifdef SIMD_X86
+    if (simdLevel() == SimdLevel::Avx2)
+      leafHit = intersectLeafAvx2(_triangleData.data(), _stride, first, count,
+                                  ray, std::min(hit.t, ray.tMax));
+    else
+#endif
+      leafHit = intersectLeafScalar(_triangleData.data(), _stride, first,
+                                    count, ray, std::min(hit.t, ray.tMax));
+    if (leafHit.t < infinity) {
+      hit.t = leafHit.t;
+      hit.triangle = _triangles[leafHit.index];
+      hit.barycentrics = {leafHit.u, leafHit.v};
+      found = true;
+    }
+  });
+  return found;
+}
+
+uint32_t SceneBvh::addInstance(const MeshBvh &mesh,
+                               const glm::mat4 &transform) {
+  _instances.push_back({&mesh, {}, {}, {}});
+  setTransform(uint32_t(_instances.size() - 1), transform);
+  return uint32_t(_instances.size() - 1);
+}
+
+// The world box is the tightest box around the transformed mesh box (Arvo
+// 1990).
+void SceneBvh::setTransform(uint32_t instance, const glm::mat4 &transform) {
+  auto &entry{_instances[instance]};
+  entry.worldToObject = glm::inverse(transform);
+  auto center{(entry.mesh->boundsMin() + entry.mesh->boundsMax()) * 0.5f};
+  auto extent{(entry.mesh->boundsMax() - entry.mesh->boundsMin()) * 0.5f};
+  glm::vec3 worldCenter{transform * glm::vec4{center, 1}};
+  glm::vec3 worldExtent{0};
+  for (int column{}; column < 3; ++column)
+    worldExtent += glm::abs(glm::vec3{transform[column]}) * extent[column];
+  entry.boundsMin = worldCenter - worldExtent;
+  entry.boundsMax = worldCenter + worldExtent;
+}
+
+void SceneBvh::build() {
+  std::vector<glm::vec3> mins, maxs;
+  for (auto &instance : _instances) {
+    mins.push_back(instance.boundsMin);
+    maxs.push_back(instance.boundsMax);
+  }
+  buildBvh(mins, maxs, _nodes, _order);
+}
+
+void SceneBvh::refit() {
+  for (auto index{_nodes.size()}; index-- > 0;) {
+    auto &node{_nodes[index]};
+    glm::vec3 lo{infinity}, hi{-infinity};
+    if (node.count) {
+      for (auto i{node.leftOrFirst}; i < node.leftOrFirst + node.count; ++i) {
+        lo = glm::min(lo, _instances[_order[i]].boundsMin);
+        hi = glm::max(hi, _instances[_order[i]].boundsMax);
+      }
+    } else {
+      for (auto child : {node.leftOrFirst, node.leftOrFirst + 1}) {
+        lo = glm::min(lo, _nodes[child].boundsMin);
+        hi = glm::max(hi, _nodes[child].boundsMax);
+      }
+    }
+    node.boundsMin = lo;
+    node.boundsMax = hi;
+  }
+}
+
+// Rays enter each instance in its object space; the direction isn't
+// renormalized there, so t means the same thing on both sides.
+bool SceneBvh::intersect(const Ray &ray, RayHit &hit) const {
+  bool found{};
+  traverse(_nodes, ray, hit, [&](uint32_t first, uint32_t count) {
+    for (auto i{first}; i < first + count; ++i) {
+      auto &instance{_instances[_order[i]]};
+      Ray local{glm::vec3{instance.worldToObject * glm::vec4{ray.origin, 1}},
+                glm::vec3{instance.worldToObject * glm::vec4{ray.direction, 0}},
+                ray.tMax};
+      if (instance.mesh->intersect(local, hit)) {
+        hit.instance = _order[i];
+        found = true;
+      }
+    }
+  });
+  return found;
+}
+
+Ray pickingRay(glm::vec2 cursor, glm::vec2 windowSize, const glm::mat4 &view,
+               const glm::mat4 &projection) {
+  glm::vec2 ndc{2 * cursor.x / windowSize.x - 1,
+                1 - 2 * cursor.y / windowSize.y};
+  auto inverse{glm::inverse(projection * view)};
+  auto nearPoint{inverse * glm::vec4{ndc, -1, 1}};
+  auto farPoint{inverse * glm::vec4{ndc, 1, 1}};
+  glm::vec3 origin{nearPoint / nearPoint.w};
+  glm::vec3 target{farPoint / farPoint.w};
+  return {origin, glm::normalize(target - origin)};
+}
+
+void benchmarkPicking() {
+  using Clock = std::chrono::steady_clock;
+  auto elapsedMs{[](Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  }};
+
+  // A UV sphere of 2 * 500 * 1000 triangles.
+  constexpr uint32_t rings{500}, segments{1000};
+  Mesh sphere;
+  for (uint32_t ring{}; ring <= rings; ++ring)
+    for (uint32_t segment{}; segment < segments; ++segment) {
+      auto theta{3.14159265f * float(ring) / rings};
+      auto phi{2 * 3.14159265f * float(segment) / segments};
+      glm::vec3 p{std::sin(theta) * std::cos(phi), std::cos(theta),
+                  std::sin(theta) * std::sin(phi)};
+      sphere.vertices.push_back({p, p, glm::vec2{0}});
+    }
+  for (uint32_t ring{}; ring < rings; ++ring)
+    for (uint32_t segment{}; segment < segments; ++segment) {
+      auto a{ring * segments + segment};
+      auto b{ring * segments + (segment + 1) % segments};
+      auto c{b + segments}, d{a + segments};
+      sphere.indices.insert(sphere.indices.end(), {a, b, c, a, c, d});
+    }
+  sphere.submeshes.push_back({0, uint32_t(sphere.indices.size()), 0});
+
+  auto start{Clock::now()};
+  MeshBvh meshBvh{sphere};
+  std::printf("%zu-triangle mesh BVH built in %.0f ms\n",
+              meshBvh.triangleCount(), elapsedMs(start));
+
+  // Ten instances in two rows, rotated and stretched differently.
+  SceneBvh scene;
+  std::vector<glm::mat4> transforms;
+  for (int i{}; i < 10; ++i) {
+    auto transform{glm::translate(glm::mat4{1},
+                                  glm::vec3{float(i % 5) * 3 - 6,
+                                            float(i / 5) * 3 - 1.5f, 0})};
+    transform = glm::rotate(transform, float(i), glm::vec3{0, 1, 1});
+    transform = glm::scale(transform, glm::vec3{1, 1 + 0.05f * float(i), 1});
+    transforms.push_back(transform);
+    scene.addInstance(meshBvh, transform);
+  }
+  scene.build();
+
+  glm::vec2 windowSize{1920, 1080};
+  auto view{glm::lookAt(glm::vec3{0, 0, 8}, glm::vec3{0}, {0, 1, 0})};
+  auto projection{glm::perspective(glm::radians(60.0f),
+                                   windowSize.x / windowSize.y, 0.1f, 100.0f)};
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> x{0, windowSize.x}, y{0, windowSize.y};
+  constexpr size_t rayCount{100000};
+  std::vector<Ray> rays;
+  for (size_t i{}; i < rayCount; ++i)
+    rays.push_back(pickingRay({x(random), y(random)}, windowSize, view,
+                              projection));
+
+  // Misses are cheap, so the rays that hit are timed again on their own.
+  std::vector<Ray> hitting;
+  start = Clock::now();
+  for (auto &ray : rays) {
+    RayHit hit;
+    if (scene.intersect(ray, hit))
+      hitting.push_back(ray);
+  }
+  auto allMs{elapsedMs(start)};
+  start = Clock::now();
+  for (auto &ray : hitting) {
+    RayHit hit;
+    scene.intersect(ray, hit);
+  }
+  std::printf("%zu picking rays over %zu triangles: %.3f us per ray, %.3f us "
+              "per ray for the %zu that hit (%s)\n",
+              rayCount, 10 * meshBvh.triangleCount(), allMs * 1000 / rayCount,
+              elapsedMs(start) * 1000 / double(hitting.size()),
+              hitting.size(), simdLevelName(simdLevel()));
+
+  // Brute force over every triangle of every instance, for a few rays, half
+  // of them known to hit.
+  constexpr size_t checkedRays{20};
+  size_t mismatches{};
+  for (size_t r{}; r < checkedRays; ++r) {
+    auto &ray{r % 2 && r / 2 < hitting.size() ? hitting[r / 2] : rays[r]};
+    RayHit hit;
+    scene.intersect(ray, hit);
+    auto closest{infinity};
+    for (auto &transform : transforms) {
+      auto worldToObject{glm::inverse(transform)};
+      glm::vec3 origin{worldToObject * glm::vec4{ray.origin, 1}};
+      glm::vec3 direction{worldToObject * glm::vec4{ray.direction, 0}};
+      for (size_t i{}; i < sphere.indices.size(); i += 3) {
+        auto &a{sphere.vertices[sphere.indices[i]].position};
+        auto &b{sphere.vertices[sphere.indices[i + 1]].position};
+        auto &c{sphere.vertices[sphere.indices[i + 2]].position};
+        auto edge1{b - a}, edge2{c - a};
+        auto p{glm::cross(direction, edge2)};
+        auto determinant{glm::dot(edge1, p)};
+        if (std::abs(determinant) < 1e-12f)
+          continue;
+        auto s{origin - a};
+        auto u{glm::dot(s, p) / determinant};
+        auto q{glm::cross(s, edge1)};
+        auto v{glm::dot(direction, q) / determinant};
+        auto t{glm::dot(edge2, q) / determinant};
+        if (u >= 0 && v >= 0 && u + v <= 1 && t > 0)
+          closest = std::min(closest, t);
+      }
+    }
+    mismatches += closest == infinity
+                      ? hit.t != infinity
+                      : std::abs(hit.t - closest) > 1e-4f * closest;
+  }
+  std::printf("%zu/%zu rays differing from brute force\n", mismatches,
+              checkedRays);
+}
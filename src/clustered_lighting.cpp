@@ -0,0 +1,547 @@
+#include "clustered_lighting.hpp"
+#include "deferred_shading.hpp"
+#include "gl_util.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+#include "window.hpp"
+
+#include "glm/common.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "glm/trigonometric.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace {
+constexpr GLuint workGroupSize{128};
+
+static_assert(sizeof(Light) == 64,
+              "Light must match the shaders' std430 Light");
+static_assert(ClusteredLighting::clusterCount % workGroupSize == 0,
+              "clusters must fill whole work groups");
+
+// One invocation per cluster. Lights are brought into view space a work
+// group's worth at a time, through shared memory, and each invocation then
+// tests the whole batch against its cluster's box.
+constexpr auto csSrc{R"(
+  #version 450
+
+  layout (local_size_x = 128) in;
+
+  struct Light {
+    vec4 positionRange;
+    vec4 colorIntensity;
+    vec4 directionCosOuter;
+    vec4 cosInner;
+  };
+
+  layout (std140, binding = 2) uniform ClusterParams {
+    mat4 clusterView;
+    uvec4 clusterGrid;
+    vec4 clusterSlicing;
+    vec4 clusterAmbient;
+  };
+  layout (std430, binding = 4) readonly buffer Lights { Light lights[]; };
+  layout (std430, binding = 5) writeonly buffer ClusterLightCounts {
+    uint clusterLightCounts[];
+  };
+  layout (std430, binding = 6) writeonly buffer ClusterLightIndices {
+    uint clusterLightIndices[];
+  };
+  layout (std430, binding = 7) readonly buffer ClusterBounds {
+    vec4 clusterBounds[]; // view-space min and max of each cluster
+  };
+
+  uniform uint lightCount;
+
+  shared vec4 spheres[gl_WorkGroupSize.x]; // center, range
+  shared vec4 cones[gl_WorkGroupSize.x];   // direction, cosOuter
+
+  bool touches(vec3 lo, vec3 hi, vec4 sphere, vec4 cone) {
+    vec3 outside = max(max(lo - sphere.xyz, sphere.xyz - hi), 0.0);
+    if (dot(outside, outside) > sphere.w * sphere.w)
+      return false;
+    if (cone.w < -1.0)
+      return true;
+    // The cone against the sphere around the box.
+    vec3 center = 0.5 * (lo + hi);
+    float radius = 0.5 * length(hi - lo);
+    vec3 v = center - sphere.xyz;
+    float along = dot(v, cone.xyz);
+    float across = sqrt(max(dot(v, v) - along * along, 0.0));
+    float sinOuter = sqrt(max(1.0 - cone.w * cone.w, 0.0));
+    return cone.w * across - along * sinOuter <= radius
+           && along >= -radius && along <= sphere.w + radius;
+  }
+
+  void main(void) {
+    uint clusterCount = clusterGrid.x * clusterGrid.y * clusterGrid.z;
+    uint maxLights = clusterGrid.w;
+    uint cluster = gl_GlobalInvocationID.x;
+    bool inGrid = cluster < clusterCount;
+    vec3 lo = vec3(0), hi = vec3(0);
+    if (inGrid) {
+      lo = clusterBounds[2 * cluster].xyz;
+      hi = clusterBounds[2 * cluster + 1].xyz;
+    }
+
+    uint count = 0;
+    for (uint first = 0; first < lightCount; first += gl_WorkGroupSize.x) {
+      uint i = first + gl_LocalInvocationIndex;
+      if (i < lightCount) {
+        Light light = lights[i];
+        spheres[gl_LocalInvocationIndex] = vec4(
+            (clusterView * vec4(light.positionRange.xyz, 1)).xyz,
+            light.positionRange.w);
+        cones[gl_LocalInvocationIndex] = vec4(
+            mat3(clusterView) * light.directionCosOuter.xyz,
+            light.directionCosOuter.w);
+      }
+      barrier();
+      uint batch = min(gl_WorkGroupSize.x, lightCount - first);
+      for (uint j = 0; inGrid && j < batch; ++j)
+        if (touches(lo, hi, spheres[j], cones[j])) {
+          if (count < maxLights)
+            clusterLightIndices[cluster * maxLights + count] = first + j;
+          ++count;
+        }
+      barrier();
+    }
+    if (inGrid)
+      clusterLightCounts[cluster] = min(count, maxLights);
+  }
+)"};
+} // namespace
+
+const char *const clusteredShadingSource{R"(
+  struct Light {
+    vec4 positionRange;
+    vec4 colorIntensity;
+    vec4 directionCosOuter;
+    vec4 cosInner;
+  };
+
+  layout (std140, binding = 2) uniform ClusterParams {
+    mat4 clusterView;
+    uvec4 clusterGrid;    // x, y, z, lights per cluster
+    vec4 clusterSlicing;  // tile width and height, slice scale and bias
+    vec4 clusterAmbient;
+  };
+  layout (std430, binding = 4) readonly buffer Lights { Light lights[]; };
+  layout (std430, binding = 5) readonly buffer ClusterLightCounts {
+    uint clusterLightCounts[];
+  };
+  layout (std430, binding = 6) readonly buffer ClusterLightIndices {
+    uint clusterLightIndices[];
+  };
+
+  vec3 shadeBlinnPhong(vec3 position, vec3 normal, vec3 eye, vec3 ka,
+                       vec3 kd, vec3 ks, float ns, vec3 ke) {
+    float depth = -(clusterView * vec4(position, 1)).z;
+    uvec2 tile = uvec2(min(gl_FragCoord.xy / clusterSlicing.xy,
+                           vec2(clusterGrid.xy - 1u)));
+    uint slice = uint(clamp(log(depth) * clusterSlicing.z + clusterSlicing.w,
+                            0.0, float(clusterGrid.z - 1u)));
+    uint cluster = tile.x + clusterGrid.x * (tile.y + clusterGrid.y * slice);
+
+    vec3 n = normalize(normal);
+    vec3 v = normalize(eye - position);
+    vec3 color = ke + ka * clusterAmbient.rgb;
+    uint count = clusterLightCounts[cluster];
+    for (uint i = 0; i < count; ++i) {
+      Light light = lights[clusterLightIndices[cluster * clusterGrid.w + i]];
+      vec3 toLight = light.positionRange.xyz - position;
+      float lightDistance = length(toLight);
+      vec3 l = toLight / lightDistance;
+      float x = lightDistance / light.positionRange.w;
+      float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+      float attenuation = window * window
+                          / (lightDistance * lightDistance + 1.0);
+      if (light.directionCosOuter.w >= -1.0)
+        attenuation *= smoothstep(light.directionCosOuter.w,
+                                  light.cosInner.x,
+                                  dot(-l, light.directionCosOuter.xyz));
+      float diffuse = max(dot(n, l), 0.0);
+      vec3 h = normalize(l + v);
+      vec3 specular = diffuse > 0.0 ? ks * pow(max(dot(n, h), 0.0), ns)
+                                    : vec3(0);
+      color += light.colorIntensity.rgb * light.colorIntensity.w
+               * attenuation * (kd * diffuse + specular);
+    }
+    return color;
+  }
+)"};
+
+Light pointLight(glm::vec3 position, float range, glm::vec3 color,
+                 float intensity) {
+  return {position, range, color, intensity, glm::vec3{0, -1, 0}, -2, -2, {}};
+}
+
+Light spotLight(glm::vec3 position, glm::vec3 direction, float range,
+                float innerAngle, float outerAngle, glm::vec3 color,
+                float intensity) {
+  // smoothstep() is undefined unless its first edge is below the second, so
+  // a hard-edged cone (inner >= outer) still fades over a sliver of cosine.
+  constexpr float minimumFade{1e-4f};
+  auto cosOuter{std::cos(outerAngle)};
+  auto cosInner{std::max(std::cos(innerAngle), cosOuter + minimumFade)};
+  return {position,
+          range,
+          color,
+          intensity,
+          glm::normalize(direction),
+          cosOuter,
+          cosInner,
+          {}};
+}
+
+ClusteredLighting::ClusteredLighting(size_t maxLights)
+    : _maxLights{maxLights}, _bounds(2 * clusterCount) {
+  static_assert(sizeof(Params) == 112,
+                "Params must match the shaders' std140 ClusterParams");
+  _program = createComputeProgram(csSrc);
+  _lightCountLoc = glGetUniformLocation(_program, "lightCount");
+  glCheck(glCreateBuffers(1, &_paramsBuffer));
+  glCheck(glNamedBufferStorage(_paramsBuffer, sizeof(Params), nullptr,
+                               GL_DYNAMIC_STORAGE_BIT));
+  glCheck(glCreateBuffers(1, &_lightsBuffer));
+  glCheck(glNamedBufferStorage(
+      _lightsBuffer, GLsizeiptr(std::max(maxLights, size_t{1}) * sizeof(Light)),
+      nullptr, GL_DYNAMIC_STORAGE_BIT));
+  glCheck(glCreateBuffers(1, &_countsBuffer));
+  glCheck(glNamedBufferStorage(_countsBuffer, clusterCount * sizeof(uint32_t),
+                               nullptr, 0));
+  glCheck(glCreateBuffers(1, &_indicesBuffer));
+  glCheck(glNamedBufferStorage(
+      _indicesBuffer,
+      GLsizeiptr(clusterCount) * maxLightsPerCluster * sizeof(uint32_t),
+      nullptr, 0));
+  glCheck(glCreateBuffers(1, &_boundsBuffer));
+  glCheck(glNamedBufferStorage(_boundsBuffer,
+                               2 * clusterCount * sizeof(glm::vec4), nullptr,
+                               GL_DYNAMIC_STORAGE_BIT));
+}
+
+ClusteredLighting::~ClusteredLighting() {
+  GLuint buffers[]{_paramsBuffer, _lightsBuffer, _countsBuffer,
+                   _indicesBuffer, _boundsBuffer};
+  glDeleteBuffers(GLsizei(std::size(buffers)), buffers);
+  glDeleteProgram(_program);
+}
+
+void ClusteredLighting::setLights(const Light *lights, size_t count) {
+  if (count > _maxLights)
+    throw std::runtime_error{"more lights than the clustered lighting holds"};
+  _lightCount = count;
+  if (count > 0)
+    glCheck(glNamedBufferSubData(_lightsBuffer, 0,
+                                 GLsizeiptr(count * sizeof(Light)), lights));
+}
+
+void ClusteredLighting::buildBounds(const glm::mat4 &projection, float near,
+                                    float far) {
+  auto inverseProjection{glm::inverse(projection)};
+  for (uint32_t z{}; z < gridZ; ++z) {
+    float depths[]{near * std::pow(far / near, float(z) / gridZ),
+                   near * std::pow(far / near, float(z + 1) / gridZ)};
+    for (uint32_t y{}; y < gridY; ++y)
+      for (uint32_t x{}; x < gridX; ++x) {
+        glm::vec3 lo{std::numeric_limits<float>::infinity()}, hi{-lo};
+        for (uint32_t corner{}; corner < 4; ++corner) {
+          glm::vec4 ndc{-1 + 2 * float(x + (corner & 1)) / gridX,
+                        -1 + 2 * float(y + (corner >> 1)) / gridY, -1, 1};
+          auto p{inverseProjection * ndc};
+          auto direction{glm::vec3{p} / -p.z}; // at a depth of 1
+          for (auto depth : depths)
+            lo = glm::min(lo, direction * depth),
+            hi = glm::max(hi, direction * depth);
+        }
+        auto cluster{x + gridX * (y + gridY * z)};
+        _bounds[2 * cluster] = glm::vec4{lo, 0};
+        _bounds[2 * cluster + 1] = glm::vec4{hi, 0};
+      }
+  }
+  glCheck(glNamedBufferSubData(_boundsBuffer, 0,
+                               GLsizeiptr(_bounds.size() * sizeof(glm::vec4)),
+                               _bounds.data()));
+}
+
+void ClusteredLighting::update(const glm::mat4 &view,
+                               const glm::mat4 &projection, float near,
+                               float far, size_t width, size_t height) {
+  if (projection != _boundsProjection || width != _boundsWidth ||
+      height != _boundsHeight) {
+    buildBounds(projection, near, far);
+    _boundsProjection = projection;
+    _boundsWidth = width, _boundsHeight = height;
+  }
+
+  auto logRatio{std::log(far / near)};
+  Params params{view,
+                {gridX, gridY, gridZ, maxLightsPerCluster},
+                {float(width) / gridX, float(height) / gridY,
+                 gridZ / logRatio, -float(gridZ) * std::log(near) / logRatio},
+                glm::vec4{_ambient, 0}};
+  glCheck(glNamedBufferSubData(_paramsBuffer, 0, sizeof(params), &params));
+
+  glCheck(glUseProgram(_program));
+  glCheck(glUniform1ui(_lightCountLoc, GLuint(_lightCount)));
+  bind();
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, boundsBinding,
+                           _boundsBuffer));
+  glCheck(glDispatchCompute(clusterCount / workGroupSize, 1, 1));
+  glCheck(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+}
+
+void ClusteredLighting::bind() const {
+  glCheck(glBindBufferBase(GL_UNIFORM_BUFFER, paramsBinding, _paramsBuffer));
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, lightsBinding,
+                           _lightsBuffer));
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, countsBinding,
+                           _countsBuffer));
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indicesBinding,
+                           _indicesBuffer));
+}
+
+std::vector<uint32_t> ClusteredLighting::clusterLightCounts() const {
+  std::vector<uint32_t> counts(clusterCount);
+  glCheck(glGetNamedBufferSubData(_countsBuffer, 0,
+                                  GLsizeiptr(counts.size() * sizeof(uint32_t)),
+                                  counts.data()));
+  return counts;
+}
+
+namespace {
+void addBox(Mesh &mesh, glm::vec3 lo, glm::vec3 hi) {
+  for (int axis{}; axis < 3; ++axis)
+    for (int side{}; side < 2; ++side) {
+      glm::vec3 normal{0};
+      normal[axis] = side ? 1.0f : -1.0f;
+      auto u{(axis + 1) % 3}, v{(axis + 2) % 3};
+      auto first{uint32_t(mesh.vertices.size())};
+      for (int corner{}; corner < 4; ++corner) {
+        auto p{side ? hi : lo};
+        p[u] = (corner == 1 || corner == 2) ? hi[u] : lo[u];
+        p[v] = corner >= 2 ? hi[v] : lo[v];
+        mesh.vertices.push_back({p, normal, {}});
+      }
+      for (uint32_t index : {0u, 1u, 2u, 0u, 2u, 3u})
+        mesh.indices.push_back(first + index);
+    }
+}
+} // namespace
+
+void benchmarkClusteredLighting() {
+  constexpr size_t width{1280}, height{720};
+  constexpr float fieldSize{100}, near{0.1f}, far{200};
+  Window window{width, height, "Clustered lighting benchmark"};
+
+  GLuint framebuffer, renderbuffers[2];
+  glCheck(glCreateRenderbuffers(2, renderbuffers));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width,
+                                     height));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24,
+                                     width, height));
+  glCheck(glCreateFramebuffers(1, &framebuffer));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0,
+                                         GL_RENDERBUFFER, renderbuffers[0]));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT,
+                                         GL_RENDERBUFFER, renderbuffers[1]));
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+  glCheck(glViewport(0, 0, width, height));
+  glCheck(glEnable(GL_DEPTH_TEST));
+
+  // A floor covered with boxes of varying height, and then the same floor
+  // with rows of walls across it, drawn back to front so that most of their
+  // fragments are shaded and then overwritten.
+  Mesh field;
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> unit{0, 1};
+  addBox(field, {-fieldSize / 2, -1, -fieldSize / 2},
+         {fieldSize / 2, 0, fieldSize / 2});
+  for (float x{-fieldSize / 2 + 2}; x < fieldSize / 2; x += 5)
+    for (float z{-fieldSize / 2 + 2}; z < fieldSize / 2; z += 5)
+      addBox(field, {x, 0, z}, {x + 1.5f, 1 + 3 * unit(random), z + 1.5f});
+  auto boxIndexCount{GLsizei(field.indices.size())};
+  for (float z{-fieldSize / 2}; z < fieldSize / 2; z += 2)
+    addBox(field, {-fieldSize / 2, 0, z},
+           {fieldSize / 2, 2 + 8 * unit(random), z + 0.2f});
+  struct Scene {
+    const char *name;
+    GLsizei indexCount;
+  };
+  const Scene scenes[]{{"boxes", boxIndexCount},
+                       {"walls", GLsizei(field.indices.size())}};
+
+  GLuint buffers[2], vao;
+  glCheck(glCreateBuffers(2, buffers));
+  glCheck(glNamedBufferStorage(
+      buffers[0], GLsizeiptr(field.vertices.size() * sizeof(Vertex)),
+      field.vertices.data(), 0));
+  glCheck(glNamedBufferStorage(
+      buffers[1], GLsizeiptr(field.indices.size() * sizeof(uint32_t)),
+      field.indices.data(), 0));
+  glCheck(glCreateVertexArrays(1, &vao));
+  glCheck(glVertexArrayVertexBuffer(vao, 0, buffers[0], 0, sizeof(Vertex)));
+  glCheck(glVertexArrayElementBuffer(vao, buffers[1]));
+  glCheck(glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE,
+                                    offsetof(Vertex, position)));
+  glCheck(glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE,
+                                    offsetof(Vertex, normal)));
+  for (GLuint attribute{}; attribute < 2; ++attribute) {
+    glCheck(glVertexArrayAttribBinding(vao, attribute, 0));
+    glCheck(glEnableVertexArrayAttrib(vao, attribute));
+  }
+
+  constexpr auto vsSrc{R"(
+    #version 450
+
+    layout (location = 0) in vec3 position;
+    layout (location = 1) in vec3 normal;
+
+    uniform mat4 viewProjection;
+
+    out vec3 worldPosition;
+    out vec3 worldNormal;
+
+    void main(void) {
+      gl_Position = viewProjection * vec4(position, 1);
+      worldPosition = position;
+      worldNormal = normal;
+    }
+  )"};
+  auto forwardFsSrc{std::string{"#version 450\n"} + clusteredShadingSource +
+                    R"(
+    in vec3 worldPosition;
+    in vec3 worldNormal;
+
+    uniform vec3 eye;
+
+    out vec4 fragmentColor;
+
+    void main(void) {
+      fragmentColor = vec4(shadeBlinnPhong(worldPosition, worldNormal, eye,
+                                           vec3(0.7), vec3(0.7), vec3(0.5),
+                                           64, vec3(0)), 1);
+    }
+  )"};
+  auto gBufferFsSrc{std::string{"#version 450\n"} + gBufferSource + R"(
+    in vec3 worldNormal;
+
+    void main(void) {
+      writeGBuffer(worldNormal, vec3(0.7), vec3(0.5), 64);
+    }
+  )"};
+  GLuint programs[]{createProgram(vsSrc, forwardFsSrc.c_str()),
+                    createProgram(vsSrc, gBufferFsSrc.c_str())};
+  glm::vec3 eye{0, 20, 60};
+  auto view{glm::lookAt(eye, glm::vec3{0}, glm::vec3{0, 1, 0})};
+  auto projection{glm::perspective(glm::radians(60.0f),
+                                   float(width) / height, near, far)};
+  auto viewProjection{projection * view};
+  for (auto program : programs)
+    glCheck(glProgramUniformMatrix4fv(
+        program, glGetUniformLocation(program, "viewProjection"), 1,
+        GL_FALSE, glm::value_ptr(viewProjection)));
+  glCheck(glProgramUniform3fv(
+      programs[0], glGetUniformLocation(programs[0], "eye"), 1,
+      glm::value_ptr(eye)));
+
+  // Assignment, forward shading, G-buffer, deferred lighting.
+  GLuint queries[4];
+  glCheck(glCreateQueries(GL_TIME_ELAPSED, 4, queries));
+  constexpr size_t maxLights{10000}, warmupFrames{5}, frames{20};
+  ClusteredLighting lighting{maxLights};
+  DeferredShading deferred{width, height};
+  std::vector<Light> lights;
+  for (const auto &scene : scenes) {
+    std::printf("%s:\n", scene.name);
+    for (size_t count{10}; count <= maxLights; count *= 10) {
+      // Same range whatever the count, so that more lights mean more of
+      // them per pixel, as in a real scene filling up with lights.
+      constexpr float range{5};
+      lights.clear();
+      for (size_t i{}; i < count; ++i) {
+        glm::vec3 position{fieldSize * (unit(random) - 0.5f),
+                           0.3f + 3 * unit(random),
+                           fieldSize * (unit(random) - 0.5f)};
+        glm::vec3 color{unit(random), unit(random), unit(random)};
+        lights.push_back(
+            i % 4 == 3 ? spotLight(position, {0, -1, 0}, range * 2,
+                                   glm::radians(30.0f), glm::radians(45.0f),
+                                   color, 20)
+                       : pointLight(position, range, color, 20));
+      }
+      lighting.setLights(lights.data(), lights.size());
+
+      // Both paths run every frame, over the same light assignment.
+      double ms[4]{};
+      for (size_t frame{}; frame < warmupFrames + frames; ++frame) {
+        glCheck(glBeginQuery(GL_TIME_ELAPSED, queries[0]));
+        lighting.update(view, projection, near, far, width, height);
+        glCheck(glEndQuery(GL_TIME_ELAPSED));
+
+        glCheck(glBeginQuery(GL_TIME_ELAPSED, queries[1]));
+        glCheck(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+        glCheck(glUseProgram(programs[0]));
+        lighting.bind();
+        glCheck(glBindVertexArray(vao));
+        glCheck(glDrawElements(GL_TRIANGLES, scene.indexCount,
+                               GL_UNSIGNED_INT, nullptr));
+        glCheck(glEndQuery(GL_TIME_ELAPSED));
+
+        glCheck(glBeginQuery(GL_TIME_ELAPSED, queries[2]));
+        deferred.beginGeometry();
+        glCheck(glUseProgram(programs[1]));
+        glCheck(glBindVertexArray(vao));
+        glCheck(glDrawElements(GL_TRIANGLES, scene.indexCount,
+                               GL_UNSIGNED_INT, nullptr));
+        glCheck(glEndQuery(GL_TIME_ELAPSED));
+        glCheck(glBeginQuery(GL_TIME_ELAPSED, queries[3]));
+        deferred.light(lighting, projection);
+        glCheck(glEndQuery(GL_TIME_ELAPSED));
+
+        for (int i{}; i < 4; ++i) {
+          GLuint64 ns;
+          glCheck(glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns));
+          if (frame >= warmupFrames)
+            ms[i] += double(ns) * 1e-6 / frames;
+        }
+      }
+
+      auto counts{lighting.clusterLightCounts()};
+      size_t litClusters{}, total{};
+      uint32_t most{};
+      for (auto clusterCount : counts) {
+        litClusters += clusterCount > 0;
+        total += clusterCount;
+        most = std::max(most, clusterCount);
+      }
+      std::printf("%5zu lights: assign %6.3f ms, %s %6.3f ms, %s %6.3f ms "
+                  "(G-buffer %6.3f, lighting %6.3f), %5.1f lights per lit "
+                  "cluster (at most %u)\n",
+                  count, ms[0], shadingPathName(ShadingPath::Forward), ms[1],
+                  shadingPathName(ShadingPath::Deferred), ms[2] + ms[3], ms[2],
+                  ms[3],
+                  litClusters ? double(total) / double(litClusters) : 0.0,
+                  most);
+    }
+  }
+
+  glDeleteQueries(4, queries);
+  for (auto program : programs)
+    glDeleteProgram(program);
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(2, buffers);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(2, renderbuffers);
+}
@@ -0,0 +1,229 @@
+#include "culling.hpp"
+#include "meshlet.hpp"
+#include "simd_transform.hpp"
+
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+// Objects per job; a multiple of the 8 lanes.
+constexpr size_t cullChunk{16384};
+
+// For every 8-bit visibility mask, the lanes that are set, packed to the
+// front: what AVX-512's vpcompressd would do in one instruction.
+constexpr std::array<uint64_t, 256> compressTable{[] {
+  std::array<uint64_t, 256> table{};
+  for (size_t mask{}; mask < 256; ++mask) {
+    size_t count{};
+    for (uint64_t lane{}; lane < 8; ++lane)
+      if (mask >> lane & 1)
+        table[mask] |= lane << (8 * count++);
+  }
+  return table;
+}()};
+
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+bool visibleScalar(const CullingBounds &bounds, const Frustum &frustum,
+                   CullShape shape, size_t i) {
+  for (auto &plane : frustum.planes) {
+    glm::vec3 n{plane};
+    if (shape == CullShape::Sphere) {
+      glm::vec3 center{bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]};
+      if (glm::dot(n, center) + plane.w < -bounds.radius[i])
+        return false;
+    } else {
+      // The corner furthest along the normal.
+      glm::vec3 corner{n.x >= 0 ? bounds.maxX[i] : bounds.minX[i],
+                       n.y >= 0 ? bounds.maxY[i] : bounds.minY[i],
+                       n.z >= 0 ? bounds.maxZ[i] : bounds.minZ[i]};
+      if (glm::dot(n, corner) + plane.w < 0)
+        return false;
+    }
+  }
+  return true;
+}
+
+size_t cullRangeScalar(const CullingBounds &bounds, const Frustum &frustum,
+                       CullShape shape, size_t first, size_t last,
+                       uint32_t *out) {
+  size_t count{};
+  for (auto i{first}; i < last; ++i)
+    if (visibleScalar(bounds, frustum, shape, i))
+      out[count++] = uint32_t(i);
+  return count;
+}
+
+#ifdef SIMD_X86
+// Writes 8 indices at out whatever the mask, so out needs that much slack.
+SIMD_TARGET("avx2,fma,popcnt")
+size_t cullRangeAvx2(const CullingBounds &bounds, const Frustum &frustum,
+                     CullShape shape, size_t first, size_t last,
+                     uint32_t *out) {
+  __m256 nx[6], ny[6], nz[6], nw[6];
+  const float *cornerX[6], *cornerY[6], *cornerZ[6];
+  for (size_t p{}; p < 6; ++p) {
+    auto &plane{frustum.planes[p]};
+    nx[p] = _mm256_set1_ps(plane.x);
+    ny[p] = _mm256_set1_ps(plane.y);
+    nz[p] = _mm256_set1_ps(plane.z);
+    nw[p] = _mm256_set1_ps(plane.w);
+    cornerX[p] = plane.x >= 0 ? bounds.maxX.data() : bounds.minX.data();
+    cornerY[p] = plane.y >= 0 ? bounds.maxY.data() : bounds.minY.data();
+    cornerZ[p] = plane.z >= 0 ? bounds.maxZ.data() : bounds.minZ.data();
+  }
+
+  size_t count{};
+  auto i{first};
+  for (; i + 8 <= last; i += 8) {
+    auto inside{_mm256_castsi256_ps(_mm256_set1_epi32(-1))};
+    if (shape == CullShape::Sphere) {
+      auto x{_mm256_loadu_ps(&bounds.centerX[i])};
+      auto y{_mm256_loadu_ps(&bounds.centerY[i])};
+      auto z{_mm256_loadu_ps(&bounds.centerZ[i])};
+      auto negativeRadius{_mm256_sub_ps(_mm256_setzero_ps(),
+                                        _mm256_loadu_ps(&bounds.radius[i]))};
+      for (size_t p{}; p < 6; ++p) {
+        auto distance{_mm256_fmadd_ps(
+            nx[p], x,
+            _mm256_fmadd_ps(ny[p], y, _mm256_fmadd_ps(nz[p], z, nw[p])))};
+        inside = _mm256_and_ps(
+            inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+      }
+    } else {
+      for (size_t p{}; p < 6; ++p) {
+        auto distance{_mm256_fmadd_ps(
+            nx[p], _mm256_loadu_ps(cornerX[p] + i),
+            _mm256_fmadd_ps(ny[p], _mm256_loadu_ps(cornerY[p] + i),
+                            _mm256_fmadd_ps(nz[p],
+                                            _mm256_loadu_ps(cornerZ[p] + i),
+                                            nw[p])))};
+        inside = _mm256_and_ps(
+            inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+      }
+    }
+    auto mask{unsigned(_mm256_movemask_ps(inside))};
+    auto lanes{_mm256_cvtepu8_epi32(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i *>(&compressTable[mask])))};
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(out + count),
+        _mm256_add_epi32(_mm256_set1_epi32(int(i)), lanes));
+    count += size_t(std::popcount(mask));
+  }
+  return count + cullRangeScalar(bounds, frustum, shape, i, last, out + count);
+}
+#endif
+
+size_t cullRange(const CullingBounds &bounds, const Frustum &frustum,
+                 CullShape shape, size_t first, size_t last, uint32_t *out) {
+#ifdef SIMD_X86
+  if (simdLevel() == SimdLevel::Avx2)
+    return cullRangeAvx2(bounds, frustum, shape, first, last, out);
+#endif
+  return cullRangeScalar(bounds, frustum, shape, first, last, out);
+}
+} // namespace
+
+void CullingBounds::resize(size_t count) {
+  for (auto array : {&centerX, &centerY, &centerZ, &radius, &minX, &minY,
+                     &minZ, &maxX, &maxY, &maxZ})
+    array->resize(count);
+}
+
+void CullingBounds::set(size_t index, glm::vec3 boundsMin,
+                        glm::vec3 boundsMax) {
+  auto center{(boundsMin + boundsMax) * 0.5f};
+  centerX[index] = center.x;
+  centerY[index] = center.y;
+  centerZ[index] = center.z;
+  radius[index] = glm::distance(center, boundsMax);
+  minX[index] = boundsMin.x, minY[index] = boundsMin.y;
+  minZ[index] = boundsMin.z;
+  maxX[index] = boundsMax.x, maxY[index] = boundsMax.y;
+  maxZ[index] = boundsMax.z;
+}
+
+size_t frustumCull(const CullingBounds &bounds,
+                   const glm::mat4 &viewProjection, CullShape shape,
+                   std::vector<uint32_t> &visible, JobSystem *jobs) {
+  // visible is never shrunk so that refilling it every frame doesn't pay for
+  // zeroing it again.
+  if (visible.size() < bounds.size() + 8)
+    visible.resize(bounds.size() + 8);
+  return frustumCull(bounds, viewProjection, shape, visible.data(), jobs);
+}
+
+size_t frustumCull(const CullingBounds &bounds,
+                   const glm::mat4 &viewProjection, CullShape shape,
+                   uint32_t *visible, JobSystem *jobs) {
+  Frustum frustum;
+  extractFrustumPlanes(viewProjection, frustum.planes);
+  auto count{bounds.size()};
+  // Every chunk writes its indices from its own first object on, which can
+  // never run into the next chunk's; the gaps are closed afterwards.
+  auto chunkCount{(count + cullChunk - 1) / cullChunk};
+  // Grown, never shrunk, for the same reason. Jobs on other threads must see
+  // this thread's copy, hence the reference.
+  thread_local std::vector<size_t> chunkVisibleStorage;
+  auto &chunkVisible{chunkVisibleStorage};
+  if (chunkVisible.size() < chunkCount)
+    chunkVisible.resize(chunkCount);
+  auto cullChunks{[&](size_t firstChunk, size_t lastChunk) {
+    for (auto chunk{firstChunk}; chunk < lastChunk; ++chunk) {
+      auto first{chunk * cullChunk};
+      chunkVisible[chunk] =
+          cullRange(bounds, frustum, shape, first,
+                    std::min(first + cullChunk, count), &visible[first]);
+    }
+  }};
+  if (jobs && chunkCount > 1)
+    jobs->parallelFor(0, chunkCount, 1, cullChunks);
+  else
+    cullChunks(0, chunkCount);
+
+  size_t total{chunkCount ? chunkVisible[0] : 0};
+  for (size_t chunk{1}; chunk < chunkCount; ++chunk) {
+    auto first{visible + chunk * cullChunk};
+    std::copy(first, first + chunkVisible[chunk], visible + total);
+    total += chunkVisible[chunk];
+  }
+  return total;
+}
+
+void benchmarkFrustumCulling(size_t count, JobSystem *jobs) {
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> position{-500, 500}, size{0.5f, 4};
+  CullingBounds bounds;
+  bounds.resize(count);
+  for (size_t i{}; i < count; ++i) {
+    glm::vec3 center{position(random), position(random), position(random)};
+    glm::vec3 extent{size(random), size(random), size(random)};
+    bounds.set(i, center - extent, center + extent);
+  }
+  auto viewProjection{
+      glm::perspective(glm::radians(60.0f), 16.0f / 9, 0.1f, 400.0f) *
+      glm::lookAt(glm::vec3{0}, glm::vec3{1, 0, 0}, glm::vec3{0, 1, 0})};
+
+  std::vector<uint32_t> visible;
+  for (auto shape : {CullShape::Sphere, CullShape::Box}) {
+    constexpr int runs{20};
+    auto visibleCount{frustumCull(bounds, viewProjection, shape, visible, jobs)};
+    auto start{std::chrono::steady_clock::now()};
+    for (int run{}; run < runs; ++run)
+      frustumCull(bounds, viewProjection, shape, visible, jobs);
+    std::chrono::duration<double, std::milli> elapsed{
+        std::chrono::steady_clock::now() - start};
+    std::printf("%zu objects, %s: %.3f ms, %zu visible (%s, %zu threads)\n",
+                count, shape == CullShape::Sphere ? "spheres" : "boxes",
+                elapsed.count() / runs, visibleCount,
+                simdLevelName(simdLevel()), jobs ? jobs->threadCount() : 1);
+  }
+}
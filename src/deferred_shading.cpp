@@ -0,0 +1,306 @@
+#include "deferred_shading.hpp"
+#include "gl_util.hpp"
+#include "shader.hpp"
+
+#include "glm/gtc/type_ptr.hpp"
+#include "glm/matrix.hpp"
+
+#include <stdexcept>
+
+namespace {
+// One work group per tile, one invocation per pixel.
+constexpr auto csSrc{R"(
+  #version 450
+
+  layout (local_size_x = 16, local_size_y = 16) in;
+
+  struct Light {
+    vec4 positionRange;
+    vec4 colorIntensity;
+    vec4 directionCosOuter;
+    vec4 cosInner;
+  };
+
+  layout (std140, binding = 2) uniform ClusterParams {
+    mat4 clusterView;
+    uvec4 clusterGrid;
+    vec4 clusterSlicing;
+    vec4 clusterAmbient;
+  };
+  layout (std430, binding = 4) readonly buffer Lights { Light lights[]; };
+
+  layout (binding = 0) uniform sampler2D depthTexture;
+  layout (binding = 1) uniform sampler2D albedoRoughnessTexture;
+  layout (binding = 2) uniform sampler2D normalSpecularTexture;
+  layout (rgba8, binding = 0) writeonly uniform image2D litImage;
+
+  uniform mat4 inverseProjection;
+  uniform uint lightCount;
+  uniform vec3 clearColor;
+
+  const uint maxLights = 256;
+  shared uint tileMinDepth, tileMaxDepth, tileLightCount;
+  shared uint tileLights[maxLights];
+  shared vec3 tileLightCenters[maxLights]; // in view space
+
+  vec3 viewPosition(vec2 pixel, float depth, vec2 size) {
+    vec4 p = inverseProjection
+             * vec4(pixel / size * 2.0 - 1.0, depth * 2.0 - 1.0, 1);
+    return p.xyz / p.w;
+  }
+
+  vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0)));
+    return normalize(n);
+  }
+
+  void main(void) {
+    vec2 size = vec2(textureSize(depthTexture, 0));
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    bool inside = all(lessThan(vec2(pixel), size));
+    float depth = inside ? texelFetch(depthTexture, pixel, 0).r : 1.0;
+    bool covered = inside && depth < 1.0;
+    vec3 position = viewPosition(vec2(pixel) + 0.5, depth, size);
+
+    if (gl_LocalInvocationIndex == 0) {
+      tileMinDepth = floatBitsToUint(3.4e38);
+      tileMaxDepth = 0u;
+      tileLightCount = 0u;
+    }
+    barrier();
+    // Positive floats sort like their bits.
+    if (covered) {
+      atomicMin(tileMinDepth, floatBitsToUint(-position.z));
+      atomicMax(tileMaxDepth, floatBitsToUint(-position.z));
+    }
+    barrier();
+    float minDepth = uintBitsToFloat(tileMinDepth);
+    float maxDepth = uintBitsToFloat(tileMaxDepth);
+
+    // The tile's side planes, through the eye and facing inwards.
+    vec2 lo = vec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy);
+    vec2 hi = lo + vec2(gl_WorkGroupSize.xy);
+    vec3 corners[4] = vec3[](viewPosition(lo, 1.0, size),
+                             viewPosition(vec2(hi.x, lo.y), 1.0, size),
+                             viewPosition(hi, 1.0, size),
+                             viewPosition(vec2(lo.x, hi.y), 1.0, size));
+    vec3 inwards = corners[0] + corners[2];
+    vec3 planes[4];
+    for (int i = 0; i < 4; ++i) {
+      vec3 n = normalize(cross(corners[i], corners[(i + 1) % 4]));
+      planes[i] = dot(n, inwards) < 0.0 ? -n : n;
+    }
+
+    uint groupSize = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+    for (uint i = gl_LocalInvocationIndex; tileMaxDepth != 0u && i < lightCount;
+         i += groupSize) {
+      vec4 light = lights[i].positionRange;
+      vec3 center = (clusterView * vec4(light.xyz, 1)).xyz;
+      float range = light.w;
+      bool touches = -center.z + range >= minDepth
+                     && -center.z - range <= maxDepth;
+      for (int k = 0; k < 4; ++k)
+        touches = touches && dot(planes[k], center) >= -range;
+      if (touches) {
+        uint slot = atomicAdd(tileLightCount, 1u);
+        if (slot < maxLights) {
+          tileLights[slot] = i;
+          tileLightCenters[slot] = center;
+        }
+      }
+    }
+    barrier();
+
+    if (!inside)
+      return;
+    if (!covered) {
+      imageStore(litImage, pixel, vec4(clearColor, 1));
+      return;
+    }
+    vec4 albedoRoughness = texelFetch(albedoRoughnessTexture, pixel, 0);
+    vec4 normalSpecular = texelFetch(normalSpecularTexture, pixel, 0);
+    vec3 kd = albedoRoughness.rgb;
+    float roughness = max(albedoRoughness.a, 0.01);
+    float ns = 2.0 / (roughness * roughness) - 2.0;
+    vec3 ks = vec3(normalSpecular.b);
+    vec3 n = normalize(mat3(clusterView)
+                       * decodeOctahedral(normalSpecular.xy * 2.0 - 1.0));
+    vec3 v = normalize(-position);
+
+    vec3 color = kd * clusterAmbient.rgb;
+    uint count = min(tileLightCount, maxLights);
+    for (uint i = 0; i < count; ++i) {
+      Light light = lights[tileLights[i]];
+      vec3 toLight = tileLightCenters[i] - position;
+      float lightDistance = length(toLight);
+      vec3 l = toLight / lightDistance;
+      float x = lightDistance / light.positionRange.w;
+      float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+      float attenuation = window * window
+                          / (lightDistance * lightDistance + 1.0);
+      if (light.directionCosOuter.w >= -1.0)
+        attenuation *= smoothstep(
+            light.directionCosOuter.w, light.cosInner.x,
+            dot(-l, mat3(clusterView) * light.directionCosOuter.xyz));
+      float diffuse = max(dot(n, l), 0.0);
+      vec3 h = normalize(l + v);
+      vec3 specular = diffuse > 0.0 ? ks * pow(max(dot(n, h), 0.0), ns)
+                                    : vec3(0);
+      color += light.colorIntensity.rgb * light.colorIntensity.w
+               * attenuation * (kd * diffuse + specular);
+    }
+    imageStore(litImage, pixel, vec4(color, 1));
+  }
+)"};
+
+// A triangle covering the screen, copying the lit image.
+constexpr auto presentVsSrc{R"(
+  #version 450
+
+  void main(void) {
+    vec2 p = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;
+    gl_Position = vec4(p, 0, 1);
+  }
+)"};
+
+constexpr auto presentFsSrc{R"(
+  #version 450
+
+  layout (binding = 0) uniform sampler2D litTexture;
+
+  out vec4 fragmentColor;
+
+  void main(void) {
+    fragmentColor = texelFetch(litTexture, ivec2(gl_FragCoord.xy), 0);
+  }
+)"};
+} // namespace
+
+const char *const gBufferSource{R"(
+  layout (location = 0) out vec4 gBufferAlbedoRoughness;
+  layout (location = 1) out vec4 gBufferNormalSpecular;
+
+  vec2 encodeOctahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0)
+      e = (1.0 - abs(n.yx))
+          * mix(vec2(-1), vec2(1), greaterThanEqual(e, vec2(0)));
+    return e;
+  }
+
+  void writeGBuffer(vec3 normal, vec3 kd, vec3 ks, float ns) {
+    gBufferAlbedoRoughness = vec4(kd, sqrt(2.0 / (ns + 2.0)));
+    gBufferNormalSpecular = vec4(
+        encodeOctahedral(normalize(normal)) * 0.5 + 0.5,
+        dot(ks, vec3(0.2126, 0.7152, 0.0722)), 0);
+  }
+)"};
+
+const char *shadingPathName(ShadingPath path) {
+  return path == ShadingPath::Forward ? "forward" : "deferred";
+}
+
+DeferredShading::DeferredShading(size_t width, size_t height)
+    : _width{width}, _height{height} {
+  _lightingProgram = createComputeProgram(csSrc);
+  _inverseProjectionLoc =
+      glGetUniformLocation(_lightingProgram, "inverseProjection");
+  _lightCountLoc = glGetUniformLocation(_lightingProgram, "lightCount");
+  _clearColorLoc = glGetUniformLocation(_lightingProgram, "clearColor");
+  _presentProgram = createProgram(presentVsSrc, presentFsSrc);
+  glCheck(glCreateVertexArrays(1, &_emptyVertexArray));
+  createTargets();
+}
+
+DeferredShading::~DeferredShading() {
+  deleteTargets();
+  glDeleteVertexArrays(1, &_emptyVertexArray);
+  glDeleteProgram(_presentProgram);
+  glDeleteProgram(_lightingProgram);
+}
+
+void DeferredShading::createTargets() {
+  constexpr GLenum formats[]{GL_DEPTH_COMPONENT32F, GL_RGBA8, GL_RGB10_A2,
+                             GL_RGBA8};
+  glCheck(glCreateTextures(GL_TEXTURE_2D, 4, _textures));
+  for (int i{}; i < 4; ++i) {
+    glCheck(glTextureStorage2D(_textures[i], 1, formats[i], GLsizei(_width),
+                               GLsizei(_height)));
+    glCheck(glTextureParameteri(_textures[i], GL_TEXTURE_MIN_FILTER,
+                                GL_NEAREST));
+    glCheck(glTextureParameteri(_textures[i], GL_TEXTURE_MAG_FILTER,
+                                GL_NEAREST));
+  }
+  glCheck(glCreateFramebuffers(1, &_framebuffer));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_DEPTH_ATTACHMENT,
+                                    _textures[0], 0));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_COLOR_ATTACHMENT0,
+                                    _textures[1], 0));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_COLOR_ATTACHMENT1,
+                                    _textures[2], 0));
+  constexpr GLenum drawBuffers[]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glCheck(glNamedFramebufferDrawBuffers(_framebuffer, 2, drawBuffers));
+  if (glCheckNamedFramebufferStatus(_framebuffer, GL_FRAMEBUFFER) !=
+      GL_FRAMEBUFFER_COMPLETE)
+    throw std::runtime_error{"G-buffer framebuffer is incomplete"};
+}
+
+void DeferredShading::deleteTargets() {
+  glDeleteFramebuffers(1, &_framebuffer);
+  glDeleteTextures(4, _textures);
+}
+
+void DeferredShading::resize(size_t width, size_t height) {
+  if (width == _width && height == _height)
+    return;
+  deleteTargets();
+  _width = width, _height = height;
+  createTargets();
+}
+
+void DeferredShading::beginGeometry() {
+  glCheck(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &_previousFramebuffer));
+  glCheck(glGetIntegerv(GL_VIEWPORT, _previousViewport));
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+  glCheck(glViewport(0, 0, GLsizei(_width), GLsizei(_height)));
+  glCheck(glEnable(GL_DEPTH_TEST));
+  glCheck(glDepthMask(GL_TRUE));
+  constexpr float zero[4]{}, farthest{1};
+  glCheck(glClearNamedFramebufferfv(_framebuffer, GL_COLOR, 0, zero));
+  glCheck(glClearNamedFramebufferfv(_framebuffer, GL_COLOR, 1, zero));
+  glCheck(glClearNamedFramebufferfv(_framebuffer, GL_DEPTH, 0, &farthest));
+}
+
+void DeferredShading::light(const ClusteredLighting &lighting,
+                            const glm::mat4 &projection,
+                            glm::vec3 clearColor) {
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, GLuint(_previousFramebuffer)));
+  glCheck(glViewport(_previousViewport[0], _previousViewport[1],
+                     _previousViewport[2], _previousViewport[3]));
+
+  glCheck(glUseProgram(_lightingProgram));
+  glCheck(glUniformMatrix4fv(_inverseProjectionLoc, 1, GL_FALSE,
+                             glm::value_ptr(glm::inverse(projection))));
+  glCheck(glUniform1ui(_lightCountLoc, GLuint(lighting.lightCount())));
+  glCheck(glUniform3fv(_clearColorLoc, 1, glm::value_ptr(clearColor)));
+  lighting.bind();
+  for (GLuint unit{}; unit < 3; ++unit)
+    glCheck(glBindTextureUnit(unit, _textures[unit]));
+  glCheck(glBindImageTexture(0, _textures[3], 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                             GL_RGBA8));
+  glCheck(glDispatchCompute(GLuint((_width + tileSize - 1) / tileSize),
+                            GLuint((_height + tileSize - 1) / tileSize), 1));
+  glCheck(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT));
+
+  auto depthTest{glIsEnabled(GL_DEPTH_TEST)};
+  glCheck(glDisable(GL_DEPTH_TEST));
+  glCheck(glUseProgram(_presentProgram));
+  glCheck(glBindTextureUnit(0, _textures[3]));
+  glCheck(glBindVertexArray(_emptyVertexArray));
+  glCheck(glDrawArrays(GL_TRIANGLES, 0, 3));
+  if (depthTest)
+    glCheck(glEnable(GL_DEPTH_TEST));
+}
@@ -0,0 +1,286 @@
+#include "dynamic_resolution.hpp"
+#include "gl_util.hpp"
+#include "shader.hpp"
+#include "window.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// A triangle covering the screen, sampling the scene's corner of the target
+// and never past its last texel.
+constexpr auto vsSrc{R"(
+  #version 460
+
+  out vec2 uv;
+
+  void main(void) {
+    vec2 p = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;
+    gl_Position = vec4(p, 0, 1);
+    uv = p * 0.5 + 0.5;
+  }
+)"};
+
+constexpr auto fsSrc{R"(
+  #version 460
+
+  layout (binding = 0) uniform sampler2D sceneTexture;
+
+  uniform vec2 uvScale;
+  uniform vec2 uvMax;
+
+  in vec2 uv;
+
+  out vec4 fragmentColor;
+
+  void main(void) {
+    fragmentColor = texture(sceneTexture, min(uv * uvScale, uvMax));
+  }
+)"};
+} // namespace
+
+DynamicResolution::DynamicResolution(size_t width, size_t height,
+                                     double budgetMs, float minScale,
+                                     float maxScale)
+    : _width{width}, _height{height}, _renderWidth{width},
+      _renderHeight{height}, _budgetMs{budgetMs}, _minScale{minScale},
+      _maxScale{maxScale}, _scale{maxScale} {
+  if (minScale <= 0 || minScale > maxScale || maxScale > 1)
+    throw std::runtime_error{"resolution scales must be in (0, 1]"};
+  _program = createProgram(vsSrc, fsSrc);
+  _uvScaleLoc = glGetUniformLocation(_program, "uvScale");
+  _uvMaxLoc = glGetUniformLocation(_program, "uvMax");
+  glCheck(glCreateVertexArrays(1, &_emptyVertexArray));
+  glCheck(glCreateQueries(GL_TIMESTAMP, 6, &_queries[0][0]));
+  createTarget();
+}
+
+DynamicResolution::~DynamicResolution() {
+  deleteTarget();
+  glDeleteQueries(6, &_queries[0][0]);
+  glDeleteVertexArrays(1, &_emptyVertexArray);
+  glDeleteProgram(_program);
+}
+
+void DynamicResolution::createTarget() {
+  glCheck(glCreateTextures(GL_TEXTURE_2D, 2, _textures));
+  glCheck(glTextureStorage2D(_textures[0], 1, GL_RGBA8, GLsizei(_width),
+                             GLsizei(_height)));
+  glCheck(glTextureStorage2D(_textures[1], 1, GL_DEPTH_COMPONENT24,
+                             GLsizei(_width), GLsizei(_height)));
+  glCheck(glTextureParameteri(_textures[0], GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+  glCheck(glTextureParameteri(_textures[0], GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  glCheck(glTextureParameteri(_textures[0], GL_TEXTURE_WRAP_S,
+                              GL_CLAMP_TO_EDGE));
+  glCheck(glTextureParameteri(_textures[0], GL_TEXTURE_WRAP_T,
+                              GL_CLAMP_TO_EDGE));
+  glCheck(glCreateFramebuffers(1, &_framebuffer));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_COLOR_ATTACHMENT0,
+                                    _textures[0], 0));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_DEPTH_ATTACHMENT,
+                                    _textures[1], 0));
+  if (glCheckNamedFramebufferStatus(_framebuffer, GL_FRAMEBUFFER) !=
+      GL_FRAMEBUFFER_COMPLETE)
+    throw std::runtime_error{"dynamic resolution framebuffer is incomplete"};
+}
+
+void DynamicResolution::deleteTarget() {
+  glDeleteFramebuffers(1, &_framebuffer);
+  glDeleteTextures(2, _textures);
+}
+
+void DynamicResolution::resize(size_t width, size_t height) {
+  if ((width == _width && height == _height) || !width || !height)
+    return;
+  deleteTarget();
+  _width = width, _height = height;
+  createTarget();
+}
+
+void DynamicResolution::setFixedScale(float scale) {
+  _fixed = true;
+  _scale = std::clamp(scale, 0.01f, 1.0f);
+}
+
+void DynamicResolution::adjust(double gpuMs) {
+  if (gpuMs <= 0)
+    return;
+  auto ratio{gpuMs / (_budgetMs * sceneShare)};
+  // Cost goes with the pixel count, the square of the scale.
+  auto target{std::clamp(_scale / float(std::sqrt(ratio)), _minScale,
+                         _maxScale)};
+  // Timings are a couple of frames old, so even over budget only half the
+  // way is taken at once, lest the scale overshoot.
+  if (ratio > 1)
+    _scale += 0.5f * (target - _scale);
+  else if (ratio < 0.85)
+    _scale += 0.1f * (target - _scale);
+}
+
+void DynamicResolution::readTimings(size_t slot) {
+  GLuint64 ns[2];
+  for (int i{}; i < 2; ++i)
+    glCheck(glGetQueryObjectui64v(_queries[slot][i], GL_QUERY_RESULT, &ns[i]));
+  _gpuMs = double(ns[1] - ns[0]) * 1e-6;
+  _queryIssued[slot] = false;
+  if (!_fixed)
+    adjust(_gpuMs);
+}
+
+void DynamicResolution::beginFrame() {
+  // Timestamps rather than a GL_TIME_ELAPSED query, since those cannot nest
+  // and the scene may well time its own passes.
+  auto slot{_frame++ % 3};
+  if (_queryIssued[slot]) {
+    // Reading a result that is not there yet would stall until the GPU
+    // catches up; if it has fallen that far behind, this frame goes untimed
+    // and the scale stays put.
+    GLint available[2];
+    for (int i{}; i < 2; ++i)
+      glCheck(glGetQueryObjectiv(_queries[slot][i], GL_QUERY_RESULT_AVAILABLE,
+                                 &available[i]));
+    if (available[0] && available[1])
+      readTimings(slot);
+  }
+  _timed = !_queryIssued[slot];
+  _renderWidth = std::clamp(size_t(std::lround(double(_width) * _scale)),
+                            size_t{1}, _width);
+  _renderHeight = std::clamp(size_t(std::lround(double(_height) * _scale)),
+                             size_t{1}, _height);
+
+  glCheck(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &_previousFramebuffer));
+  glCheck(glGetIntegerv(GL_VIEWPORT, _previousViewport));
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+  glCheck(glViewport(0, 0, GLsizei(_renderWidth), GLsizei(_renderHeight)));
+  if (_timed)
+    glCheck(glQueryCounter(_queries[slot][0], GL_TIMESTAMP));
+}
+
+void DynamicResolution::endFrame() {
+  if (_timed) {
+    auto slot{(_frame - 1) % 3};
+    glCheck(glQueryCounter(_queries[slot][1], GL_TIMESTAMP));
+    _queryIssued[slot] = true;
+  }
+
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, GLuint(_previousFramebuffer)));
+  glCheck(glViewport(_previousViewport[0], _previousViewport[1],
+                     _previousViewport[2], _previousViewport[3]));
+  auto depthTest{glIsEnabled(GL_DEPTH_TEST)};
+  glCheck(glDisable(GL_DEPTH_TEST));
+  glCheck(glUseProgram(_program));
+  glCheck(glUniform2f(_uvScaleLoc, float(_renderWidth) / float(_width),
+                      float(_renderHeight) / float(_height)));
+  glCheck(glUniform2f(_uvMaxLoc, (float(_renderWidth) - 0.5f) / float(_width),
+                      (float(_renderHeight) - 0.5f) / float(_height)));
+  glCheck(glBindTextureUnit(0, _textures[0]));
+  glCheck(glBindVertexArray(_emptyVertexArray));
+  glCheck(glDrawArrays(GL_TRIANGLES, 0, 3));
+  if (depthTest)
+    glCheck(glEnable(GL_DEPTH_TEST));
+}
+
+void benchmarkDynamicResolution() {
+  constexpr size_t width{1280}, height{720}, frames{240};
+  constexpr GLuint baseIterations{64};
+  Window window{width, height, "Dynamic resolution benchmark"};
+
+  // Stands in for the window's framebuffer.
+  GLuint framebuffer, renderbuffer;
+  glCheck(glCreateRenderbuffers(1, &renderbuffer));
+  glCheck(glNamedRenderbufferStorage(renderbuffer, GL_RGBA8, width, height));
+  glCheck(glCreateFramebuffers(1, &framebuffer));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0,
+                                         GL_RENDERBUFFER, renderbuffer));
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+  glCheck(glViewport(0, 0, width, height));
+
+  // A full-screen pattern costing a fixed amount of work per pixel.
+  auto program{createProgram(vsSrc, R"(
+    #version 460
+
+    uniform uint iterations;
+
+    out vec4 fragmentColor;
+
+    void main(void) {
+      vec2 p = gl_FragCoord.xy * 0.01;
+      float v = 0;
+      for (uint i = 0; i < iterations; ++i) {
+        p = vec2(sin(1.3 * p.x + p.y), cos(1.7 * p.y - p.x)) + 0.5 * p;
+        v += p.x * p.y;
+      }
+      fragmentColor = vec4(fract(v), 0.5 + 0.5 * sin(v), 0.5, 1);
+    }
+  )")};
+  auto iterationsLoc{glGetUniformLocation(program, "iterations")};
+  GLuint vao;
+  glCheck(glCreateVertexArrays(1, &vao));
+
+  using Clock = std::chrono::steady_clock;
+  auto drawFrame{[&](DynamicResolution &resolution, float load) {
+    auto start{Clock::now()};
+    resolution.beginFrame();
+    glCheck(glUseProgram(program));
+    glCheck(glUniform1ui(iterationsLoc, GLuint(float(baseIterations) * load)));
+    glCheck(glBindVertexArray(vao));
+    glCheck(glDrawArrays(GL_TRIANGLES, 0, 3));
+    resolution.endFrame();
+    glCheck(glFinish());
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  }};
+
+  // The budget is twice the lightest load at full resolution, so that the
+  // heaviest needs about 0.7 of it.
+  std::vector<double> times;
+  {
+    DynamicResolution resolution{width, height};
+    resolution.setFixedScale(1);
+    for (size_t frame{}; frame < 20; ++frame)
+      times.push_back(drawFrame(resolution, 1));
+  }
+  std::sort(times.begin(), times.end());
+  auto budgetMs{2 * times[times.size() / 2]};
+  std::printf("budget %.3f ms\n", budgetMs);
+
+  for (auto dynamic : {false, true}) {
+    DynamicResolution resolution{width, height, budgetMs};
+    if (!dynamic)
+      resolution.setFixedScale(1);
+    times.clear();
+    size_t overBudget{};
+    double scaleSum{}, minScale{1};
+    for (size_t frame{}; frame < frames; ++frame) {
+      // Light, ramping up, heavy, then light again.
+      auto load{frame < 60    ? 1.0f
+                : frame < 120 ? 1 + 3 * float(frame - 60) / 60
+                : frame < 180 ? 4.0f
+                              : 1.0f};
+      auto ms{drawFrame(resolution, load)};
+      times.push_back(ms);
+      overBudget += ms > budgetMs;
+      scaleSum += resolution.scale();
+      minScale = std::min(minScale, double(resolution.scale()));
+    }
+    double sum{};
+    for (auto ms : times)
+      sum += ms;
+    std::sort(times.begin(), times.end());
+    std::printf("%-7s mean %.3f ms, 95th percentile %.3f ms, worst %.3f ms, "
+                "%zu/%zu frames over budget, scale %.2f on average "
+                "(%.2f lowest)\n",
+                dynamic ? "dynamic" : "fixed", sum / frames,
+                times[frames * 95 / 100], times.back(), overBudget, frames,
+                scaleSum / frames, minScale);
+  }
+
+  glDeleteVertexArrays(1, &vao);
+  glDeleteProgram(program);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(1, &renderbuffer);
+}
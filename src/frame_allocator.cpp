@@ -0,0 +1,113 @@
+#include "frame_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+std::atomic<size_t> allocationCount{}, allocatedBytes{};
+#ifndef NDEBUG
+std::atomic<int> activeGuards{};
+#endif
+
+void countAllocation(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+#ifndef NDEBUG
+  assert(activeGuards.load(std::memory_order_relaxed) == 0 &&
+         "heap allocation inside a HeapAllocationGuard");
+#endif
+}
+} // namespace
+
+// The array and nothrow forms forward to these by default, so replacing them
+// is enough to see every allocation.
+void *operator new(size_t size) {
+  countAllocation(size);
+  if (auto memory{std::malloc(size ? size : 1)})
+    return memory;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
+void *operator new(size_t size, std::align_val_t alignment) {
+  countAllocation(size);
+  auto align{size_t(alignment)};
+#ifdef _MSC_VER
+  auto memory{_aligned_malloc(size ? size : 1, align)};
+#else
+  auto memory{std::aligned_alloc(align, (size + align - 1) / align * align)};
+#endif
+  if (memory)
+    return memory;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+#ifdef _MSC_VER
+  _aligned_free(memory);
+#else
+  std::free(memory);
+#endif
+}
+
+void operator delete(void *memory, size_t,
+                     std::align_val_t alignment) noexcept {
+  operator delete(memory, alignment);
+}
+
+size_t heapAllocationCount() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+size_t heapAllocatedBytes() {
+  return allocatedBytes.load(std::memory_order_relaxed);
+}
+
+HeapAllocationGuard::HeapAllocationGuard(bool active) : _active{active} {
+#ifndef NDEBUG
+  if (_active)
+    activeGuards.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+HeapAllocationGuard::~HeapAllocationGuard() {
+#ifndef NDEBUG
+  if (_active)
+    activeGuards.fetch_sub(1, std::memory_order_relaxed);
+#endif
+}
+
+LinearArena::LinearArena(size_t capacity)
+    : _memory{std::make_unique_for_overwrite<std::byte[]>(capacity)},
+      _capacity{capacity} {}
+
+void *LinearArena::allocate(size_t size, size_t alignment) {
+  auto base{reinterpret_cast<uintptr_t>(_memory.get())};
+  auto offset{((base + _used + alignment - 1) & ~(alignment - 1)) - base};
+  if (offset + size > _capacity)
+    throw std::runtime_error{"Linear arena is out of memory"};
+  _used = offset + size;
+  _peak = std::max(_peak, _used);
+  return _memory.get() + offset;
+}
+
+FrameArena::FrameArena(size_t capacityPerFrame)
+    : _arenas{LinearArena{capacityPerFrame}, LinearArena{capacityPerFrame}},
+      _heapAllocationsAtStart{heapAllocationCount()},
+      _heapBytesAtStart{heapAllocatedBytes()} {}
+
+void FrameArena::nextFrame() {
+  auto allocations{heapAllocationCount()};
+  auto bytes{heapAllocatedBytes()};
+  _lastFrame = {allocations - _heapAllocationsAtStart,
+                bytes - _heapBytesAtStart, current().used()};
+  _heapAllocationsAtStart = allocations;
+  _heapBytesAtStart = bytes;
+  ++_frame;
+  current().reset();
+}
@@ -0,0 +1,280 @@
+#include "frame_capture.hpp"
+#include "gl_util.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+// C stdio allocates with malloc, not operator new, so files can be opened
+// and written while a HeapAllocationGuard is alive.
+std::FILE *openForWriting(const char *path) {
+#ifdef _MSC_VER
+  std::FILE *file{};
+  return fopen_s(&file, path, "wb") == 0 ? file : nullptr;
+#else
+  return std::fopen(path, "wb");
+#endif
+}
+
+// BT.601 studio range, as most players assume for Y4M.
+uint8_t lumaOf(int r, int g, int b) {
+  return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+uint8_t blueDifferenceOf(int r, int g, int b) {
+  return uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+uint8_t redDifferenceOf(int r, int g, int b) {
+  return uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+} // namespace
+
+FrameCapture::FrameCapture(size_t width, size_t height,
+                           std::string screenshotPrefix)
+    : _width{width}, _height{height},
+      _screenshotPrefix{std::move(screenshotPrefix)},
+      _rgb(width * height * 3),
+      _yuv(width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2)) {
+  createBuffers();
+  _writer = std::thread{[this] { writerLoop(); }};
+}
+
+FrameCapture::~FrameCapture() {
+  flush();
+  enqueue(closeVideo);
+  {
+    std::lock_guard lock{_mutex};
+    _quit = true;
+  }
+  _wake.notify_one();
+  _writer.join();
+  deleteBuffers();
+}
+
+void FrameCapture::startRecording(const std::filesystem::path &y4mPath,
+                                  unsigned fps) {
+  stopRecording();
+  _videoPath = y4mPath.string();
+  _videoFps = fps;
+  _recording = true;
+}
+
+void FrameCapture::stopRecording() {
+  if (!_recording)
+    return;
+  flush();
+  enqueue(closeVideo);
+  _recording = false;
+}
+
+void FrameCapture::endFrame() {
+  poll(false);
+  auto frame{_frame++};
+  if (!_screenshotRequested && !_recording)
+    return;
+
+  auto index{(_firstPending + _pendingCount) % ringSize};
+  auto &slot{_slots[index]};
+  {
+    std::lock_guard lock{_mutex};
+    // The writer is behind; a pending screenshot waits for the next frame.
+    if (slot.state != SlotState::Free) {
+      ++_stats.dropped;
+      return;
+    }
+    slot.state = SlotState::Pending;
+    ++_stats.captured;
+  }
+  slot.frame = frame;
+  slot.screenshot = _screenshotRequested;
+  slot.video = _recording;
+  _screenshotRequested = false;
+
+  glCheck(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer));
+  glCheck(glReadPixels(0, 0, GLsizei(_width), GLsizei(_height), GL_RGBA,
+                       GL_UNSIGNED_BYTE, nullptr));
+  glCheck(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ++_pendingCount;
+}
+
+void FrameCapture::resize(size_t width, size_t height) {
+  if (width == _width && height == _height)
+    return;
+  stopRecording();
+  // The writer is idle from here on, so its buffers can be replaced too.
+  flush();
+  deleteBuffers();
+  _width = width;
+  _height = height;
+  _rgb.assign(width * height * 3, 0);
+  _yuv.assign(width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2), 0);
+  createBuffers();
+}
+
+FrameCaptureStats FrameCapture::stats() const {
+  std::lock_guard lock{_mutex};
+  return _stats;
+}
+
+void FrameCapture::createBuffers() {
+  auto bytes{GLsizeiptr(std::max(_width * _height * 4, size_t{4}))};
+  constexpr GLbitfield flags{GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT |
+                             GL_MAP_COHERENT_BIT};
+  for (auto &slot : _slots) {
+    glCheck(glCreateBuffers(1, &slot.buffer));
+    glCheck(glNamedBufferStorage(slot.buffer, bytes, nullptr, flags));
+    slot.pixels = static_cast<const uint8_t *>(
+        glMapNamedBufferRange(slot.buffer, 0, bytes, flags));
+    if (!slot.pixels)
+      throw std::runtime_error{"could not map a frame capture buffer"};
+  }
+}
+
+void FrameCapture::deleteBuffers() {
+  for (auto &slot : _slots) {
+    glUnmapNamedBuffer(slot.buffer);
+    glDeleteBuffers(1, &slot.buffer);
+    slot.buffer = 0;
+    slot.pixels = nullptr;
+  }
+}
+
+void FrameCapture::poll(bool wait) {
+  while (_pendingCount > 0) {
+    auto &slot{_slots[_firstPending]};
+    auto status{glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                 wait ? 1'000'000'000 : 0)};
+    if (status == GL_WAIT_FAILED)
+      throw std::runtime_error{"waiting on a frame capture fence failed"};
+    if (status == GL_TIMEOUT_EXPIRED) {
+      if (wait)
+        continue;
+      return;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    {
+      std::lock_guard lock{_mutex};
+      slot.state = SlotState::Writing;
+    }
+    enqueue(int(_firstPending));
+    _firstPending = (_firstPending + 1) % ringSize;
+    --_pendingCount;
+  }
+}
+
+void FrameCapture::flush() {
+  poll(true);
+  std::unique_lock lock{_mutex};
+  _idle.wait(lock, [this] {
+    return _queueSize == 0 &&
+           std::none_of(std::begin(_slots), std::end(_slots),
+                        [](const Slot &slot) {
+                          return slot.state == SlotState::Writing;
+                        });
+  });
+}
+
+void FrameCapture::enqueue(int task) {
+  {
+    std::lock_guard lock{_mutex};
+    _queue[(_queueFirst + _queueSize++) % std::size(_queue)] = task;
+  }
+  _wake.notify_one();
+}
+
+void FrameCapture::writerLoop() {
+  std::unique_lock lock{_mutex};
+  while (true) {
+    _wake.wait(lock, [this] { return _queueSize > 0 || _quit; });
+    if (_queueSize == 0)
+      return;
+    auto task{_queue[_queueFirst]};
+    _queueFirst = (_queueFirst + 1) % std::size(_queue);
+    --_queueSize;
+    lock.unlock();
+
+    if (task == closeVideo) {
+      if (_video)
+        std::fclose(_video);
+      _video = nullptr;
+    } else {
+      auto &slot{_slots[task]};
+      if (slot.screenshot)
+        writeScreenshot(slot);
+      if (slot.video)
+        writeVideoFrame(slot);
+    }
+
+    lock.lock();
+    if (task != closeVideo) {
+      _slots[task].state = SlotState::Free;
+      ++_stats.written;
+    }
+    _idle.notify_all();
+  }
+}
+
+void FrameCapture::writeScreenshot(const Slot &slot) {
+  char path[1024];
+  std::snprintf(path, sizeof(path), "%s%06llu.ppm", _screenshotPrefix.c_str(),
+                (unsigned long long)slot.frame);
+  auto file{openForWriting(path)};
+  if (!file) {
+    std::fprintf(stderr, "could not create %s\n", path);
+    return;
+  }
+  for (size_t y{}; y < _height; ++y) {
+    auto source{slot.pixels + (_height - 1 - y) * _width * 4};
+    auto target{_rgb.data() + y * _width * 3};
+    for (size_t x{}; x < _width; ++x)
+      std::copy_n(source + 4 * x, 3, target + 3 * x);
+  }
+  std::fprintf(file, "P6\n%zu %zu\n255\n", _width, _height);
+  std::fwrite(_rgb.data(), 1, _rgb.size(), file);
+  std::fclose(file);
+}
+
+void FrameCapture::writeVideoFrame(const Slot &slot) {
+  if (!_video) {
+    _video = openForWriting(_videoPath.c_str());
+    if (!_video) {
+      std::fprintf(stderr, "could not create %s\n", _videoPath.c_str());
+      return;
+    }
+    std::fprintf(_video, "YUV4MPEG2 W%zu H%zu F%u:1 Ip A1:1 C420jpeg\n",
+                 _width, _height, _videoFps);
+  }
+
+  // Chroma is averaged over 2x2 blocks, centered between their pixels.
+  auto chromaWidth{(_width + 1) / 2}, chromaHeight{(_height + 1) / 2};
+  auto luma{_yuv.data()};
+  auto blue{luma + _width * _height};
+  auto red{blue + chromaWidth * chromaHeight};
+  auto rgba{[&](size_t x, size_t y) {
+    return slot.pixels + ((_height - 1 - y) * _width + x) * 4;
+  }};
+  for (size_t y{}; y < _height; ++y)
+    for (size_t x{}; x < _width; ++x) {
+      auto p{rgba(x, y)};
+      luma[y * _width + x] = lumaOf(p[0], p[1], p[2]);
+    }
+  for (size_t cy{}; cy < chromaHeight; ++cy)
+    for (size_t cx{}; cx < chromaWidth; ++cx) {
+      size_t x0{2 * cx}, y0{2 * cy};
+      size_t x1{std::min(x0 + 1, _width - 1)};
+      size_t y1{std::min(y0 + 1, _height - 1)};
+      int sum[3]{};
+      for (auto p : {rgba(x0, y0), rgba(x1, y0), rgba(x0, y1), rgba(x1, y1)})
+        for (int c{}; c < 3; ++c)
+          sum[c] += p[c];
+      int r{(sum[0] + 2) / 4}, g{(sum[1] + 2) / 4}, b{(sum[2] + 2) / 4};
+      blue[cy * chromaWidth + cx] = blueDifferenceOf(r, g, b);
+      red[cy * chromaWidth + cx] = redDifferenceOf(r, g, b);
+    }
+  std::fputs("FRAME\n", _video);
+  std::fwrite(_yuv.data(), 1, _yuv.size(), _video);
+}
@@ -0,0 +1,622 @@
+#include "golden.hpp"
+#include "anti_aliasing.hpp"
+#include "clustered_lighting.hpp"
+#include "deferred_shading.hpp"
+#include "gl_util.hpp"
+#include "image.hpp"
+#include "intro_triangle.hpp"
+#include "path_tracer.hpp"
+#include "shader.hpp"
+#include "shadow_maps.hpp"
+#include "window.hpp"
+
+#include "glm/common.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+constexpr GLsizei width{256}, height{256};
+
+class GoldenScene {
+public:
+  virtual ~GoldenScene() = default;
+  // Draws the given frame into the bound framebuffer; frames must only
+  // depend on their number, never on the time.
+  virtual void render(size_t frame) = 0;
+};
+
+// main.cpp's spinning triangle, with its own shaders, drawn through the
+// given anti-aliasing mode.
+class TriangleScene final : public GoldenScene {
+public:
+  explicit TriangleScene(AntiAliasingMode mode)
+      : _antiAliasing{width, height, mode} {
+    constexpr float pi{3.1415926535f}, r{0.5f};
+    float vertices[18]{};
+    for (int i{}; i < 3; ++i) {
+      auto v{vertices + 6 * i};
+      v[0] = r * std::cos(2.0f * pi * float(i) / 3.0f);
+      v[1] = r * std::sin(2.0f * pi * float(i) / 3.0f);
+      v[3 + i] = 1; // color
+    }
+    glCheck(glCreateBuffers(1, &_vbo));
+    glCheck(glNamedBufferStorage(_vbo, sizeof(vertices), vertices, 0));
+    glCheck(glCreateVertexArrays(1, &_vao));
+    glCheck(glVertexArrayVertexBuffer(_vao, 0, _vbo, 0, 6 * sizeof(float)));
+    for (GLuint attribute{}; attribute < 2; ++attribute) {
+      glCheck(glVertexArrayAttribFormat(_vao, attribute, 3, GL_FLOAT, GL_FALSE,
+                                        3 * attribute * sizeof(float)));
+      glCheck(glVertexArrayAttribBinding(_vao, attribute, 0));
+      glCheck(glEnableVertexArrayAttrib(_vao, attribute));
+    }
+    _program = createProgram(introTriangleVertexShaderSource,
+                             introTriangleFragmentShaderSource);
+    _tLoc = glGetUniformLocation(_program, "t");
+    _previousTLoc = glGetUniformLocation(_program, "previousT");
+    _jitterLoc = glGetUniformLocation(_program, "jitter");
+  }
+
+  ~TriangleScene() override {
+    glDeleteProgram(_program);
+    glDeleteVertexArrays(1, &_vao);
+    glDeleteBuffers(1, &_vbo);
+  }
+
+  void render(size_t frame) override {
+    auto t{0.01f * float(frame)};
+    _antiAliasing.beginFrame({1, 1, 1, 1});
+    glCheck(glUseProgram(_program));
+    glCheck(glUniform1f(_tLoc, t));
+    glCheck(glUniform1f(_previousTLoc, t - 0.01f));
+    glCheck(glUniformMatrix4fv(
+        _jitterLoc, 1, GL_FALSE,
+        glm::value_ptr(_antiAliasing.jitter(glm::mat4{1}))));
+    glCheck(glBindVertexArray(_vao));
+    glCheck(glDrawArrays(GL_TRIANGLES, 0, 3));
+    _antiAliasing.endFrame();
+  }
+
+private:
+  AntiAliasing _antiAliasing;
+  GLuint _vbo{}, _vao{}, _program{};
+  GLint _tLoc{}, _previousTLoc{}, _jitterLoc{};
+};
+
+// The path tracer's Cornell box, with positions, normals and colors at
+// attributes 0 to 2, seen by a camera that sways from side to side.
+class CornellGeometry {
+public:
+  static constexpr float near{0.1f}, far{10.0f};
+
+  CornellGeometry() {
+    struct SceneVertex {
+      glm::vec3 position, normal, color;
+    };
+    auto box{cornellBox()};
+    std::vector<SceneVertex> vertices(box.vertices.size());
+    for (auto &submesh : box.submeshes) {
+      auto &material{box.materials[submesh.material]};
+      auto color{glm::min(material.kd + material.ke, glm::vec3{1})};
+      for (uint32_t i{}; i < submesh.indexCount; ++i) {
+        auto index{box.indices[submesh.firstIndex + i]};
+        auto &vertex{box.vertices[index]};
+        vertices[index] = {vertex.position, vertex.normal, color};
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+      }
+    }
+    indexCount = GLsizei(box.indices.size());
+
+    glCheck(glCreateBuffers(2, _buffers));
+    glCheck(glNamedBufferStorage(
+        _buffers[0], GLsizeiptr(vertices.size() * sizeof(SceneVertex)),
+        vertices.data(), 0));
+    glCheck(glNamedBufferStorage(
+        _buffers[1], GLsizeiptr(box.indices.size() * sizeof(uint32_t)),
+        box.indices.data(), 0));
+    glCheck(glCreateVertexArrays(1, &vertexArray));
+    glCheck(glVertexArrayVertexBuffer(vertexArray, 0, _buffers[0], 0,
+                                      sizeof(SceneVertex)));
+    glCheck(glVertexArrayElementBuffer(vertexArray, _buffers[1]));
+    GLuint offsets[]{offsetof(SceneVertex, position),
+                     offsetof(SceneVertex, normal),
+                     offsetof(SceneVertex, color)};
+    for (GLuint attribute{}; attribute < 3; ++attribute) {
+      glCheck(glVertexArrayAttribFormat(vertexArray, attribute, 3, GL_FLOAT,
+                                        GL_FALSE, offsets[attribute]));
+      glCheck(glVertexArrayAttribBinding(vertexArray, attribute, 0));
+      glCheck(glEnableVertexArrayAttrib(vertexArray, attribute));
+    }
+  }
+
+  ~CornellGeometry() {
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(2, _buffers);
+  }
+
+  CornellGeometry(const CornellGeometry &) = delete;
+  CornellGeometry &operator=(const CornellGeometry &) = delete;
+
+  static glm::vec3 eye(size_t frame) {
+    auto angle{0.3f * std::sin(0.05f * float(frame))};
+    return {3.75f * std::sin(angle), 0, 3.75f * std::cos(angle)};
+  }
+  static glm::mat4 view(size_t frame) {
+    return glm::lookAt(eye(frame), glm::vec3{0}, glm::vec3{0, 1, 0});
+  }
+  static glm::mat4 projection() {
+    return glm::perspective(glm::radians(40.0f), float(width) / height, near,
+                            far);
+  }
+
+  void draw() const {
+    glCheck(glBindVertexArray(vertexArray));
+    glCheck(glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT,
+                           nullptr));
+  }
+
+  GLuint vertexArray{};
+  GLsizei indexCount{};
+  glm::vec3 boundsMin{std::numeric_limits<float>::infinity()},
+      boundsMax{-boundsMin};
+
+private:
+  GLuint _buffers[2]{};
+};
+
+constexpr auto cornellVsSrc{R"(
+  #version 450
+
+  layout (location = 0) in vec3 position;
+  layout (location = 1) in vec3 normal;
+  layout (location = 2) in vec3 color;
+
+  uniform mat4 view;
+  uniform mat4 projection;
+
+  out vec3 worldPosition;
+  out vec3 worldNormal;
+  out vec3 vertexColor;
+  out float viewDepth;
+
+  void main(void) {
+    vec4 viewPosition = view * vec4(position, 1);
+    gl_Position = projection * viewPosition;
+    worldPosition = position;
+    worldNormal = normal;
+    vertexColor = color;
+    viewDepth = -viewPosition.z;
+  }
+)"};
+
+// Takes a program built on cornellVsSrc and sets its camera for the frame.
+void setCornellCamera(GLuint program, size_t frame) {
+  auto eye{CornellGeometry::eye(frame)};
+  auto view{CornellGeometry::view(frame)};
+  auto projection{CornellGeometry::projection()};
+  glCheck(glProgramUniformMatrix4fv(
+      program, glGetUniformLocation(program, "view"), 1, GL_FALSE,
+      glm::value_ptr(view)));
+  glCheck(glProgramUniformMatrix4fv(
+      program, glGetUniformLocation(program, "projection"), 1, GL_FALSE,
+      glm::value_ptr(projection)));
+  if (auto eyeLoc{glGetUniformLocation(program, "eye")}; eyeLoc >= 0) {
+    glCheck(glProgramUniform3fv(program, eyeLoc, 1, glm::value_ptr(eye)));
+  }
+}
+
+// The Cornell box with diffuse shading from a point light under its area
+// light.
+class CornellScene final : public GoldenScene {
+public:
+  CornellScene() {
+    _program = createProgram(cornellVsSrc, R"(
+      #version 450
+
+      in vec3 worldPosition;
+      in vec3 worldNormal;
+      in vec3 vertexColor;
+
+      uniform vec3 eye;
+
+      out vec4 fragmentColor;
+
+      void main(void) {
+        const vec3 lightPosition = vec3(0, 0.9, 0);
+        vec3 n = normalize(worldNormal);
+        n = faceforward(n, worldPosition - eye, n);
+        vec3 toLight = lightPosition - worldPosition;
+        float distance = length(toLight);
+        float diffuse = max(dot(n, toLight / distance), 0.0);
+        float light = 0.15 + 0.85 * diffuse / (1.0 + 0.5 * distance * distance);
+        fragmentColor = vec4(min(vertexColor * light * 1.5, vec3(1)), 1);
+      }
+    )");
+  }
+
+  ~CornellScene() override { glDeleteProgram(_program); }
+
+  void render(size_t frame) override {
+    glCheck(glEnable(GL_DEPTH_TEST));
+    glCheck(glClearColor(0, 0, 0, 1));
+    glCheck(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+    setCornellCamera(_program, frame);
+    glCheck(glUseProgram(_program));
+    _geometry.draw();
+    glCheck(glDisable(GL_DEPTH_TEST));
+  }
+
+private:
+  CornellGeometry _geometry;
+  GLuint _program{};
+};
+
+// The Cornell box under a directional light coming in through its open side,
+// with the blocks, walls and ceiling casting cascaded shadows.
+class ShadowScene final : public GoldenScene {
+public:
+  ShadowScene() : _shadows{1024} {
+    auto fsSrc{std::string{"#version 450\n"} + shadowSource + R"(
+      in vec3 worldPosition;
+      in vec3 worldNormal;
+      in vec3 vertexColor;
+      in float viewDepth;
+
+      uniform vec3 eye;
+
+      out vec4 fragmentColor;
+
+      void main(void) {
+        vec3 n = normalize(worldNormal);
+        n = faceforward(n, worldPosition - eye, n);
+        float diffuse = max(dot(n, shadowToLight.xyz), 0.0);
+        float lit = directionalShadow(worldPosition, n, viewDepth);
+        fragmentColor = vec4(vertexColor * (0.15 + 0.85 * diffuse * lit), 1);
+      }
+    )"};
+    _program = createProgram(cornellVsSrc, fsSrc.c_str());
+    // Shadows are fitted per frame, so the cache is not what is under test.
+    _shadows.setCaching(false);
+  }
+
+  ~ShadowScene() override { glDeleteProgram(_program); }
+
+  void render(size_t frame) override {
+    ShadowCaster caster{_geometry.vertexArray, 0, _geometry.indexCount,
+                        glm::mat4{1}, _geometry.boundsMin,
+                        _geometry.boundsMax};
+    _shadows.render(CornellGeometry::view(frame),
+                    CornellGeometry::projection(), CornellGeometry::near,
+                    CornellGeometry::far,
+                    glm::normalize(glm::vec3{0.4f, -0.5f, -1}), &caster, 1);
+
+    glCheck(glEnable(GL_DEPTH_TEST));
+    glCheck(glClearColor(0, 0, 0, 1));
+    glCheck(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+    setCornellCamera(_program, frame);
+    glCheck(glUseProgram(_program));
+    _shadows.bind();
+    _geometry.draw();
+    glCheck(glDisable(GL_DEPTH_TEST));
+  }
+
+private:
+  CornellGeometry _geometry;
+  CascadedShadowMaps _shadows;
+  GLuint _program{};
+};
+
+// The Cornell box lit by colored point lights and a spot light through
+// ClusteredLighting, shaded forward or deferred.
+class ClusteredScene final : public GoldenScene {
+public:
+  explicit ClusteredScene(ShadingPath path)
+      : _path{path}, _lighting{4}, _deferred{width, height} {
+    Light lights[]{
+        pointLight({0, 0.8f, 0}, 2.5f, {1, 0.9f, 0.7f}, 1.5f),
+        pointLight({-0.7f, -0.8f, 0.5f}, 1.2f, {1, 0.3f, 0.1f}, 2),
+        pointLight({0.7f, -0.8f, 0.6f}, 1.2f, {0.2f, 0.4f, 1}, 2),
+        spotLight({0.2f, 0.9f, 1.5f}, glm::normalize(glm::vec3{-0.5f, -1, -1}),
+                  4, glm::radians(10.0f), glm::radians(20.0f), {1, 1, 1},
+                  3)};
+    _lighting.setLights(lights, std::size(lights));
+    _lighting.setAmbient(glm::vec3{0.1f});
+    auto fsSrc{path == ShadingPath::Forward
+                   ? std::string{"#version 450\n"} + clusteredShadingSource +
+                         R"(
+      in vec3 worldPosition;
+      in vec3 worldNormal;
+      in vec3 vertexColor;
+
+      uniform vec3 eye;
+
+      out vec4 fragmentColor;
+
+      void main(void) {
+        vec3 n = normalize(worldNormal);
+        n = faceforward(n, worldPosition - eye, n);
+        fragmentColor = vec4(shadeBlinnPhong(worldPosition, n, eye,
+                                             vertexColor, vertexColor,
+                                             vec3(0), 1, vec3(0)), 1);
+      }
+    )"
+                   : std::string{"#version 450\n"} + gBufferSource + R"(
+      in vec3 worldPosition;
+      in vec3 worldNormal;
+      in vec3 vertexColor;
+
+      uniform vec3 eye;
+
+      void main(void) {
+        vec3 n = normalize(worldNormal);
+        n = faceforward(n, worldPosition - eye, n);
+        writeGBuffer(n, vertexColor, vec3(0), 1);
+      }
+    )"};
+    _program = createProgram(cornellVsSrc, fsSrc.c_str());
+  }
+
+  ~ClusteredScene() override { glDeleteProgram(_program); }
+
+  void render(size_t frame) override {
+    auto projection{CornellGeometry::projection()};
+    _lighting.update(CornellGeometry::view(frame), projection,
+                     CornellGeometry::near, CornellGeometry::far, width,
+                     height);
+    setCornellCamera(_program, frame);
+    if (_path == ShadingPath::Forward) {
+      glCheck(glEnable(GL_DEPTH_TEST));
+      glCheck(glClearColor(0, 0, 0, 1));
+      glCheck(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+      glCheck(glUseProgram(_program));
+      _lighting.bind();
+      _geometry.draw();
+      glCheck(glDisable(GL_DEPTH_TEST));
+    } else {
+      _deferred.beginGeometry();
+      glCheck(glUseProgram(_program));
+      _geometry.draw();
+      _deferred.light(_lighting, projection);
+    }
+  }
+
+private:
+  ShadingPath _path;
+  CornellGeometry _geometry;
+  ClusteredLighting _lighting;
+  DeferredShading _deferred;
+  GLuint _program{};
+};
+
+struct SceneEntry {
+  const char *name;
+  std::unique_ptr<GoldenScene> (*create)();
+};
+
+const SceneEntry sceneEntries[]{
+    {"triangle",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<TriangleScene>(AntiAliasingMode::Off);
+     }},
+    {"cornell",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<CornellScene>();
+     }},
+    {"shadows",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<ShadowScene>();
+     }},
+    {"clustered",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<ClusteredScene>(ShadingPath::Forward);
+     }},
+    {"deferred",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<ClusteredScene>(ShadingPath::Deferred);
+     }},
+    {"msaa4",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<TriangleScene>(AntiAliasingMode::Msaa4);
+     }},
+    {"fxaa",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<TriangleScene>(AntiAliasingMode::Fxaa);
+     }},
+    {"taa",
+     []() -> std::unique_ptr<GoldenScene> {
+       return std::make_unique<TriangleScene>(AntiAliasingMode::Taa);
+     }},
+};
+
+struct FrameTime {
+  double cpuMs, gpuMs, frameMs;
+};
+
+// JSON has no infinity, which is what PSNR reports for identical images.
+std::string jsonNumber(double value) {
+  if (!std::isfinite(value))
+    return "null";
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+  return buffer;
+}
+
+Image readColorBuffer() {
+  Image image{width, height};
+  glCheck(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+  glCheck(glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+                       image.data()));
+  // GL's rows go bottom to top, PPM's top to bottom.
+  for (size_t y{}; y < height / 2; ++y)
+    std::swap_ranges(image.pixel(0, y), image.pixel(0, y + 1),
+                     image.pixel(0, height - 1 - y));
+  return image;
+}
+} // namespace
+
+std::vector<std::string> goldenSceneNames() {
+  std::vector<std::string> names;
+  for (auto &entry : sceneEntries)
+    names.emplace_back(entry.name);
+  return names;
+}
+
+bool runGoldenTests(const GoldenTestOptions &options) {
+  namespace fs = std::filesystem;
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  for (auto &name : options.scenes)
+    if (std::none_of(std::begin(sceneEntries), std::end(sceneEntries),
+                     [&](const SceneEntry &entry) {
+                       return name == entry.name;
+                     }))
+      throw std::runtime_error{"unknown golden scene \"" + name + "\""};
+
+  // Never shown; only there for its context, 4.5 being as far as llvmpipe
+  // goes.
+  Window window{width, height, "Golden image tests", 0, {4, 5}};
+
+  GLuint framebuffer, renderbuffers[2], queries[2];
+  glCheck(glCreateRenderbuffers(2, renderbuffers));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width,
+                                     height));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24,
+                                     width, height));
+  glCheck(glCreateFramebuffers(1, &framebuffer));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0,
+                                         GL_RENDERBUFFER, renderbuffers[0]));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT,
+                                         GL_RENDERBUFFER, renderbuffers[1]));
+  if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) !=
+      GL_FRAMEBUFFER_COMPLETE)
+    throw std::runtime_error{"offscreen framebuffer is incomplete"};
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+  glCheck(glViewport(0, 0, width, height));
+  // Timestamps rather than an elapsed time query, which scenes could not
+  // nest their own in.
+  glCheck(glCreateQueries(GL_TIMESTAMP, 2, queries));
+
+  std::ofstream report{options.reportPath};
+  if (!report)
+    throw std::runtime_error{"could not create " +
+                             options.reportPath.string()};
+  report << "{\n  \"renderer\": \""
+         << reinterpret_cast<const char *>(glGetString(GL_RENDERER))
+         << "\",\n  \"width\": " << width << ",\n  \"height\": " << height
+         << ",\n  \"scenes\": [";
+  if (options.updateReferences)
+    fs::create_directories(options.referenceDirectory);
+
+  auto allPassed{true}, firstScene{true};
+  std::vector<FrameTime> times(options.frameCount);
+  for (auto &entry : sceneEntries) {
+    if (!options.scenes.empty() &&
+        std::find(options.scenes.begin(), options.scenes.end(), entry.name) ==
+            options.scenes.end())
+      continue;
+    auto scene{entry.create()};
+    for (size_t frame{}; frame < options.frameCount; ++frame) {
+      auto start{Clock::now()};
+      glCheck(glQueryCounter(queries[0], GL_TIMESTAMP));
+      scene->render(frame);
+      glCheck(glQueryCounter(queries[1], GL_TIMESTAMP));
+      auto submitted{Clock::now()};
+      glCheck(glFinish());
+      GLuint64 gpuNs[2]{};
+      for (int i{}; i < 2; ++i)
+        glCheck(glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT,
+                                      &gpuNs[i]));
+      times[frame] = {Milliseconds{submitted - start}.count(),
+                      double(gpuNs[1] - gpuNs[0]) * 1e-6,
+                      Milliseconds{Clock::now() - start}.count()};
+    }
+    auto image{readColorBuffer()};
+
+    std::vector<double> frameMs(times.size());
+    for (size_t i{}; i < times.size(); ++i)
+      frameMs[i] = times[i].frameMs;
+    std::nth_element(frameMs.begin(), frameMs.begin() + frameMs.size() / 2,
+                     frameMs.end());
+    auto medianMs{frameMs.empty() ? 0.0 : frameMs[frameMs.size() / 2]};
+
+    auto referencePath{options.referenceDirectory /
+                       (std::string{entry.name} + ".ppm")};
+    auto timePath{options.referenceDirectory /
+                  (std::string{entry.name} + ".time")};
+    auto psnrDb{std::numeric_limits<double>::infinity()}, similarity{1.0};
+    double referenceMs{}, slowdown{1};
+    std::string failure;
+    if (options.updateReferences) {
+      image.savePpm(referencePath);
+      if (std::ofstream out{timePath}; out)
+        out << medianMs << '\n';
+    } else {
+      if (fs::exists(referencePath)) {
+        Image reference{referencePath};
+        if (reference.width() != image.width() ||
+            reference.height() != image.height()) {
+          failure = "reference size differs";
+        } else {
+          psnrDb = psnr(image, reference);
+          similarity = ssim(image, reference);
+          if (psnrDb < options.minPsnr || similarity < options.minSsim)
+            failure = "image differs from the reference";
+        }
+      } else {
+        failure = "no reference image";
+      }
+      if (std::ifstream in{timePath}; in && in >> referenceMs &&
+                                      referenceMs > 0) {
+        slowdown = medianMs / referenceMs;
+        if (slowdown > options.maxSlowdown && failure.empty())
+          failure = "slower than the reference";
+      }
+    }
+    auto passed{failure.empty()};
+    allPassed = allPassed && passed;
+    if (!passed)
+      image.savePpm(options.reportPath.parent_path() /
+                    (std::string{entry.name} + ".actual.ppm"));
+
+    std::printf("%-10s PSNR %6.2f dB, SSIM %.4f, %7.3f ms/frame "
+                "(%.2fx reference): %s\n",
+                entry.name, psnrDb, similarity, medianMs, slowdown,
+                passed ? "passed" : failure.c_str());
+
+    report << (firstScene ? "" : ",") << "\n    {\n      \"name\": \""
+           << entry.name << "\",\n      \"passed\": "
+           << (passed ? "true" : "false") << ",\n      \"failure\": \""
+           << failure << "\",\n      \"psnr\": " << jsonNumber(psnrDb)
+           << ",\n      \"ssim\": " << jsonNumber(similarity)
+           << ",\n      \"medianFrameMs\": " << jsonNumber(medianMs)
+           << ",\n      \"referenceFrameMs\": " << jsonNumber(referenceMs)
+           << ",\n      \"frames\": [";
+    for (size_t frame{}; frame < times.size(); ++frame)
+      report << (frame ? "," : "") << "\n        {\"cpuMs\": "
+             << jsonNumber(times[frame].cpuMs)
+             << ", \"gpuMs\": " << jsonNumber(times[frame].gpuMs)
+             << ", \"frameMs\": " << jsonNumber(times[frame].frameMs) << "}";
+    report << "\n      ]\n    }";
+    firstScene = false;
+  }
+  report << "\n  ],\n  \"passed\": " << (allPassed ? "true" : "false")
+         << "\n}\n";
+
+  glDeleteQueries(2, queries);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(2, renderbuffers);
+  return allPassed;
+}
@@ -0,0 +1,192 @@
+#include "gpu_scene.hpp"
+#include "gl_util.hpp"
+#include "shader.hpp"
+#include "window.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace {
+constexpr auto csSrc{R"(
+  #version 460
+
+  layout (local_size_x = 64) in;
+
+  struct Object {
+    mat4 model;
+    uint material, padding0, padding1, padding2;
+  };
+
+  layout (std430, binding = 0) writeonly buffer Objects { Object objects[]; };
+  layout (std430, binding = 1) readonly buffer Records { Object records[]; };
+  layout (std430, binding = 2) readonly buffer Indices { uint indices[]; };
+
+  uniform uint recordCount;
+
+  void main(void) {
+    uint i = gl_GlobalInvocationID.x;
+    if (i < recordCount)
+      objects[indices[i]] = records[i];
+  }
+)"};
+
+static_assert(sizeof(GpuObject) == 80,
+              "GpuObject must match the shaders' std430 Object");
+
+constexpr size_t scatterRecordSize{sizeof(GpuObject) + sizeof(uint32_t)};
+} // namespace
+
+GpuScene::GpuScene(size_t capacity)
+    : _objects(capacity, GpuObject{glm::mat4{1}, 0, {}}),
+      _isDirty(capacity) {
+  _program = createComputeProgram(csSrc);
+  _countLoc = glGetUniformLocation(_program, "recordCount");
+  glCheck(glCreateBuffers(1, &_buffer));
+  glCheck(glNamedBufferStorage(
+      _buffer, GLsizeiptr(std::max(capacity, size_t{1}) * sizeof(GpuObject)),
+      _objects.data(), GL_DYNAMIC_STORAGE_BIT));
+  glCheck(glCreateBuffers(2, _stagingBuffers));
+}
+
+GpuScene::~GpuScene() {
+  glDeleteBuffers(2, _stagingBuffers);
+  glDeleteBuffers(1, &_buffer);
+  glDeleteProgram(_program);
+}
+
+void GpuScene::markDirty(uint32_t object) {
+  if (!_isDirty[object]) {
+    _isDirty[object] = 1;
+    _dirty.push_back(object);
+  }
+}
+
+void GpuScene::setTransform(uint32_t object, const glm::mat4 &model) {
+  _objects.at(object).model = model;
+  markDirty(object);
+}
+
+void GpuScene::setMaterial(uint32_t object, uint32_t material) {
+  _objects.at(object).material = material;
+  markDirty(object);
+}
+
+void GpuScene::upload() {
+  _lastUpload = {_dirty.size(), 0, false};
+  if (_dirty.empty())
+    return;
+
+  auto [first, last]{std::minmax_element(_dirty.begin(), _dirty.end())};
+  auto rangeBytes{size_t(*last - *first + 1) * sizeof(GpuObject)};
+  auto scatterBytes{_dirty.size() * scatterRecordSize};
+  if (rangeBytes <= scatterBytes) {
+    glCheck(glNamedBufferSubData(_buffer,
+                                 GLintptr(*first * sizeof(GpuObject)),
+                                 GLsizeiptr(rangeBytes), &_objects[*first]));
+    _lastUpload.uploadBytes = rangeBytes;
+  } else {
+    // Staging buffers are only ever grown, to the largest dirty list seen.
+    if (_dirty.size() > _stagingCapacity) {
+      _stagingCapacity = std::max(_dirty.size(), 2 * _stagingCapacity);
+      glCheck(glNamedBufferData(
+          _stagingBuffers[0], GLsizeiptr(_stagingCapacity * sizeof(GpuObject)),
+          nullptr, GL_STREAM_DRAW));
+      glCheck(glNamedBufferData(_stagingBuffers[1],
+                                GLsizeiptr(_stagingCapacity * sizeof(uint32_t)),
+                                nullptr, GL_STREAM_DRAW));
+    }
+    _stagingRecords.clear();
+    for (auto object : _dirty)
+      _stagingRecords.push_back(_objects[object]);
+    glCheck(glNamedBufferSubData(
+        _stagingBuffers[0], 0,
+        GLsizeiptr(_stagingRecords.size() * sizeof(GpuObject)),
+        _stagingRecords.data()));
+    glCheck(glNamedBufferSubData(_stagingBuffers[1], 0,
+                                 GLsizeiptr(_dirty.size() * sizeof(uint32_t)),
+                                 _dirty.data()));
+
+    GLint previousProgram;
+    glCheck(glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram));
+    glCheck(glUseProgram(_program));
+    glCheck(glUniform1ui(_countLoc, GLuint(_dirty.size())));
+    glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _buffer));
+    glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _stagingBuffers[0]));
+    glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _stagingBuffers[1]));
+    glCheck(glDispatchCompute(GLuint((_dirty.size() + 63) / 64), 1, 1));
+    // Shaders read the scattered records, and buffer reads such as
+    // glGetBufferSubData may follow.
+    glCheck(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT |
+                            GL_BUFFER_UPDATE_BARRIER_BIT));
+    glCheck(glUseProgram(GLuint(previousProgram)));
+    _lastUpload.uploadBytes = scatterBytes;
+    _lastUpload.scattered = true;
+  }
+
+  _totalUploadBytes += _lastUpload.uploadBytes;
+  for (auto object : _dirty)
+    _isDirty[object] = 0;
+  _dirty.clear();
+}
+
+void GpuScene::bind(GLuint binding) const {
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, _buffer));
+}
+
+void benchmarkGpuScene() {
+  constexpr size_t objectCount{100000}, frames{30};
+  Window window{64, 64, "GPU scene benchmark"};
+  GpuScene scene{objectCount};
+  std::mt19937 random{1};
+  std::uniform_int_distribution<uint32_t> anyObject{0, objectCount - 1};
+  std::vector<GpuObject> readBack(objectCount);
+
+  struct Pattern {
+    const char *name;
+    size_t count;
+    bool contiguous;
+  };
+  const Pattern patterns[]{{"100 scattered", 100, false},
+                           {"1000 scattered", 1000, false},
+                           {"1000 in a run", 1000, true},
+                           {"all", objectCount, true}};
+  using Clock = std::chrono::steady_clock;
+  for (auto &pattern : patterns) {
+    double ms{};
+    size_t bytes{}, scattered{}, mismatches{};
+    for (size_t frame{}; frame < frames; ++frame) {
+      auto first{anyObject(random) % (objectCount - pattern.count + 1)};
+      for (size_t i{}; i < pattern.count; ++i) {
+        auto object{pattern.contiguous ? uint32_t(first + i)
+                                       : anyObject(random)};
+        scene.setTransform(object,
+                           glm::translate(glm::mat4{1},
+                                          glm::vec3{frame, i, object}));
+        scene.setMaterial(object, uint32_t(frame));
+      }
+      auto start{Clock::now()};
+      scene.upload();
+      glCheck(glFinish());
+      ms += std::chrono::duration<double, std::milli>(Clock::now() - start)
+                .count();
+      bytes += scene.lastUploadStats().uploadBytes;
+      scattered += scene.lastUploadStats().scattered;
+
+      glCheck(glGetNamedBufferSubData(
+          scene.buffer(), 0, GLsizeiptr(objectCount * sizeof(GpuObject)),
+          readBack.data()));
+      for (uint32_t object{}; object < objectCount; ++object)
+        mismatches += std::memcmp(&readBack[object], &scene.object(object),
+                                  sizeof(GpuObject)) != 0;
+    }
+    std::printf("%-14s %8.3f ms, %9zu bytes per upload, %2zu/%zu scattered, "
+                "%zu objects differing on the GPU\n",
+                pattern.name, ms / frames, bytes / frames, scattered, frames,
+                mismatches);
+  }
+}
@@ -0,0 +1,126 @@
+#include "image.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+// Reads the next whitespace-separated header token, skipping '#' comments.
+std::string readPpmToken(std::istream &in) {
+  std::string token;
+  while (in >> token) {
+    if (token[0] != '#')
+      return token;
+    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  throw std::runtime_error{"unexpected end of PPM header"};
+}
+} // namespace
+
+Image::Image(size_t width, size_t height)
+    : _width{width}, _height{height}, _pixels(width * height * 3) {}
+
+Image::Image(const std::filesystem::path &ppmPath) {
+  std::ifstream in{ppmPath, std::ios::binary};
+  if (!in)
+    throw std::runtime_error{"could not open " + ppmPath.string()};
+  if (readPpmToken(in) != "P6")
+    throw std::runtime_error{ppmPath.string() + " is not a binary PPM"};
+  _width = std::stoul(readPpmToken(in));
+  _height = std::stoul(readPpmToken(in));
+  if (std::stoul(readPpmToken(in)) != 255)
+    throw std::runtime_error{ppmPath.string() + " is not an 8-bit PPM"};
+  in.get(); // single whitespace byte separating header and raster
+  _pixels.resize(_width * _height * 3);
+  if (!in.read(reinterpret_cast<char *>(_pixels.data()),
+               std::streamsize(_pixels.size())))
+    throw std::runtime_error{ppmPath.string() + " is truncated"};
+}
+
+size_t Image::width() const { return _width; }
+size_t Image::height() const { return _height; }
+size_t Image::sizeInBytes() const { return _pixels.size(); }
+
+uint8_t *Image::data() { return _pixels.data(); }
+const uint8_t *Image::data() const { return _pixels.data(); }
+
+uint8_t *Image::pixel(size_t x, size_t y) {
+  return &_pixels[(y * _width + x) * 3];
+}
+
+const uint8_t *Image::pixel(size_t x, size_t y) const {
+  return &_pixels[(y * _width + x) * 3];
+}
+
+void Image::savePpm(const std::filesystem::path &ppmPath) const {
+  std::ofstream out{ppmPath, std::ios::binary};
+  if (!out)
+    throw std::runtime_error{"could not create " + ppmPath.string()};
+  out << "P6\n" << _width << ' ' << _height << "\n255\n";
+  out.write(reinterpret_cast<const char *>(_pixels.data()),
+            std::streamsize(_pixels.size()));
+}
+
+double psnr(const Image &a, const Image &b) {
+  if (a.width() != b.width() || a.height() != b.height())
+    throw std::runtime_error{"PSNR needs images of the same size"};
+  double squaredError{};
+  for (size_t i{}; i < a.sizeInBytes(); ++i) {
+    double d{double(a.data()[i]) - double(b.data()[i])};
+    squaredError += d * d;
+  }
+  if (squaredError == 0)
+    return std::numeric_limits<double>::infinity();
+  auto mse{squaredError / double(a.sizeInBytes())};
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+double ssim(const Image &a, const Image &b) {
+  if (a.width() != b.width() || a.height() != b.height())
+    throw std::runtime_error{"SSIM needs images of the same size"};
+  if (a.width() == 0 || a.height() == 0)
+    return 1;
+  auto luma{[](const Image &image) {
+    std::vector<double> y(image.width() * image.height());
+    for (size_t i{}; i < y.size(); ++i) {
+      auto p{image.data() + 3 * i};
+      y[i] = 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2];
+    }
+    return y;
+  }};
+  auto lumaA{luma(a)}, lumaB{luma(b)};
+
+  constexpr size_t window{8}, stride{4};
+  constexpr double c1{0.01 * 255 * 0.01 * 255}, c2{0.03 * 255 * 0.03 * 255};
+  auto windowWidth{std::min(window, a.width())};
+  auto windowHeight{std::min(window, a.height())};
+  auto n{double(windowWidth * windowHeight)};
+  double sum{};
+  size_t windows{};
+  for (size_t y0{}; y0 + windowHeight <= a.height(); y0 += stride)
+    for (size_t x0{}; x0 + windowWidth <= a.width(); x0 += stride) {
+      double meanA{}, meanB{};
+      for (size_t y{y0}; y < y0 + windowHeight; ++y)
+        for (size_t x{x0}; x < x0 + windowWidth; ++x) {
+          meanA += lumaA[y * a.width() + x];
+          meanB += lumaB[y * a.width() + x];
+        }
+      meanA /= n, meanB /= n;
+      double varianceA{}, varianceB{}, covariance{};
+      for (size_t y{y0}; y < y0 + windowHeight; ++y)
+        for (size_t x{x0}; x < x0 + windowWidth; ++x) {
+          auto da{lumaA[y * a.width() + x] - meanA};
+          auto db{lumaB[y * a.width() + x] - meanB};
+          varianceA += da * da, varianceB += db * db, covariance += da * db;
+        }
+      varianceA /= n, varianceB /= n, covariance /= n;
+      sum += (2 * meanA * meanB + c1) * (2 * covariance + c2) /
+             ((meanA * meanA + meanB * meanB + c1) *
+              (varianceA + varianceB + c2));
+      ++windows;
+    }
+  return sum / double(windows);
+}
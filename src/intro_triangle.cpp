@@ -0,0 +1,69 @@
+#include "intro_triangle.hpp"
+
+const char *const introTriangleVertexShaderSource{R"(
+  #version 450
+
+  layout (location = 0) in vec3 position;
+  layout (location = 1) in vec3 color;
+
+  uniform float t;
+  uniform float previousT; // the previous frame's angle, for TAA
+  uniform mat4 jitter;
+
+  out vec3 vertexColor;
+  out vec3 vertexBarycentric; // only read without gl_BaryCoordNV
+  out vec4 clipPosition;
+  out vec4 previousClipPosition;
+
+  vec4 rotate(vec3 position, float t) {
+    float c = cos(t), s = sin(t);
+    return vec4(mat3(
+      c, -s, 0,
+      s,  c, 0,
+      0,  0, 1
+    ) * position, 1);
+  }
+
+  void main(void) {
+    clipPosition = rotate(position, t);
+    previousClipPosition = rotate(position, previousT);
+    gl_Position = jitter * clipPosition;
+    vertexColor = color;
+    vertexBarycentric = vec3(equal(ivec3(gl_VertexID % 3), ivec3(0, 1, 2)));
+  }
+)"};
+
+const char *const introTriangleFragmentShaderSource{R"(
+  #version 450
+
+  #ifdef GL_NV_fragment_shader_barycentric
+  #extension GL_NV_fragment_shader_barycentric : require
+  #endif
+
+  in vec3 vertexColor;
+  in vec3 vertexBarycentric;
+  in vec4 clipPosition;
+  in vec4 previousClipPosition;
+
+  layout (location = 0) out vec4 fragmentColor;
+  layout (location = 1) out vec2 motionVector; // only read by TAA
+
+  void main(void) {
+    const float epsilon = 0.01;
+    fragmentColor = vec4(vertexColor, 1);
+    motionVector = (clipPosition.xy / clipPosition.w
+                    - previousClipPosition.xy / previousClipPosition.w)
+                   * 0.5;
+  #ifdef GL_NV_fragment_shader_barycentric
+    vec3 b = gl_BaryCoordNV;
+  #else
+    vec3 b = vertexBarycentric;
+  #endif
+    if (b.x < epsilon || b.y < epsilon || b.z < epsilon
+        || abs(b.x - b.y) < 10.0 * epsilon
+        && abs(b.x - b.z) < 10.0 * epsilon
+        && abs(b.y - b.z) < 10.0 * epsilon)
+      fragmentColor = 0.25 * (fragmentColor * fragmentColor
+                              + 2.0 * sqrt(2.0 * fragmentColor));
+  }
+)"};
@@ -0,0 +1,239 @@
+#include "job_system.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+// Which pool the current thread works for, and as which worker.
+struct WorkerIdentity {
+  const JobSystem *system;
+  size_t index;
+};
+thread_local WorkerIdentity currentWorker{nullptr, 0};
+thread_local WorkerIdentity previousWorker{nullptr, 0};
+
+// Attempts at finding work before a worker goes to sleep.
+constexpr int spinsBeforeSleep{64};
+
+// Pooled jobs per thread, as many as a deque holds; run() executes a job
+// inline when they are all taken.
+constexpr size_t jobsPerThread{4096};
+
+size_t defaultThreadCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+size_t jobPoolCapacity(size_t threadCount) {
+  return (threadCount ? threadCount : defaultThreadCount()) * jobsPerThread;
+}
+} // namespace
+
+bool JobSystem::Deque::push(Job *job) {
+  auto bottom{_bottom.load(std::memory_order_relaxed)};
+  auto top{_top.load(std::memory_order_acquire)};
+  if (bottom - top >= capacity)
+    return false;
+  _jobs[bottom & (capacity - 1)].store(job, std::memory_order_relaxed);
+  // Publishes the job to thieves, who load _bottom with acquire.
+  _bottom.store(bottom + 1, std::memory_order_release);
+  return true;
+}
+
+JobSystem::Job *JobSystem::Deque::pop() {
+  auto bottom{_bottom.load(std::memory_order_relaxed) - 1};
+  _bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto top{_top.load(std::memory_order_relaxed)};
+  if (top > bottom) {
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  auto job{_jobs[bottom & (capacity - 1)].load(std::memory_order_relaxed)};
+  if (top == bottom) {
+    // Last job: race the thieves for it.
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      job = nullptr;
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+JobSystem::Job *JobSystem::Deque::steal() {
+  auto top{_top.load(std::memory_order_acquire)};
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto bottom{_bottom.load(std::memory_order_acquire)};
+  if (top >= bottom)
+    return nullptr;
+  auto job{_jobs[top & (capacity - 1)].load(std::memory_order_relaxed)};
+  if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed))
+    return nullptr;
+  return job;
+}
+
+JobSystem::JobSystem(size_t threadCount)
+    : _jobPool{jobPoolCapacity(threadCount)},
+      _shared(jobPoolCapacity(threadCount)) {
+  if (!threadCount)
+    threadCount = defaultThreadCount();
+  for (size_t i{}; i < threadCount; ++i)
+    _deques.push_back(std::make_unique<Deque>());
+  previousWorker = currentWorker;
+  currentWorker = {this, 0};
+  for (size_t i{1}; i < threadCount; ++i)
+    _threads.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard lock{_sleepMutex};
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for (auto &thread : _threads)
+    thread.join();
+  for (size_t i{}; i < _sharedCount; ++i)
+    _jobPool.destroy(_shared[(_sharedFirst + i) % _shared.size()]);
+  if (currentWorker.system == this)
+    currentWorker = previousWorker;
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter *counter) {
+  submit({std::move(function), nullptr, nullptr, 0, 0, counter});
+}
+
+void JobSystem::runRange(void (*range)(void *, size_t, size_t), void *context,
+                         size_t first, size_t last, JobCounter *counter) {
+  submit({{}, range, context, first, last, counter});
+}
+
+void JobSystem::submit(Job &&pending) {
+  if (pending.counter)
+    pending.counter->_pending.fetch_add(1, std::memory_order_relaxed);
+  Job *job;
+  {
+    std::lock_guard lock{_jobPoolMutex};
+    job = _jobPool.create(std::move(pending));
+  }
+  if (!job) {
+    invoke(pending);
+    return;
+  }
+  if (currentWorker.system == this) {
+    if (!_deques[currentWorker.index]->push(job)) {
+      execute(job);
+      return;
+    }
+  } else {
+    std::lock_guard lock{_sharedMutex};
+    _shared[(_sharedFirst + _sharedCount) % _shared.size()] = job;
+    ++_sharedCount;
+  }
+  _queued.fetch_add(1);
+  if (_sleepers.load() > 0) {
+    std::lock_guard lock{_sleepMutex};
+    _wake.notify_one();
+  }
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  auto index{currentWorker.system == this ? currentWorker.index
+                                          : _deques.size()};
+  while (!counter.done()) {
+    if (auto job{findJob(index)})
+      execute(job);
+    else
+      std::this_thread::yield();
+  }
+}
+
+// Own deque first, then the shared queue, then the other workers' deques,
+// starting next to our own so that thieves spread out.
+JobSystem::Job *JobSystem::findJob(size_t index) {
+  Job *job{};
+  if (index < _deques.size())
+    job = _deques[index]->pop();
+  if (!job && _sharedCount.load() > 0) {
+    std::lock_guard lock{_sharedMutex};
+    if (_sharedCount > 0) {
+      job = _shared[_sharedFirst];
+      _sharedFirst = (_sharedFirst + 1) % _shared.size();
+      --_sharedCount;
+    }
+  }
+  for (size_t i{1}; !job && i <= _deques.size(); ++i) {
+    auto victim{(index + i) % _deques.size()};
+    if (victim != index)
+      job = _deques[victim]->steal();
+  }
+  if (job)
+    _queued.fetch_sub(1);
+  return job;
+}
+
+void JobSystem::invoke(Job &job) {
+  if (job.range)
+    job.range(job.context, job.first, job.last);
+  else
+    job.function();
+  if (job.counter)
+    job.counter->_pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::execute(Job *job) {
+  invoke(*job);
+  std::lock_guard lock{_jobPoolMutex};
+  _jobPool.destroy(job);
+}
+
+void JobSystem::workerLoop(size_t index) {
+  currentWorker = {this, index};
+  int spins{};
+  while (!_stopping) {
+    if (auto job{findJob(index)}) {
+      execute(job);
+      spins = 0;
+    } else if (++spins < spinsBeforeSleep) {
+      std::this_thread::yield();
+    } else {
+      std::unique_lock lock{_sleepMutex};
+      ++_sleepers;
+      _wake.wait(lock, [&] { return _queued.load() > 0 || _stopping; });
+      --_sleepers;
+      spins = 0;
+    }
+  }
+}
+
+void benchmarkJobSystem(size_t maxThreads) {
+  auto cores{defaultThreadCount()};
+  if (!maxThreads)
+    maxThreads = cores;
+  constexpr size_t itemCount{1 << 22}, grain{1 << 10};
+  std::vector<float> results(itemCount);
+
+  double baseline{};
+  for (size_t threads{1}; threads <= std::min<size_t>(maxThreads, 64);
+       threads *= 2) {
+    JobSystem jobs{threads};
+    auto start{std::chrono::steady_clock::now()};
+    jobs.parallelFor(0, itemCount, grain, [&](size_t first, size_t last) {
+      for (auto i{first}; i < last; ++i) {
+        auto x{float(i)};
+        for (int step{}; step < 32; ++step)
+          x = std::sqrt(x + 1.0f);
+        results[i] = x;
+      }
+    });
+    std::chrono::duration<double, std::milli> elapsed{
+        std::chrono::steady_clock::now() - start};
+    if (threads == 1)
+      baseline = elapsed.count();
+    std::printf("%2zu threads: %8.2f ms, %7.1f M items/s, %.2fx%s\n", threads,
+                elapsed.count(), double(itemCount) / elapsed.count() / 1e3,
+                baseline / elapsed.count(),
+                threads > cores ? " (oversubscribed)" : "");
+  }
+}
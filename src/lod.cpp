@@ -0,0 +1,377 @@
+#include "lod.hpp"
+#include "mesh_optimizer.hpp"
+
+#include "glm/geometric.hpp"
+#include "glm/trigonometric.hpp"
+#include "glm/vec3.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+// Symmetric 4x4 quadric, upper triangle only.
+struct Quadric {
+  double xx{}, xy{}, xz{}, xw{}, yy{}, yz{}, yw{}, zz{}, zw{}, ww{};
+
+  static Quadric plane(glm::dvec3 n, double d) {
+    return {n.x * n.x, n.x * n.y, n.x * n.z, n.x * d, n.y * n.y,
+            n.y * n.z, n.y * d,   n.z * n.z, n.z * d, d * d};
+  }
+
+  Quadric &operator+=(const Quadric &q) {
+    xx += q.xx, xy += q.xy, xz += q.xz, xw += q.xw, yy += q.yy;
+    yz += q.yz, yw += q.yw, zz += q.zz, zw += q.zw, ww += q.ww;
+    return *this;
+  }
+
+  // Sum of squared distances from p to the accumulated planes.
+  double evaluate(glm::dvec3 p) const {
+    return xx * p.x * p.x + yy * p.y * p.y + zz * p.z * p.z +
+           2 * (xy * p.x * p.y + xz * p.x * p.z + yz * p.y * p.z) +
+           2 * (xw * p.x + yw * p.y + zw * p.z) + ww;
+  }
+};
+
+struct Collapse {
+  uint32_t from, to;
+  double cost;
+};
+
+class Simplifier {
+public:
+  explicit Simplifier(const Mesh &mesh)
+      : _mesh{mesh}, _canonical(mesh.vertices.size()),
+        _nextSibling(mesh.vertices.size()), _quadrics(mesh.vertices.size()) {
+    // Vertices that share a position but differ in normal or UV sit on an
+    // attribute seam; they are linked into a ring of siblings.
+    struct PositionHash {
+      size_t operator()(const glm::vec3 &p) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof bits);
+        return size_t(bits[0] * 73856093u ^ bits[1] * 19349663u ^
+                      bits[2] * 83492791u);
+      }
+    };
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> byPosition;
+    for (uint32_t v{}; v < mesh.vertices.size(); ++v) {
+      auto [found, inserted]{byPosition.try_emplace(mesh.vertices[v].position, v)};
+      auto first{found->second};
+      _canonical[v] = first;
+      _nextSibling[v] = inserted ? v : _nextSibling[first];
+      _nextSibling[first] = v;
+    }
+
+    for (size_t i{}; i + 2 < mesh.indices.size(); i += 3) {
+      auto a{glm::dvec3(position(mesh.indices[i]))};
+      auto b{glm::dvec3(position(mesh.indices[i + 1]))};
+      auto c{glm::dvec3(position(mesh.indices[i + 2]))};
+      auto normal{glm::cross(b - a, c - a)};
+      auto length{glm::length(normal)};
+      if (length == 0)
+        continue;
+      normal /= length;
+      auto q{Quadric::plane(normal, -glm::dot(normal, a))};
+      for (size_t corner{}; corner < 3; ++corner)
+        _quadrics[_canonical[mesh.indices[i + corner]]] += q;
+    }
+  }
+
+  float error() const { return float(std::sqrt(_maxCost)); }
+
+  // Collapses edges of one submesh until it has at most targetTriangles.
+  std::vector<uint32_t> simplify(std::vector<uint32_t> indices,
+                                 size_t targetTriangles) {
+    auto locked{lockedVertices(indices)};
+    std::vector<uint32_t> remap(_mesh.vertices.size());
+    std::vector<bool> touched(_mesh.vertices.size());
+    std::vector<Collapse> moves;
+
+    while (indices.size() / 3 > targetTriangles) {
+      auto collapses{candidateCollapses(indices, locked)};
+      std::sort(collapses.begin(), collapses.end(),
+                [](const Collapse &a, const Collapse &b) {
+                  return a.cost < b.cost;
+                });
+      auto adjacency{triangleAdjacency(indices)};
+
+      std::iota(remap.begin(), remap.end(), 0u);
+      std::fill(touched.begin(), touched.end(), false);
+      size_t removed{}, budget{indices.size() / 3 - targetTriangles};
+      for (auto &collapse : collapses) {
+        auto blocked{[&](const Collapse &move) {
+          return locked[move.from] || touched[move.from] ||
+                 touched[move.to] || flips(indices, adjacency, move);
+        }};
+        if (!siblingMoves(indices, adjacency, collapse, moves) ||
+            std::any_of(moves.begin(), moves.end(), blocked))
+          continue;
+        _quadrics[_canonical[collapse.to]] +=
+            _quadrics[_canonical[collapse.from]];
+        _maxCost = std::max(_maxCost, collapse.cost);
+        for (auto &move : moves) {
+          remap[move.from] = move.to;
+          // Freeze the whole neighbourhood so later collapses in this pass
+          // are checked against up-to-date triangles.
+          for (auto t : adjacency[move.from]) {
+            bool collapsed{};
+            for (size_t corner{}; corner < 3; ++corner) {
+              collapsed |= indices[t * 3 + corner] == move.to;
+              touched[indices[t * 3 + corner]] = true;
+            }
+            removed += collapsed;
+          }
+        }
+        if (removed >= budget)
+          break;
+      }
+      if (removed == 0)
+        break;
+
+      size_t written{};
+      for (size_t i{}; i < indices.size(); i += 3) {
+        uint32_t a{remap[indices[i]]}, b{remap[indices[i + 1]]},
+            c{remap[indices[i + 2]]};
+        if (a == b || b == c || c == a)
+          continue;
+        indices[written++] = a, indices[written++] = b, indices[written++] = c;
+      }
+      indices.resize(written);
+    }
+    return indices;
+  }
+
+private:
+  const glm::vec3 &position(uint32_t v) const {
+    return _mesh.vertices[v].position;
+  }
+
+  // Vertices on an open border of this index range, and seam vertices with
+  // a sibling outside it, which could not be moved along.
+  std::vector<bool> lockedVertices(const std::vector<uint32_t> &indices) const {
+    std::vector<bool> locked(_mesh.vertices.size()),
+        present(_mesh.vertices.size());
+    for (auto v : indices)
+      present[v] = true;
+    for (uint32_t v{}; v < locked.size(); ++v)
+      for (auto s{_nextSibling[v]}; s != v && !locked[v]; s = _nextSibling[s])
+        locked[v] = !present[s];
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    auto edgeKey{[&](uint32_t a, uint32_t b) {
+      a = _canonical[a], b = _canonical[b];
+      return uint64_t(std::min(a, b)) << 32 | std::max(a, b);
+    }};
+    for (size_t i{}; i < indices.size(); i += 3)
+      for (size_t e{}; e < 3; ++e)
+        ++edgeUses[edgeKey(indices[i + e], indices[i + (e + 1) % 3])];
+    for (size_t i{}; i < indices.size(); i += 3)
+      for (size_t e{}; e < 3; ++e) {
+        auto a{indices[i + e]}, b{indices[i + (e + 1) % 3]};
+        if (edgeUses[edgeKey(a, b)] == 1)
+          locked[a] = locked[b] = true;
+      }
+    return locked;
+  }
+
+  std::vector<Collapse> candidateCollapses(const std::vector<uint32_t> &indices,
+                                           const std::vector<bool> &locked) {
+    std::vector<Collapse> collapses;
+    for (size_t i{}; i < indices.size(); i += 3)
+      for (size_t e{}; e < 3; ++e) {
+        auto a{indices[i + e]}, b{indices[i + (e + 1) % 3]};
+        // Each interior edge shows up twice, once from either side; only
+        // the a -> b direction is considered from this side.
+        if (locked[a])
+          continue;
+        auto q{_quadrics[_canonical[a]]};
+        q += _quadrics[_canonical[b]];
+        collapses.push_back({a, b, q.evaluate(glm::dvec3(position(b)))});
+      }
+    return collapses;
+  }
+
+  std::vector<std::vector<uint32_t>>
+  triangleAdjacency(const std::vector<uint32_t> &indices) const {
+    std::vector<std::vector<uint32_t>> adjacency(_mesh.vertices.size());
+    for (size_t i{}; i < indices.size(); ++i)
+      adjacency[indices[i]].push_back(uint32_t(i / 3));
+    return adjacency;
+  }
+
+  // A seam vertex only moves along with its siblings, each onto the vertex
+  // at the target position on its own side of the seam, which keeps the
+  // seam closed and its attributes apart. That takes an edge towards the
+  // target from every sibling, so seams collapse along themselves only.
+  // Fills moves with the collapse of every sibling, the given one first.
+  bool siblingMoves(const std::vector<uint32_t> &indices,
+                    const std::vector<std::vector<uint32_t>> &adjacency,
+                    const Collapse &collapse,
+                    std::vector<Collapse> &moves) const {
+    moves.assign(1, collapse);
+    auto target{_canonical[collapse.to]};
+    if (target == _canonical[collapse.from])
+      return false;
+    for (auto s{_nextSibling[collapse.from]}; s != collapse.from;
+         s = _nextSibling[s]) {
+      auto partner{noVertex};
+      for (auto t : adjacency[s])
+        for (size_t corner{}; corner < 3; ++corner)
+          if (auto v{indices[t * 3 + corner]}; _canonical[v] == target)
+            partner = v;
+      if (partner == noVertex)
+        return false;
+      moves.push_back({s, partner, collapse.cost});
+    }
+    return true;
+  }
+
+  // Whether moving collapse.from onto collapse.to turns any of the
+  // surviving triangles around it over.
+  bool flips(const std::vector<uint32_t> &indices,
+             const std::vector<std::vector<uint32_t>> &adjacency,
+             const Collapse &collapse) const {
+    for (auto t : adjacency[collapse.from]) {
+      glm::vec3 before[3], after[3];
+      bool degenerate{};
+      for (size_t corner{}; corner < 3; ++corner) {
+        auto v{indices[t * 3 + corner]};
+        degenerate |= v == collapse.to;
+        before[corner] = position(v);
+        after[corner] = v == collapse.from ? position(collapse.to) : before[corner];
+      }
+      if (degenerate)
+        continue;
+      auto n0{glm::cross(before[1] - before[0], before[2] - before[0])};
+      auto n1{glm::cross(after[1] - after[0], after[2] - after[0])};
+      if (glm::dot(n0, n1) <= 0)
+        return true;
+    }
+    return false;
+  }
+
+  static constexpr uint32_t noVertex{~uint32_t{}};
+
+  const Mesh &_mesh;
+  std::vector<uint32_t> _canonical, _nextSibling;
+  std::vector<Quadric> _quadrics;
+  double _maxCost{};
+};
+} // namespace
+
+std::vector<MeshLod> generateLods(Mesh &mesh, const LodSettings &settings) {
+  std::vector<MeshLod> lods{{0, mesh.submeshes}};
+  std::vector<std::vector<uint32_t>> previous;
+  for (auto &submesh : mesh.submeshes)
+    previous.emplace_back(mesh.indices.begin() + submesh.firstIndex,
+                          mesh.indices.begin() + submesh.firstIndex +
+                              submesh.indexCount);
+
+  Simplifier simplifier{mesh};
+  while (lods.size() < settings.levelCount) {
+    size_t before{}, after{};
+    std::vector<std::vector<uint32_t>> current;
+    for (auto &indices : previous) {
+      auto target{size_t(float(indices.size() / 3) * settings.reduction)};
+      current.push_back(simplifier.simplify(indices, target));
+      before += indices.size(), after += current.back().size();
+    }
+    // Not worth a level of its own if it barely saves anything.
+    if (after == 0 || after * 10 > before * 9)
+      break;
+
+    MeshLod lod{simplifier.error(), {}};
+    for (size_t s{}; s < current.size(); ++s) {
+      lod.submeshes.push_back({uint32_t(mesh.indices.size()),
+                               uint32_t(current[s].size()),
+                               mesh.submeshes[s].material});
+      mesh.indices.insert(mesh.indices.end(), current[s].begin(),
+                          current[s].end());
+    }
+    lods.push_back(std::move(lod));
+    previous = std::move(current);
+  }
+  return lods;
+}
+
+float projectedLodError(float error, float distance,
+                        const LodSelectionSettings &settings) {
+  auto pixelsPerUnit{settings.viewportHeight /
+                     (2 * std::tan(settings.fovY / 2) *
+                      std::max(distance, 1e-6f))};
+  return error * pixelsPerUnit;
+}
+
+size_t selectLod(const std::vector<MeshLod> &lods, float distance, float scale,
+                 const LodSelectionSettings &settings, size_t currentLevel) {
+  auto projected{[&](size_t level) {
+    return projectedLodError(lods[level].error * scale, distance, settings);
+  }};
+  currentLevel = std::min(currentLevel, lods.size() - 1);
+
+  size_t target{};
+  while (target + 1 < lods.size() &&
+         projected(target + 1) <= settings.pixelThreshold)
+    ++target;
+
+  auto margin{settings.pixelThreshold * settings.hysteresis};
+  if (target > currentLevel) {
+    while (target > currentLevel &&
+           projected(target) > settings.pixelThreshold - margin)
+      --target;
+    return target;
+  }
+  if (target < currentLevel &&
+      projected(currentLevel) <= settings.pixelThreshold + margin)
+    return currentLevel;
+  return target;
+}
+
+void benchmarkLodSelection(const std::filesystem::path &objPath) {
+  auto mesh{loadObj(objPath)};
+  weldVertices(mesh);
+  auto lods{generateLods(mesh)};
+  for (size_t level{}; level < lods.size(); ++level) {
+    size_t triangles{};
+    for (auto &submesh : lods[level].submeshes)
+      triangles += submesh.indexCount / 3;
+    std::printf("level %zu: %zu triangles, error %g\n", level, triangles,
+                lods[level].error);
+  }
+  if (lods.size() < 2 || lods.back().error <= 0) {
+    std::printf("nothing to select between\n");
+    return;
+  }
+
+  LodSelectionSettings settings{glm::radians(60.0f), 1080};
+  auto margin{settings.pixelThreshold * settings.hysteresis};
+  auto projected{[&](size_t level, float distance) {
+    return projectedLodError(lods[level].error, distance, settings);
+  }};
+  // Far enough for the coarsest level's error to clear the threshold by
+  // twice the margin.
+  auto farthest{projectedLodError(lods.back().error, 1, settings) /
+                (settings.pixelThreshold - 2 * margin)};
+  auto nearest{farthest / 1000};
+
+  size_t level{}, steps{}, outOfBounds{};
+  auto step{[&](float distance) {
+    auto picked{selectLod(lods, distance, 1, settings, level)};
+    if (picked != level)
+      std::printf("%8.3f: level %zu -> %zu\n", distance, level, picked);
+    level = picked;
+    ++steps;
+    outOfBounds += (level > 0 && projected(level, distance) >
+                                     settings.pixelThreshold + margin) ||
+                   (level + 1 < lods.size() &&
+                    projected(level + 1, distance) <=
+                        settings.pixelThreshold - margin);
+  }};
+  for (auto distance{nearest}; distance < farthest; distance *= 1.01f)
+    step(distance);
+  for (auto distance{farthest}; distance > nearest; distance /= 1.01f)
+    step(distance);
+  std::printf("%zu/%zu picks out of bounds\n", outOfBounds, steps);
+}
@@ -1,12 +1,203 @@
+#include "anti_aliasing.hpp"
+#include "asset_cache.hpp"
+#include "asset_pack.hpp"
+#include "bvh.hpp"
+#include "clustered_lighting.hpp"
+#include "culling.hpp"
+#include "dynamic_resolution.hpp"
+#include "frame_allocator.hpp"
+#include "frame_capture.hpp"
 #include "gl_util.hpp"
+#include "golden.hpp"
+#include "gpu_scene.hpp"
+#include "intro_triangle.hpp"
+#include "lod.hpp"
+#include "meshlet.hpp"
+#include "occlusion.hpp"
+#include "pack_renderer.hpp"
+#include "path_tracer.hpp"
+#include "scene.hpp"
+#include "shadow_maps.hpp"
+#include "simd_transform.hpp"
+#include "software_rasterizer.hpp"
 #include "window.hpp"
 
-int main() {
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+int main(int argc, char **argv) {
+  // Modo offline: "--bake <pack> <assets...>" empacota os assets e sai
+  if (argc > 2 && std::string_view{argv[1]} == "--bake") {
+    bakeAssetPack({argv + 3, argv + argc}, argv[2], {});
+    return 0;
+  }
+  // "--import <pasta> <cache>" atualiza os artefatos de toda a pasta
+  if (argc > 3 && std::string_view{argv[1]} == "--import") {
+    AssetCache cache{argv[3]};
+    JobSystem jobs;
+    importAssetTree(argv[2], cache, {}, jobs);
+    return 0;
+  }
+  // "--bench-simd" compara os kernels SIMD com o glm escalar
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-simd") {
+    benchmarkSimdTransforms(1 << 14);
+    return 0;
+  }
+  // "--bench-jobs [threads]" mede a escalabilidade do sistema de jobs, at
+  // threads threads (por padro, um por ncleo)
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-jobs") {
+    benchmarkJobSystem(argc > 2 ? std::stoul(argv[2]) : 0);
+    return 0;
+  }
+  // "--bench-cull" mede o frustum culling de 1M objetos
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-cull") {
+    JobSystem jobs;
+    benchmarkFrustumCulling(1 << 20, &jobs);
+    return 0;
+  }
+  // "--bench-scene" mede a atualizao das matrizes de 1M ns da cena
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-scene") {
+    JobSystem jobs;
+    benchmarkScene(1 << 20, &jobs);
+    return 0;
+  }
+  // "--bench-occlusion" mede o occlusion culling numa grade de salas
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-occlusion") {
+    JobSystem jobs;
+    benchmarkOcclusionCulling(&jobs);
+    return 0;
+  }
+  // "--bench-lights" mede a iluminao em clusters de 10 a 10000 luzes
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-lights") {
+    benchmarkClusteredLighting();
+    return 0;
+  }
+  // "--bench-shadows" mede as shadow maps em cascata, com e sem cache
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-shadows") {
+    benchmarkShadowMaps();
+    return 0;
+  }
+  // "--bench-resolution" mede os tempos de quadro sob carga varivel, com e
+  // sem resoluo dinmica
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-resolution") {
+    benchmarkDynamicResolution();
+    return 0;
+  }
+  // "--bench-aa" mede o custo de cada modo de anti-aliasing
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-aa") {
+    benchmarkAntiAliasing();
+    return 0;
+  }
+  // "--bench-gpu-scene" mede o envio das mudanas da cena para a GPU e
+  // confere o resultado
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-gpu-scene") {
+    benchmarkGpuScene();
+    return 0;
+  }
+  // "--bench-pick" mede os raios de seleo com o cursor numa cena de 10
+  // milhes de tringulos
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-pick") {
+    benchmarkPicking();
+    return 0;
+  }
+  // "--bench-lod <obj>" gera os LODs do modelo e testa a escolha de nvel
+  // conforme a distncia
+  if (argc > 2 && std::string_view{argv[1]} == "--bench-lod") {
+    benchmarkLodSelection(argv[2]);
+    return 0;
+  }
+  // "--bench-meshlets <obj>" divide o modelo em meshlets e mede o culling
+  // deles na GPU, conferindo se nenhum visvel foi descartado
+  if (argc > 2 && std::string_view{argv[1]} == "--bench-meshlets") {
+    benchmarkMeshletCulling(argv[2]);
+    return 0;
+  }
+  // "--path-trace <sada.ppm> [amostras] [obj]" gera uma imagem de
+  // referncia na CPU; sem obj, de uma Cornell box
+  if (argc > 2 && std::string_view{argv[1]} == "--path-trace") {
+    JobSystem jobs;
+    auto mesh{argc > 4 ? loadObj(argv[4]) : Mesh{}};
+    renderReferenceImage(argc > 4 ? &mesh : nullptr, argv[2],
+                         argc > 3 ? std::stoul(argv[3]) : 64, &jobs);
+    return 0;
+  }
+  // "--raster <sada.ppm> [t]" desenha o tringulo na CPU, sem GPU
+  if (argc > 2 && std::string_view{argv[1]} == "--raster") {
+    JobSystem jobs;
+    SoftwareRasterizer rasterizer{900, 900};
+    renderIntroTriangle(rasterizer, argc > 3 ? std::stof(argv[3]) : 0, &jobs);
+    rasterizer.image().savePpm(argv[2]);
+    return 0;
+  }
+  // "--bench-raster" mede os quadros por segundo do rasterizador na CPU
+  if (argc > 1 && std::string_view{argv[1]} == "--bench-raster") {
+    JobSystem jobs;
+    benchmarkSoftwareRasterizer(&jobs);
+    return 0;
+  }
+
+  // "--golden <referncias> [relatrio.json] [cenas...]" renderiza as cenas
+  // de teste (todas, se nenhuma for dada) fora da tela e compara com as
+  // referncias; "--golden-update <referncias>" as regrava. Sai com 1 se
+  // alguma cena falhar
+  if (argc > 2 && (std::string_view{argv[1]} == "--golden" ||
+                   std::string_view{argv[1]} == "--golden-update")) {
+    GoldenTestOptions options;
+    options.referenceDirectory = argv[2];
+    if (argc > 3)
+      options.reportPath = argv[3];
+    options.scenes.assign(argv + std::min(argc, 4), argv + argc);
+    options.updateReferences = std::string_view{argv[1]} == "--golden-update";
+    return runGoldenTests(options) ? 0 : 1;
+  }
+
   constexpr size_t w{900}, h{900};
   Window window{w, h, "Computer Graphics Intro"};
 
   window.show();
 
+  // F12 salva uma captura de tela; "--record <vdeo.y4m>" grava todos os
+  // quadros. A leitura  assncrona e no trava a GPU
+  FrameCapture capture{w, h};
+  if (argc > 2 && std::string_view{argv[1]} == "--record")
+    capture.startRecording(argv[2]);
+  bool f12WasPressed{};
+
+  // A cena  desenhada fora da tela, numa resoluo ajustada a cada quadro
+  // para caber em 60 quadros por segundo, e depois esticada sobre a janela
+  DynamicResolution resolution{w, h};
+
+  // "--aa <modo>" escolhe o anti-aliasing (off, msaa2, msaa4, msaa8, fxaa ou
+  // taa); F10 alterna entre eles durante a execuo
+  auto antiAliasingMode{AntiAliasingMode::Fxaa};
+  for (int i{1}; i + 1 < argc; ++i)
+    if (std::string_view{argv[i]} == "--aa")
+      antiAliasingMode = parseAntiAliasingMode(argv[i + 1]);
+  AntiAliasing antiAliasing{w, h, antiAliasingMode};
+  bool f10WasPressed{};
+  constexpr glm::vec3 background{1, 1, 1};
+
+  // "--view <pacote>" desenha os modelos de um pacote gerado por --bake no
+  // lugar do tringulo, com a cmera girando em volta deles
+  std::optional<AssetPack> pack;
+  std::optional<PackRenderer> packRenderer;
+  bool clickWasPressed{}, f9WasPressed{};
+  for (int i{1}; i + 1 < argc; ++i)
+    if (std::string_view{argv[i]} == "--view") {
+      pack.emplace(argv[i + 1]);
+      packRenderer.emplace(*pack);
+      packRenderer->setBackground(background);
+      std::printf("%zu draws, %zu texture binds per frame\n",
+                  packRenderer->drawCount(), packRenderer->textureBinds());
+    }
+
   // Contm as posies dos vrtices dos tringulos
   // Atualmente possui somente 3 vrtices, ento s compe 1 tringulo
   constexpr float pi{3.1415926535}, r{0.5};
@@ -42,50 +233,11 @@ int main() {
   glCheck(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr)); // Diz que a localizao 1 dentro do vetor de vrtices vai conter as cores
   glCheck(glEnableVertexAttribArray(1)); // Ativa a localizao 1 do vetor de vrtices
 
-  // Um shader de vrtices bsico
-  constexpr auto vsSrc{R"(
-    #version 460
-
-    layout (location = 0) in vec3 position;
-    layout (location = 1) in vec3 color;
-
-    uniform float t;
-
-    out vec3 vertexColor;
-
-    void main(void) {
-      float c = cos(t), s = sin(t);
-      vec3 p = mat3(
-        c, -s, 0,
-        s,  c, 0,
-        0,  0, 1
-      ) * position;
-      gl_Position = vec4(p, 1);
-      vertexColor = color;
-    }
-  )"};
-
-  // Um shader de fragmentos bsico
-  constexpr auto fsSrc{R"(
-    #version 460
-
-    #extension GL_NV_fragment_shader_barycentric : require
-
-    in vec3 vertexColor;
-
-    out vec4 fragmentColor;
-
-    void main(void) {
-      const float epsilon = 0.01;
-      fragmentColor = vec4(vertexColor, 1);
-      vec3 b = gl_BaryCoordNV;
-      if (b.x < epsilon || b.y < epsilon || b.z < epsilon
-          || abs(b.x - b.y) < 10.0 * epsilon
-          && abs(b.x - b.z) < 10.0 * epsilon
-          && abs(b.y - b.z) < 10.0 * epsilon)
-        fragmentColor = 0.25 * (fragmentColor * fragmentColor + 2.0 * sqrt(2.0 * fragmentColor));
-    }
-  )"};
+  // Um shader de vrtices bsico e um de fragmentos; ficam em
+  // intro_triangle.cpp para que os testes de imagem (--golden) desenhem
+  // exatamente o mesmo tringulo
+  auto vsSrc{introTriangleVertexShaderSource};
+  auto fsSrc{introTriangleFragmentShaderSource};
 
   auto vs{glCreateShader(GL_VERTEX_SHADER)}; // Cria uma ID para o shader de vrtices
   glCheck(glShaderSource(vs, 1, &vsSrc, nullptr)); // Diz que a string em vsSrc vai ser o cdigo do shader de vrtices
@@ -108,13 +260,104 @@ int main() {
   glCheck(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL)); // Diz que tringulos tero seus interiores preenchidos
 
   auto tLoc{glGetUniformLocation(program, "t")};
+  auto previousTLoc{glGetUniformLocation(program, "previousT")};
+  auto jitterLoc{glGetUniformLocation(program, "jitter")};
+
+  // Memria temporria de cada quadro; os primeiros quadros podem alocar no
+  // heap, os demais no devem (em debug, um assert dispara se alocarem).
+  // Trocar de modo (F9, F10) recomea o aquecimento, j que o driver pode
+  // compilar shaders no primeiro uso
+  FrameArena frameArena{1 << 20};
+  constexpr uint64_t warmupFrames{3};
+  uint64_t steadyAfter{warmupFrames};
+
+  // Redimensionar a janela recria os buffers da captura, o que aloca; os
+  // eventos so tratados fora da guarda e recomeam o aquecimento
+  window.setFramebufferSizeCallback([&](size_t width, size_t height) {
+    auto wasRecording{capture.isRecording()};
+    capture.resize(width, height);
+    if (wasRecording && !capture.isRecording())
+      std::printf("recording stopped: the window was resized\n");
+    steadyAfter = frameArena.frame() + warmupFrames;
+  });
 
   float t = 0;
   while (!window.shouldClose()) {
-    glCheck(glClearColor(1, 1, 1, 1)); // Define a cor de fundo da janela
-    glCheck(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)); // Limpa a janela usando a cor de fundo
-    glCheck(glDrawArrays(GL_TRIANGLES, 0, 9)); // Desenha os vrtices usando os buffers e shaders
-    glCheck(glUniform1f(tLoc, t));
+    // Reporta os quadros estveis anteriores que alocaram no heap
+    auto steady{frameArena.frame() > steadyAfter};
+    frameArena.nextFrame();
+    if (auto &stats{frameArena.lastFrameStats()};
+        steady && stats.heapAllocations > 0)
+      std::printf("frame %llu: %zu heap allocations (%zu bytes)\n",
+                  (unsigned long long)frameArena.frame() - 1,
+                  stats.heapAllocations, stats.heapBytes);
+    std::optional<HeapAllocationGuard> noHeapAllocations;
+    noHeapAllocations.emplace(frameArena.frame() > steadyAfter);
+    resolution.resize(window.width(), window.height());
+    resolution.beginFrame();
+    antiAliasing.resize(window.width(), window.height());
+    antiAliasing.beginFrame(glm::vec4{background, 1}); // Limpa a cena usando a cor de fundo
+    if (packRenderer) {
+      // A cmera gira em volta dos modelos, olhando para o centro deles
+      auto center{(packRenderer->boundsMin() + packRenderer->boundsMax()) / 2.0f};
+      auto radius{std::max(glm::length(packRenderer->boundsMax() - packRenderer->boundsMin()), 1e-3f)};
+      auto eye{center + radius * glm::vec3{std::sin(0.3f * t), 0.4f, std::cos(0.3f * t)}};
+      auto near{0.01f * radius}, far{4 * radius};
+      auto view{glm::lookAt(eye, center, glm::vec3{0, 1, 0})};
+      auto projection{glm::perspective(glm::radians(60.0f), float(resolution.renderWidth()) / float(resolution.renderHeight()), near, far)};
+      packRenderer->draw(view, projection, near, far, resolution.renderWidth(), resolution.renderHeight(), antiAliasing.jitter(glm::mat4{1}), frameArena.current());
+      // Um clique seleciona o modelo sob o cursor, por um raio pela BVH
+      if (auto click{window.mouseButtonIsPressed(GLFW_MOUSE_BUTTON_LEFT)}; click != clickWasPressed) {
+        if (click) {
+          auto [x, y]{window.getCursorPos()};
+          auto hit{packRenderer->pick(pickingRay({x, y}, {window.width(), window.height()}, view, projection))};
+          if (hit.instance != RayHit::none)
+            std::printf("picked %s, triangle %u, %g away\n", packRenderer->instanceName(hit.instance).c_str(), hit.triangle, hit.t);
+          else
+            std::printf("picked nothing\n");
+        }
+        clickWasPressed = click;
+      }
+    } else {
+      glCheck(glUseProgram(program)); // endFrame() troca o programa e o vetor de vrtices
+      glCheck(glBindVertexArray(vao));
+      glCheck(glUniformMatrix4fv(jitterLoc, 1, GL_FALSE, glm::value_ptr(antiAliasing.jitter(glm::mat4{1})))); // Desloca a cena em menos de um pixel, no TAA
+      glCheck(glDrawArrays(GL_TRIANGLES, 0, 3)); // Desenha os vrtices usando os buffers e shaders
+      glCheck(glUniform1f(tLoc, t));
+      glCheck(glUniform1f(previousTLoc, t - 0.01f));
+    }
+    antiAliasing.endFrame();
+    resolution.endFrame(); // O que vier depois daqui fica na resoluo da janela
+    // F9 troca o pacote entre o shading forward e o deferred
+    if (auto f9{window.keyIsPressed(GLFW_KEY_F9)}; f9 != f9WasPressed) {
+      if (f9 && packRenderer) {
+        packRenderer->setShadingPath(packRenderer->shadingPath() == ShadingPath::Forward ? ShadingPath::Deferred : ShadingPath::Forward);
+        std::printf("shading: %s\n", shadingPathName(packRenderer->shadingPath()));
+        steadyAfter = frameArena.frame() + warmupFrames;
+      }
+      f9WasPressed = f9;
+    }
+    if (auto f10{window.keyIsPressed(GLFW_KEY_F10)}; f10 != f10WasPressed) {
+      if (f10) {
+        auto next{std::find(std::begin(antiAliasingModes),
+                            std::end(antiAliasingModes), antiAliasing.mode()) +
+                  1};
+        antiAliasing.setMode(next == std::end(antiAliasingModes)
+                                 ? antiAliasingModes[0]
+                                 : *next);
+        std::printf("anti-aliasing: %s\n",
+                    antiAliasingModeName(antiAliasing.mode()));
+        steadyAfter = frameArena.frame() + warmupFrames;
+      }
+      f10WasPressed = f10;
+    }
+    if (auto f12{window.keyIsPressed(GLFW_KEY_F12)}; f12 != f12WasPressed) {
+      if (f12)
+        capture.takeScreenshot();
+      f12WasPressed = f12;
+    }
+    capture.endFrame();
+    noHeapAllocations.reset();
     window.swapBuffers();
     window.pollEvents();
     t += 0.01;
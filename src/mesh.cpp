@@ -0,0 +1,252 @@
+#include "mesh.hpp"
+
+#include "glm/geometric.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+std::string readFile(const std::filesystem::path &path) {
+  std::ifstream in{path, std::ios::binary};
+  if (!in)
+    throw std::runtime_error{"could not open " + path.string()};
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+// Cursor over one line of an OBJ/MTL file.
+class LineParser {
+public:
+  explicit LineParser(std::string_view line) : _line{line} {}
+
+  std::string_view word() {
+    skipSpaces();
+    auto end{_line.find_first_of(" \t", _position)};
+    if (end == std::string_view::npos)
+      end = _line.size();
+    auto result{_line.substr(_position, end - _position)};
+    _position = end;
+    return result;
+  }
+
+  // Everything left on the line, for names and paths that may hold spaces.
+  std::string_view rest() {
+    skipSpaces();
+    auto result{_line.substr(_position)};
+    while (!result.empty() && (result.back() == ' ' || result.back() == '\t'))
+      result.remove_suffix(1);
+    return result;
+  }
+
+  float number() {
+    auto text{word()};
+    float value{};
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+  }
+
+  std::string_view peek() {
+    auto position{_position};
+    auto result{word()};
+    _position = position;
+    return result;
+  }
+
+  bool numberAhead() {
+    auto text{peek()};
+    float value{};
+    return !text.empty() &&
+           std::from_chars(text.data(), text.data() + text.size(), value)
+                   .ptr == text.data() + text.size();
+  }
+
+  glm::vec3 vec3() {
+    auto x{number()}, y{number()}, z{number()};
+    return {x, y, z};
+  }
+
+private:
+  void skipSpaces() {
+    while (_position < _line.size() &&
+           (_line[_position] == ' ' || _line[_position] == '\t'))
+      ++_position;
+  }
+
+  std::string_view _line;
+  size_t _position{};
+};
+
+template <typename Fn> void forEachLine(std::string_view text, Fn fn) {
+  size_t start{};
+  while (start < text.size()) {
+    auto end{text.find('\n', start)};
+    if (end == std::string_view::npos)
+      end = text.size();
+    auto line{text.substr(start, end - start)};
+    if (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    fn(line);
+    start = end + 1;
+  }
+}
+
+// Resolves a 1-based (or negative, relative) OBJ index into a 0-based one.
+int resolveIndex(std::string_view text, size_t count) {
+  int index{};
+  std::from_chars(text.data(), text.data() + text.size(), index);
+  return index < 0 ? int(count) + index : index - 1;
+}
+// Texture map statement: options, each followed by up to three numbers,
+// then the file name.
+void parseMap(LineParser &parser, Material &material) {
+  while (!parser.peek().empty() && parser.peek()[0] == '-') {
+    auto option{parser.word()};
+    float values[3]{};
+    size_t count{};
+    while (count < 3 && parser.numberAhead())
+      values[count++] = parser.number();
+    if (option == "-o")
+      material.mapKdOffset = {values[0], values[1]};
+    else if (option == "-s")
+      material.mapKdScale = {count > 0 ? values[0] : 1,
+                             count > 1 ? values[1] : 1};
+    else if (option == "-clamp" && count == 0)
+      material.mapKdClamp = parser.word() == "on";
+    else if (count == 0)
+      parser.word(); // other on/off flags, such as -blendu
+  }
+  material.mapKd = parser.rest();
+}
+} // namespace
+
+std::vector<Material> loadMtl(const std::filesystem::path &mtlPath) {
+  auto text{readFile(mtlPath)};
+  std::vector<Material> materials;
+  forEachLine(text, [&](std::string_view line) {
+    LineParser parser{line};
+    auto keyword{parser.word()};
+    if (keyword == "newmtl") {
+      materials.push_back({});
+      materials.back().name = parser.rest();
+      return;
+    }
+    if (materials.empty() || keyword.empty() || keyword[0] == '#')
+      return;
+    auto &material{materials.back()};
+    if (keyword == "Ka")
+      material.ka = parser.vec3();
+    else if (keyword == "Kd")
+      material.kd = parser.vec3();
+    else if (keyword == "Ks")
+      material.ks = parser.vec3();
+    else if (keyword == "Ke")
+      material.ke = parser.vec3();
+    else if (keyword == "Ns")
+      material.ns = parser.number();
+    else if (keyword == "Ni")
+      material.ni = parser.number();
+    else if (keyword == "d")
+      material.d = parser.number();
+    else if (keyword == "Tr")
+      material.d = 1 - parser.number();
+    else if (keyword == "illum")
+      material.illum = int(parser.number());
+    else if (keyword == "map_Kd")
+      parseMap(parser, material);
+  });
+  return materials;
+}
+
+Mesh loadObj(const std::filesystem::path &objPath) {
+  auto text{readFile(objPath)};
+  std::vector<glm::vec3> positions, normals;
+  std::vector<glm::vec2> uvs;
+  Mesh mesh;
+
+  auto useMaterial{[&](uint32_t material) {
+    auto firstIndex{uint32_t(mesh.indices.size())};
+    if (!mesh.submeshes.empty() && mesh.submeshes.back().indexCount == 0)
+      mesh.submeshes.back().material = material;
+    else
+      mesh.submeshes.push_back({firstIndex, 0, material});
+  }};
+
+  forEachLine(text, [&](std::string_view line) {
+    LineParser parser{line};
+    auto keyword{parser.word()};
+    if (keyword == "v") {
+      positions.push_back(parser.vec3());
+    } else if (keyword == "vn") {
+      normals.push_back(parser.vec3());
+    } else if (keyword == "vt") {
+      auto u{parser.number()}, v{parser.number()};
+      uvs.push_back({u, v});
+    } else if (keyword == "mtllib") {
+      auto library{objPath.parent_path() / parser.rest()};
+      for (auto &material : loadMtl(library))
+        mesh.materials.push_back(std::move(material));
+    } else if (keyword == "usemtl") {
+      auto name{parser.rest()};
+      uint32_t material{};
+      while (material < mesh.materials.size() &&
+             mesh.materials[material].name != name)
+        ++material;
+      if (material == mesh.materials.size())
+        mesh.materials.emplace_back().name = name;
+      useMaterial(material);
+    } else if (keyword == "f") {
+      if (mesh.submeshes.empty()) {
+        if (mesh.materials.empty())
+          mesh.materials.emplace_back().name = "default";
+        useMaterial(0);
+      }
+      std::vector<Vertex> polygon;
+      bool hasNormals{true};
+      for (auto corner{parser.word()}; !corner.empty(); corner = parser.word()) {
+        Vertex vertex{};
+        auto slash{corner.find('/')};
+        vertex.position = positions.at(
+            size_t(resolveIndex(corner.substr(0, slash), positions.size())));
+        if (slash != std::string_view::npos) {
+          auto rest{corner.substr(slash + 1)};
+          auto secondSlash{rest.find('/')};
+          auto uv{rest.substr(0, secondSlash)};
+          if (!uv.empty())
+            vertex.uv = uvs.at(size_t(resolveIndex(uv, uvs.size())));
+          if (secondSlash != std::string_view::npos)
+            vertex.normal = normals.at(size_t(
+                resolveIndex(rest.substr(secondSlash + 1), normals.size())));
+          else
+            hasNormals = false;
+        } else {
+          hasNormals = false;
+        }
+        polygon.push_back(vertex);
+      }
+      if (polygon.size() < 3)
+        throw std::runtime_error{objPath.string() + " has a degenerate face"};
+      if (!hasNormals) {
+        auto n{glm::normalize(
+            glm::cross(polygon[1].position - polygon[0].position,
+                       polygon[2].position - polygon[0].position))};
+        for (auto &vertex : polygon)
+          vertex.normal = n;
+      }
+      for (size_t i{1}; i + 1 < polygon.size(); ++i)
+        for (auto corner : {size_t{0}, i, i + 1}) {
+          mesh.indices.push_back(uint32_t(mesh.vertices.size()));
+          mesh.vertices.push_back(polygon[corner]);
+        }
+      mesh.submeshes.back().indexCount =
+          uint32_t(mesh.indices.size()) - mesh.submeshes.back().firstIndex;
+    }
+  });
+
+  if (!mesh.submeshes.empty() && mesh.submeshes.back().indexCount == 0)
+    mesh.submeshes.pop_back();
+  return mesh;
+}
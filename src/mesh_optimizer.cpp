@@ -0,0 +1,256 @@
+#include "mesh_optimizer.hpp"
+
+#include "glm/geometric.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+struct VertexHash {
+  size_t operator()(const Vertex &v) const {
+    // FNV-1a over the raw bytes; welding is bitwise anyway.
+    auto bytes{reinterpret_cast<const unsigned char *>(&v)};
+    uint64_t hash{14695981039346656037ull};
+    for (size_t i{}; i < sizeof v; ++i)
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return size_t(hash);
+  }
+};
+
+struct VertexEqual {
+  bool operator()(const Vertex &a, const Vertex &b) const {
+    return std::memcmp(&a, &b, sizeof a) == 0;
+  }
+};
+
+// Triangles adjacent to each vertex, in compressed row form.
+struct Adjacency {
+  std::vector<uint32_t> offsets, triangles;
+
+  Adjacency(const uint32_t *indices, size_t indexCount, size_t vertexCount)
+      : offsets(vertexCount + 1), triangles(indexCount) {
+    for (size_t i{}; i < indexCount; ++i)
+      ++offsets[indices[i] + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i{}; i < indexCount; ++i)
+      triangles[fill[indices[i]]++] = uint32_t(i / 3);
+  }
+};
+
+// Tipsify over one run of triangles, writing the new order to out.
+void tipsify(const uint32_t *indices, size_t indexCount, size_t vertexCount,
+             size_t cacheSize, uint32_t *out) {
+  Adjacency adjacency{indices, indexCount, vertexCount};
+  std::vector<uint32_t> live(vertexCount);
+  for (size_t v{}; v < vertexCount; ++v)
+    live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+  std::vector<size_t> cacheTime(vertexCount);
+  std::vector<bool> emitted(indexCount / 3);
+  std::vector<uint32_t> deadEnd, candidates;
+  size_t time{cacheSize + 1}, cursor{}, written{};
+
+  auto nextLiveVertex{[&]() -> int64_t {
+    while (!deadEnd.empty()) {
+      auto v{deadEnd.back()};
+      deadEnd.pop_back();
+      if (live[v] > 0)
+        return v;
+    }
+    while (cursor < indexCount) {
+      auto v{indices[cursor++]};
+      if (live[v] > 0)
+        return v;
+    }
+    return -1;
+  }};
+
+  for (auto fanning{nextLiveVertex()}; fanning >= 0;) {
+    candidates.clear();
+    for (auto i{adjacency.offsets[size_t(fanning)]};
+         i < adjacency.offsets[size_t(fanning) + 1]; ++i) {
+      auto triangle{adjacency.triangles[i]};
+      if (emitted[triangle])
+        continue;
+      emitted[triangle] = true;
+      for (size_t corner{}; corner < 3; ++corner) {
+        auto v{indices[triangle * 3 + corner]};
+        out[written++] = v;
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if (time - cacheTime[v] > cacheSize)
+          cacheTime[v] = time++;
+      }
+    }
+
+    // Prefer the candidate that stays in the cache longest while still being
+    // able to emit all its remaining triangles before it is evicted.
+    int64_t best{-1};
+    size_t bestPriority{};
+    for (auto v : candidates) {
+      if (live[v] == 0)
+        continue;
+      size_t priority{};
+      if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+        priority = time - cacheTime[v];
+      if (best < 0 || priority > bestPriority)
+        best = v, bestPriority = priority;
+    }
+    fanning = best >= 0 ? best : nextLiveVertex();
+  }
+}
+
+// Splits a run of triangles into clusters wherever a FIFO cache simulation
+// misses on all three corners, i.e. where the cache effectively restarts.
+std::vector<size_t> cacheRestarts(const uint32_t *indices, size_t indexCount,
+                                  size_t vertexCount, size_t cacheSize) {
+  std::vector<size_t> cacheTime(vertexCount), starts;
+  size_t time{cacheSize + 1};
+  for (size_t t{}; t < indexCount / 3; ++t) {
+    size_t misses{};
+    for (size_t corner{}; corner < 3; ++corner) {
+      auto v{indices[t * 3 + corner]};
+      if (time - cacheTime[v] > cacheSize)
+        cacheTime[v] = time++, ++misses;
+    }
+    if (misses == 3 || t == 0)
+      starts.push_back(t);
+  }
+  starts.push_back(indexCount / 3);
+  return starts;
+}
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const Mesh &mesh, size_t cacheSize) {
+  std::vector<size_t> cacheTime(mesh.vertices.size());
+  std::vector<bool> referenced(mesh.vertices.size());
+  size_t time{cacheSize + 1}, misses{}, vertexCount{};
+  for (auto v : mesh.indices) {
+    if (time - cacheTime[v] > cacheSize)
+      cacheTime[v] = time++, ++misses;
+    if (!referenced[v])
+      referenced[v] = true, ++vertexCount;
+  }
+  auto triangleCount{mesh.indices.size() / 3};
+  return {triangleCount ? float(misses) / float(triangleCount) : 0,
+          vertexCount ? float(misses) / float(vertexCount) : 0};
+}
+
+void weldVertices(Mesh &mesh) {
+  std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> unique;
+  unique.reserve(mesh.vertices.size());
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> remap(mesh.vertices.size());
+  for (size_t v{}; v < mesh.vertices.size(); ++v) {
+    auto [found, inserted]{
+        unique.try_emplace(mesh.vertices[v], uint32_t(vertices.size()))};
+    if (inserted)
+      vertices.push_back(mesh.vertices[v]);
+    remap[v] = found->second;
+  }
+  for (auto &index : mesh.indices)
+    index = remap[index];
+  mesh.vertices = std::move(vertices);
+}
+
+void optimizeVertexCache(Mesh &mesh, size_t cacheSize) {
+  std::vector<uint32_t> reordered(mesh.indices.size());
+  for (auto &submesh : mesh.submeshes)
+    tipsify(&mesh.indices[submesh.firstIndex], submesh.indexCount,
+            mesh.vertices.size(), cacheSize, &reordered[submesh.firstIndex]);
+  mesh.indices = std::move(reordered);
+}
+
+void optimizeOverdraw(Mesh &mesh, size_t cacheSize) {
+  struct Cluster {
+    size_t first, last;
+    float occlusion;
+  };
+
+  std::vector<uint32_t> reordered(mesh.indices.size());
+  for (auto &submesh : mesh.submeshes) {
+    auto indices{&mesh.indices[submesh.firstIndex]};
+    auto triangleCount{submesh.indexCount / 3};
+    if (triangleCount == 0)
+      continue;
+
+    std::vector<glm::vec3> centroids(triangleCount), normals(triangleCount);
+    glm::vec3 meshCentroid{0};
+    float meshArea{};
+    for (size_t t{}; t < triangleCount; ++t) {
+      auto &a{mesh.vertices[indices[t * 3]].position};
+      auto &b{mesh.vertices[indices[t * 3 + 1]].position};
+      auto &c{mesh.vertices[indices[t * 3 + 2]].position};
+      normals[t] = glm::cross(b - a, c - a); // length is twice the area
+      centroids[t] = (a + b + c) / 3.0f;
+      auto area{glm::length(normals[t])};
+      meshCentroid += centroids[t] * area;
+      meshArea += area;
+    }
+    if (meshArea > 0)
+      meshCentroid /= meshArea;
+
+    auto starts{cacheRestarts(indices, submesh.indexCount,
+                              mesh.vertices.size(), cacheSize)};
+    std::vector<Cluster> clusters;
+    for (size_t c{}; c + 1 < starts.size(); ++c) {
+      glm::vec3 centroid{0}, normal{0};
+      float area{};
+      for (auto t{starts[c]}; t < starts[c + 1]; ++t) {
+        auto triangleArea{glm::length(normals[t])};
+        centroid += centroids[t] * triangleArea;
+        normal += normals[t];
+        area += triangleArea;
+      }
+      if (area > 0)
+        centroid /= area;
+      auto normalLength{glm::length(normal)};
+      auto occlusion{normalLength > 0 ? glm::dot(centroid - meshCentroid,
+                                                 normal / normalLength)
+                                      : 0.0f};
+      clusters.push_back({starts[c], starts[c + 1], occlusion});
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster &a, const Cluster &b) {
+                       return a.occlusion > b.occlusion;
+                     });
+
+    auto out{&reordered[submesh.firstIndex]};
+    for (auto &cluster : clusters)
+      out = std::copy(indices + cluster.first * 3, indices + cluster.last * 3,
+                      out);
+  }
+  mesh.indices = std::move(reordered);
+}
+
+void optimizeVertexFetch(Mesh &mesh) {
+  constexpr auto unused{~uint32_t{}};
+  std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+  std::vector<Vertex> vertices;
+  vertices.reserve(mesh.vertices.size());
+  for (auto &index : mesh.indices) {
+    if (remap[index] == unused) {
+      remap[index] = uint32_t(vertices.size());
+      vertices.push_back(mesh.vertices[index]);
+    }
+    index = remap[index];
+  }
+  mesh.vertices = std::move(vertices);
+}
+
+std::vector<MeshOptimizationStep> optimizeMesh(Mesh &mesh) {
+  std::vector<MeshOptimizationStep> steps{
+      {"imported", analyzeVertexCache(mesh)}};
+  weldVertices(mesh);
+  steps.push_back({"welded", analyzeVertexCache(mesh)});
+  optimizeVertexCache(mesh);
+  steps.push_back({"vertex cache", analyzeVertexCache(mesh)});
+  optimizeOverdraw(mesh);
+  steps.push_back({"overdraw", analyzeVertexCache(mesh)});
+  optimizeVertexFetch(mesh);
+  steps.push_back({"vertex fetch", analyzeVertexCache(mesh)});
+  return steps;
+}
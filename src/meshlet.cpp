@@ -0,0 +1,436 @@
+#include "meshlet.hpp"
+#include "gl_util.hpp"
+#include "mesh_optimizer.hpp"
+#include "shader.hpp"
+#include "window.hpp"
+
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/matrix.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+
+namespace {
+constexpr auto csSrc{R"(
+  #version 460
+
+  layout (local_size_x = 64) in;
+
+  struct Meshlet {
+    uint firstIndex, triangleCount, vertexCount, material;
+  };
+
+  struct Bounds {
+    vec4 sphere; // center, radius
+    vec4 cone;   // axis, cutoff
+  };
+
+  struct DrawCommand {
+    uint count, instanceCount, firstIndex;
+    int baseVertex;
+    uint baseInstance;
+  };
+
+  layout (std430, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+  layout (std430, binding = 1) readonly buffer BoundsBuffer { Bounds bounds[]; };
+  layout (std430, binding = 2) writeonly buffer Commands { DrawCommand commands[]; };
+  layout (std430, binding = 3) buffer Counters { uint drawCount, triangleCount; };
+
+  uniform mat4 model;
+  uniform vec3 objectCameraPosition;
+  uniform vec4 planes[6];
+  uniform float scale;
+  uniform uint meshletCount;
+
+  void main(void) {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= meshletCount)
+      return;
+
+    vec3 center = (model * vec4(bounds[i].sphere.xyz, 1)).xyz;
+    float radius = bounds[i].sphere.w * scale;
+    for (int p = 0; p < 6; ++p)
+      if (dot(planes[p].xyz, center) + planes[p].w < -radius)
+        return;
+
+    // In object space, where the cone was built: a non-uniform scale would
+    // tilt its axis (the inverse transpose takes care of that) but also widen
+    // its angle, so a world-space cone culls faces that still face the camera.
+    vec3 view = bounds[i].sphere.xyz - objectCameraPosition;
+    if (dot(view, bounds[i].cone.xyz) >=
+        bounds[i].cone.w * length(view) + bounds[i].sphere.w)
+      return;
+
+    uint slot = atomicAdd(drawCount, 1);
+    atomicAdd(triangleCount, meshlets[i].triangleCount);
+    commands[slot] = DrawCommand(meshlets[i].triangleCount * 3, 1,
+                                 meshlets[i].firstIndex, 0, i);
+  }
+)"};
+
+constexpr auto benchVsSrc{R"(
+  #version 460
+
+  layout (location = 0) in vec3 position;
+
+  uniform mat4 modelViewProjection;
+
+  void main(void) { gl_Position = modelViewProjection * vec4(position, 1); }
+)"};
+
+constexpr auto benchFsSrc{R"(
+  #version 460
+
+  out vec4 fragmentColor;
+
+  void main(void) { fragmentColor = vec4(1); }
+)"};
+
+struct DrawElementsIndirectCommand {
+  GLuint count, instanceCount, firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+MeshletBounds computeBounds(const Mesh &mesh, const uint32_t *indices,
+                            size_t triangleCount) {
+  // Ritter's sphere: start from an approximate diameter, then grow it to
+  // enclose every vertex.
+  auto position{[&](size_t i) { return mesh.vertices[indices[i]].position; }};
+  auto farthestFrom{[&](glm::vec3 p) {
+    size_t best{};
+    for (size_t i{}; i < triangleCount * 3; ++i)
+      if (glm::distance(position(i), p) > glm::distance(position(best), p))
+        best = i;
+    return position(best);
+  }};
+  auto a{farthestFrom(position(0))}, b{farthestFrom(a)};
+  auto center{(a + b) / 2.0f};
+  auto radius{glm::distance(a, b) / 2};
+  for (size_t i{}; i < triangleCount * 3; ++i) {
+    auto d{glm::distance(position(i), center)};
+    if (d > radius) {
+      auto grown{(radius + d) / 2};
+      center += (position(i) - center) * ((grown - radius) / d);
+      radius = grown;
+    }
+  }
+
+  glm::vec3 axis{0};
+  std::vector<glm::vec3> normals;
+  for (size_t t{}; t < triangleCount; ++t) {
+    auto n{glm::cross(position(t * 3 + 1) - position(t * 3),
+                      position(t * 3 + 2) - position(t * 3))};
+    auto length{glm::length(n)};
+    if (length > 0)
+      normals.push_back(n / length), axis += normals.back();
+  }
+  auto axisLength{glm::length(axis)};
+  float minDot{1};
+  if (axisLength > 0) {
+    axis /= axisLength;
+    for (auto &n : normals)
+      minDot = std::min(minDot, glm::dot(axis, n));
+  }
+  // Cones wider than about 84 degrees aren't worth testing.
+  auto cutoff{axisLength > 0 && minDot > 0.1f
+                  ? std::sqrt(1 - minDot * minDot)
+                  : 1.0f};
+  return {center, radius, axisLength > 0 ? axis : glm::vec3{0, 0, 1}, cutoff};
+}
+} // namespace
+
+MeshletSet buildMeshlets(const Mesh &mesh) {
+  MeshletSet set;
+  std::vector<bool> inMeshlet(mesh.vertices.size());
+  std::vector<uint32_t> vertices;
+
+  for (auto &submesh : mesh.submeshes) {
+    auto indices{&mesh.indices[submesh.firstIndex]};
+    auto triangleCount{submesh.indexCount / 3};
+    uint32_t first{};
+    auto close{[&](uint32_t end) {
+      set.meshlets.push_back({submesh.firstIndex + first * 3, end - first,
+                              uint32_t(vertices.size()), submesh.material});
+      set.bounds.push_back(
+          computeBounds(mesh, indices + first * 3, end - first));
+      for (auto v : vertices)
+        inMeshlet[v] = false;
+      vertices.clear();
+      first = end;
+    }};
+
+    for (uint32_t t{}; t < triangleCount; ++t) {
+      size_t added{};
+      for (size_t corner{}; corner < 3; ++corner)
+        added += !inMeshlet[indices[t * 3 + corner]];
+      if (t - first == maxMeshletTriangles ||
+          vertices.size() + added > maxMeshletVertices)
+        close(t);
+      for (size_t corner{}; corner < 3; ++corner) {
+        auto v{indices[t * 3 + corner]};
+        if (!inMeshlet[v])
+          inMeshlet[v] = true, vertices.push_back(v);
+      }
+    }
+    if (first < triangleCount)
+      close(triangleCount);
+  }
+  return set;
+}
+
+void extractFrustumPlanes(const glm::mat4 &viewProjection,
+                          glm::vec4 planes[6]) {
+  auto m{glm::transpose(viewProjection)};
+  planes[0] = m[3] + m[0];
+  planes[1] = m[3] - m[0];
+  planes[2] = m[3] + m[1];
+  planes[3] = m[3] - m[1];
+  planes[4] = m[3] + m[2];
+  planes[5] = m[3] - m[2];
+  for (size_t p{}; p < 6; ++p)
+    planes[p] /= glm::length(glm::vec3(planes[p]));
+}
+
+MeshletCuller::MeshletCuller(const MeshletSet &set)
+    : _meshletCount{set.meshlets.size()} {
+  _program = createComputeProgram(csSrc);
+  _modelLoc = glGetUniformLocation(_program, "model");
+  _objectCameraLoc = glGetUniformLocation(_program, "objectCameraPosition");
+  _planesLoc = glGetUniformLocation(_program, "planes");
+  _scaleLoc = glGetUniformLocation(_program, "scale");
+  _countLoc = glGetUniformLocation(_program, "meshletCount");
+
+  GLuint buffers[4];
+  glCheck(glCreateBuffers(4, buffers));
+  _meshlets = buffers[0], _bounds = buffers[1];
+  _commands = buffers[2], _counters = buffers[3];
+  glCheck(glNamedBufferStorage(_meshlets,
+                               GLsizeiptr(_meshletCount * sizeof(Meshlet)),
+                               set.meshlets.data(), 0));
+  glCheck(glNamedBufferStorage(_bounds,
+                               GLsizeiptr(_meshletCount * sizeof(MeshletBounds)),
+                               set.bounds.data(), 0));
+  glCheck(glNamedBufferStorage(
+      _commands,
+      GLsizeiptr(_meshletCount * sizeof(DrawElementsIndirectCommand)), nullptr,
+      0));
+  glCheck(glNamedBufferStorage(_counters, 2 * sizeof(GLuint), nullptr,
+                               GL_DYNAMIC_STORAGE_BIT));
+}
+
+MeshletCuller::~MeshletCuller() {
+  GLuint buffers[]{_meshlets, _bounds, _commands, _counters};
+  glDeleteBuffers(4, buffers);
+  glDeleteProgram(_program);
+}
+
+void MeshletCuller::cull(const glm::mat4 &model,
+                         const glm::mat4 &viewProjection,
+                         glm::vec3 cameraPosition) const {
+  glm::vec4 planes[6];
+  extractFrustumPlanes(viewProjection, planes);
+  auto scale{std::max({glm::length(glm::vec3(model[0])),
+                       glm::length(glm::vec3(model[1])),
+                       glm::length(glm::vec3(model[2]))})};
+  glm::vec3 objectCameraPosition{glm::inverse(model) *
+                                 glm::vec4{cameraPosition, 1}};
+
+  constexpr GLuint zero{};
+  glCheck(glClearNamedBufferData(_counters, GL_R32UI, GL_RED_INTEGER,
+                                 GL_UNSIGNED_INT, &zero));
+  glCheck(glUseProgram(_program));
+  glCheck(glUniformMatrix4fv(_modelLoc, 1, GL_FALSE, &model[0][0]));
+  glCheck(glUniform3fv(_objectCameraLoc, 1, &objectCameraPosition[0]));
+  glCheck(glUniform4fv(_planesLoc, 6, &planes[0][0]));
+  glCheck(glUniform1f(_scaleLoc, scale));
+  glCheck(glUniform1ui(_countLoc, GLuint(_meshletCount)));
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _meshlets));
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _bounds));
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _commands));
+  glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _counters));
+  glCheck(glDispatchCompute(GLuint((_meshletCount + 63) / 64), 1, 1));
+  glCheck(glMemoryBarrier(GL_COMMAND_BARRIER_BIT |
+                          GL_SHADER_STORAGE_BARRIER_BIT));
+}
+
+void MeshletCuller::draw() const {
+  glCheck(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands));
+  glCheck(glBindBuffer(GL_PARAMETER_BUFFER, _counters));
+  glCheck(glMultiDrawElementsIndirectCount(
+      GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, GLsizei(_meshletCount),
+      sizeof(DrawElementsIndirectCommand)));
+}
+
+MeshletCullStats MeshletCuller::stats() const {
+  MeshletCullStats stats{};
+  glCheck(glGetNamedBufferSubData(_counters, 0, sizeof stats, &stats));
+  return stats;
+}
+
+GLuint MeshletCuller::meshletBuffer() const { return _meshlets; }
+
+GLuint MeshletCuller::commandBuffer() const { return _commands; }
+
+void benchmarkMeshletCulling(const std::filesystem::path &objPath) {
+  auto mesh{loadObj(objPath)};
+  weldVertices(mesh);
+  optimizeMesh(mesh);
+  auto set{buildMeshlets(mesh)};
+  auto triangleCount{mesh.indices.size() / 3};
+  std::printf("%zu triangles in %zu meshlets\n", triangleCount,
+              set.meshlets.size());
+
+  constexpr GLsizei width{512}, height{512};
+  Window window{width, height, "Meshlet culling benchmark"};
+
+  GLuint framebuffer, renderbuffers[2];
+  glCheck(glCreateRenderbuffers(2, renderbuffers));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width,
+                                     height));
+  glCheck(glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24,
+                                     width, height));
+  glCheck(glCreateFramebuffers(1, &framebuffer));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0,
+                                         GL_RENDERBUFFER, renderbuffers[0]));
+  glCheck(glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT,
+                                         GL_RENDERBUFFER, renderbuffers[1]));
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+  glCheck(glViewport(0, 0, width, height));
+
+  GLuint buffers[2], vertexArray;
+  glCheck(glCreateBuffers(2, buffers));
+  glCheck(glNamedBufferStorage(
+      buffers[0], GLsizeiptr(mesh.vertices.size() * sizeof(Vertex)),
+      mesh.vertices.data(), 0));
+  glCheck(glNamedBufferStorage(
+      buffers[1], GLsizeiptr(mesh.indices.size() * sizeof(uint32_t)),
+      mesh.indices.data(), 0));
+  glCheck(glCreateVertexArrays(1, &vertexArray));
+  glCheck(glVertexArrayVertexBuffer(vertexArray, 0, buffers[0], 0,
+                                    sizeof(Vertex)));
+  glCheck(glVertexArrayElementBuffer(vertexArray, buffers[1]));
+  glCheck(glVertexArrayAttribFormat(vertexArray, 0, 3, GL_FLOAT, GL_FALSE,
+                                    offsetof(Vertex, position)));
+  glCheck(glVertexArrayAttribBinding(vertexArray, 0, 0));
+  glCheck(glEnableVertexArrayAttrib(vertexArray, 0));
+  auto program{createProgram(benchVsSrc, benchFsSrc)};
+  auto modelViewProjectionLoc{
+      glGetUniformLocation(program, "modelViewProjection")};
+  MeshletCuller culler{set};
+
+  glm::vec3 lo{1e30f}, hi{-1e30f};
+  for (auto &vertex : mesh.vertices)
+    lo = glm::min(lo, vertex.position), hi = glm::max(hi, vertex.position);
+  auto center{(lo + hi) / 2.0f};
+  auto radius{std::max(glm::distance(lo, hi) / 2, 1e-3f)};
+  auto projection{glm::perspective(glm::radians(60.0f), 1.0f, radius / 100,
+                                   radius * 100)};
+
+  struct Case {
+    const char *name;
+    glm::mat4 model;
+    glm::vec3 eye, target;
+  };
+  auto squash{glm::scale(glm::rotate(glm::mat4{1}, 0.7f, glm::vec3{1, 1, 0}),
+                         glm::vec3{1, 0.25f, 1})};
+  const Case cases[]{
+      {"in view", glm::mat4{1}, center + glm::vec3{0, 0, 3 * radius}, center},
+      {"looking aside", glm::mat4{1}, center + glm::vec3{0, 0, 2 * radius},
+       center + glm::vec3{2 * radius, 0, 0}},
+      {"squashed 4x", squash,
+       glm::vec3{squash * glm::vec4{center, 1}} +
+           glm::vec3{radius, 2 * radius, 2 * radius},
+       glm::vec3{squash * glm::vec4{center, 1}}},
+  };
+
+  using Clock = std::chrono::steady_clock;
+  constexpr size_t frames{20};
+  glCheck(glEnable(GL_DEPTH_TEST));
+  for (auto &c : cases) {
+    auto viewProjection{projection * glm::lookAt(c.eye, c.target, {0, 1, 0})};
+    auto modelViewProjection{viewProjection * c.model};
+    glCheck(glUseProgram(program));
+    glCheck(glUniformMatrix4fv(modelViewProjectionLoc, 1, GL_FALSE,
+                               &modelViewProjection[0][0]));
+    glCheck(glBindVertexArray(vertexArray));
+
+    auto time{[&](auto &&drawFrame) {
+      glCheck(glFinish());
+      auto start{Clock::now()};
+      for (size_t frame{}; frame < frames; ++frame) {
+        glCheck(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+        drawFrame();
+      }
+      glCheck(glFinish());
+      return std::chrono::duration<double, std::milli>(Clock::now() - start)
+                 .count() /
+             frames;
+    }};
+    auto fullMs{time([&] {
+      glCheck(glDrawElements(GL_TRIANGLES, GLsizei(mesh.indices.size()),
+                             GL_UNSIGNED_INT, nullptr));
+    })};
+    auto culledMs{time([&] {
+      culler.cull(c.model, viewProjection, c.eye);
+      glCheck(glUseProgram(program));
+      culler.draw();
+    })};
+    auto stats{culler.stats()};
+
+    // Every meshlet the pass dropped must be outside the frustum or have
+    // all of its triangles facing away from the camera.
+    std::vector<DrawElementsIndirectCommand> commands(stats.visibleMeshlets);
+    glCheck(glGetNamedBufferSubData(
+        culler.commandBuffer(), 0,
+        GLsizeiptr(commands.size() * sizeof(DrawElementsIndirectCommand)),
+        commands.data()));
+    std::vector<bool> visible(set.meshlets.size());
+    for (auto &command : commands)
+      visible[command.baseInstance] = true;
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+    auto scale{std::max({glm::length(glm::vec3(c.model[0])),
+                         glm::length(glm::vec3(c.model[1])),
+                         glm::length(glm::vec3(c.model[2]))})};
+    size_t wronglyCulled{};
+    for (size_t m{}; m < set.meshlets.size(); ++m) {
+      if (visible[m])
+        continue;
+      auto &bounds{set.bounds[m]};
+      glm::vec3 sphereCenter{c.model * glm::vec4{bounds.center, 1}};
+      bool inFrustum{true}, facing{};
+      for (auto &plane : planes)
+        inFrustum &= glm::dot(glm::vec3{plane}, sphereCenter) + plane.w >=
+                     -bounds.radius * scale;
+      auto &meshlet{set.meshlets[m]};
+      for (uint32_t t{}; t < meshlet.triangleCount && !facing; ++t) {
+        glm::vec3 p[3];
+        for (size_t corner{}; corner < 3; ++corner) {
+          auto index{mesh.indices[meshlet.firstIndex + t * 3 + corner]};
+          p[corner] = c.model * glm::vec4{mesh.vertices[index].position, 1};
+        }
+        facing = glm::dot(glm::cross(p[1] - p[0], p[2] - p[0]),
+                          c.eye - p[0]) > 0;
+      }
+      wronglyCulled += inFrustum && facing;
+    }
+    std::printf("%-13s %5u/%zu meshlets, %7u/%zu triangles, %7.3f ms "
+                "culled, %7.3f ms all, %zu wrongly culled\n",
+                c.name, stats.visibleMeshlets, set.meshlets.size(),
+                stats.visibleTriangles, triangleCount, culledMs, fullMs,
+                wronglyCulled);
+  }
+  glCheck(glDisable(GL_DEPTH_TEST));
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  glDeleteProgram(program);
+  glDeleteVertexArrays(1, &vertexArray);
+  glDeleteBuffers(2, buffers);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(2, renderbuffers);
+}
@@ -0,0 +1,425 @@
+#include "occlusion.hpp"
+#include "simd_transform.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/vec2.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace {
+// Candidates per job when testing.
+constexpr size_t testChunk{1024};
+
+float edge(glm::vec2 from, glm::vec2 to, glm::vec2 p) {
+  return (to.x - from.x) * (p.y - from.y) - (to.y - from.y) * (p.x - from.x);
+}
+
+bool anyGreaterScalar(const float *values, int first, int last, float value) {
+  for (auto i{first}; i <= last; ++i)
+    if (values[i] > value)
+      return true;
+  return false;
+}
+
+#ifdef SIMD_X86
+SIMD_TARGET("avx2")
+bool anyGreaterAvx2(const float *values, int first, int last, float value) {
+  auto threshold{_mm256_set1_ps(value)};
+  auto i{first};
+  for (; i + 7 <= last; i += 8)
+    if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i),
+                                         threshold, _CMP_GT_OQ)))
+      return true;
+  return anyGreaterScalar(values, i, last, value);
+}
+#endif
+
+// Whether any of values[first..last] is greater than value.
+bool anyGreater(const float *values, int first, int last, float value) {
+#ifdef SIMD_X86
+  if (simdLevel() == SimdLevel::Avx2)
+    return anyGreaterAvx2(values, first, last, value);
+#endif
+  return anyGreaterScalar(values, first, last, value);
+}
+
+Mesh boxMesh(glm::vec3 boundsMin, glm::vec3 boundsMax) {
+  Mesh mesh;
+  for (int corner{}; corner < 8; ++corner)
+    mesh.vertices.push_back({{corner & 1 ? boundsMax.x : boundsMin.x,
+                              corner & 2 ? boundsMax.y : boundsMin.y,
+                              corner & 4 ? boundsMax.z : boundsMin.z},
+                             {},
+                             {}});
+  mesh.indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                  2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+  return mesh;
+}
+
+void appendMesh(Mesh &to, const Mesh &from) {
+  auto offset{uint32_t(to.vertices.size())};
+  to.vertices.insert(to.vertices.end(), from.vertices.begin(),
+                     from.vertices.end());
+  for (auto index : from.indices)
+    to.indices.push_back(offset + index);
+}
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(size_t width, size_t height)
+    : _width{width}, _height{height},
+      _tilesX{(width + tileSize - 1) / tileSize},
+      _tilesY{(height + tileSize - 1) / tileSize}, _depth(width * height, 1),
+      _tileMaxDepth(_tilesX * _tilesY, 1), _bins(_tilesX * _tilesY) {
+  if (width % 8)
+    throw std::runtime_error{"occlusion buffer width must be a multiple of 8"};
+}
+
+void OcclusionBuffer::begin(const glm::mat4 &viewProjection) {
+  _viewProjection = viewProjection;
+  _triangles.clear();
+  for (auto &bin : _bins)
+    bin.clear();
+}
+
+void OcclusionBuffer::addOccluder(const Mesh &mesh, const glm::mat4 &model) {
+  auto transform{_viewProjection * model};
+  for (size_t first{}; first + 3 <= mesh.indices.size(); first += 3) {
+    glm::vec4 clip[3];
+    for (size_t i{}; i < 3; ++i)
+      clip[i] = transform *
+                glm::vec4{mesh.vertices[mesh.indices[first + i]].position, 1};
+    // Clipping a triangle against the near plane, z = -w, leaves at most
+    // four corners.
+    glm::vec4 polygon[4];
+    size_t count{};
+    for (size_t i{}; i < 3; ++i) {
+      auto &p{clip[i]}, &q{clip[(i + 1) % 3]};
+      auto distanceP{p.z + p.w}, distanceQ{q.z + q.w};
+      if (distanceP >= 0)
+        polygon[count++] = p;
+      if ((distanceP >= 0) != (distanceQ >= 0))
+        polygon[count++] = p + (q - p) * (distanceP / (distanceP - distanceQ));
+    }
+    for (size_t i{2}; i < count; ++i) {
+      glm::vec4 triangle[]{polygon[0], polygon[i - 1], polygon[i]};
+      addTriangle(triangle);
+    }
+  }
+}
+
+void OcclusionBuffer::addTriangle(const glm::vec4 clip[3]) {
+  auto width{float(_width)}, height{float(_height)};
+  glm::vec2 p[3];
+  float depth[3];
+  for (size_t i{}; i < 3; ++i) {
+    auto inverseW{1 / clip[i].w};
+    p[i] = {(clip[i].x * inverseW + 1) * 0.5f * width,
+            (1 - clip[i].y * inverseW) * 0.5f * height};
+    depth[i] = clip[i].z * inverseW;
+  }
+  auto area{edge(p[0], p[1], p[2])};
+  if (!(std::abs(area) > 0))
+    return;
+  auto [lowX, highX]{std::minmax({p[0].x, p[1].x, p[2].x})};
+  auto [lowY, highY]{std::minmax({p[0].y, p[1].y, p[2].y})};
+  if (highX < 0 || highY < 0 || lowX > width - 1 || lowY > height - 1)
+    return;
+
+  Triangle triangle;
+  triangle.depthA = triangle.depthB = triangle.depthC = 0;
+  for (size_t i{}; i < 3; ++i) {
+    auto &from{p[(i + 1) % 3]}, &to{p[(i + 2) % 3]};
+    triangle.a[i] = (from.y - to.y) / area;
+    triangle.b[i] = (to.x - from.x) / area;
+    triangle.c[i] = -(triangle.a[i] * from.x + triangle.b[i] * from.y);
+    triangle.depthA += depth[i] * triangle.a[i];
+    triangle.depthB += depth[i] * triangle.b[i];
+    triangle.depthC += depth[i] * triangle.c[i];
+  }
+  triangle.minX = int(std::max(std::floor(lowX), 0.0f));
+  triangle.minY = int(std::max(std::floor(lowY), 0.0f));
+  triangle.maxX = int(std::min(std::ceil(highX), width - 1));
+  triangle.maxY = int(std::min(std::ceil(highY), height - 1));
+
+  auto index{uint32_t(_triangles.size())};
+  _triangles.push_back(triangle);
+  for (auto tileY{size_t(triangle.minY) / tileSize};
+       tileY <= size_t(triangle.maxY) / tileSize; ++tileY)
+    for (auto tileX{size_t(triangle.minX) / tileSize};
+         tileX <= size_t(triangle.maxX) / tileSize; ++tileX)
+      _bins[tileY * _tilesX + tileX].push_back(index);
+}
+
+void OcclusionBuffer::rasterize(JobSystem *jobs) {
+  auto rasterizeTiles{[&](size_t first, size_t last) {
+    for (auto tile{first}; tile < last; ++tile)
+      rasterizeTile(tile);
+  }};
+  if (jobs)
+    jobs->parallelFor(0, _bins.size(), 1, rasterizeTiles);
+  else
+    rasterizeTiles(0, _bins.size());
+}
+
+void OcclusionBuffer::rasterizeTile(size_t tile) {
+  auto x0{int(tile % _tilesX * tileSize)}, y0{int(tile / _tilesX * tileSize)};
+  auto x1{std::min(x0 + int(tileSize), int(_width)) - 1};
+  auto y1{std::min(y0 + int(tileSize), int(_height)) - 1};
+  for (auto y{y0}; y <= y1; ++y)
+    std::fill_n(&_depth[size_t(y) * _width + size_t(x0)], x1 - x0 + 1, 1.0f);
+
+  for (auto index : _bins[tile]) {
+    auto &triangle{_triangles[index]};
+    auto minX{std::max(triangle.minX, x0)}, maxX{std::min(triangle.maxX, x1)};
+    auto minY{std::max(triangle.minY, y0)}, maxY{std::min(triangle.maxY, y1)};
+#ifdef SIMD_X86
+    if (simdLevel() == SimdLevel::Avx2) {
+      rasterizeAvx2(triangle, minX, minY, maxX, maxY);
+      continue;
+    }
+#endif
+    rasterizeScalar(triangle, minX, minY, maxX, maxY);
+  }
+
+  auto maxDepth{-std::numeric_limits<float>::infinity()};
+  for (auto y{y0}; y <= y1; ++y) {
+    auto row{&_depth[size_t(y) * _width]};
+    maxDepth = std::max(maxDepth, *std::max_element(row + x0, row + x1 + 1));
+  }
+  _tileMaxDepth[tile] = maxDepth;
+}
+
+void OcclusionBuffer::rasterizeScalar(const Triangle &triangle, int minX,
+                                      int minY, int maxX, int maxY) {
+  for (auto y{minY}; y <= maxY; ++y)
+    for (auto x{minX}; x <= maxX; ++x) {
+      auto px{x + 0.5f}, py{y + 0.5f};
+      auto inside{true};
+      for (size_t i{}; i < 3; ++i)
+        inside &= triangle.a[i] * px + triangle.b[i] * py + triangle.c[i] >= 0;
+      if (!inside)
+        continue;
+      auto &depth{_depth[size_t(y) * _width + size_t(x)]};
+      depth = std::min(depth, triangle.depthA * px + triangle.depthB * py +
+                                  triangle.depthC);
+    }
+}
+
+#ifdef SIMD_X86
+// Works on aligned groups of 8 pixels, which never straddle tiles since
+// tiles and rows are multiples of 8 wide; pixels of the group outside the
+// triangle are written back unchanged.
+SIMD_TARGET("avx2,fma")
+void OcclusionBuffer::rasterizeAvx2(const Triangle &triangle, int minX,
+                                    int minY, int maxX, int maxY) {
+  auto zero{_mm256_setzero_ps()};
+  __m256 a[3], b[3], c[3];
+  for (size_t i{}; i < 3; ++i) {
+    a[i] = _mm256_set1_ps(triangle.a[i]);
+    b[i] = _mm256_set1_ps(triangle.b[i]);
+    c[i] = _mm256_set1_ps(triangle.c[i]);
+  }
+  auto depthA{_mm256_set1_ps(triangle.depthA)};
+  auto depthB{_mm256_set1_ps(triangle.depthB)};
+  auto depthC{_mm256_set1_ps(triangle.depthC)};
+  auto laneOffsets{
+      _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f)};
+
+  for (auto y{minY}; y <= maxY; ++y) {
+    auto py{_mm256_set1_ps(y + 0.5f)};
+    __m256 rowC[3];
+    for (size_t i{}; i < 3; ++i)
+      rowC[i] = _mm256_fmadd_ps(b[i], py, c[i]);
+    auto rowDepth{_mm256_fmadd_ps(depthB, py, depthC)};
+    auto row{&_depth[size_t(y) * _width]};
+
+    for (auto x{minX & ~7}; x <= maxX; x += 8) {
+      auto px{_mm256_add_ps(_mm256_set1_ps(float(x)), laneOffsets)};
+      auto inside{_mm256_cmp_ps(_mm256_fmadd_ps(a[0], px, rowC[0]), zero,
+                                _CMP_GE_OQ)};
+      for (size_t i{1}; i < 3; ++i)
+        inside = _mm256_and_ps(
+            inside, _mm256_cmp_ps(_mm256_fmadd_ps(a[i], px, rowC[i]), zero,
+                                  _CMP_GE_OQ));
+      if (!_mm256_movemask_ps(inside))
+        continue;
+      auto depth{_mm256_loadu_ps(row + x)};
+      auto nearer{_mm256_min_ps(depth, _mm256_fmadd_ps(depthA, px, rowDepth))};
+      _mm256_storeu_ps(row + x, _mm256_blendv_ps(depth, nearer, inside));
+    }
+  }
+}
+#endif
+
+bool OcclusionBuffer::anyBehind(int minX, int minY, int maxX, int maxY,
+                                float minDepth) const {
+  for (auto tileY{minY / int(tileSize)}; tileY <= maxY / int(tileSize);
+       ++tileY)
+    for (auto tileX{minX / int(tileSize)}; tileX <= maxX / int(tileSize);
+         ++tileX) {
+      // Nothing in the tile is farther than the box: it hides it all.
+      if (_tileMaxDepth[size_t(tileY) * _tilesX + size_t(tileX)] <= minDepth)
+        continue;
+      auto x0{std::max(minX, tileX * int(tileSize))};
+      auto x1{std::min(maxX, (tileX + 1) * int(tileSize) - 1)};
+      auto y0{std::max(minY, tileY * int(tileSize))};
+      auto y1{std::min(maxY, (tileY + 1) * int(tileSize) - 1)};
+      for (auto y{y0}; y <= y1; ++y)
+        if (anyGreater(&_depth[size_t(y) * _width], x0, x1, minDepth))
+          return true;
+    }
+  return false;
+}
+
+bool OcclusionBuffer::isVisible(glm::vec3 boundsMin,
+                                glm::vec3 boundsMax) const {
+  glm::vec2 low{std::numeric_limits<float>::infinity()}, high{-low};
+  auto minDepth{std::numeric_limits<float>::infinity()};
+  for (int corner{}; corner < 8; ++corner) {
+    auto clip{_viewProjection *
+              glm::vec4{corner & 1 ? boundsMax.x : boundsMin.x,
+                        corner & 2 ? boundsMax.y : boundsMin.y,
+                        corner & 4 ? boundsMax.z : boundsMin.z, 1}};
+    if (clip.w <= 0 || clip.z < -clip.w)
+      return true;
+    glm::vec2 ndc{clip.x / clip.w, clip.y / clip.w};
+    low = glm::min(low, ndc), high = glm::max(high, ndc);
+    minDepth = std::min(minDepth, clip.z / clip.w);
+  }
+  auto width{float(_width)}, height{float(_height)};
+  auto minX{(low.x + 1) * 0.5f * width}, maxX{(high.x + 1) * 0.5f * width};
+  auto minY{(1 - high.y) * 0.5f * height}, maxY{(1 - low.y) * 0.5f * height};
+  if (maxX < 0 || maxY < 0 || minX >= width || minY >= height)
+    return false;
+  return anyBehind(int(std::max(minX, 0.0f)), int(std::max(minY, 0.0f)),
+                   int(std::min(maxX, width - 1)),
+                   int(std::min(maxY, height - 1)), minDepth);
+}
+
+size_t OcclusionBuffer::cull(const CullingBounds &bounds,
+                             const uint32_t *candidates, size_t count,
+                             uint32_t *visible, JobSystem *jobs) const {
+  // Each chunk writes its survivors from its own first slot on, which reads
+  // run ahead of, so candidates and visible may be the same; the gaps are
+  // closed afterwards, as in frustumCull().
+  auto chunkCount{(count + testChunk - 1) / testChunk};
+  thread_local std::vector<size_t> chunkVisibleStorage;
+  auto &chunkVisible{chunkVisibleStorage};
+  if (chunkVisible.size() < chunkCount)
+    chunkVisible.resize(chunkCount);
+  auto testChunks{[&](size_t firstChunk, size_t lastChunk) {
+    for (auto chunk{firstChunk}; chunk < lastChunk; ++chunk) {
+      auto first{chunk * testChunk}, last{std::min(first + testChunk, count)};
+      size_t survivors{};
+      for (auto i{first}; i < last; ++i) {
+        auto object{candidates[i]};
+        if (isVisible({bounds.minX[object], bounds.minY[object],
+                       bounds.minZ[object]},
+                      {bounds.maxX[object], bounds.maxY[object],
+                       bounds.maxZ[object]}))
+          visible[first + survivors++] = object;
+      }
+      chunkVisible[chunk] = survivors;
+    }
+  }};
+  if (jobs && chunkCount > 1)
+    jobs->parallelFor(0, chunkCount, 1, testChunks);
+  else
+    testChunks(0, chunkCount);
+
+  size_t total{chunkCount ? chunkVisible[0] : 0};
+  for (size_t chunk{1}; chunk < chunkCount; ++chunk) {
+    auto first{visible + chunk * testChunk};
+    std::copy(first, first + chunkVisible[chunk], visible + total);
+    total += chunkVisible[chunk];
+  }
+  return total;
+}
+
+void benchmarkOcclusionCulling(JobSystem *jobs) {
+  constexpr int rooms{16};
+  constexpr float roomSize{8}, wallHeight{3}, wallThickness{0.2f};
+  constexpr float doorWidth{1.6f};
+  constexpr size_t objectsPerRoom{40};
+
+  // Walls on every grid line, with a door in the middle of each room's side.
+  Mesh walls;
+  constexpr auto extent{rooms * roomSize};
+  for (int line{}; line <= rooms; ++line)
+    for (int room{}; room < rooms; ++room) {
+      auto along{room * roomSize}, across{line * roomSize};
+      auto doorStart{along + (roomSize - doorWidth) / 2};
+      for (auto [first, last] : {std::pair{along, doorStart},
+                                 std::pair{doorStart + doorWidth,
+                                           along + roomSize}}) {
+        appendMesh(walls, boxMesh({first, 0, across - wallThickness / 2},
+                                  {last, wallHeight,
+                                   across + wallThickness / 2}));
+        appendMesh(walls, boxMesh({across - wallThickness / 2, 0, first},
+                                  {across + wallThickness / 2, wallHeight,
+                                   last}));
+      }
+    }
+
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> position{0.5f, roomSize - 0.5f},
+      size{0.3f, 1.2f};
+  CullingBounds bounds;
+  bounds.resize(size_t(rooms * rooms) * objectsPerRoom);
+  for (size_t i{}; i < bounds.size(); ++i) {
+    auto room{i / objectsPerRoom};
+    glm::vec3 corner{(room % rooms) * roomSize + position(random), 0,
+                     (room / rooms) * roomSize + position(random)};
+    bounds.set(i, corner,
+               corner + glm::vec3{size(random), size(random), size(random)});
+  }
+
+  glm::vec3 eye{1.5f, 1.6f, 1.5f};
+  auto viewProjection{
+      glm::perspective(glm::radians(60.0f), 16.0f / 9, 0.1f, 500.0f) *
+      glm::lookAt(eye, glm::vec3{extent, 1.6f, extent * 0.6f},
+                  glm::vec3{0, 1, 0})};
+
+  OcclusionBuffer occlusion{256, 144};
+  std::vector<uint32_t> visible;
+  auto frustumVisible{frustumCull(bounds, viewProjection, CullShape::Box,
+                                  visible, jobs)};
+  occlusion.begin(viewProjection);
+  occlusion.addOccluder(walls, glm::mat4{1});
+
+  constexpr int runs{20};
+  std::vector<uint32_t> survivors(frustumVisible);
+  size_t occlusionVisible{};
+  double rasterizeTime{}, testTime{};
+  for (int run{}; run < runs; ++run) {
+    auto start{std::chrono::steady_clock::now()};
+    occlusion.rasterize(jobs);
+    auto rasterized{std::chrono::steady_clock::now()};
+    occlusionVisible = occlusion.cull(bounds, visible.data(), frustumVisible,
+                                      survivors.data(), jobs);
+    auto tested{std::chrono::steady_clock::now()};
+    rasterizeTime +=
+        std::chrono::duration<double, std::milli>{rasterized - start}.count();
+    testTime +=
+        std::chrono::duration<double, std::milli>{tested - rasterized}.count();
+  }
+  std::printf("%zu objects, %zu occluder triangles (%zu on screen)\n",
+              bounds.size(), walls.indices.size() / 3,
+              occlusion.triangleCount());
+  std::printf("frustum culling: %zu draws\n", frustumVisible);
+  std::printf("occlusion culling: %zu draws (%.1f%% fewer)\n",
+              occlusionVisible,
+              100.0 * double(frustumVisible - occlusionVisible) /
+                  double(std::max(frustumVisible, size_t{1})));
+  std::printf("%zux%zu buffer: rasterize %.3f ms, test %.3f ms (%s, %zu "
+              "threads)\n",
+              occlusion.width(), occlusion.height(), rasterizeTime / runs,
+              testTime / runs, simdLevelName(simdLevel()),
+              jobs ? jobs->threadCount() : 1);
+}
@@ -0,0 +1,391 @@
+#include "pack_renderer.hpp"
+#include "gl_util.hpp"
+#include "quantization.hpp"
+#include "shader.hpp"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "glm/matrix.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <string>
+
+namespace {
+constexpr size_t lightCount{8};
+constexpr GLuint materialsBinding{0};
+constexpr GLuint objectsBinding{1};
+constexpr GLuint diffuseTextureUnit{0};
+
+size_t instanceCount(const AssetPack &pack) {
+  size_t count{};
+  for (size_t i{}; i < pack.entryCount(); ++i)
+    if (auto &entry{pack.entry(i)};
+        entry.type == PackEntryType::Mesh && entry.lodCount > 0)
+      ++count;
+  return count;
+}
+
+// Reads the pack's quantized vertices and takes each instance's transform
+// from the GpuScene buffer.
+constexpr auto vsSrc{R"(
+  struct Object {
+    mat4 model;
+    uint material, padding0, padding1, padding2;
+  };
+
+  layout (std430, binding = 1) readonly buffer Objects { Object objects[]; };
+
+  uniform uint object;
+  uniform vec3 boundsMin, boundsExtent; // QuantizedMesh::dequantization()
+  uniform mat4 viewProjection;
+  uniform mat4 previousViewProjection;
+  uniform mat4 jitter;
+
+  out vec3 worldPosition;
+  out vec3 worldNormal;
+  out vec2 vertexUv;
+  out vec4 clipPosition;
+  out vec4 previousClipPosition;
+
+  void main(void) {
+    mat4 model = objects[object].model;
+    vec4 world = model * vec4(boundsMin + position * boundsExtent, 1);
+    clipPosition = viewProjection * world;
+    previousClipPosition = previousViewProjection * world;
+    gl_Position = jitter * clipPosition;
+    worldPosition = world.xyz;
+    // The cofactor matrix is the inverse transpose scaled by the
+    // determinant, which normalizing drops.
+    mat3 m = mat3(model);
+    worldNormal = mat3(cross(m[1], m[2]), cross(m[2], m[0]),
+                       cross(m[0], m[1])) * decodeOctahedral(normal);
+    vertexUv = uv;
+  }
+)"};
+
+// PackedMaterial, as std430 lays it out.
+constexpr auto materialSource{R"(
+  struct Material {
+    vec3 kd;
+    float d;
+    vec3 ks;
+    float ns;
+    vec3 ke;
+    float ni;
+    int illum;
+    int diffuseTexture;
+    uint ka[2];
+    vec4 uvTransform;
+  };
+
+  layout (std430, binding = 0) readonly buffer Materials {
+    Material materials[];
+  };
+
+  vec3 ambientOf(Material m) {
+    return vec3(unpackHalf2x16(m.ka[0]), unpackHalf2x16(m.ka[1]).x);
+  }
+)"};
+
+// Inputs and the material's diffuse color, shared by both shading paths.
+constexpr auto surfaceSource{R"(
+  in vec3 worldPosition;
+  in vec3 worldNormal;
+  in vec2 vertexUv;
+  in vec4 clipPosition;
+  in vec4 previousClipPosition;
+
+  uniform uint material;
+  layout (binding = 0) uniform sampler2D diffuseMap;
+
+  // Gradients are taken from vertexUv alone, before any branch: helper
+  // invocations need not load the material, so anything derived from it has
+  // no defined derivatives.
+  vec3 diffuseOf(Material m) {
+    vec2 uvDx = dFdx(vertexUv), uvDy = dFdy(vertexUv);
+    vec3 kd = m.kd;
+    if (m.diffuseTexture >= 0) {
+      vec2 scale = m.uvTransform.zw;
+      kd *= textureGrad(diffuseMap, vertexUv * scale + m.uvTransform.xy,
+                        uvDx * scale, uvDy * scale).rgb;
+    }
+    return kd;
+  }
+)"};
+
+constexpr auto forwardFsSrc{R"(
+  uniform vec3 eye;
+
+  layout (location = 0) out vec4 fragmentColor;
+  layout (location = 1) out vec2 motionVector;
+
+  void main(void) {
+    Material m = materials[material];
+    vec3 kd = diffuseOf(m);
+    vec3 color = kd;
+    if (m.illum > 0)
+      color = shadeBlinnPhong(worldPosition, worldNormal, eye, ambientOf(m),
+                              kd, m.illum > 1 ? m.ks : vec3(0), m.ns, m.ke);
+    fragmentColor = vec4(color, 1);
+    motionVector = (clipPosition.xy / clipPosition.w
+                    - previousClipPosition.xy / previousClipPosition.w)
+                   * 0.5;
+  }
+)"};
+
+// The G-buffer has no room for Ka, Ke or unlit materials: DeferredShading
+// takes Ka to be Kd, and illum 0 is lit like illum 1.
+constexpr auto gBufferFsSrc{R"(
+  void main(void) {
+    Material m = materials[material];
+    writeGBuffer(worldNormal, diffuseOf(m), m.illum > 1 ? m.ks : vec3(0),
+                 m.ns);
+  }
+)"};
+} // namespace
+
+static_assert(sizeof(PackedMaterial) == 80,
+              "PackedMaterial must match the shaders' std430 Material");
+
+PackRenderer::PackRenderer(const AssetPack &pack)
+    : _lighting{lightCount}, _gpuScene{instanceCount(pack)} {
+  // Every mesh sits on the same floor line, centered on z, with a gap of a
+  // quarter of the largest extent between neighbours.
+  float largestExtent{};
+  for (size_t i{}; i < pack.entryCount(); ++i)
+    if (auto &entry{pack.entry(i)}; entry.type == PackEntryType::Mesh)
+      for (auto extent : entry.boundsExtent)
+        largestExtent = std::max(largestExtent, extent);
+  // Textures are uploaded as they are stored, still block-compressed.
+  _textures.assign(pack.entryCount(), 0);
+  for (size_t i{}; i < pack.entryCount(); ++i)
+    if (auto &entry{pack.entry(i)}; entry.type == PackEntryType::Texture)
+      _textures[i] = pack.createTexture(entry);
+
+  float cursor{};
+  _boundsMin = glm::vec3{std::numeric_limits<float>::infinity()};
+  _boundsMax = -_boundsMin;
+  for (size_t i{}; i < pack.entryCount(); ++i) {
+    auto &entry{pack.entry(i)};
+    if (entry.type != PackEntryType::Mesh || entry.lodCount == 0)
+      continue;
+    auto &instance{_instances.emplace_back()};
+    glm::vec3 boundsMin{entry.boundsMin[0], entry.boundsMin[1],
+                        entry.boundsMin[2]};
+    glm::vec3 extent{entry.boundsExtent[0], entry.boundsExtent[1],
+                     entry.boundsExtent[2]};
+    glm::vec3 offset{cursor - boundsMin.x, -boundsMin.y,
+                     -boundsMin.z - extent.z / 2};
+    instance.model = glm::translate(glm::mat4{1}, offset);
+    _boundsMin = glm::min(_boundsMin, boundsMin + offset);
+    _boundsMax = glm::max(_boundsMax, boundsMin + extent + offset);
+    _instanceBounds.resize(_instances.size());
+    _instanceBounds.set(_instances.size() - 1, boundsMin + offset,
+                        boundsMin + extent + offset);
+    cursor += extent.x + largestExtent / 4;
+
+    // Draws take the finest level of detail, each with the texture its
+    // material samples, if any.
+    auto lod{static_cast<const PackedLod *>(pack.blob(entry, PackBlob::Lods))};
+    auto submeshes{
+        static_cast<const Submesh *>(pack.blob(entry, PackBlob::Submeshes))};
+    auto materials{static_cast<const PackedMaterial *>(
+        pack.blob(entry, PackBlob::Materials))};
+    for (auto s{lod->firstSubmesh}; s < lod->firstSubmesh + lod->submeshCount;
+         ++s) {
+      auto diffuseTexture{materials[submeshes[s].material].diffuseTexture};
+      _draws.push_back({uint32_t(_instances.size() - 1),
+                        diffuseTexture < 0
+                            ? 0
+                            : _textures[size_t(diffuseTexture)],
+                        submeshes[s]});
+    }
+
+    instance.boundsMin = boundsMin, instance.boundsExtent = extent;
+    _gpuScene.setTransform(uint32_t(_instances.size() - 1), instance.model);
+    instance.name = entry.name;
+
+    // Picking traces the same finest level of detail, through the float
+    // vertices the GPU no longer needs.
+    Mesh mesh;
+    auto vertices{
+        static_cast<const Vertex *>(pack.blob(entry, PackBlob::Vertices))};
+    auto indices{
+        static_cast<const uint32_t *>(pack.blob(entry, PackBlob::Indices))};
+    mesh.vertices.assign(vertices, vertices + entry.vertexCount);
+    mesh.indices.assign(indices, indices + entry.indexCount);
+    mesh.submeshes.assign(submeshes + lod->firstSubmesh,
+                          submeshes + lod->firstSubmesh + lod->submeshCount);
+    instance.bvh = std::make_unique<MeshBvh>(mesh);
+    _scene.addInstance(*instance.bvh, instance.model);
+
+    instance.buffers[0] =
+        pack.createBuffer(entry, PackBlob::QuantizedVertices);
+    instance.buffers[1] = pack.createBuffer(entry, PackBlob::Indices);
+    instance.buffers[2] = pack.createBuffer(entry, PackBlob::Materials);
+    glCheck(glCreateVertexArrays(1, &instance.vertexArray));
+    setupQuantizedVertexArray(instance.vertexArray, instance.buffers[0]);
+    glCheck(glVertexArrayElementBuffer(instance.vertexArray,
+                                       instance.buffers[1]));
+  }
+  if (_instances.empty())
+    _boundsMin = _boundsMax = glm::vec3{0};
+  _scene.build();
+
+  // Sorted by texture, so that the materials sharing an atlas page are drawn
+  // together and the page is bound once for all of them.
+  std::stable_sort(_draws.begin(), _draws.end(),
+                   [](const Draw &a, const Draw &b) {
+                     return a.texture < b.texture;
+                   });
+  GLuint previous{};
+  for (auto &draw : _draws)
+    if (draw.texture && draw.texture != previous)
+      ++_textureBinds, previous = draw.texture;
+
+  // A ring of colored lights above the scene, bright enough to light its
+  // middle whatever the scale of the pack.
+  auto center{(_boundsMin + _boundsMax) / 2.0f};
+  auto radius{std::max(glm::length(_boundsMax - _boundsMin) / 2, 1e-3f)};
+  Light lights[lightCount];
+  for (size_t i{}; i < lightCount; ++i) {
+    auto angle{2 * 3.14159265f * float(i) / lightCount};
+    glm::vec3 position{center + radius * glm::vec3{std::cos(angle), 0.75f,
+                                                   std::sin(angle)}};
+    glm::vec3 color{0.6f + 0.4f * std::cos(angle),
+                    0.6f + 0.4f * std::cos(angle + 2.1f),
+                    0.6f + 0.4f * std::cos(angle + 4.2f)};
+    lights[i] = pointLight(position, 4 * radius, color,
+                           (1 + radius * radius) * 4 / lightCount);
+  }
+  _lighting.setLights(lights, lightCount);
+  _lighting.setAmbient(glm::vec3{0.1f});
+
+  auto fullVsSrc{std::string{"#version 450\n"} + quantizedVertexInputSource +
+                 vsSrc};
+  auto forwardSrc{std::string{"#version 450\n"} + clusteredShadingSource +
+                  materialSource + surfaceSource + forwardFsSrc};
+  auto gBufferSrc{std::string{"#version 450\n"} + gBufferSource +
+                  materialSource + surfaceSource + gBufferFsSrc};
+  for (auto path : {ShadingPath::Forward, ShadingPath::Deferred}) {
+    auto &program{_programs[size_t(path)]};
+    program.id = createProgram(fullVsSrc.c_str(),
+                               path == ShadingPath::Forward
+                                   ? forwardSrc.c_str()
+                                   : gBufferSrc.c_str());
+    program.objectLoc = glGetUniformLocation(program.id, "object");
+    program.boundsMinLoc = glGetUniformLocation(program.id, "boundsMin");
+    program.boundsExtentLoc = glGetUniformLocation(program.id, "boundsExtent");
+    program.viewProjectionLoc =
+        glGetUniformLocation(program.id, "viewProjection");
+    program.previousViewProjectionLoc =
+        glGetUniformLocation(program.id, "previousViewProjection");
+    program.jitterLoc = glGetUniformLocation(program.id, "jitter");
+    program.eyeLoc = glGetUniformLocation(program.id, "eye");
+    program.materialLoc = glGetUniformLocation(program.id, "material");
+  }
+}
+
+RayHit PackRenderer::pick(const Ray &ray) const {
+  RayHit hit;
+  _scene.intersect(ray, hit);
+  return hit;
+}
+
+const std::string &PackRenderer::instanceName(uint32_t instance) const {
+  return _instances[instance].name;
+}
+
+PackRenderer::~PackRenderer() {
+  for (auto &instance : _instances) {
+    glDeleteVertexArrays(1, &instance.vertexArray);
+    glDeleteBuffers(GLsizei(std::size(instance.buffers)), instance.buffers);
+  }
+  for (auto texture : _textures)
+    glDeleteTextures(1, &texture);
+  for (auto &program : _programs)
+    glDeleteProgram(program.id);
+}
+
+void PackRenderer::draw(const glm::mat4 &view, const glm::mat4 &projection,
+                        float near, float far, size_t width, size_t height,
+                        const glm::mat4 &jitter, LinearArena &arena) {
+  auto viewProjection{projection * view};
+  if (_previousViewProjection == glm::mat4{0})
+    _previousViewProjection = viewProjection;
+  glm::vec3 eye{glm::inverse(view)[3]};
+
+  // The instances in view, and then the draws of those, in the arena: both
+  // lists are rebuilt every frame and dropped with it.
+  auto visibleInstances{arena.allocateArray<uint32_t>(_instances.size() + 8)};
+  auto visibleInstanceCount{frustumCull(_instanceBounds, viewProjection,
+                                        CullShape::Box, visibleInstances)};
+  auto isVisible{arena.allocateArray<bool>(_instances.size())};
+  std::fill_n(isVisible, _instances.size(), false);
+  for (size_t i{}; i < visibleInstanceCount; ++i)
+    isVisible[visibleInstances[i]] = true;
+  auto drawList{arena.allocateArray<const Draw *>(_draws.size())};
+  _lastDrawCount = 0;
+  for (auto &draw : _draws)
+    if (isVisible[draw.instance])
+      drawList[_lastDrawCount++] = &draw;
+
+  // Before anything gets bound: the scatter pass takes over bindings 0 to 2.
+  _gpuScene.upload();
+  _lighting.update(view, projection, near, far, width, height);
+
+  auto deferred{_shadingPath == ShadingPath::Deferred};
+  if (deferred) {
+    _deferred.resize(width, height); // follows the render resolution
+    _deferred.beginGeometry();
+  } else {
+    glCheck(glEnable(GL_DEPTH_TEST));
+  }
+  auto &program{_programs[size_t(_shadingPath)]};
+  glCheck(glUseProgram(program.id));
+  _lighting.bind();
+  _gpuScene.bind(objectsBinding);
+  glCheck(glUniformMatrix4fv(program.viewProjectionLoc, 1, GL_FALSE,
+                             glm::value_ptr(viewProjection)));
+  glCheck(glUniformMatrix4fv(program.previousViewProjectionLoc, 1, GL_FALSE,
+                             glm::value_ptr(_previousViewProjection)));
+  glCheck(glUniformMatrix4fv(program.jitterLoc, 1, GL_FALSE,
+                             glm::value_ptr(jitter)));
+  glCheck(glUniform3fv(program.eyeLoc, 1, glm::value_ptr(eye)));
+  auto boundInstance{~uint32_t{}};
+  GLuint boundTexture{};
+  for (size_t d{}; d < _lastDrawCount; ++d) {
+    auto &draw{*drawList[d]};
+    if (draw.instance != boundInstance) {
+      auto &instance{_instances[draw.instance]};
+      glCheck(glUniform1ui(program.objectLoc, draw.instance));
+      glCheck(glUniform3fv(program.boundsMinLoc, 1,
+                           glm::value_ptr(instance.boundsMin)));
+      glCheck(glUniform3fv(program.boundsExtentLoc, 1,
+                           glm::value_ptr(instance.boundsExtent)));
+      glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, materialsBinding,
+                               instance.buffers[2]));
+      glCheck(glBindVertexArray(instance.vertexArray));
+      boundInstance = draw.instance;
+    }
+    if (draw.texture && draw.texture != boundTexture) {
+      glCheck(glBindTextureUnit(diffuseTextureUnit, draw.texture));
+      boundTexture = draw.texture;
+    }
+    glCheck(glUniform1ui(program.materialLoc, draw.submesh.material));
+    glCheck(glDrawElements(
+        GL_TRIANGLES, GLsizei(draw.submesh.indexCount), GL_UNSIGNED_INT,
+        reinterpret_cast<const void *>(draw.submesh.firstIndex *
+                                       sizeof(uint32_t))));
+  }
+  if (deferred)
+    _deferred.light(_lighting, projection, _background);
+  glCheck(glDisable(GL_DEPTH_TEST));
+  _previousViewProjection = viewProjection;
+}
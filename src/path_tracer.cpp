@@ -0,0 +1,400 @@
+#include "path_tracer.hpp"
+#include "simd_transform.hpp"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/matrix.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+constexpr float pi{3.14159265358979f};
+// Bounces that always continue before Russian roulette may end a path.
+constexpr size_t guaranteedBounces{3};
+
+// PCG (O'Neill 2014), one stream per pixel and sample.
+uint32_t nextRandom(uint32_t &state) {
+  state = state * 747796405u + 2891336453u;
+  auto word{((state >> ((state >> 28) + 4)) ^ state) * 277803737u};
+  return (word >> 22) ^ word;
+}
+
+float uniform(uint32_t &state) {
+  return float(nextRandom(state) >> 8) * (1.0f / 16777216);
+}
+
+float luminance(glm::vec3 color) {
+  return glm::dot(color, glm::vec3{0.2126f, 0.7152f, 0.0722f});
+}
+
+// Some unit vectors perpendicular to n and to each other (Duff et al. 2017).
+void basis(glm::vec3 n, glm::vec3 &tangent, glm::vec3 &bitangent) {
+  auto sign{std::copysign(1.0f, n.z)};
+  auto a{-1 / (sign + n.z)}, b{n.x * n.y * a};
+  tangent = {1 + sign * n.x * n.x * a, sign * b, -sign * n.x};
+  bitangent = {b, sign + n.y * n.y * a, -n.y};
+}
+
+glm::vec3 toWorld(glm::vec3 local, glm::vec3 n) {
+  glm::vec3 tangent, bitangent;
+  basis(n, tangent, bitangent);
+  return local.x * tangent + local.y * bitangent + local.z * n;
+}
+
+glm::vec3 sampleCosine(glm::vec3 n, uint32_t &random) {
+  auto r{std::sqrt(uniform(random))}, phi{2 * pi * uniform(random)};
+  return toWorld({r * std::cos(phi), r * std::sin(phi),
+                  std::sqrt(std::max(0.0f, 1 - r * r))},
+                 n);
+}
+
+// Smith's masking term for GGX.
+float smithG1(float cosine, float alpha) {
+  auto alpha2{alpha * alpha};
+  return 2 * cosine /
+         (cosine + std::sqrt(alpha2 + (1 - alpha2) * cosine * cosine));
+}
+
+float fresnelDielectric(float cosIncident, float eta) {
+  auto sin2Transmitted{eta * eta * (1 - cosIncident * cosIncident)};
+  if (sin2Transmitted >= 1)
+    return 1;
+  auto cosTransmitted{std::sqrt(1 - sin2Transmitted)};
+  auto parallel{(cosIncident - eta * cosTransmitted) /
+                (cosIncident + eta * cosTransmitted)};
+  auto perpendicular{(eta * cosIncident - cosTransmitted) /
+                     (eta * cosIncident + cosTransmitted)};
+  return 0.5f * (parallel * parallel + perpendicular * perpendicular);
+}
+
+float srgb(float linear) {
+  linear = std::clamp(linear, 0.0f, 1.0f);
+  return linear <= 0.0031308f ? 12.92f * linear
+                              : 1.055f * std::pow(linear, 1 / 2.4f) - 0.055f;
+}
+
+void addQuad(Mesh &mesh, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d,
+             uint32_t material) {
+  auto normal{glm::normalize(glm::cross(b - a, c - a))};
+  auto first{uint32_t(mesh.vertices.size())};
+  for (auto corner : {a, b, c, d})
+    mesh.vertices.push_back({corner, normal, {}});
+  auto firstIndex{uint32_t(mesh.indices.size())};
+  mesh.indices.insert(mesh.indices.end(), {first, first + 1, first + 2, first,
+                                           first + 2, first + 3});
+  mesh.submeshes.push_back({firstIndex, 6, material});
+}
+
+// An upright box standing on y = -1, turned by angle around its axis.
+void addBlock(Mesh &mesh, glm::vec2 center, glm::vec3 halfSize, float angle,
+              uint32_t material) {
+  auto corner{[&](int x, int y, int z) {
+    auto c{std::cos(angle)}, s{std::sin(angle)};
+    glm::vec2 offset{x * halfSize.x, z * halfSize.z};
+    return glm::vec3{center.x + c * offset.x - s * offset.y,
+                     -1 + (y + 1) * halfSize.y,
+                     center.y + s * offset.x + c * offset.y};
+  }};
+  addQuad(mesh, corner(-1, 1, -1), corner(-1, 1, 1), corner(1, 1, 1),
+          corner(1, 1, -1), material);
+  addQuad(mesh, corner(-1, -1, 1), corner(1, -1, 1), corner(1, 1, 1),
+          corner(-1, 1, 1), material);
+  addQuad(mesh, corner(1, -1, -1), corner(-1, -1, -1), corner(-1, 1, -1),
+          corner(1, 1, -1), material);
+  addQuad(mesh, corner(-1, -1, -1), corner(-1, -1, 1), corner(-1, 1, 1),
+          corner(-1, 1, -1), material);
+  addQuad(mesh, corner(1, -1, 1), corner(1, -1, -1), corner(1, 1, -1),
+          corner(1, 1, 1), material);
+}
+} // namespace
+
+PathTracer::PathTracer(size_t width, size_t height)
+    : _width{width}, _height{height}, _tilesX{(width + tileSize - 1) /
+                                              tileSize},
+      _tilesY{(height + tileSize - 1) / tileSize},
+      _accumulated(width * height) {}
+
+uint32_t PathTracer::addMesh(const Mesh &mesh) {
+  MeshData data{&mesh, std::make_unique<MeshBvh>(mesh), {}};
+  data.triangleMaterials.resize(mesh.indices.size() / 3);
+  for (auto &submesh : mesh.submeshes)
+    std::fill_n(data.triangleMaterials.begin() + submesh.firstIndex / 3,
+                submesh.indexCount / 3, submesh.material);
+  _meshes.push_back(std::move(data));
+  return uint32_t(_meshes.size() - 1);
+}
+
+void PathTracer::addInstance(uint32_t mesh, const glm::mat4 &transform) {
+  _instances.push_back({mesh, transform,
+                        glm::transpose(glm::inverse(glm::mat3{transform}))});
+  _bvh.addInstance(*_meshes.at(mesh).bvh, transform);
+  _bvhBuilt = false;
+  _sampleCount = 0;
+}
+
+void PathTracer::setCamera(const glm::mat4 &view,
+                           const glm::mat4 &projection) {
+  _inverseViewProjection = glm::inverse(projection * view);
+  _sampleCount = 0;
+}
+
+void PathTracer::setSkyColor(glm::vec3 color) {
+  _skyColor = color;
+  _sampleCount = 0;
+}
+
+void PathTracer::render(size_t samplesPerPixel, JobSystem *jobs) {
+  if (!_bvhBuilt) {
+    _bvh.build();
+    _bvhBuilt = true;
+  }
+  if (!_sampleCount)
+    std::fill(_accumulated.begin(), _accumulated.end(), glm::vec3{0});
+  auto renderTiles{[&](size_t first, size_t last) {
+    for (auto tile{first}; tile < last; ++tile)
+      renderTile(tile, samplesPerPixel);
+  }};
+  auto tileCount{_tilesX * _tilesY};
+  if (jobs)
+    jobs->parallelFor(0, tileCount, 1, renderTiles);
+  else
+    renderTiles(0, tileCount);
+  _sampleCount += samplesPerPixel;
+}
+
+void PathTracer::renderTile(size_t tile, size_t samples) {
+  auto x0{tile % _tilesX * tileSize}, y0{tile / _tilesX * tileSize};
+  auto x1{std::min(x0 + tileSize, _width)};
+  auto y1{std::min(y0 + tileSize, _height)};
+  for (auto y{y0}; y < y1; ++y)
+    for (auto x{x0}; x < x1; ++x) {
+      glm::vec3 sum{0};
+      for (size_t sample{}; sample < samples; ++sample) {
+        // Seeded by pixel and sample, so images don't depend on how the
+        // tiles were scheduled.
+        auto random{uint32_t(y * _width + x)};
+        nextRandom(random);
+        random += uint32_t(_sampleCount + sample) * 0x9e3779b9u;
+        nextRandom(random);
+
+        glm::vec2 ndc{2 * (float(x) + uniform(random)) / float(_width) - 1,
+                      1 - 2 * (float(y) + uniform(random)) / float(_height)};
+        auto nearPoint{_inverseViewProjection * glm::vec4{ndc, -1, 1}};
+        auto farPoint{_inverseViewProjection * glm::vec4{ndc, 1, 1}};
+        glm::vec3 origin{nearPoint / nearPoint.w};
+        glm::vec3 target{farPoint / farPoint.w};
+        auto color{radiance({origin, glm::normalize(target - origin)}, random)};
+        // Fireflies from rare, bright paths would take forever to average
+        // out; NaNs from degenerate geometry would never.
+        if (std::isfinite(color.x + color.y + color.z))
+          sum += glm::min(color, glm::vec3{64});
+      }
+      _accumulated[y * _width + x] += sum;
+    }
+}
+
+glm::vec3 PathTracer::radiance(Ray ray, uint32_t &random) const {
+  static const Material defaultMaterial;
+  glm::vec3 result{0}, throughput{1};
+  for (size_t bounce{}; bounce < maxBounces; ++bounce) {
+    RayHit hit;
+    if (!_bvh.intersect(ray, hit)) {
+      result += throughput * _skyColor;
+      break;
+    }
+
+    auto &instance{_instances[hit.instance]};
+    auto &data{_meshes[instance.mesh]};
+    auto &mesh{*data.mesh};
+    auto &v0{mesh.vertices[mesh.indices[3 * hit.triangle]]};
+    auto &v1{mesh.vertices[mesh.indices[3 * hit.triangle + 1]]};
+    auto &v2{mesh.vertices[mesh.indices[3 * hit.triangle + 2]]};
+    auto u{hit.barycentrics.x}, v{hit.barycentrics.y};
+    auto geometric{glm::normalize(
+        instance.normalToWorld *
+        glm::cross(v1.position - v0.position, v2.position - v0.position))};
+    auto normal{glm::normalize(
+        instance.normalToWorld *
+        ((1 - u - v) * v0.normal + u * v1.normal + v * v2.normal))};
+    auto entering{glm::dot(ray.direction, geometric) < 0};
+    if (!entering)
+      geometric = -geometric;
+    if (glm::dot(normal, geometric) < 0)
+      normal = -normal;
+    auto materialIndex{data.triangleMaterials[hit.triangle]};
+    auto &material{materialIndex < mesh.materials.size()
+                       ? mesh.materials[materialIndex]
+                       : defaultMaterial};
+
+    auto position{ray.origin + hit.t * ray.direction};
+    auto offset{1e-4f * (1 + std::max({std::abs(position.x),
+                                       std::abs(position.y),
+                                       std::abs(position.z)}))};
+    result += throughput * material.ke;
+    if (material.illum == 0) {
+      result += throughput * material.kd;
+      break;
+    }
+
+    if (uniform(random) >= material.d) {
+      // Transmitted, through glass or a hole in the surface.
+      auto direction{ray.direction};
+      if (material.illum == 6 || material.illum == 7) {
+        auto eta{entering ? 1 / material.ni : material.ni};
+        auto cosIncident{-glm::dot(ray.direction, normal)};
+        if (uniform(random) < fresnelDielectric(cosIncident, eta)) {
+          ray = {position + offset * geometric,
+                 glm::reflect(ray.direction, normal)};
+          continue;
+        }
+        direction = glm::refract(ray.direction, normal, eta);
+      }
+      ray = {position - offset * geometric, direction};
+      continue;
+    }
+
+    // One lobe per bounce, picked by how much each reflects.
+    auto diffuseWeight{luminance(material.kd)};
+    auto specularWeight{material.illum >= 2 ? luminance(material.ks) : 0.0f};
+    if (diffuseWeight + specularWeight <= 0)
+      break;
+    auto specularChance{specularWeight / (diffuseWeight + specularWeight)};
+    auto outgoing{-ray.direction};
+    glm::vec3 direction;
+    if (uniform(random) < specularChance) {
+      auto alpha{std::max(std::sqrt(2 / (material.ns + 2)), 1e-3f)};
+      // Half vector drawn from D(h) cos(theta_h).
+      auto xi{uniform(random)};
+      auto tan2Theta{alpha * alpha * xi / (1 - xi)};
+      auto cosTheta{1 / std::sqrt(1 + tan2Theta)};
+      auto sinTheta{std::sqrt(std::max(0.0f, 1 - cosTheta * cosTheta))};
+      auto phi{2 * pi * uniform(random)};
+      auto half{toWorld({sinTheta * std::cos(phi), sinTheta * std::sin(phi),
+                         cosTheta},
+                        normal)};
+      direction = glm::reflect(ray.direction, half);
+      auto cosOut{glm::dot(normal, outgoing)};
+      auto cosIn{glm::dot(normal, direction)};
+      auto cosHalf{glm::dot(outgoing, half)};
+      if (cosIn <= 0 || cosOut <= 0 || cosHalf <= 0)
+        break;
+      auto fresnel{material.ks +
+                   (glm::vec3{1} - material.ks) * std::pow(1 - cosHalf, 5.0f)};
+      // f cos / pdf, with pdf = D cos(theta_h) / (4 (o.h)).
+      throughput *= fresnel * smithG1(cosOut, alpha) * smithG1(cosIn, alpha) *
+                    cosHalf / (cosOut * cosTheta * specularChance);
+    } else {
+      direction = sampleCosine(normal, random);
+      throughput *= material.kd / (1 - specularChance);
+    }
+    if (glm::dot(direction, geometric) <= 0)
+      break;
+    ray = {position + offset * geometric, direction};
+
+    if (bounce >= guaranteedBounces) {
+      auto survival{std::min(0.95f, std::max({throughput.x, throughput.y,
+                                              throughput.z}))};
+      if (uniform(random) >= survival)
+        break;
+      throughput /= survival;
+    }
+  }
+  return result;
+}
+
+Image PathTracer::image() const {
+  Image image{_width, _height};
+  auto scale{_sampleCount ? 1.0f / float(_sampleCount) : 0.0f};
+  for (size_t i{}; i < _accumulated.size(); ++i)
+    for (int channel{}; channel < 3; ++channel)
+      image.data()[i * 3 + size_t(channel)] = uint8_t(
+          std::lround(srgb(_accumulated[i][channel] * scale) * 255));
+  return image;
+}
+
+Mesh cornellBox() {
+  Mesh mesh;
+  mesh.materials.resize(6);
+  auto &white{mesh.materials[0]}, &red{mesh.materials[1]};
+  auto &green{mesh.materials[2]}, &light{mesh.materials[3]};
+  auto &metal{mesh.materials[4]}, &glass{mesh.materials[5]};
+  for (auto [material, name] :
+       {std::pair{&white, "white"}, {&red, "red"}, {&green, "green"},
+        {&light, "light"}, {&metal, "metal"}, {&glass, "glass"}})
+    material->name = name;
+  white.kd = {0.73f, 0.73f, 0.73f};
+  red.kd = {0.65f, 0.05f, 0.05f};
+  green.kd = {0.12f, 0.45f, 0.15f};
+  for (auto material : {&white, &red, &green, &light})
+    material->ks = glm::vec3{0}, material->illum = 1;
+  light.kd = glm::vec3{0};
+  light.ke = glm::vec3{15};
+  metal.kd = glm::vec3{0.05f};
+  metal.ks = {0.9f, 0.75f, 0.5f};
+  metal.ns = 400;
+  metal.illum = 3;
+  glass.kd = glm::vec3{0};
+  glass.ks = glm::vec3{0};
+  glass.d = 0;
+  glass.ni = 1.5f;
+  glass.illum = 7;
+
+  addQuad(mesh, {-1, -1, 1}, {1, -1, 1}, {1, -1, -1}, {-1, -1, -1}, 0);
+  addQuad(mesh, {-1, 1, -1}, {1, 1, -1}, {1, 1, 1}, {-1, 1, 1}, 0);
+  addQuad(mesh, {-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1}, 0);
+  addQuad(mesh, {-1, -1, 1}, {-1, -1, -1}, {-1, 1, -1}, {-1, 1, 1}, 1);
+  addQuad(mesh, {1, -1, -1}, {1, -1, 1}, {1, 1, 1}, {1, 1, -1}, 2);
+  addQuad(mesh, {-0.25f, 0.999f, -0.25f}, {0.25f, 0.999f, -0.25f},
+          {0.25f, 0.999f, 0.25f}, {-0.25f, 0.999f, 0.25f}, 3);
+  addBlock(mesh, {-0.35f, -0.3f}, {0.3f, 0.6f, 0.3f}, 0.3f, 4);
+  addBlock(mesh, {0.35f, 0.35f}, {0.3f, 0.3f, 0.3f}, -0.3f, 5);
+  return mesh;
+}
+
+void renderReferenceImage(const Mesh *mesh,
+                          const std::filesystem::path &ppmPath,
+                          size_t samplesPerPixel, JobSystem *jobs) {
+  auto box{mesh ? Mesh{} : cornellBox()};
+  if (!mesh)
+    mesh = &box;
+  constexpr size_t width{512}, height{512};
+  PathTracer tracer{width, height};
+  tracer.addInstance(tracer.addMesh(*mesh), glm::mat4{1});
+
+  glm::vec3 lo{std::numeric_limits<float>::infinity()}, hi{-lo};
+  for (auto &vertex : mesh->vertices)
+    lo = glm::min(lo, vertex.position), hi = glm::max(hi, vertex.position);
+  auto center{(lo + hi) * 0.5f};
+  auto radius{std::max(glm::length(hi - lo) * 0.5f, 1e-3f)};
+  constexpr auto fov{glm::radians(40.0f)};
+  // The Cornell box is seen through its open side; other meshes from far
+  // enough for their bounding sphere to fit.
+  auto distance{mesh == &box ? 3.75f : radius / std::sin(fov / 2)};
+  glm::vec3 eye{center.x, center.y, (mesh == &box ? 0 : center.z) + distance};
+  tracer.setCamera(glm::lookAt(eye, center, glm::vec3{0, 1, 0}),
+                   glm::perspective(fov, float(width) / height,
+                                    distance * 0.01f, distance + 2 * radius));
+  // Meshes without lights of their own are lit by a white sky.
+  auto emissive{std::any_of(mesh->materials.begin(), mesh->materials.end(),
+                            [](const Material &material) {
+                              return luminance(material.ke) > 0;
+                            })};
+  tracer.setSkyColor(glm::vec3{emissive ? 0.0f : 1.0f});
+
+  for (size_t pass{1}; tracer.samplesPerPixel() < samplesPerPixel;
+       pass = std::min(2 * pass, samplesPerPixel - tracer.samplesPerPixel())) {
+    auto start{std::chrono::steady_clock::now()};
+    tracer.render(pass, jobs);
+    std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() -
+                                          start};
+    std::printf("%zu spp: %.2f M samples/s (%s, %zu threads)\n",
+                tracer.samplesPerPixel(),
+                double(width * height * pass) / elapsed.count() * 1e-6,
+                simdLevelName(simdLevel()), jobs ? jobs->threadCount() : 1);
+  }
+  tracer.image().savePpm(ppmPath);
+}
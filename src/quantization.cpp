@@ -0,0 +1,127 @@
+#include "quantization.hpp"
+#include "gl_util.hpp"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/packing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+
+namespace {
+glm::vec2 signNotZero(glm::vec2 v) {
+  return {v.x >= 0 ? 1.0f : -1.0f, v.y >= 0 ? 1.0f : -1.0f};
+}
+
+float toDegrees(float radians) { return radians * 57.2957795f; }
+} // namespace
+
+const char *const quantizedVertexInputSource{R"(
+  layout (location = 0) in vec3 position; // unorm16, [0, 1] within the bounds
+  layout (location = 1) in vec2 normal;   // snorm8, octahedral
+  layout (location = 2) in vec2 uv;       // half float
+
+  vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0)));
+    return normalize(n);
+  }
+)"};
+
+glm::vec2 encodeOctahedral(glm::vec3 n) {
+  n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  glm::vec2 e{n};
+  if (n.z < 0)
+    e = (1.0f - glm::abs(glm::vec2{e.y, e.x})) * signNotZero(e);
+  return e;
+}
+
+glm::vec3 decodeOctahedral(glm::vec2 e) {
+  glm::vec3 n{e, 1 - std::abs(e.x) - std::abs(e.y)};
+  auto t{std::max(-n.z, 0.0f)};
+  n.x += n.x >= 0 ? -t : t;
+  n.y += n.y >= 0 ? -t : t;
+  return glm::normalize(n);
+}
+
+glm::mat4 QuantizedMesh::dequantization() const {
+  return glm::scale(glm::translate(glm::mat4{1}, boundsMin), boundsExtent);
+}
+
+QuantizedMesh quantizeMesh(const Mesh &mesh, QuantizationError *error) {
+  QuantizedMesh result;
+  glm::vec3 lo{1e30f}, hi{-1e30f};
+  for (auto &vertex : mesh.vertices)
+    lo = glm::min(lo, vertex.position), hi = glm::max(hi, vertex.position);
+  if (mesh.vertices.empty())
+    lo = hi = glm::vec3{0};
+  result.boundsMin = lo;
+  result.boundsExtent = hi - lo;
+  for (size_t axis{}; axis < 3; ++axis)
+    if (result.boundsExtent[axis] <= 0)
+      result.boundsExtent[axis] = 1;
+
+  if (error)
+    *error = {};
+  result.vertices.reserve(mesh.vertices.size());
+  for (auto &vertex : mesh.vertices) {
+    QuantizedVertex q{};
+    auto normalized{(vertex.position - lo) / result.boundsExtent};
+    for (size_t axis{}; axis < 3; ++axis)
+      q.position[axis] = uint16_t(
+          std::lround(glm::clamp(normalized[axis], 0.0f, 1.0f) * 65535.0f));
+
+    // Rounding each component to nearest isn't always the closest direction
+    // once decoded, so try all four neighbours (Cigolle et al. 2014).
+    auto n{glm::normalize(vertex.normal)};
+    auto e{encodeOctahedral(n) * 127.0f};
+    float bestDot{-2};
+    for (int corner{}; corner < 4; ++corner) {
+      glm::vec2 candidate{corner & 1 ? std::ceil(e.x) : std::floor(e.x),
+                          corner & 2 ? std::ceil(e.y) : std::floor(e.y)};
+      candidate = glm::clamp(candidate, -127.0f, 127.0f);
+      auto d{glm::dot(decodeOctahedral(candidate / 127.0f), n)};
+      if (d > bestDot) {
+        bestDot = d;
+        q.normal[0] = int8_t(candidate.x), q.normal[1] = int8_t(candidate.y);
+      }
+    }
+
+    auto uv{glm::packHalf2x16(vertex.uv)};
+    q.uv[0] = uint16_t(uv), q.uv[1] = uint16_t(uv >> 16);
+    result.vertices.push_back(q);
+
+    if (error) {
+      auto decoded{lo + glm::vec3(q.position[0], q.position[1], q.position[2]) /
+                            65535.0f * result.boundsExtent};
+      error->maxPosition = std::max(error->maxPosition,
+                                    glm::distance(decoded, vertex.position));
+      error->maxNormalDegrees =
+          std::max(error->maxNormalDegrees,
+                   toDegrees(std::acos(glm::clamp(bestDot, -1.0f, 1.0f))));
+      auto uvError{glm::abs(glm::unpackHalf2x16(uv) - vertex.uv)};
+      error->maxUv = std::max({error->maxUv, uvError.x, uvError.y});
+    }
+  }
+  return result;
+}
+
+void setupQuantizedVertexArray(GLuint vao, GLuint vertexBuffer) {
+  glCheck(glVertexArrayVertexBuffer(vao, 0, vertexBuffer, 0,
+                                    sizeof(QuantizedVertex)));
+  glCheck(glVertexArrayAttribFormat(vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+                                    offsetof(QuantizedVertex, position)));
+  glCheck(glVertexArrayAttribFormat(vao, 1, 2, GL_BYTE, GL_TRUE,
+                                    offsetof(QuantizedVertex, normal)));
+  glCheck(glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE,
+                                    offsetof(QuantizedVertex, uv)));
+  for (GLuint attribute{}; attribute < 3; ++attribute) {
+    glCheck(glVertexArrayAttribBinding(vao, attribute, 0));
+    glCheck(glEnableVertexArrayAttrib(vao, attribute));
+  }
+}
@@ -0,0 +1,338 @@
+#include "scene.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace {
+// Levels smaller than this aren't worth splitting into jobs; also the
+// size of the jobs.
+constexpr size_t minParallelLevel{4096};
+
+glm::mat4 localMatrix(glm::vec3 position, glm::quat rotation,
+                      glm::vec3 scale) {
+  auto r{glm::mat3_cast(rotation)};
+  return {glm::vec4{r[0] * scale.x, 0}, glm::vec4{r[1] * scale.y, 0},
+          glm::vec4{r[2] * scale.z, 0}, glm::vec4{position, 1}};
+}
+
+// a * b for matrices whose last row is (0, 0, 0, 1), which is all that
+// localMatrix() produces: 48 multiplies instead of 64.
+glm::mat4 affineProduct(const glm::mat4 &a, const glm::mat4 &b) {
+  glm::mat4 result;
+  for (int column{}; column < 3; ++column)
+    result[column] =
+        a[0] * b[column].x + a[1] * b[column].y + a[2] * b[column].z;
+  result[3] = a[0] * b[3].x + a[1] * b[3].y + a[2] * b[3].z + a[3];
+  return result;
+}
+
+template <typename T>
+void permute(std::vector<T> &values, const std::vector<uint32_t> &order) {
+  std::vector<T> permuted;
+  permuted.reserve(values.size());
+  for (auto slot : order)
+    permuted.push_back(std::move(values[slot]));
+  values = std::move(permuted);
+}
+} // namespace
+
+void Scene::reserve(size_t nodeCount) {
+  _positions.reserve(nodeCount);
+  _rotations.reserve(nodeCount);
+  _scales.reserve(nodeCount);
+  _worldMatrices.reserve(nodeCount);
+  _parents.reserve(nodeCount);
+  _depths.reserve(nodeCount);
+  _firstChildren.reserve(nodeCount);
+  _childCounts.reserve(nodeCount);
+  _dirty.reserve(nodeCount);
+  _names.reserve(nodeCount);
+  _handles.reserve(nodeCount);
+  _slots.reserve(nodeCount);
+  _dirtyNodes.reserve(nodeCount);
+}
+
+NodeHandle Scene::createNode(std::string_view name, NodeHandle parent) {
+  auto parentSlot{parent == noNode ? noNode : _slots.at(parent)};
+  auto depth{parent == noNode ? 0 : _depths[parentSlot] + 1};
+  auto handle{NodeHandle(_slots.size())};
+  auto slot{uint32_t(_handles.size())};
+
+  // Appending a node no shallower than the last one, and with a parent no
+  // earlier than its, keeps the order; the level and child bookkeeping is
+  // rebuilt by sortByDepth() otherwise.
+  if (!_depths.empty() &&
+      (depth < _depths.back() ||
+       (depth == _depths.back() && parentSlot < _parents.back()))) {
+    _sorted = false;
+  } else if (_sorted) {
+    if (_levelStarts.empty())
+      _levelStarts.push_back(slot);
+    if (depth == _levelStarts.size() - 1)
+      _levelStarts.push_back(slot + 1);
+    else
+      _levelStarts.back() = slot + 1;
+    if (parentSlot != noNode && !_childCounts[parentSlot]++)
+      _firstChildren[parentSlot] = slot;
+  }
+
+  _positions.emplace_back(0);
+  _rotations.emplace_back(1, 0, 0, 0);
+  _scales.emplace_back(1);
+  _worldMatrices.emplace_back(1);
+  _parents.push_back(parentSlot);
+  _depths.push_back(depth);
+  _firstChildren.push_back(0);
+  _childCounts.push_back(0);
+  _dirty.push_back(1);
+  _names.emplace_back(name);
+  _handles.push_back(handle);
+  _slots.push_back(slot);
+  _dirtyNodes.push_back(handle);
+  return handle;
+}
+
+const std::string &Scene::name(NodeHandle node) const {
+  return _names[_slots.at(node)];
+}
+
+NodeHandle Scene::parent(NodeHandle node) const {
+  auto parentSlot{_parents[_slots.at(node)]};
+  return parentSlot == noNode ? noNode : _handles[parentSlot];
+}
+
+glm::vec3 Scene::position(NodeHandle node) const {
+  return _positions[_slots.at(node)];
+}
+
+glm::quat Scene::rotation(NodeHandle node) const {
+  return _rotations[_slots.at(node)];
+}
+
+glm::vec3 Scene::scale(NodeHandle node) const {
+  return _scales[_slots.at(node)];
+}
+
+void Scene::setPosition(NodeHandle node, glm::vec3 position) {
+  auto slot{_slots.at(node)};
+  _positions[slot] = position;
+  if (!_dirty[slot])
+    _dirty[slot] = 1, _dirtyNodes.push_back(node);
+}
+
+void Scene::setRotation(NodeHandle node, glm::quat rotation) {
+  auto slot{_slots.at(node)};
+  _rotations[slot] = rotation;
+  if (!_dirty[slot])
+    _dirty[slot] = 1, _dirtyNodes.push_back(node);
+}
+
+void Scene::setScale(NodeHandle node, glm::vec3 scale) {
+  auto slot{_slots.at(node)};
+  _scales[slot] = scale;
+  if (!_dirty[slot])
+    _dirty[slot] = 1, _dirtyNodes.push_back(node);
+}
+
+const glm::mat4 &Scene::worldMatrix(NodeHandle node) const {
+  return _worldMatrices[_slots.at(node)];
+}
+
+void Scene::sortByDepth() {
+  std::vector<uint32_t> order(_handles.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return _depths[a] < _depths[b];
+  });
+  // Then each level by where its parents went, which the level above has
+  // just settled, so that siblings end up next to each other.
+  std::vector<uint32_t> newSlots(order.size());
+  for (uint32_t first{}, last{}; first < order.size(); first = last) {
+    last = first;
+    while (last < order.size() && _depths[order[last]] == _depths[order[first]])
+      ++last;
+    if (_depths[order[first]] > 0)
+      std::stable_sort(order.begin() + first, order.begin() + last,
+                       [&](uint32_t a, uint32_t b) {
+                         return newSlots[_parents[a]] < newSlots[_parents[b]];
+                       });
+    for (auto slot{first}; slot < last; ++slot)
+      newSlots[order[slot]] = slot;
+  }
+
+  permute(_positions, order);
+  permute(_rotations, order);
+  permute(_scales, order);
+  permute(_worldMatrices, order);
+  permute(_parents, order);
+  permute(_depths, order);
+  permute(_dirty, order);
+  permute(_names, order);
+  permute(_handles, order);
+  for (auto &parent : _parents)
+    if (parent != noNode)
+      parent = newSlots[parent];
+  for (uint32_t slot{}; slot < _handles.size(); ++slot)
+    _slots[_handles[slot]] = slot;
+  std::fill(_childCounts.begin(), _childCounts.end(), 0);
+  for (uint32_t slot{}; slot < _parents.size(); ++slot)
+    if (auto parent{_parents[slot]};
+        parent != noNode && !_childCounts[parent]++)
+      _firstChildren[parent] = slot;
+
+  _levelStarts.clear();
+  for (uint32_t slot{}; slot < _depths.size(); ++slot)
+    if (slot == 0 || _depths[slot] != _depths[slot - 1])
+      _levelStarts.push_back(slot);
+  _levelStarts.push_back(_depths.size());
+  _sorted = true;
+}
+
+void Scene::updateNodes(const uint32_t *slots, size_t count) {
+  for (size_t i{}; i < count; ++i) {
+    auto slot{slots[i]}, parent{_parents[slot]};
+    auto local{localMatrix(_positions[slot], _rotations[slot], _scales[slot])};
+    _worldMatrices[slot] =
+        parent == noNode ? local : affineProduct(_worldMatrices[parent], local);
+  }
+}
+
+void Scene::updateRange(size_t first, size_t last) {
+  for (auto slot{first}; slot < last; ++slot) {
+    auto parent{_parents[slot]};
+    auto local{localMatrix(_positions[slot], _rotations[slot], _scales[slot])};
+    _worldMatrices[slot] =
+        parent == noNode ? local : affineProduct(_worldMatrices[parent], local);
+  }
+}
+
+void Scene::updateWorldMatrices(JobSystem *jobs) {
+  if (_dirtyNodes.empty())
+    return;
+  if (!_sorted)
+    sortByDepth();
+
+  // The changed nodes start off the list of their level; every level then
+  // hands the children of what it updated to the next one, skipping those
+  // already on it, so only the changed subtrees are visited.
+  auto levelCount{_levelStarts.size() - 1};
+  if (_dirtyLevels.size() < levelCount)
+    _dirtyLevels.resize(levelCount);
+  for (auto node : _dirtyNodes) {
+    auto slot{_slots[node]};
+    _dirtyLevels[_depths[slot]].push_back(slot);
+  }
+  _dirtyNodes.clear();
+
+  // Each level reads the matrices the previous one wrote, so levels run one
+  // after the other and only the nodes within a level are split up. Once a
+  // whole level is dirty so is everything below it, which is then swept
+  // slot by slot instead.
+  bool wholeLevels{};
+  for (size_t level{}; level < levelCount; ++level) {
+    auto first{_levelStarts[level]}, last{_levelStarts[level + 1]};
+    auto &slots{_dirtyLevels[level]};
+    wholeLevels = wholeLevels || slots.size() == last - first;
+    if (wholeLevels) {
+      if (jobs && last - first >= minParallelLevel)
+        jobs->parallelFor(first, last, minParallelLevel,
+                          [this](size_t begin, size_t end) {
+                            updateRange(begin, end);
+                          });
+      else
+        updateRange(first, last);
+      std::fill(_dirty.begin() + ptrdiff_t(first),
+                _dirty.begin() + ptrdiff_t(last), uint8_t{});
+      slots.clear();
+      continue;
+    }
+    if (jobs && slots.size() >= minParallelLevel)
+      jobs->parallelFor(0, slots.size(), minParallelLevel,
+                        [this, &slots](size_t begin, size_t end) {
+                          updateNodes(slots.data() + begin, end - begin);
+                        });
+    else
+      updateNodes(slots.data(), slots.size());
+    for (auto slot : slots) {
+      for (auto child{_firstChildren[slot]},
+           end{child + _childCounts[slot]};
+           child < end; ++child)
+        if (!_dirty[child])
+          _dirty[child] = 1, _dirtyLevels[level + 1].push_back(child);
+      _dirty[slot] = 0;
+    }
+    slots.clear();
+  }
+}
+
+void benchmarkScene(size_t count, JobSystem *jobs) {
+  constexpr size_t branching{8};
+  Scene scene;
+  scene.reserve(count);
+  // Breadth first, so that the nodes arrive already sorted by depth.
+  for (size_t i{}; i < count; ++i)
+    scene.createNode("node", i == 0 ? noNode : NodeHandle((i - 1) / branching));
+
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> offset{-1, 1}, angle{-0.5f, 0.5f};
+  auto randomRotation{[&] {
+    return glm::angleAxis(angle(random), glm::normalize(glm::vec3{
+                                             offset(random), offset(random),
+                                             offset(random) + 2}));
+  }};
+  for (NodeHandle node{}; node < count; ++node) {
+    scene.setPosition(node, {offset(random), offset(random), offset(random)});
+    scene.setRotation(node, randomRotation());
+  }
+  scene.updateWorldMatrices(jobs);
+
+  std::uniform_int_distribution<NodeHandle> anyNode{0, NodeHandle(count - 1)};
+  struct Case {
+    const char *name;
+    size_t changes; // random nodes moved before each update; 0 moves the root
+  };
+  for (auto [name, changes] :
+       {Case{"root moved", 0}, Case{"1% moved", count / 100},
+        Case{"10 moved", 10}, Case{"nothing moved", ~size_t{}}}) {
+    constexpr int runs{10};
+    std::chrono::duration<double, std::milli> elapsed{};
+    for (int run{}; run < runs; ++run) {
+      if (changes == 0)
+        scene.setRotation(0, randomRotation());
+      else if (changes != ~size_t{})
+        for (size_t i{}; i < changes; ++i)
+          scene.setPosition(anyNode(random), {offset(random), offset(random),
+                                              offset(random)});
+      auto start{std::chrono::steady_clock::now()};
+      scene.updateWorldMatrices(jobs);
+      elapsed += std::chrono::steady_clock::now() - start;
+    }
+    std::printf("%zu nodes, %s: %.3f ms (%zu threads)\n", count, name,
+                elapsed.count() / runs, jobs ? jobs->threadCount() : 1);
+  }
+
+  // Straight from the definition: the parent's world matrix times the
+  // node's translation, rotation and scale.
+  float maxError{};
+  for (int sample{}; sample < 1000; ++sample) {
+    auto node{anyNode(random)};
+    glm::mat4 expected{1};
+    for (auto n{node}; n != noNode; n = scene.parent(n))
+      expected = glm::translate(glm::mat4{1}, scene.position(n)) *
+                 glm::mat4_cast(scene.rotation(n)) *
+                 glm::scale(glm::mat4{1}, scene.scale(n)) * expected;
+    auto &actual{scene.worldMatrix(node)};
+    for (int column{}; column < 4; ++column)
+      for (int row{}; row < 4; ++row)
+        maxError = std::max(
+            maxError, std::abs(actual[column][row] - expected[column][row]));
+  }
+  std::printf("largest difference from the recomputation: %g\n", maxError);
+}
@@ -0,0 +1,52 @@
+#include "shader.hpp"
+#include "gl_util.hpp"
+
+#include <cstdio>
+#include <exception>
+
+GLuint compileShader(GLenum type, const char *source) {
+  auto shader{glCreateShader(type)};
+  glCheck(glShaderSource(shader, 1, &source, nullptr));
+  glCheck(glCompileShader(shader));
+  glCheckShaderCompilation(shader);
+  return shader;
+}
+
+GLuint createProgram(const char *vsSrc, const char *fsSrc) {
+  auto vs{compileShader(GL_VERTEX_SHADER, vsSrc)};
+  auto fs{compileShader(GL_FRAGMENT_SHADER, fsSrc)};
+  auto program{glCreateProgram()};
+  glCheck(glAttachShader(program, vs));
+  glCheck(glAttachShader(program, fs));
+  glCheck(glLinkProgram(program));
+  glCheckProgramLinkage(program);
+  glCheck(glDeleteShader(vs));
+  glCheck(glDeleteShader(fs));
+  return program;
+}
+
+GLuint createProgram(const char *vsSrc, const char *gsSrc, const char *fsSrc) {
+  auto vs{compileShader(GL_VERTEX_SHADER, vsSrc)};
+  auto gs{compileShader(GL_GEOMETRY_SHADER, gsSrc)};
+  auto fs{compileShader(GL_FRAGMENT_SHADER, fsSrc)};
+  auto program{glCreateProgram()};
+  glCheck(glAttachShader(program, vs));
+  glCheck(glAttachShader(program, gs));
+  glCheck(glAttachShader(program, fs));
+  glCheck(glLinkProgram(program));
+  glCheckProgramLinkage(program);
+  glCheck(glDeleteShader(vs));
+  glCheck(glDeleteShader(gs));
+  glCheck(glDeleteShader(fs));
+  return program;
+}
+
+GLuint createComputeProgram(const char *csSrc) {
+  auto cs{compileShader(GL_COMPUTE_SHADER, csSrc)};
+  auto program{glCreateProgram()};
+  glCheck(glAttachShader(program, cs));
+  glCheck(glLinkProgram(program));
+  glCheckProgramLinkage(program);
+  glCheck(glDeleteShader(cs));
+  return program;
+}
@@ -0,0 +1,505 @@
+#include "shadow_maps.hpp"
+#include "gl_util.hpp"
+#include "shader.hpp"
+#include "window.hpp"
+
+#include "glm/common.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+static_assert(CascadedShadowMaps::cascadeCount == 4,
+              "the shaders and ShadowStats assume four cascades");
+
+constexpr float splitLambda{0.75f};  // 1 logarithmic, 0 uniform
+constexpr float cachedMargin{1.25f}; // radius scale of cached cascades
+
+constexpr auto vsSrc{R"(
+  #version 450
+
+  layout (location = 0) in vec3 position;
+
+  uniform mat4 model;
+
+  out vec3 worldPosition;
+
+  void main(void) {
+    worldPosition = (model * vec4(position, 1)).xyz;
+  }
+)"};
+
+// One instance per cascade; those not being drawn, or that the caster does
+// not reach, emit nothing.
+constexpr auto gsSrc{R"(
+  #version 450
+
+  layout (triangles, invocations = 4) in;
+  layout (triangle_strip, max_vertices = 3) out;
+
+  layout (std140, binding = 3) uniform ShadowParams {
+    mat4 shadowViewProjection[4];
+    vec4 shadowSplits;
+    vec4 shadowTexelSizes;
+    vec4 shadowToLight;
+  };
+
+  uniform uint cascadeMask;
+
+  in vec3 worldPosition[];
+
+  void main(void) {
+    if ((cascadeMask & (1u << gl_InvocationID)) == 0u)
+      return;
+    for (int i = 0; i < 3; ++i) {
+      gl_Layer = gl_InvocationID;
+      gl_Position = shadowViewProjection[gl_InvocationID]
+                    * vec4(worldPosition[i], 1);
+      EmitVertex();
+    }
+    EndPrimitive();
+  }
+)"};
+
+constexpr auto fsSrc{R"(
+  #version 450
+
+  void main(void) {}
+)"};
+} // namespace
+
+const char *const shadowSource{R"(
+  layout (std140, binding = 3) uniform ShadowParams {
+    mat4 shadowViewProjection[4];
+    vec4 shadowSplits;      // far depth of each cascade
+    vec4 shadowTexelSizes;  // world size of a texel in each cascade
+    vec4 shadowToLight;
+  };
+  layout (binding = 8) uniform sampler2DArrayShadow shadowMap;
+
+  float directionalShadow(vec3 position, vec3 normal, float viewDepth) {
+    int cascade = 0;
+    while (cascade < 3 && viewDepth > shadowSplits[cascade])
+      ++cascade;
+    // Pushed off the surface by about a texel, more where the light grazes
+    // it, against acne.
+    vec3 n = normalize(normal);
+    float grazing = 1.0 - abs(dot(n, shadowToLight.xyz));
+    position += n * shadowTexelSizes[cascade] * (0.5 + 1.5 * grazing);
+    vec3 uvz = (shadowViewProjection[cascade] * vec4(position, 1)).xyz;
+    uvz = uvz * 0.5 + 0.5;
+    float texel = 1.0 / float(textureSize(shadowMap, 0).x);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y)
+      for (int x = -1; x <= 1; ++x)
+        lit += texture(shadowMap, vec4(uvz.xy + vec2(x, y) * texel,
+                                       float(cascade), min(uvz.z, 1.0)));
+    return lit / 9.0;
+  }
+)"};
+
+CascadedShadowMaps::CascadedShadowMaps(size_t resolution)
+    : _resolution{resolution} {
+  static_assert(sizeof(Params) == 304,
+                "Params must match the shaders' std140 ShadowParams");
+  _program = createProgram(vsSrc, gsSrc, fsSrc);
+  _modelLoc = glGetUniformLocation(_program, "model");
+  _maskLoc = glGetUniformLocation(_program, "cascadeMask");
+
+  glCheck(glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &_texture));
+  glCheck(glTextureStorage3D(_texture, 1, GL_DEPTH_COMPONENT32F,
+                             GLsizei(resolution), GLsizei(resolution),
+                             GLsizei(cascadeCount)));
+  glCheck(glTextureParameteri(_texture, GL_TEXTURE_COMPARE_MODE,
+                              GL_COMPARE_REF_TO_TEXTURE));
+  glCheck(glTextureParameteri(_texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL));
+  glCheck(glTextureParameteri(_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+  glCheck(glTextureParameteri(_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  // Outside the cascades is lit.
+  constexpr float border[]{1, 1, 1, 1};
+  glCheck(glTextureParameteri(_texture, GL_TEXTURE_WRAP_S,
+                              GL_CLAMP_TO_BORDER));
+  glCheck(glTextureParameteri(_texture, GL_TEXTURE_WRAP_T,
+                              GL_CLAMP_TO_BORDER));
+  glCheck(glTextureParameterfv(_texture, GL_TEXTURE_BORDER_COLOR, border));
+  constexpr float farthest{1};
+  glCheck(glClearTexImage(_texture, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
+                          &farthest));
+
+  glCheck(glCreateFramebuffers(1, &_framebuffer));
+  glCheck(glNamedFramebufferTexture(_framebuffer, GL_DEPTH_ATTACHMENT,
+                                    _texture, 0));
+  glCheck(glNamedFramebufferDrawBuffer(_framebuffer, GL_NONE));
+  glCheck(glNamedFramebufferReadBuffer(_framebuffer, GL_NONE));
+  if (glCheckNamedFramebufferStatus(_framebuffer, GL_FRAMEBUFFER) !=
+      GL_FRAMEBUFFER_COMPLETE)
+    throw std::runtime_error{"shadow map framebuffer is incomplete"};
+
+  glCheck(glCreateBuffers(1, &_paramsBuffer));
+  glCheck(glNamedBufferStorage(_paramsBuffer, sizeof(Params), nullptr,
+                               GL_DYNAMIC_STORAGE_BIT));
+  glCheck(glCreateQueries(GL_TIME_ELAPSED, 3, _queries));
+}
+
+CascadedShadowMaps::~CascadedShadowMaps() {
+  glDeleteQueries(3, _queries);
+  glDeleteBuffers(1, &_paramsBuffer);
+  glDeleteFramebuffers(1, &_framebuffer);
+  glDeleteTextures(1, &_texture);
+  glDeleteProgram(_program);
+}
+
+uint32_t CascadedShadowMaps::cascadeMask(const glm::mat4 &lightView,
+                                         glm::vec3 boundsMin,
+                                         glm::vec3 boundsMax) const {
+  glm::vec3 lo{std::numeric_limits<float>::infinity()}, hi{-lo};
+  for (int corner{}; corner < 8; ++corner) {
+    glm::vec4 p{corner & 1 ? boundsMax.x : boundsMin.x,
+                corner & 2 ? boundsMax.y : boundsMin.y,
+                corner & 4 ? boundsMax.z : boundsMin.z, 1};
+    auto q{glm::vec3{lightView * p}};
+    lo = glm::min(lo, q), hi = glm::max(hi, q);
+  }
+  uint32_t mask{};
+  for (size_t k{}; k < cascadeCount; ++k) {
+    auto &cascade{_cascades[k]};
+    auto c{cascade.center};
+    auto r{cascade.radius};
+    // Anything toward the light from the far end may cast into it.
+    if (r > 0 && lo.x <= c.x + r && hi.x >= c.x - r && lo.y <= c.y + r &&
+        hi.y >= c.y - r && hi.z >= c.z - r)
+      mask |= 1u << k;
+  }
+  return mask;
+}
+
+void CascadedShadowMaps::render(const glm::mat4 &view,
+                                const glm::mat4 &projection, float near,
+                                float far, glm::vec3 lightDirection,
+                                const ShadowCaster *casters, size_t count) {
+  auto direction{glm::normalize(lightDirection)};
+  auto up{std::abs(direction.y) > 0.99f ? glm::vec3{1, 0, 0}
+                                        : glm::vec3{0, 1, 0}};
+  auto lightView{glm::lookAt(glm::vec3{0}, direction, up)};
+  auto lightChanged{direction != _lightDirection};
+  _lightDirection = direction;
+
+  // The depth range the casters cover within the view frustum.
+  auto viewProjection{projection * view};
+  auto minDepth{far}, maxDepth{near};
+  for (size_t i{}; i < count; ++i) {
+    auto &caster{casters[i]};
+    uint32_t outside{0x3f};
+    float lo{std::numeric_limits<float>::infinity()}, hi{-lo};
+    for (int corner{}; corner < 8; ++corner) {
+      glm::vec4 p{corner & 1 ? caster.boundsMax.x : caster.boundsMin.x,
+                  corner & 2 ? caster.boundsMax.y : caster.boundsMin.y,
+                  corner & 4 ? caster.boundsMax.z : caster.boundsMin.z, 1};
+      auto clip{viewProjection * p};
+      outside &= uint32_t(clip.x < -clip.w) | uint32_t(clip.x > clip.w) << 1 |
+                 uint32_t(clip.y < -clip.w) << 2 |
+                 uint32_t(clip.y > clip.w) << 3 |
+                 uint32_t(clip.z < -clip.w) << 4 |
+                 uint32_t(clip.z > clip.w) << 5;
+      auto depth{-(view * p).z};
+      lo = std::min(lo, depth), hi = std::max(hi, depth);
+    }
+    if (outside)
+      continue;
+    minDepth = std::min(minDepth, std::max(lo, near));
+    maxDepth = std::max(maxDepth, std::min(hi, far));
+  }
+  if (minDepth >= maxDepth)
+    minDepth = near, maxDepth = far;
+
+  float splits[cascadeCount + 1]{minDepth};
+  for (size_t k{1}; k <= cascadeCount; ++k) {
+    auto t{float(k) / cascadeCount};
+    splits[k] = splitLambda * minDepth * std::pow(maxDepth / minDepth, t) +
+                (1 - splitLambda) * (minDepth + (maxDepth - minDepth) * t);
+  }
+
+  // Directions from the eye through the frustum's corners, at a depth of 1.
+  auto inverseProjection{glm::inverse(projection)};
+  auto viewToLight{lightView * glm::inverse(view)};
+  glm::vec3 directions[4];
+  for (int corner{}; corner < 4; ++corner) {
+    auto p{inverseProjection * glm::vec4{corner & 1 ? 1 : -1,
+                                         corner & 2 ? 1 : -1, -1, 1}};
+    directions[corner] = glm::vec3{p} / -p.z;
+  }
+
+  uint32_t renderMask{_caching ? 0u : (1u << cascadeCount) - 1};
+  for (size_t k{}; k < cascadeCount; ++k) {
+    glm::vec3 corners[8], center{0};
+    for (int i{}; i < 8; ++i) {
+      auto depth{splits[k + (i >> 2)]};
+      corners[i] = glm::vec3{viewToLight *
+                             glm::vec4{directions[i & 3] * depth, 1}};
+      center += corners[i] / 8.0f;
+    }
+    float radius{};
+    for (auto &corner : corners)
+      radius = std::max(radius, glm::length(corner - center));
+
+    auto &cascade{_cascades[k]};
+    auto cached{_caching && k >= firstCachedCascade};
+    if (cached && !lightChanged && cascade.radius > 0 &&
+        std::max(std::abs(center.x - cascade.center.x),
+                 std::abs(center.y - cascade.center.y)) +
+                radius <=
+            cascade.radius &&
+        std::abs(center.z - cascade.center.z) + radius <= cascade.radius)
+      continue;
+
+    // The radius only takes a few values per power of two, and the center
+    // moves by whole texels, so that fits stay put as long as they can.
+    if (cached)
+      radius *= cachedMargin;
+    auto step{std::exp2(std::floor(std::log2(radius))) / 16};
+    radius = std::ceil(radius / step) * step;
+    auto texel{2 * radius / float(_resolution)};
+    center.x = std::floor(center.x / texel) * texel;
+    center.y = std::floor(center.y / texel) * texel;
+    if (!lightChanged && radius == cascade.radius &&
+        center == cascade.center)
+      continue;
+    cascade.center = center;
+    cascade.radius = radius;
+    cascade.viewProjection =
+        glm::ortho(center.x - radius, center.x + radius, center.y - radius,
+                   center.y + radius, -(center.z + radius),
+                   -(center.z - radius)) *
+        lightView;
+    renderMask |= 1u << k;
+  }
+
+  // Cascades where a caster moved, either where it was or where it is.
+  if (_previousModels.size() != count) {
+    renderMask = (1u << cascadeCount) - 1;
+  } else {
+    for (size_t i{}; i < count && renderMask != (1u << cascadeCount) - 1;
+         ++i)
+      if (casters[i].model != _previousModels[i])
+        renderMask |= cascadeMask(lightView, casters[i].boundsMin,
+                                  casters[i].boundsMax) |
+                      cascadeMask(lightView, _previousBounds[2 * i],
+                                  _previousBounds[2 * i + 1]);
+  }
+  _previousModels.resize(count);
+  _previousBounds.resize(2 * count);
+  for (size_t i{}; i < count; ++i) {
+    _previousModels[i] = casters[i].model;
+    _previousBounds[2 * i] = casters[i].boundsMin;
+    _previousBounds[2 * i + 1] = casters[i].boundsMax;
+  }
+
+  Params params{};
+  for (size_t k{}; k < cascadeCount; ++k) {
+    params.viewProjection[k] = _cascades[k].viewProjection;
+    params.splits[k] = splits[k + 1];
+    params.texelSizes[k] = 2 * _cascades[k].radius / float(_resolution);
+  }
+  params.toLight = glm::vec4{-direction, 0};
+  glCheck(glNamedBufferSubData(_paramsBuffer, 0, sizeof(params), &params));
+
+  // The pass from three frames ago has most likely finished by now; if it
+  // has not, this frame reports no time and goes untimed rather than wait.
+  auto querySlot{_frame++ % 3};
+  _stats.gpuMs = 0;
+  GLint available{};
+  if (_queryIssued[querySlot])
+    glCheck(glGetQueryObjectiv(_queries[querySlot],
+                               GL_QUERY_RESULT_AVAILABLE, &available));
+  if (available) {
+    GLuint64 ns{};
+    glCheck(glGetQueryObjectui64v(_queries[querySlot], GL_QUERY_RESULT, &ns));
+    _stats.gpuMs = double(ns) * 1e-6;
+    _queryIssued[querySlot] = false;
+  }
+  for (size_t k{}; k < cascadeCount; ++k)
+    _stats.cascades[k] = {splits[k + 1], bool(renderMask >> k & 1), 0, 0};
+  if (!renderMask)
+    return;
+
+  GLint previousFramebuffer, previousViewport[4];
+  glCheck(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer));
+  glCheck(glGetIntegerv(GL_VIEWPORT, previousViewport));
+  auto depthTest{glIsEnabled(GL_DEPTH_TEST)};
+  auto depthClamp{glIsEnabled(GL_DEPTH_CLAMP)};
+  auto polygonOffset{glIsEnabled(GL_POLYGON_OFFSET_FILL)};
+
+  auto timed{!_queryIssued[querySlot]};
+  if (timed) {
+    glCheck(glBeginQuery(GL_TIME_ELAPSED, _queries[querySlot]));
+    _queryIssued[querySlot] = true;
+  }
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+  glCheck(glViewport(0, 0, GLsizei(_resolution), GLsizei(_resolution)));
+  glCheck(glEnable(GL_DEPTH_TEST));
+  glCheck(glEnable(GL_DEPTH_CLAMP));
+  glCheck(glEnable(GL_POLYGON_OFFSET_FILL));
+  glCheck(glPolygonOffset(1.5f, 4));
+  glCheck(glDepthMask(GL_TRUE));
+  constexpr float farthest{1};
+  for (size_t k{}; k < cascadeCount; ++k)
+    if (renderMask >> k & 1)
+      glCheck(glClearTexSubImage(_texture, 0, 0, 0, GLint(k),
+                                 GLsizei(_resolution), GLsizei(_resolution), 1,
+                                 GL_DEPTH_COMPONENT, GL_FLOAT, &farthest));
+
+  glCheck(glUseProgram(_program));
+  bind();
+  for (size_t i{}; i < count; ++i) {
+    auto &caster{casters[i]};
+    auto mask{cascadeMask(lightView, caster.boundsMin, caster.boundsMax) &
+              renderMask};
+    if (!mask)
+      continue;
+    for (size_t k{}; k < cascadeCount; ++k)
+      if (mask >> k & 1) {
+        ++_stats.cascades[k].casters;
+        _stats.cascades[k].triangles += size_t(caster.indexCount) / 3;
+      }
+    glCheck(glUniform1ui(_maskLoc, mask));
+    glCheck(glUniformMatrix4fv(_modelLoc, 1, GL_FALSE,
+                               glm::value_ptr(caster.model)));
+    glCheck(glBindVertexArray(caster.vertexArray));
+    glCheck(glDrawElements(
+        GL_TRIANGLES, caster.indexCount, GL_UNSIGNED_INT,
+        reinterpret_cast<const void *>(caster.firstIndex * sizeof(GLuint))));
+  }
+  if (timed)
+    glCheck(glEndQuery(GL_TIME_ELAPSED));
+
+  glCheck(glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer)));
+  glCheck(glViewport(previousViewport[0], previousViewport[1],
+                     previousViewport[2], previousViewport[3]));
+  for (auto [capability, enabled] :
+       {std::pair{GL_DEPTH_TEST, depthTest}, {GL_DEPTH_CLAMP, depthClamp},
+        {GL_POLYGON_OFFSET_FILL, polygonOffset}})
+    if (enabled) {
+      glCheck(glEnable(capability));
+    } else {
+      glCheck(glDisable(capability));
+    }
+}
+
+void CascadedShadowMaps::bind() const {
+  glCheck(glBindBufferBase(GL_UNIFORM_BUFFER, paramsBinding, _paramsBuffer));
+  glCheck(glBindTextureUnit(textureUnit, _texture));
+}
+
+void benchmarkShadowMaps() {
+  constexpr size_t boxesPerSide{30};
+  constexpr float spacing{4}, near{0.1f}, far{150};
+  constexpr size_t frames{120};
+  Window window{64, 64, "Shadow map benchmark"};
+
+  // One unit cube, scaled and placed by every caster's model matrix.
+  constexpr float cube[]{0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0,
+                         0, 0, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1};
+  constexpr GLuint cubeIndices[]{0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+                                 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+                                 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+  GLuint buffers[2], vao;
+  glCheck(glCreateBuffers(2, buffers));
+  glCheck(glNamedBufferStorage(buffers[0], sizeof(cube), cube, 0));
+  glCheck(glNamedBufferStorage(buffers[1], sizeof(cubeIndices), cubeIndices,
+                               0));
+  glCheck(glCreateVertexArrays(1, &vao));
+  glCheck(glVertexArrayVertexBuffer(vao, 0, buffers[0], 0, 3 * sizeof(float)));
+  glCheck(glVertexArrayElementBuffer(vao, buffers[1]));
+  glCheck(glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0));
+  glCheck(glVertexArrayAttribBinding(vao, 0, 0));
+  glCheck(glEnableVertexArrayAttrib(vao, 0));
+
+  auto caster{[&](glm::vec3 boundsMin, glm::vec3 boundsMax) {
+    auto model{glm::scale(glm::translate(glm::mat4{1}, boundsMin),
+                          boundsMax - boundsMin)};
+    return ShadowCaster{vao, 0, GLsizei(std::size(cubeIndices)), model,
+                        boundsMin, boundsMax};
+  }};
+  std::vector<ShadowCaster> casters;
+  constexpr float half{boxesPerSide * spacing / 2};
+  casters.push_back(caster({-half - 10, -1, -half - 10},
+                           {half + 10, 0, half + 10}));
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> height{1, 4};
+  for (size_t z{}; z < boxesPerSide; ++z)
+    for (size_t x{}; x < boxesPerSide; ++x) {
+      glm::vec3 corner{-half + float(x) * spacing, 0,
+                       -half + float(z) * spacing};
+      casters.push_back(
+          caster(corner, corner + glm::vec3{1.5f, height(random), 1.5f}));
+    }
+  // The boxes nearest to and farthest from the camera.
+  auto nearBox{casters.size() - boxesPerSide / 2};
+  auto farBox{1 + boxesPerSide / 2};
+  auto restingCasters{casters};
+
+  glm::vec3 lightDirection{-0.4f, -1, -0.3f};
+  auto projection{glm::perspective(glm::radians(60.0f), 16.0f / 9, near, far)};
+  struct Scenario {
+    const char *name;
+    bool cameraMoves;
+    size_t movingCaster; // 0 for none
+  };
+  const Scenario scenarios[]{{"still", false, 0},
+                             {"camera moving", true, 0},
+                             {"caster moving near", false, nearBox},
+                             {"caster moving far", false, farBox}};
+  for (auto &scenario : scenarios) {
+    double cachedMs{}, uncachedMs{};
+    size_t drawn[4]{}, drawnCasters[4]{};
+    for (auto caching : {true, false}) {
+      CascadedShadowMaps shadows;
+      shadows.setCaching(caching);
+      casters = restingCasters;
+      // Three more frames, for the last queries to come back.
+      for (size_t frame{}; frame < frames + 3; ++frame) {
+        auto t{float(std::min(frame, frames - 1))};
+        glm::vec3 eye{0, 10, half + 5 - (scenario.cameraMoves ? 0.1f * t : 0)};
+        auto view{glm::lookAt(eye, eye + glm::vec3{0, -0.3f, -1},
+                              glm::vec3{0, 1, 0})};
+        if (scenario.movingCaster) {
+          auto &moving{casters[scenario.movingCaster]};
+          auto &resting{restingCasters[scenario.movingCaster]};
+          glm::vec3 offset{0, 1 + std::sin(0.1f * t), 0};
+          moving = caster(resting.boundsMin + offset,
+                          resting.boundsMax + offset);
+        }
+        shadows.render(view, projection, near, far, lightDirection,
+                       casters.data(), casters.size());
+        glCheck(glFinish());
+        (caching ? cachedMs : uncachedMs) += shadows.stats().gpuMs;
+        for (size_t k{}; caching && frame < frames && k < 4; ++k) {
+          auto &cascade{shadows.stats().cascades[k]};
+          drawn[k] += cascade.rendered;
+          drawnCasters[k] += cascade.casters;
+        }
+      }
+    }
+    std::printf("%-18s %.3f ms/frame cached, %.3f ms/frame uncached; "
+                "cascades drawn %zu/%zu/%zu/%zu times in %zu frames, "
+                "with %zu/%zu/%zu/%zu casters on average\n",
+                scenario.name, cachedMs / frames, uncachedMs / frames,
+                drawn[0], drawn[1], drawn[2], drawn[3], frames,
+                drawnCasters[0] / std::max(drawn[0], size_t{1}),
+                drawnCasters[1] / std::max(drawn[1], size_t{1}),
+                drawnCasters[2] / std::max(drawn[2], size_t{1}),
+                drawnCasters[3] / std::max(drawn[3], size_t{1}));
+  }
+
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(2, buffers);
+}
@@ -0,0 +1,640 @@
+#include "simd_transform.hpp"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/vec3.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#ifdef SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+// Scalar versions, also the reference the benchmark checks the others with.
+namespace scalar {
+void multiplyMatrices(const MatrixBlock *a, const MatrixBlock *b,
+                      MatrixBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; ++lane)
+      setLane(result[block], lane,
+              getLane(a[block], lane) * getLane(b[block], lane));
+}
+
+void transformPoints(const glm::mat4 &matrix, const PointBlock *points,
+                     PointBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; ++lane) {
+      auto &in{points[block]};
+      auto p{matrix * glm::vec4{in.x[lane], in.y[lane], in.z[lane], 1}};
+      result[block].x[lane] = p.x;
+      result[block].y[lane] = p.y;
+      result[block].z[lane] = p.z;
+    }
+}
+
+void transformAabbs(const MatrixBlock *matrices, const AabbBlock *boxes,
+                    AabbBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; ++lane) {
+      auto &in{boxes[block]};
+      auto &out{result[block]};
+      auto m{getLane(matrices[block], lane)};
+      glm::vec3 lo{in.minX[lane], in.minY[lane], in.minZ[lane]};
+      glm::vec3 hi{in.maxX[lane], in.maxY[lane], in.maxZ[lane]};
+      auto center{glm::vec3{m * glm::vec4{(lo + hi) * 0.5f, 1}}};
+      auto extent{(hi - lo) * 0.5f};
+      glm::vec3 newExtent{};
+      for (int column{}; column < 3; ++column)
+        newExtent += glm::abs(glm::vec3{m[column]}) * extent[column];
+      out.minX[lane] = center.x - newExtent.x;
+      out.minY[lane] = center.y - newExtent.y;
+      out.minZ[lane] = center.z - newExtent.z;
+      out.maxX[lane] = center.x + newExtent.x;
+      out.maxY[lane] = center.y + newExtent.y;
+      out.maxZ[lane] = center.z + newExtent.z;
+    }
+}
+
+void transformSpheres(const MatrixBlock *matrices, const SphereBlock *spheres,
+                      SphereBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; ++lane) {
+      auto &in{spheres[block]};
+      auto &out{result[block]};
+      auto m{getLane(matrices[block], lane)};
+      auto center{m * glm::vec4{in.x[lane], in.y[lane], in.z[lane], 1}};
+      float scale{};
+      for (int column{}; column < 3; ++column)
+        scale = std::max(scale, glm::dot(glm::vec3{m[column]},
+                                         glm::vec3{m[column]}));
+      out.x[lane] = center.x;
+      out.y[lane] = center.y;
+      out.z[lane] = center.z;
+      out.radius[lane] = in.radius[lane] * std::sqrt(scale);
+    }
+}
+} // namespace scalar
+
+#ifdef SIMD_X86
+// The SSE4.1 and AVX2 kernels are the same code over 4 and 8 lanes, each
+// with its own helpers so that they compile for their own instruction set.
+namespace sse41 {
+constexpr size_t width{4};
+using Lanes = __m128;
+
+SIMD_TARGET("sse4.1") inline Lanes load(const float *p) {
+  return _mm_load_ps(p);
+}
+SIMD_TARGET("sse4.1") inline void store(float *p, Lanes v) {
+  _mm_store_ps(p, v);
+}
+SIMD_TARGET("sse4.1") inline Lanes broadcast(float x) {
+  return _mm_set1_ps(x);
+}
+SIMD_TARGET("sse4.1") inline Lanes add(Lanes a, Lanes b) {
+  return _mm_add_ps(a, b);
+}
+SIMD_TARGET("sse4.1") inline Lanes sub(Lanes a, Lanes b) {
+  return _mm_sub_ps(a, b);
+}
+SIMD_TARGET("sse4.1") inline Lanes mul(Lanes a, Lanes b) {
+  return _mm_mul_ps(a, b);
+}
+SIMD_TARGET("sse4.1") inline Lanes madd(Lanes a, Lanes b, Lanes c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+SIMD_TARGET("sse4.1") inline Lanes max(Lanes a, Lanes b) {
+  return _mm_max_ps(a, b);
+}
+SIMD_TARGET("sse4.1") inline Lanes abs(Lanes a) {
+  return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+}
+SIMD_TARGET("sse4.1") inline Lanes sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+
+SIMD_TARGET("sse4.1")
+void multiplyMatrices(const MatrixBlock *a, const MatrixBlock *b,
+                      MatrixBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; lane += width) {
+      Lanes left[16];
+      for (int e{}; e < 16; ++e)
+        left[e] = load(&a[block].m[e][lane]);
+      for (int column{}; column < 4; ++column) {
+        Lanes right[4];
+        for (int k{}; k < 4; ++k)
+          right[k] = load(&b[block].m[column * 4 + k][lane]);
+        for (int row{}; row < 4; ++row) {
+          auto sum{mul(left[row], right[0])};
+          for (int k{1}; k < 4; ++k)
+            sum = madd(left[k * 4 + row], right[k], sum);
+          store(&result[block].m[column * 4 + row][lane], sum);
+        }
+      }
+    }
+}
+
+SIMD_TARGET("sse4.1")
+void transformPoints(const glm::mat4 &matrix, const PointBlock *points,
+                     PointBlock *result, size_t blockCount) {
+  Lanes m[4][3];
+  for (int column{}; column < 4; ++column)
+    for (int row{}; row < 3; ++row)
+      m[column][row] = broadcast(matrix[column][row]);
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; lane += width) {
+      auto x{load(&points[block].x[lane])}, y{load(&points[block].y[lane])},
+          z{load(&points[block].z[lane])};
+      float *out[3]{&result[block].x[lane], &result[block].y[lane],
+                    &result[block].z[lane]};
+      for (int row{}; row < 3; ++row)
+        store(out[row],
+              madd(m[0][row], x,
+                   madd(m[1][row], y, madd(m[2][row], z, m[3][row]))));
+    }
+}
+
+SIMD_TARGET("sse4.1")
+void transformAabbs(const MatrixBlock *matrices, const AabbBlock *boxes,
+                    AabbBlock *result, size_t blockCount) {
+  auto half{broadcast(0.5f)};
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; lane += width) {
+      auto &in{boxes[block]};
+      auto &out{result[block]};
+      auto &m{matrices[block].m};
+      const float *lo[3]{&in.minX[lane], &in.minY[lane], &in.minZ[lane]};
+      const float *hi[3]{&in.maxX[lane], &in.maxY[lane], &in.maxZ[lane]};
+      float *outLo[3]{&out.minX[lane], &out.minY[lane], &out.minZ[lane]};
+      float *outHi[3]{&out.maxX[lane], &out.maxY[lane], &out.maxZ[lane]};
+      Lanes center[3], extent[3];
+      for (int axis{}; axis < 3; ++axis) {
+        auto l{load(lo[axis])}, h{load(hi[axis])};
+        center[axis] = mul(add(l, h), half);
+        extent[axis] = mul(sub(h, l), half);
+      }
+      for (int row{}; row < 3; ++row) {
+        auto c{load(&m[12 + row][lane])};
+        Lanes e{broadcast(0)};
+        for (int column{}; column < 3; ++column) {
+          auto element{load(&m[column * 4 + row][lane])};
+          c = madd(element, center[column], c);
+          e = madd(abs(element), extent[column], e);
+        }
+        store(outLo[row], sub(c, e));
+        store(outHi[row], add(c, e));
+      }
+    }
+}
+
+SIMD_TARGET("sse4.1")
+void transformSpheres(const MatrixBlock *matrices, const SphereBlock *spheres,
+                      SphereBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; lane += width) {
+      auto &in{spheres[block]};
+      auto &out{result[block]};
+      auto &m{matrices[block].m};
+      Lanes center[3]{load(&in.x[lane]), load(&in.y[lane]), load(&in.z[lane])};
+      float *outCenter[3]{&out.x[lane], &out.y[lane], &out.z[lane]};
+      Lanes scale{broadcast(0)};
+      for (int column{}; column < 3; ++column) {
+        Lanes lengthSquared{broadcast(0)};
+        for (int row{}; row < 3; ++row) {
+          auto element{load(&m[column * 4 + row][lane])};
+          lengthSquared = madd(element, element, lengthSquared);
+        }
+        scale = max(scale, lengthSquared);
+      }
+      for (int row{}; row < 3; ++row) {
+        auto c{load(&m[12 + row][lane])};
+        for (int column{}; column < 3; ++column)
+          c = madd(load(&m[column * 4 + row][lane]), center[column], c);
+        store(outCenter[row], c);
+      }
+      store(&out.radius[lane], mul(load(&in.radius[lane]), sqrt(scale)));
+    }
+}
+} // namespace sse41
+
+namespace avx2 {
+constexpr size_t width{8};
+using Lanes = __m256;
+
+SIMD_TARGET("avx2,fma") inline Lanes load(const float *p) {
+  return _mm256_load_ps(p);
+}
+SIMD_TARGET("avx2,fma") inline void store(float *p, Lanes v) {
+  _mm256_store_ps(p, v);
+}
+SIMD_TARGET("avx2,fma") inline Lanes broadcast(float x) {
+  return _mm256_set1_ps(x);
+}
+SIMD_TARGET("avx2,fma") inline Lanes add(Lanes a, Lanes b) {
+  return _mm256_add_ps(a, b);
+}
+SIMD_TARGET("avx2,fma") inline Lanes sub(Lanes a, Lanes b) {
+  return _mm256_sub_ps(a, b);
+}
+SIMD_TARGET("avx2,fma") inline Lanes mul(Lanes a, Lanes b) {
+  return _mm256_mul_ps(a, b);
+}
+SIMD_TARGET("avx2,fma") inline Lanes madd(Lanes a, Lanes b, Lanes c) {
+  return _mm256_fmadd_ps(a, b, c);
+}
+SIMD_TARGET("avx2,fma") inline Lanes max(Lanes a, Lanes b) {
+  return _mm256_max_ps(a, b);
+}
+SIMD_TARGET("avx2,fma") inline Lanes abs(Lanes a) {
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+}
+SIMD_TARGET("avx2,fma") inline Lanes sqrt(Lanes a) {
+  return _mm256_sqrt_ps(a);
+}
+
+// Not written like the SSE4.1 kernel: GCC turns the loop filling its
+// arrays of registers into a copy through the stack made of 16-byte moves,
+// which the 32-byte loads that follow cannot be forwarded from, and that
+// stall made this slower than SSE4.1. Here b's column sits in four named
+// registers and a is read straight into the FMAs.
+SIMD_TARGET("avx2,fma")
+void multiplyMatrices(const MatrixBlock *a, const MatrixBlock *b,
+                      MatrixBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block) {
+    auto &left{a[block].m};
+    for (int column{}; column < 4; ++column) {
+      auto right{&b[block].m[column * 4]};
+      auto r0{load(right[0])}, r1{load(right[1])}, r2{load(right[2])},
+          r3{load(right[3])};
+      for (int row{}; row < 4; ++row) {
+        auto sum{mul(load(left[row]), r0)};
+        sum = madd(load(left[4 + row]), r1, sum);
+        sum = madd(load(left[8 + row]), r2, sum);
+        sum = madd(load(left[12 + row]), r3, sum);
+        store(result[block].m[column * 4 + row], sum);
+      }
+    }
+  }
+}
+
+SIMD_TARGET("avx2,fma")
+void transformPoints(const glm::mat4 &matrix, const PointBlock *points,
+                     PointBlock *result, size_t blockCount) {
+  Lanes m[4][3];
+  for (int column{}; column < 4; ++column)
+    for (int row{}; row < 3; ++row)
+      m[column][row] = broadcast(matrix[column][row]);
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; lane += width) {
+      auto x{load(&points[block].x[lane])}, y{load(&points[block].y[lane])},
+          z{load(&points[block].z[lane])};
+      float *out[3]{&result[block].x[lane], &result[block].y[lane],
+                    &result[block].z[lane]};
+      for (int row{}; row < 3; ++row)
+        store(out[row],
+              madd(m[0][row], x,
+                   madd(m[1][row], y, madd(m[2][row], z, m[3][row]))));
+    }
+}
+
+SIMD_TARGET("avx2,fma")
+void transformAabbs(const MatrixBlock *matrices, const AabbBlock *boxes,
+                    AabbBlock *result, size_t blockCount) {
+  auto half{broadcast(0.5f)};
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; lane += width) {
+      auto &in{boxes[block]};
+      auto &out{result[block]};
+      auto &m{matrices[block].m};
+      const float *lo[3]{&in.minX[lane], &in.minY[lane], &in.minZ[lane]};
+      const float *hi[3]{&in.maxX[lane], &in.maxY[lane], &in.maxZ[lane]};
+      float *outLo[3]{&out.minX[lane], &out.minY[lane], &out.minZ[lane]};
+      float *outHi[3]{&out.maxX[lane], &out.maxY[lane], &out.maxZ[lane]};
+      Lanes center[3], extent[3];
+      for (int axis{}; axis < 3; ++axis) {
+        auto l{load(lo[axis])}, h{load(hi[axis])};
+        center[axis] = mul(add(l, h), half);
+        extent[axis] = mul(sub(h, l), half);
+      }
+      for (int row{}; row < 3; ++row) {
+        auto c{load(&m[12 + row][lane])};
+        Lanes e{broadcast(0)};
+        for (int column{}; column < 3; ++column) {
+          auto element{load(&m[column * 4 + row][lane])};
+          c = madd(element, center[column], c);
+          e = madd(abs(element), extent[column], e);
+        }
+        store(outLo[row], sub(c, e));
+        store(outHi[row], add(c, e));
+      }
+    }
+}
+
+SIMD_TARGET("avx2,fma")
+void transformSpheres(const MatrixBlock *matrices, const SphereBlock *spheres,
+                      SphereBlock *result, size_t blockCount) {
+  for (size_t block{}; block < blockCount; ++block)
+    for (size_t lane{}; lane < simdLanes; lane += width) {
+      auto &in{spheres[block]};
+      auto &out{result[block]};
+      auto &m{matrices[block].m};
+      Lanes center[3]{load(&in.x[lane]), load(&in.y[lane]), load(&in.z[lane])};
+      float *outCenter[3]{&out.x[lane], &out.y[lane], &out.z[lane]};
+      Lanes scale{broadcast(0)};
+      for (int column{}; column < 3; ++column) {
+        Lanes lengthSquared{broadcast(0)};
+        for (int row{}; row < 3; ++row) {
+          auto element{load(&m[column * 4 + row][lane])};
+          lengthSquared = madd(element, element, lengthSquared);
+        }
+        scale = max(scale, lengthSquared);
+      }
+      for (int row{}; row < 3; ++row) {
+        auto c{load(&m[12 + row][lane])};
+        for (int column{}; column < 3; ++column)
+          c = madd(load(&m[column * 4 + row][lane]), center[column], c);
+        store(outCenter[row], c);
+      }
+      store(&out.radius[lane], mul(load(&in.radius[lane]), sqrt(scale)));
+    }
+}
+} // namespace avx2
+
+void cpuid(int leaf, int subleaf, unsigned registers[4]) {
+#ifdef _MSC_VER
+  __cpuidex(reinterpret_cast<int *>(registers), leaf, subleaf);
+#else
+  __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2],
+                registers[3]);
+#endif
+}
+
+// Whether the OS saves the AVX registers on context switches.
+bool osSupportsAvx() {
+#ifdef _MSC_VER
+  return (_xgetbv(0) & 6) == 6;
+#else
+  unsigned eax, edx;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (eax & 6) == 6;
+#endif
+}
+#endif
+
+SimdLevel detectSimdLevel() {
+#ifdef SIMD_X86
+  unsigned registers[4];
+  cpuid(0, 0, registers);
+  auto maxLeaf{registers[0]};
+  cpuid(1, 0, registers);
+  bool sse41{(registers[2] >> 19 & 1) != 0};
+  bool fma{(registers[2] >> 12 & 1) != 0};
+  bool avx{(registers[2] >> 28 & 1) != 0 && (registers[2] >> 27 & 1) != 0 &&
+           osSupportsAvx()};
+  bool avx2{};
+  if (maxLeaf >= 7) {
+    cpuid(7, 0, registers);
+    avx2 = (registers[1] >> 5 & 1) != 0;
+  }
+  if (avx && avx2 && fma)
+    return SimdLevel::Avx2;
+  if (sse41)
+    return SimdLevel::Sse41;
+#endif
+  return SimdLevel::Scalar;
+}
+
+struct Kernels {
+  decltype(&scalar::multiplyMatrices) multiplyMatrices;
+  decltype(&scalar::transformPoints) transformPoints;
+  decltype(&scalar::transformAabbs) transformAabbs;
+  decltype(&scalar::transformSpheres) transformSpheres;
+};
+
+Kernels kernelsFor(SimdLevel level) {
+  switch (level) {
+#ifdef SIMD_X86
+  case SimdLevel::Avx2:
+    return {avx2::multiplyMatrices, avx2::transformPoints,
+            avx2::transformAabbs, avx2::transformSpheres};
+  case SimdLevel::Sse41:
+    return {sse41::multiplyMatrices, sse41::transformPoints,
+            sse41::transformAabbs, sse41::transformSpheres};
+#endif
+  default:
+    return {scalar::multiplyMatrices, scalar::transformPoints,
+            scalar::transformAabbs, scalar::transformSpheres};
+  }
+}
+
+const SimdLevel supported{detectSimdLevel()};
+SimdLevel current{supported};
+Kernels kernels{kernelsFor(supported)};
+
+template <typename Fn> double millisecondsPerRun(Fn fn) {
+  constexpr int runs{20};
+  fn(); // warm up the caches
+  auto start{std::chrono::steady_clock::now()};
+  for (int run{}; run < runs; ++run)
+    fn();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         runs;
+}
+} // namespace
+
+void setLane(MatrixBlock &block, size_t lane, const glm::mat4 &matrix) {
+  for (int column{}; column < 4; ++column)
+    for (int row{}; row < 4; ++row)
+      block.m[column * 4 + row][lane] = matrix[column][row];
+}
+
+glm::mat4 getLane(const MatrixBlock &block, size_t lane) {
+  glm::mat4 matrix;
+  for (int column{}; column < 4; ++column)
+    for (int row{}; row < 4; ++row)
+      matrix[column][row] = block.m[column * 4 + row][lane];
+  return matrix;
+}
+
+SimdLevel simdLevel() { return current; }
+
+SimdLevel supportedSimdLevel() { return supported; }
+
+void setSimdLevel(SimdLevel level) {
+  current = std::min(level, supported);
+  kernels = kernelsFor(current);
+}
+
+const char *simdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::Avx2:
+    return "AVX2";
+  case SimdLevel::Sse41:
+    return "SSE4.1";
+  default:
+    return "scalar";
+  }
+}
+
+void multiplyMatrices(const MatrixBlock *a, const MatrixBlock *b,
+                      MatrixBlock *result, size_t blockCount) {
+  kernels.multiplyMatrices(a, b, result, blockCount);
+}
+
+void transformPoints(const glm::mat4 &matrix, const PointBlock *points,
+                     PointBlock *result, size_t blockCount) {
+  kernels.transformPoints(matrix, points, result, blockCount);
+}
+
+void transformAabbs(const MatrixBlock *matrices, const AabbBlock *boxes,
+                    AabbBlock *result, size_t blockCount) {
+  kernels.transformAabbs(matrices, boxes, result, blockCount);
+}
+
+void transformSpheres(const MatrixBlock *matrices, const SphereBlock *spheres,
+                      SphereBlock *result, size_t blockCount) {
+  kernels.transformSpheres(matrices, spheres, result, blockCount);
+}
+
+void benchmarkSimdTransforms(size_t count) {
+  auto blockCount{(count + simdLanes - 1) / simdLanes};
+  std::mt19937 random{1};
+  std::uniform_real_distribution<float> distribution{-1, 1};
+
+  std::vector<glm::mat4> matricesA(count), matricesB(count), products(count);
+  std::vector<glm::vec3> points(count), transformedPoints(count);
+  std::vector<MatrixBlock> blocksA(blockCount), blocksB(blockCount),
+      blockProducts(blockCount);
+  std::vector<PointBlock> pointBlocks(blockCount), pointResults(blockCount);
+  std::vector<AabbBlock> boxes(blockCount), boxResults(blockCount);
+  std::vector<SphereBlock> spheres(blockCount), sphereResults(blockCount);
+  for (size_t i{}; i < count; ++i) {
+    matricesA[i] = matricesB[i] = glm::mat4{1};
+    for (int column{}; column < 4; ++column)
+      for (int row{}; row < 3; ++row) {
+        matricesA[i][column][row] = distribution(random);
+        matricesB[i][column][row] = distribution(random);
+      }
+    points[i] = {distribution(random), distribution(random),
+                 distribution(random)};
+    auto block{i / simdLanes}, lane{i % simdLanes};
+    setLane(blocksA[block], lane, matricesA[i]);
+    setLane(blocksB[block], lane, matricesB[i]);
+    pointBlocks[block].x[lane] = points[i].x;
+    pointBlocks[block].y[lane] = points[i].y;
+    pointBlocks[block].z[lane] = points[i].z;
+    boxes[block].minX[lane] = boxes[block].minY[lane] =
+        boxes[block].minZ[lane] = -1;
+    boxes[block].maxX[lane] = boxes[block].maxY[lane] =
+        boxes[block].maxZ[lane] = 1;
+    spheres[block].x[lane] = points[i].x;
+    spheres[block].y[lane] = points[i].y;
+    spheres[block].z[lane] = points[i].z;
+    spheres[block].radius[lane] = 1;
+  }
+
+  std::printf("%zu objects, ms per batch\n", count);
+  std::printf("  %-8s mat4*mat4 %7.3f  mat4*point %7.3f\n", "glm",
+              millisecondsPerRun([&] {
+                for (size_t i{}; i < count; ++i)
+                  products[i] = matricesA[i] * matricesB[i];
+              }),
+              millisecondsPerRun([&] {
+                for (size_t i{}; i < count; ++i)
+                  transformedPoints[i] =
+                      glm::vec3{matricesA[0] * glm::vec4{points[i], 1}};
+              }));
+
+  // What the box and sphere kernels should give, straight from the
+  // definitions: the bounds of the eight transformed corners, and the
+  // transformed center with the radius scaled by the longest axis.
+  std::vector<glm::vec3> boxMins(count), boxMaxes(count), sphereCenters(count);
+  std::vector<float> sphereRadii(count);
+  for (size_t i{}; i < count; ++i) {
+    auto &matrix{matricesA[i]};
+    boxMins[i] = glm::vec3{std::numeric_limits<float>::max()};
+    boxMaxes[i] = glm::vec3{std::numeric_limits<float>::lowest()};
+    for (int corner{}; corner < 8; ++corner) {
+      glm::vec4 p{corner & 1 ? 1 : -1, corner & 2 ? 1 : -1,
+                  corner & 4 ? 1 : -1, 1};
+      auto transformed{glm::vec3{matrix * p}};
+      boxMins[i] = glm::min(boxMins[i], transformed);
+      boxMaxes[i] = glm::max(boxMaxes[i], transformed);
+    }
+    sphereCenters[i] = glm::vec3{matrix * glm::vec4{points[i], 1}};
+    sphereRadii[i] = std::max({glm::length(glm::vec3{matrix[0]}),
+                               glm::length(glm::vec3{matrix[1]}),
+                               glm::length(glm::vec3{matrix[2]})});
+  }
+
+  auto previous{current};
+  for (auto level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2}) {
+    if (level > supported)
+      break;
+    setSimdLevel(level);
+    auto multiply{millisecondsPerRun([&] {
+      multiplyMatrices(blocksA.data(), blocksB.data(), blockProducts.data(),
+                       blockCount);
+    })};
+    auto point{millisecondsPerRun([&] {
+      transformPoints(matricesA[0], pointBlocks.data(), pointResults.data(),
+                      blockCount);
+    })};
+    auto aabb{millisecondsPerRun([&] {
+      transformAabbs(blocksA.data(), boxes.data(), boxResults.data(),
+                     blockCount);
+    })};
+    auto sphere{millisecondsPerRun([&] {
+      transformSpheres(blocksA.data(), spheres.data(), sphereResults.data(),
+                       blockCount);
+    })};
+
+    float multiplyError{}, pointError{}, aabbError{}, sphereError{};
+    for (size_t i{}; i < count; ++i) {
+      auto block{i / simdLanes}, lane{i % simdLanes};
+      auto product{getLane(blockProducts[block], lane)};
+      for (int column{}; column < 4; ++column)
+        multiplyError = std::max(
+            multiplyError,
+            glm::distance(product[column], products[i][column]));
+      auto &p{pointResults[block]};
+      pointError = std::max(
+          pointError, glm::distance(glm::vec3{p.x[lane], p.y[lane], p.z[lane]},
+                                    transformedPoints[i]));
+      auto &box{boxResults[block]};
+      aabbError = std::max(
+          {aabbError,
+           glm::distance(
+               glm::vec3{box.minX[lane], box.minY[lane], box.minZ[lane]},
+               boxMins[i]),
+           glm::distance(
+               glm::vec3{box.maxX[lane], box.maxY[lane], box.maxZ[lane]},
+               boxMaxes[i])});
+      auto &sphere{sphereResults[block]};
+      sphereError = std::max(
+          {sphereError,
+           glm::distance(glm::vec3{sphere.x[lane], sphere.y[lane],
+                                   sphere.z[lane]},
+                         sphereCenters[i]),
+           std::abs(sphere.radius[lane] - sphereRadii[i])});
+    }
+    std::printf("  %-8s mat4*mat4 %7.3f  mat4*point %7.3f  AABB %7.3f  "
+                "sphere %7.3f\n",
+                simdLevelName(level), multiply, point, aabb, sphere);
+    std::printf("  %-8s max error %g, %g, %g, %g\n", "", multiplyError,
+                pointError, aabbError, sphereError);
+  }
+  setSimdLevel(previous);
+}
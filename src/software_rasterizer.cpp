@@ -0,0 +1,339 @@
+#include "software_rasterizer.hpp"
+#include "simd_transform.hpp"
+
+#include "glm/vec2.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace {
+// main.cpp's fragment shader: vertex colors, brightened where a barycentric
+// is close to 0 or all three are close to each other.
+constexpr float highlightEpsilon{0.01f};
+
+bool highlighted(float b0, float b1, float b2) {
+  constexpr auto epsilon{highlightEpsilon};
+  return b0 < epsilon || b1 < epsilon || b2 < epsilon ||
+         (std::abs(b0 - b1) < 10 * epsilon &&
+          std::abs(b0 - b2) < 10 * epsilon && std::abs(b1 - b2) < 10 * epsilon);
+}
+
+float brighten(float c) { return 0.25f * (c * c + 2 * std::sqrt(c + c)); }
+
+// Rounds half to even, as _mm256_cvtps_epi32 does.
+uint8_t toByte(float c) {
+  return uint8_t(std::nearbyint(std::clamp(c, 0.0f, 1.0f) * 255));
+}
+
+float edge(glm::vec2 from, glm::vec2 to, glm::vec2 p) {
+  return (to.x - from.x) * (p.y - from.y) - (to.y - from.y) * (p.x - from.x);
+}
+
+#ifdef SIMD_X86
+// Lanes where p and q are less than epsilon apart; a function rather than a
+// lambda in rasterizeAvx2(), since lambdas do not inherit the target
+// attribute.
+SIMD_TARGET("avx2")
+inline __m256 nearlyEqual(__m256 p, __m256 q, __m256 epsilon) {
+  auto absMask{_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))};
+  return _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(p, q), absMask), epsilon,
+                       _CMP_LT_OQ);
+}
+#endif
+} // namespace
+
+SoftwareRasterizer::SoftwareRasterizer(size_t width, size_t height)
+    : _image{width, height}, _tilesX{(width + tileSize - 1) / tileSize},
+      _tilesY{(height + tileSize - 1) / tileSize}, _bins(_tilesX * _tilesY) {}
+
+void SoftwareRasterizer::render(glm::vec3 clearColor,
+                                const glm::vec4 *positions,
+                                const glm::vec3 *colors, size_t vertexCount,
+                                JobSystem *jobs) {
+  setup(positions, colors, vertexCount);
+  auto renderTiles{[&](size_t first, size_t last) {
+    for (auto tile{first}; tile < last; ++tile)
+      renderTile(tile, clearColor);
+  }};
+  if (jobs)
+    jobs->parallelFor(0, _bins.size(), 1, renderTiles);
+  else
+    renderTiles(0, _bins.size());
+}
+
+void SoftwareRasterizer::setup(const glm::vec4 *positions,
+                               const glm::vec3 *colors, size_t vertexCount) {
+  _triangles.clear();
+  for (auto &bin : _bins)
+    bin.clear();
+  auto width{float(_image.width())}, height{float(_image.height())};
+  for (size_t first{}; first + 3 <= vertexCount; first += 3) {
+    Triangle triangle;
+    glm::vec2 p[3];
+    bool behind{};
+    for (size_t i{}; i < 3; ++i) {
+      auto &clip{positions[first + i]};
+      behind |= !(clip.w > 0);
+      triangle.inverseW[i] = 1 / clip.w;
+      // Image rows go down, GL's window y up.
+      p[i] = {(clip.x * triangle.inverseW[i] + 1) * 0.5f * width,
+              (1 - clip.y * triangle.inverseW[i]) * 0.5f * height};
+      triangle.colors[i] = colors[first + i];
+    }
+    auto area{edge(p[0], p[1], p[2])};
+    if (behind || !(std::abs(area) > 0))
+      continue;
+
+    // Dividing by the signed area makes the edges positive inside whichever
+    // way the triangle winds.
+    for (size_t i{}; i < 3; ++i) {
+      auto &from{p[(i + 1) % 3]}, &to{p[(i + 2) % 3]};
+      triangle.a[i] = (from.y - to.y) / area;
+      triangle.b[i] = (to.x - from.x) / area;
+      triangle.c[i] = -(triangle.a[i] * from.x + triangle.b[i] * from.y);
+      // A shared edge comes with opposite signs in its two triangles, so
+      // exactly one of them owns it.
+      triangle.topLeft[i] =
+          triangle.a[i] > 0 || (triangle.a[i] == 0 && triangle.b[i] > 0);
+    }
+
+    auto [minX, maxX]{std::minmax({p[0].x, p[1].x, p[2].x})};
+    auto [minY, maxY]{std::minmax({p[0].y, p[1].y, p[2].y})};
+    triangle.minX = std::max(0, int(std::floor(minX)));
+    triangle.minY = std::max(0, int(std::floor(minY)));
+    triangle.maxX = std::min(int(width) - 1, int(std::ceil(maxX)));
+    triangle.maxY = std::min(int(height) - 1, int(std::ceil(maxY)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+      continue;
+
+    auto index{uint32_t(_triangles.size())};
+    _triangles.push_back(triangle);
+    for (auto tileY{size_t(triangle.minY) / tileSize};
+         tileY <= size_t(triangle.maxY) / tileSize; ++tileY)
+      for (auto tileX{size_t(triangle.minX) / tileSize};
+           tileX <= size_t(triangle.maxX) / tileSize; ++tileX)
+        _bins[tileY * _tilesX + tileX].push_back(index);
+  }
+}
+
+void SoftwareRasterizer::renderTile(size_t tile, glm::vec3 clearColor) {
+  auto x0{int(tile % _tilesX * tileSize)}, y0{int(tile / _tilesX * tileSize)};
+  auto x1{std::min(x0 + int(tileSize), int(_image.width())) - 1};
+  auto y1{std::min(y0 + int(tileSize), int(_image.height())) - 1};
+
+  uint8_t clearRow[tileSize * 3];
+  for (size_t x{}; x < tileSize; ++x)
+    for (size_t channel{}; channel < 3; ++channel)
+      clearRow[x * 3 + channel] = toByte(clearColor[int(channel)]);
+  for (auto y{y0}; y <= y1; ++y)
+    std::memcpy(_image.pixel(x0, y), clearRow, size_t(x1 - x0 + 1) * 3);
+
+  for (auto index : _bins[tile]) {
+    auto &triangle{_triangles[index]};
+    auto minX{std::max(triangle.minX, x0)}, maxX{std::min(triangle.maxX, x1)};
+    auto minY{std::max(triangle.minY, y0)}, maxY{std::min(triangle.maxY, y1)};
+#ifdef SIMD_X86
+    if (simdLevel() == SimdLevel::Avx2) {
+      rasterizeAvx2(triangle, minX, minY, maxX, maxY);
+      continue;
+    }
+#endif
+    rasterizeScalar(triangle, minX, minY, maxX, maxY);
+  }
+}
+
+void SoftwareRasterizer::rasterizeScalar(const Triangle &triangle, int minX,
+                                         int minY, int maxX, int maxY) {
+  for (auto y{minY}; y <= maxY; ++y)
+    for (auto x{minX}; x <= maxX; ++x) {
+      float e[3];
+      auto inside{true};
+      for (size_t i{}; i < 3; ++i) {
+        e[i] = triangle.a[i] * (x + 0.5f) +
+               (triangle.b[i] * (y + 0.5f) + triangle.c[i]);
+        inside &= e[i] > 0 || (e[i] == 0 && triangle.topLeft[i]);
+      }
+      if (!inside)
+        continue;
+
+      // Perspective correction, as the GPU's interpolation does.
+      float b[3], sum{};
+      for (size_t i{}; i < 3; ++i)
+        sum += b[i] = e[i] * triangle.inverseW[i];
+      auto inverseSum{1 / sum};
+      for (auto &weight : b)
+        weight *= inverseSum;
+      auto color{b[0] * triangle.colors[0] + b[1] * triangle.colors[1] +
+                 b[2] * triangle.colors[2]};
+      auto highlight{highlighted(b[0], b[1], b[2])};
+      auto pixel{_image.pixel(size_t(x), size_t(y))};
+      for (int channel{}; channel < 3; ++channel) {
+        // Rounding can push a color slightly below 0 near a vertex.
+        auto c{std::max(color[channel], 0.0f)};
+        pixel[channel] = toByte(highlight ? brighten(c) : c);
+      }
+    }
+}
+
+#ifdef SIMD_X86
+// Every operation is the scalar path's, in the same order and without FMA
+// (which the target leaves out so that nothing gets contracted), so both
+// draw the same bytes.
+SIMD_TARGET("avx2")
+void SoftwareRasterizer::rasterizeAvx2(const Triangle &triangle, int minX,
+                                       int minY, int maxX, int maxY) {
+  auto zero{_mm256_setzero_ps()};
+  auto epsilon{_mm256_set1_ps(highlightEpsilon)};
+  auto centerEpsilon{_mm256_set1_ps(10 * highlightEpsilon)};
+  __m256 a[3], b[3], c[3], topLeft[3], inverseW[3], colors[3][3];
+  for (size_t i{}; i < 3; ++i) {
+    a[i] = _mm256_set1_ps(triangle.a[i]);
+    b[i] = _mm256_set1_ps(triangle.b[i]);
+    c[i] = _mm256_set1_ps(triangle.c[i]);
+    topLeft[i] = _mm256_castsi256_ps(
+        _mm256_set1_epi32(triangle.topLeft[i] ? -1 : 0));
+    inverseW[i] = _mm256_set1_ps(triangle.inverseW[i]);
+    for (int channel{}; channel < 3; ++channel)
+      colors[i][channel] = _mm256_set1_ps(triangle.colors[i][channel]);
+  }
+  auto laneOffsets{
+      _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f)};
+  auto end{_mm256_set1_ps(float(maxX + 1))};
+
+  for (auto y{minY}; y <= maxY; ++y) {
+    auto py{_mm256_set1_ps(y + 0.5f)};
+    __m256 rowC[3];
+    for (size_t i{}; i < 3; ++i)
+      rowC[i] = _mm256_add_ps(_mm256_mul_ps(b[i], py), c[i]);
+    auto row{_image.pixel(0, size_t(y))};
+
+    for (auto x{minX}; x <= maxX; x += 8) {
+      auto px{_mm256_add_ps(_mm256_set1_ps(float(x)), laneOffsets)};
+      auto inside{_mm256_cmp_ps(px, end, _CMP_LT_OQ)};
+      __m256 e[3];
+      for (size_t i{}; i < 3; ++i) {
+        e[i] = _mm256_add_ps(_mm256_mul_ps(a[i], px), rowC[i]);
+        auto onEdge{_mm256_and_ps(_mm256_cmp_ps(e[i], zero, _CMP_EQ_OQ),
+                                  topLeft[i])};
+        inside = _mm256_and_ps(
+            inside,
+            _mm256_or_ps(_mm256_cmp_ps(e[i], zero, _CMP_GT_OQ), onEdge));
+      }
+      auto mask{_mm256_movemask_ps(inside)};
+      if (!mask)
+        continue;
+
+      __m256 weights[3];
+      for (size_t i{}; i < 3; ++i)
+        weights[i] = _mm256_mul_ps(e[i], inverseW[i]);
+      auto inverseSum{_mm256_div_ps(
+          _mm256_set1_ps(1),
+          _mm256_add_ps(_mm256_add_ps(weights[0], weights[1]), weights[2]))};
+      for (auto &weight : weights)
+        weight = _mm256_mul_ps(weight, inverseSum);
+
+      auto nearEdge{_mm256_or_ps(
+          _mm256_cmp_ps(weights[0], epsilon, _CMP_LT_OQ),
+          _mm256_or_ps(_mm256_cmp_ps(weights[1], epsilon, _CMP_LT_OQ),
+                       _mm256_cmp_ps(weights[2], epsilon, _CMP_LT_OQ)))};
+      auto nearCenter{_mm256_and_ps(
+          nearlyEqual(weights[0], weights[1], centerEpsilon),
+          _mm256_and_ps(nearlyEqual(weights[0], weights[2], centerEpsilon),
+                        nearlyEqual(weights[1], weights[2], centerEpsilon)))};
+      auto highlight{_mm256_or_ps(nearEdge, nearCenter)};
+
+      alignas(32) int32_t bytes[3][8];
+      for (int channel{}; channel < 3; ++channel) {
+        auto color{_mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(weights[0], colors[0][channel]),
+                          _mm256_mul_ps(weights[1], colors[1][channel])),
+            _mm256_mul_ps(weights[2], colors[2][channel]))};
+        color = _mm256_max_ps(color, zero);
+        auto bright{_mm256_mul_ps(
+            _mm256_set1_ps(0.25f),
+            _mm256_add_ps(
+                _mm256_mul_ps(color, color),
+                _mm256_mul_ps(_mm256_set1_ps(2),
+                              _mm256_sqrt_ps(_mm256_add_ps(color, color)))))};
+        color = _mm256_min_ps(_mm256_blendv_ps(color, bright, highlight),
+                              _mm256_set1_ps(1));
+        _mm256_store_si256(
+            reinterpret_cast<__m256i *>(bytes[channel]),
+            _mm256_cvtps_epi32(_mm256_mul_ps(color, _mm256_set1_ps(255))));
+      }
+      for (auto lanes{unsigned(mask)}; lanes; lanes &= lanes - 1) {
+        auto lane{std::countr_zero(lanes)};
+        auto pixel{row + size_t(x + lane) * 3};
+        for (int channel{}; channel < 3; ++channel)
+          pixel[channel] = uint8_t(bytes[channel][lane]);
+      }
+    }
+  }
+}
+#endif
+
+void renderIntroTriangle(SoftwareRasterizer &rasterizer, float t,
+                         JobSystem *jobs) {
+  constexpr float pi{3.1415926535f}, r{0.5f};
+  constexpr glm::vec3 colors[]{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  auto c{std::cos(t)}, s{std::sin(t)};
+  glm::vec4 positions[3];
+  for (int i{}; i < 3; ++i) {
+    auto angle{2.0f * pi * float(i) / 3.0f};
+    glm::vec2 p{r * std::cos(angle), r * std::sin(angle)};
+    // mat3(c, -s, 0, s, c, 0, 0, 0, 1) * p, GLSL matrices being given
+    // column by column.
+    positions[i] = {c * p.x + s * p.y, -s * p.x + c * p.y, 0, 1};
+  }
+  rasterizer.render({1, 1, 1}, positions, colors, 3, jobs);
+}
+
+void benchmarkSoftwareRasterizer(JobSystem *jobs) {
+  auto level{simdLevel()};
+  for (auto [width, height] :
+       {std::pair<size_t, size_t>{900, 900}, {3840, 2160}}) {
+    SoftwareRasterizer rasterizer{width, height};
+    renderIntroTriangle(rasterizer, 0, jobs);
+    constexpr int frames{100};
+    auto start{std::chrono::steady_clock::now()};
+    for (int frame{}; frame < frames; ++frame)
+      renderIntroTriangle(rasterizer, 0.01f * float(frame), jobs);
+    std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() -
+                                          start};
+    std::printf("%zux%zu: %.1f frames/s (%s, %zu threads)\n", width, height,
+                frames / elapsed.count(), simdLevelName(level),
+                jobs ? jobs->threadCount() : 1);
+  }
+
+  // The scalar fallback has to draw the same bytes as the vector path.
+  if (level == SimdLevel::Scalar)
+    return;
+  SoftwareRasterizer vector{900, 900}, scalar{900, 900};
+  size_t differentPixels{};
+  int maxError{};
+  for (int frame{}; frame < 100; ++frame) {
+    auto t{0.0637f * float(frame)};
+    renderIntroTriangle(vector, t, jobs);
+    setSimdLevel(SimdLevel::Scalar);
+    renderIntroTriangle(scalar, t, jobs);
+    setSimdLevel(level);
+    for (size_t i{}; i < vector.image().sizeInBytes(); i += 3) {
+      auto p{vector.image().data() + i}, q{scalar.image().data() + i};
+      auto different{false};
+      for (size_t channel{}; channel < 3; ++channel) {
+        auto error{std::abs(int(p[channel]) - int(q[channel]))};
+        maxError = std::max(maxError, error);
+        different |= error > 0;
+      }
+      differentPixels += different;
+    }
+  }
+  std::printf("%s vs scalar, 100 frames at 900x900: %zu pixels differ, "
+              "by at most %d\n",
+              simdLevelName(level), differentPixels, maxError);
+}
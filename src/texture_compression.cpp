@@ -0,0 +1,633 @@
+#include "texture_compression.hpp"
+#include "gl_util.hpp"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+// Core OpenGL 4.6 only guarantees BPTC; S3TC comes from
+// EXT_texture_compression_s3tc, which glad was not generated with.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+using Block = std::array<glm::vec4, 16>;
+
+constexpr uint32_t cacheMagic{0x31544342}; // "BCT1"
+
+struct CacheHeader {
+  uint32_t magic, format, quality, width, height, levelCount;
+};
+
+constexpr int bc7Weights[16]{0,  4,  9,  13, 17, 21, 26, 30,
+                             34, 38, 43, 47, 51, 55, 60, 64};
+
+Block fetchBlock(const Image &image, size_t bx, size_t by) {
+  Block block;
+  for (size_t y{}; y < 4; ++y)
+    for (size_t x{}; x < 4; ++x) {
+      auto p{image.pixel(std::min(bx * 4 + x, image.width() - 1),
+                         std::min(by * 4 + y, image.height() - 1))};
+      block[y * 4 + x] = {p[0], p[1], p[2], 255};
+    }
+  return block;
+}
+
+void storeBlock(Image &image, size_t bx, size_t by, const Block &block) {
+  for (size_t y{}; y < 4 && by * 4 + y < image.height(); ++y)
+    for (size_t x{}; x < 4 && bx * 4 + x < image.width(); ++x) {
+      auto p{image.pixel(bx * 4 + x, by * 4 + y)};
+      for (size_t c{}; c < 3; ++c)
+        p[c] = uint8_t(glm::clamp(block[y * 4 + x][c], 0.0f, 255.0f));
+    }
+}
+
+Image downsample(const Image &source) {
+  Image result{std::max<size_t>(1, source.width() / 2),
+               std::max<size_t>(1, source.height() / 2)};
+  for (size_t y{}; y < result.height(); ++y)
+    for (size_t x{}; x < result.width(); ++x)
+      for (size_t c{}; c < 3; ++c) {
+        unsigned sum{2};
+        for (size_t dy{}; dy < 2; ++dy)
+          for (size_t dx{}; dx < 2; ++dx)
+            sum += source.pixel(std::min(x * 2 + dx, source.width() - 1),
+                                std::min(y * 2 + dy, source.height() - 1))[c];
+        result.pixel(x, y)[c] = uint8_t(sum / 4);
+      }
+  return result;
+}
+
+// Endpoints spanning the block along its bounding box diagonal (quality 0) or
+// its principal axis. Channels outside mask are ignored.
+void fitEndpoints(const Block &block, glm::vec4 mask, int quality,
+                  glm::vec4 &e0, glm::vec4 &e1) {
+  glm::vec4 lo{255}, hi{0}, mean{0};
+  for (auto &p : block) {
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+    mean += p / 16.0f;
+  }
+  e0 = lo;
+  e1 = hi;
+  if (quality == 0)
+    return;
+
+  glm::mat4 covariance{0};
+  for (auto &p : block) {
+    auto d{(p - mean) * mask};
+    covariance += glm::outerProduct(d, d);
+  }
+  auto axis{(hi - lo) * mask};
+  for (int i{}; i < 8; ++i) {
+    auto next{covariance * axis};
+    auto length{glm::length(next)};
+    if (length < 1e-6f)
+      break;
+    axis = next / length;
+  }
+  auto axisLength{glm::length(axis)};
+  if (axisLength < 1e-6f)
+    return;
+  axis /= axisLength;
+
+  float tMin{1e9f}, tMax{-1e9f};
+  for (auto &p : block) {
+    auto t{glm::dot((p - mean) * mask, axis)};
+    tMin = std::min(tMin, t);
+    tMax = std::max(tMax, t);
+  }
+  e0 = glm::clamp(mean + axis * tMin, 0.0f, 255.0f);
+  e1 = glm::clamp(mean + axis * tMax, 0.0f, 255.0f);
+}
+
+// Least-squares endpoints for fixed interpolation weights, t[i] being the
+// weight of e1 for pixel i.
+bool refineEndpoints(const Block &block, const float *t, glm::vec4 &e0,
+                     glm::vec4 &e1) {
+  float aa{}, ab{}, bb{};
+  glm::vec4 ax{0}, bx{0};
+  for (size_t i{}; i < 16; ++i) {
+    auto a{1.0f - t[i]}, b{t[i]};
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    ax += a * block[i];
+    bx += b * block[i];
+  }
+  auto det{aa * bb - ab * ab};
+  if (std::abs(det) < 1e-6f)
+    return false;
+  e0 = glm::clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f);
+  e1 = glm::clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f);
+  return true;
+}
+
+float distance2(glm::vec4 a, glm::vec4 b, glm::vec4 mask) {
+  auto d{(a - b) * mask};
+  return glm::dot(d, d);
+}
+
+void putBits(uint8_t *out, size_t &offset, uint32_t value, size_t count) {
+  for (size_t i{}; i < count; ++i, ++offset)
+    if (value >> i & 1)
+      out[offset / 8] |= uint8_t(1 << offset % 8);
+}
+
+uint32_t getBits(const uint8_t *in, size_t &offset, size_t count) {
+  uint32_t value{};
+  for (size_t i{}; i < count; ++i, ++offset)
+    value |= uint32_t(in[offset / 8] >> offset % 8 & 1) << i;
+  return value;
+}
+
+// BC1 ------------------------------------------------------------------------
+
+uint16_t packRgb565(glm::vec4 c) {
+  auto r{unsigned(c.r * 31.0f / 255.0f + 0.5f)};
+  auto g{unsigned(c.g * 63.0f / 255.0f + 0.5f)};
+  auto b{unsigned(c.b * 31.0f / 255.0f + 0.5f)};
+  return uint16_t(r << 11 | g << 5 | b);
+}
+
+glm::vec4 unpackRgb565(uint16_t v) {
+  unsigned r{v >> 11 & 31u}, g{v >> 5 & 63u}, b{v & 31u};
+  return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 255};
+}
+
+void bc1Palette(uint16_t c0, uint16_t c1, glm::vec4 palette[4]) {
+  palette[0] = unpackRgb565(c0);
+  palette[1] = unpackRgb565(c1);
+  if (c0 > c1) {
+    palette[2] = glm::floor((2.0f * palette[0] + palette[1]) / 3.0f);
+    palette[3] = glm::floor((palette[0] + 2.0f * palette[1]) / 3.0f);
+  } else {
+    palette[2] = glm::floor((palette[0] + palette[1]) / 2.0f);
+    palette[3] = {0, 0, 0, 255};
+  }
+}
+
+struct Bc1Fit {
+  uint16_t c0, c1;
+  uint32_t indices;
+  float error;
+};
+
+// Evaluates endpoints in four-colour mode, regardless of their order.
+Bc1Fit assignBc1(const Block &block, uint16_t c0, uint16_t c1) {
+  constexpr glm::vec4 rgb{1, 1, 1, 0};
+  glm::vec4 palette[4];
+  bc1Palette(std::max(c0, c1), std::min(c0, c1), palette);
+  if (c0 < c1)
+    std::swap(palette[0], palette[1]), std::swap(palette[2], palette[3]);
+  Bc1Fit fit{c0, c1, 0, 0};
+  for (size_t i{}; i < 16; ++i) {
+    uint32_t best{};
+    auto bestError{distance2(block[i], palette[0], rgb)};
+    for (uint32_t j{1}; j < 4; ++j) {
+      auto error{distance2(block[i], palette[j], rgb)};
+      if (error < bestError)
+        best = j, bestError = error;
+    }
+    fit.indices |= best << 2 * i;
+    fit.error += bestError;
+  }
+  return fit;
+}
+
+void encodeBc1(const Block &block, int quality, uint8_t *out) {
+  constexpr float weights[4]{0, 1, 1.0f / 3.0f, 2.0f / 3.0f};
+  glm::vec4 e0, e1;
+  fitEndpoints(block, {1, 1, 1, 0}, quality, e0, e1);
+  auto fit{assignBc1(block, packRgb565(e0), packRgb565(e1))};
+  for (int pass{1}; pass < quality; ++pass) {
+    float t[16];
+    for (size_t i{}; i < 16; ++i)
+      t[i] = weights[fit.indices >> 2 * i & 3];
+    if (!refineEndpoints(block, t, e0, e1))
+      break;
+    auto candidate{assignBc1(block, packRgb565(e0), packRgb565(e1))};
+    if (candidate.error >= fit.error)
+      break;
+    fit = candidate;
+  }
+
+  if (fit.c0 < fit.c1) {
+    std::swap(fit.c0, fit.c1);
+    fit.indices ^= 0x55555555; // 0 <-> 1, 2 <-> 3
+  } else if (fit.c0 == fit.c1) {
+    fit.indices = 0; // index 3 would be transparent black in this mode
+  }
+  out[0] = uint8_t(fit.c0), out[1] = uint8_t(fit.c0 >> 8);
+  out[2] = uint8_t(fit.c1), out[3] = uint8_t(fit.c1 >> 8);
+  for (size_t i{}; i < 4; ++i)
+    out[4 + i] = uint8_t(fit.indices >> 8 * i);
+}
+
+void decodeBc1(const uint8_t *in, Block &block) {
+  auto c0{uint16_t(in[0] | in[1] << 8)}, c1{uint16_t(in[2] | in[3] << 8)};
+  glm::vec4 palette[4];
+  bc1Palette(c0, c1, palette);
+  for (size_t i{}; i < 16; ++i)
+    block[i] = palette[in[4 + i / 4] >> 2 * (i % 4) & 3];
+}
+
+// BC3 (BC1 colour plus a BC4 alpha block) ------------------------------------
+
+void encodeBc4Alpha(const Block &block, uint8_t *out) {
+  float lo{255}, hi{0};
+  for (auto &p : block)
+    lo = std::min(lo, p.a), hi = std::max(hi, p.a);
+  std::fill(out, out + 8, uint8_t{0});
+  out[0] = uint8_t(hi + 0.5f);
+  out[1] = uint8_t(lo + 0.5f);
+  if (out[0] == out[1])
+    return;
+
+  float palette[8]{float(out[0]), float(out[1])};
+  for (int i{1}; i < 7; ++i)
+    palette[i + 1] = std::floor(((7 - i) * palette[0] + i * palette[1]) / 7);
+  size_t offset{16};
+  for (auto &p : block) {
+    uint32_t best{};
+    for (uint32_t j{1}; j < 8; ++j)
+      if (std::abs(p.a - palette[j]) < std::abs(p.a - palette[best]))
+        best = j;
+    putBits(out, offset, best, 3);
+  }
+}
+
+void decodeBc4Alpha(const uint8_t *in, Block &block) {
+  float palette[8]{float(in[0]), float(in[1])};
+  if (in[0] > in[1]) {
+    for (int i{1}; i < 7; ++i)
+      palette[i + 1] = std::floor(((7 - i) * palette[0] + i * palette[1]) / 7);
+  } else {
+    for (int i{1}; i < 5; ++i)
+      palette[i + 1] = std::floor(((5 - i) * palette[0] + i * palette[1]) / 5);
+    palette[6] = 0, palette[7] = 255;
+  }
+  size_t offset{16};
+  for (auto &p : block)
+    p.a = palette[getBits(in, offset, 3)];
+}
+
+// BC7, mode 6 only: one RGBA subset, 7-bit endpoints with a p-bit each and
+// 4-bit indices. It is the mode that suits smooth, opaque photographic
+// content best, which is all our PPMs hold.
+
+struct Bc7Fit {
+  glm::ivec4 c[2];
+  int p[2];
+  uint8_t indices[16];
+  float error;
+};
+
+glm::vec4 expandBc7(glm::ivec4 c, int p) { return glm::vec4(c * 2 + p); }
+
+glm::ivec4 quantizeBc7(glm::vec4 e, int p) {
+  return glm::clamp(glm::ivec4(glm::round((e - float(p)) / 2.0f)), 0, 127);
+}
+
+void assignBc7(const Block &block, Bc7Fit &fit) {
+  auto e0{expandBc7(fit.c[0], fit.p[0])}, e1{expandBc7(fit.c[1], fit.p[1])};
+  glm::vec4 palette[16];
+  for (size_t j{}; j < 16; ++j)
+    palette[j] = glm::floor(
+        ((64.0f - bc7Weights[j]) * e0 + float(bc7Weights[j]) * e1 + 32.0f) /
+        64.0f);
+  fit.error = 0;
+  for (size_t i{}; i < 16; ++i) {
+    uint8_t best{};
+    auto bestError{distance2(block[i], palette[0], glm::vec4{1})};
+    for (uint8_t j{1}; j < 16; ++j) {
+      auto error{distance2(block[i], palette[j], glm::vec4{1})};
+      if (error < bestError)
+        best = j, bestError = error;
+    }
+    fit.indices[i] = best;
+    fit.error += bestError;
+  }
+}
+
+Bc7Fit quantizeAndAssignBc7(const Block &block, glm::vec4 e0, glm::vec4 e1,
+                            bool searchPBits) {
+  Bc7Fit best{};
+  best.error = 1e30f;
+  if (searchPBits) {
+    for (int p{}; p < 4; ++p) {
+      Bc7Fit fit{{quantizeBc7(e0, p & 1), quantizeBc7(e1, p >> 1)},
+                 {p & 1, p >> 1},
+                 {},
+                 0};
+      assignBc7(block, fit);
+      if (fit.error < best.error)
+        best = fit;
+    }
+    return best;
+  }
+  glm::vec4 endpoints[2]{e0, e1};
+  for (size_t e{}; e < 2; ++e) {
+    float bestError{1e30f};
+    for (int p{}; p < 2; ++p) {
+      auto c{quantizeBc7(endpoints[e], p)};
+      auto error{distance2(endpoints[e], expandBc7(c, p), glm::vec4{1})};
+      if (error < bestError)
+        bestError = error, best.c[e] = c, best.p[e] = p;
+    }
+  }
+  assignBc7(block, best);
+  return best;
+}
+
+void encodeBc7(const Block &block, int quality, uint8_t *out) {
+  glm::vec4 e0, e1;
+  fitEndpoints(block, glm::vec4{1}, quality, e0, e1);
+  auto searchPBits{quality >= 2};
+  auto fit{quantizeAndAssignBc7(block, e0, e1, searchPBits)};
+  for (int pass{1}; pass < quality; ++pass) {
+    float t[16];
+    for (size_t i{}; i < 16; ++i)
+      t[i] = bc7Weights[fit.indices[i]] / 64.0f;
+    if (!refineEndpoints(block, t, e0, e1))
+      break;
+    auto candidate{quantizeAndAssignBc7(block, e0, e1, searchPBits)};
+    if (candidate.error >= fit.error)
+      break;
+    fit = candidate;
+  }
+
+  // The anchor (first) index is stored without its top bit.
+  if (fit.indices[0] & 8) {
+    std::swap(fit.c[0], fit.c[1]);
+    std::swap(fit.p[0], fit.p[1]);
+    for (auto &index : fit.indices)
+      index = uint8_t(15 - index);
+  }
+  std::fill(out, out + 16, uint8_t{0});
+  size_t offset{};
+  putBits(out, offset, 1 << 6, 7);
+  for (int channel{}; channel < 4; ++channel)
+    for (size_t e{}; e < 2; ++e)
+      putBits(out, offset, uint32_t(fit.c[e][channel]), 7);
+  putBits(out, offset, uint32_t(fit.p[0]), 1);
+  putBits(out, offset, uint32_t(fit.p[1]), 1);
+  for (size_t i{}; i < 16; ++i)
+    putBits(out, offset, fit.indices[i], i == 0 ? 3 : 4);
+}
+
+void decodeBc7(const uint8_t *in, Block &block) {
+  if ((in[0] & 0x7F) != 0x40)
+    throw std::runtime_error{"only BC7 mode 6 blocks can be decoded"};
+  size_t offset{7};
+  glm::ivec4 c[2];
+  for (int channel{}; channel < 4; ++channel)
+    for (size_t e{}; e < 2; ++e)
+      c[e][channel] = int(getBits(in, offset, 7));
+  int p0{int(getBits(in, offset, 1))}, p1{int(getBits(in, offset, 1))};
+  auto e0{expandBc7(c[0], p0)}, e1{expandBc7(c[1], p1)};
+  for (size_t i{}; i < 16; ++i) {
+    auto w{float(bc7Weights[getBits(in, offset, i == 0 ? 3 : 4)])};
+    block[i] = glm::floor(((64.0f - w) * e0 + w * e1 + 32.0f) / 64.0f);
+  }
+}
+
+void encodeBlock(BcFormat format, const Block &block, int quality,
+                 uint8_t *out) {
+  switch (format) {
+  case BcFormat::Bc1:
+    encodeBc1(block, quality, out);
+    break;
+  case BcFormat::Bc3:
+    encodeBc4Alpha(block, out);
+    encodeBc1(block, quality, out + 8);
+    break;
+  case BcFormat::Bc7:
+    encodeBc7(block, quality, out);
+    break;
+  }
+}
+
+void decodeBlock(BcFormat format, const uint8_t *in, Block &block) {
+  switch (format) {
+  case BcFormat::Bc1:
+    decodeBc1(in, block);
+    break;
+  case BcFormat::Bc3:
+    decodeBc1(in + 8, block);
+    decodeBc4Alpha(in, block);
+    break;
+  case BcFormat::Bc7:
+    decodeBc7(in, block);
+    break;
+  }
+}
+
+size_t blocksAcross(size_t pixels) { return (pixels + 3) / 4; }
+
+std::vector<size_t> levelOffsets(BcFormat format, size_t width, size_t height,
+                                 size_t levelCount) {
+  std::vector<size_t> offsets{0};
+  for (size_t level{}; level < levelCount; ++level) {
+    auto w{std::max<size_t>(1, width >> level)};
+    auto h{std::max<size_t>(1, height >> level)};
+    offsets.push_back(offsets.back() + bcLevelSizeInBytes(format, w, h));
+  }
+  return offsets;
+}
+} // namespace
+
+size_t bcBlockSizeInBytes(BcFormat format) {
+  return format == BcFormat::Bc1 ? 8 : 16;
+}
+
+size_t bcLevelSizeInBytes(BcFormat format, size_t width, size_t height) {
+  return blocksAcross(width) * blocksAcross(height) *
+         bcBlockSizeInBytes(format);
+}
+
+GLenum bcGlInternalFormat(BcFormat format) {
+  switch (format) {
+  case BcFormat::Bc1:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case BcFormat::Bc3:
+    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case BcFormat::Bc7:
+  default:
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  }
+}
+
+GLuint uploadBcTexture(BcFormat format, size_t width, size_t height,
+                       size_t levelCount, const uint8_t *levels) {
+  auto internalFormat{bcGlInternalFormat(format)};
+  GLuint texture;
+  glCheck(glCreateTextures(GL_TEXTURE_2D, 1, &texture));
+  glCheck(glTextureStorage2D(texture, GLsizei(levelCount), internalFormat,
+                             GLsizei(width), GLsizei(height)));
+  for (size_t level{}; level < levelCount; ++level) {
+    auto w{std::max<size_t>(1, width >> level)};
+    auto h{std::max<size_t>(1, height >> level)};
+    auto size{bcLevelSizeInBytes(format, w, h)};
+    glCheck(glCompressedTextureSubImage2D(texture, GLint(level), 0, 0,
+                                          GLsizei(w), GLsizei(h),
+                                          internalFormat, GLsizei(size),
+                                          levels));
+    levels += size;
+  }
+  glCheck(glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER,
+                              levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR
+                                             : GL_LINEAR));
+  glCheck(glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  return texture;
+}
+
+CompressedTexture::CompressedTexture(const Image &image,
+                                     const BcEncodeSettings &settings,
+                                     BcEncodeReport *report)
+    : _format{settings.format}, _quality{std::clamp(settings.quality, 0, 8)},
+      _width{image.width()}, _height{image.height()} {
+  auto start{std::chrono::steady_clock::now()};
+
+  std::vector<Image> levels{image};
+  auto maxLevelCount{settings.maxLevelCount ? settings.maxLevelCount
+                                             : ~size_t{}};
+  while (settings.generateMips && levels.size() < maxLevelCount &&
+         (levels.back().width() > 1 || levels.back().height() > 1))
+    levels.push_back(downsample(levels.back()));
+  _levelOffsets = levelOffsets(_format, _width, _height, levels.size());
+  _blocks.resize(_levelOffsets.back());
+
+  // Rows of blocks across every level are handed out to the workers one at a
+  // time, so small mip levels don't leave threads idle.
+  std::vector<std::pair<size_t, size_t>> rows;
+  for (size_t level{}; level < levels.size(); ++level)
+    for (size_t by{}; by < blocksAcross(levels[level].height()); ++by)
+      rows.emplace_back(level, by);
+
+  std::atomic<size_t> nextRow{};
+  auto worker{[&] {
+    for (size_t row; (row = nextRow.fetch_add(1)) < rows.size();) {
+      auto [level, by]{rows[row]};
+      auto &source{levels[level]};
+      auto across{blocksAcross(source.width())};
+      auto out{&_blocks[_levelOffsets[level] +
+                        by * across * bcBlockSizeInBytes(_format)]};
+      for (size_t bx{}; bx < across; ++bx)
+        encodeBlock(_format, fetchBlock(source, bx, by), _quality,
+                    out + bx * bcBlockSizeInBytes(_format));
+    }
+  }};
+  auto threadCount{settings.threadCount ? settings.threadCount
+                                        : std::thread::hardware_concurrency()};
+  std::vector<std::thread> threads;
+  for (size_t i{1}; i < threadCount; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &thread : threads)
+    thread.join();
+
+  if (report) {
+    report->seconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    report->psnr = psnr(image, decode(0));
+    report->sourceBytes = 0;
+    for (auto &level : levels)
+      report->sourceBytes += level.sizeInBytes();
+    report->compressedBytes = _blocks.size();
+  }
+}
+
+CompressedTexture::CompressedTexture(const std::filesystem::path &cachePath) {
+  std::ifstream in{cachePath, std::ios::binary};
+  if (!in)
+    throw std::runtime_error{"could not open " + cachePath.string()};
+  CacheHeader header{};
+  in.read(reinterpret_cast<char *>(&header), sizeof header);
+  if (!in || header.magic != cacheMagic || header.format > 2)
+    throw std::runtime_error{cachePath.string() +
+                             " is not a compressed texture cache"};
+  _format = BcFormat(header.format);
+  _quality = int(header.quality);
+  _width = header.width;
+  _height = header.height;
+  _levelOffsets = levelOffsets(_format, _width, _height, header.levelCount);
+  _blocks.resize(_levelOffsets.back());
+  if (!in.read(reinterpret_cast<char *>(_blocks.data()),
+               std::streamsize(_blocks.size())))
+    throw std::runtime_error{cachePath.string() + " is truncated"};
+}
+
+BcFormat CompressedTexture::format() const { return _format; }
+int CompressedTexture::quality() const { return _quality; }
+size_t CompressedTexture::width() const { return _width; }
+size_t CompressedTexture::height() const { return _height; }
+size_t CompressedTexture::levelCount() const {
+  return _levelOffsets.empty() ? 0 : _levelOffsets.size() - 1;
+}
+
+size_t CompressedTexture::levelWidth(size_t level) const {
+  return std::max<size_t>(1, _width >> level);
+}
+
+size_t CompressedTexture::levelHeight(size_t level) const {
+  return std::max<size_t>(1, _height >> level);
+}
+
+size_t CompressedTexture::levelSizeInBytes(size_t level) const {
+  return _levelOffsets[level + 1] - _levelOffsets[level];
+}
+
+const uint8_t *CompressedTexture::levelData(size_t level) const {
+  return &_blocks[_levelOffsets[level]];
+}
+
+size_t CompressedTexture::sizeInBytes() const { return _blocks.size(); }
+
+Image CompressedTexture::decode(size_t level) const {
+  Image image{levelWidth(level), levelHeight(level)};
+  auto across{blocksAcross(image.width())};
+  auto data{levelData(level)};
+  Block block;
+  for (size_t by{}; by < blocksAcross(image.height()); ++by)
+    for (size_t bx{}; bx < across; ++bx) {
+      decodeBlock(_format,
+                  data + (by * across + bx) * bcBlockSizeInBytes(_format),
+                  block);
+      storeBlock(image, bx, by, block);
+    }
+  return image;
+}
+
+void CompressedTexture::save(const std::filesystem::path &cachePath) const {
+  std::ofstream out{cachePath, std::ios::binary};
+  if (!out)
+    throw std::runtime_error{"could not create " + cachePath.string()};
+  CacheHeader header{cacheMagic,       uint32_t(_format),
+                     uint32_t(_quality), uint32_t(_width),
+                     uint32_t(_height),  uint32_t(levelCount())};
+  out.write(reinterpret_cast<const char *>(&header), sizeof header);
+  out.write(reinterpret_cast<const char *>(_blocks.data()),
+            std::streamsize(_blocks.size()));
+}
+
+GLuint CompressedTexture::upload() const {
+  return uploadBcTexture(_format, _width, _height, levelCount(),
+                         _blocks.data());
+}
@@ -1,14 +1,17 @@
 #include "window.hpp"
 
-Window::Window(size_t width, size_t height, const char *title)
+#include <utility>
+
+Window::Window(size_t width, size_t height, const char *title, int samples,
+               GlVersion version)
     : _width{width}, _height{height} {
   if (!glfwInit())
     throw std::runtime_error{"GLFW could not be initialized"};
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version.major);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version.minor);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-  glfwWindowHint(GLFW_SAMPLES, 8);
+  glfwWindowHint(GLFW_SAMPLES, samples);
   glfwSwapInterval(0);
   _window = glfwCreateWindow(GLsizei(width), GLsizei(height), title, nullptr,
                              nullptr);
@@ -24,15 +27,14 @@ Window::Window(size_t width, size_t height, const char *title)
   if (glfwRawMouseMotionSupported())
     glfwSetInputMode(_window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
 
-  glfwSetWindowSizeCallback(_window,
-                            [](GLFWwindow *window, int width, int height) {
-                              glViewport(0, 0, width, height);
-                            });
-
-  //glfwSetFramebufferSizeCallback(_window,
-  //                               [](GLFWwindow *window, int width, int height) {
-  //                                 glViewport(0, 0, width, height);
-  //                               });
+  glfwSetWindowUserPointer(_window, this);
+  glfwSetFramebufferSizeCallback(
+      _window, [](GLFWwindow *window, int width, int height) {
+        glViewport(0, 0, width, height);
+        auto self{static_cast<Window *>(glfwGetWindowUserPointer(window))};
+        if (self->_framebufferSizeCallback)
+          self->_framebufferSizeCallback(size_t(width), size_t(height));
+      });
 }
 
 Window::~Window() {
@@ -59,6 +61,10 @@ bool Window::keyIsPressed(int key) const {
   return glfwGetKey(_window, key) == GLFW_PRESS;
 }
 
+bool Window::mouseButtonIsPressed(int button) const {
+  return glfwGetMouseButton(_window, button) == GLFW_PRESS;
+}
+
 std::tuple<float, float> Window::getCursorPos() const {
   double x, y;
   glfwGetCursorPos(_window, &x, &y);
@@ -66,3 +72,8 @@ std::tuple<float, float> Window::getCursorPos() const {
 }
 
 void Window::show() const { glfwShowWindow(_window); }
+
+void Window::setFramebufferSizeCallback(
+    std::function<void(size_t width, size_t height)> callback) {
+  _framebufferSizeCallback = std::move(callback);
+}